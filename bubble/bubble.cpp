@@ -99,6 +99,44 @@ public:
 		vVector4Lerp( io_vColor, io_vColor, vColor, fSaturate( fAlpha ) );
 		return true;
 	}
+
+	#ifndef VISUALIZE_RATE_OF_CHANGE
+	uint32 iGetBatchSize() { return 4; }
+	void ExecuteBatch( m3dpixelbatch &io_Batch, uint32 &io_iLaneMask )
+	{
+		// Look up the film and the environment for all four pixels at once.
+		vector4 vFilmCoords[4], vReflections[4];
+		for( uint32 iLane = 0; iLane < 4; ++iLane )
+		{
+			vFilmCoords[iLane] = vector4( io_Batch.Inputs[0].x[iLane], io_Batch.Inputs[0].y[iLane], 0.0f, 0.0f );
+			vReflections[iLane] = vector4( io_Batch.Inputs[1].x[iLane], io_Batch.Inputs[1].y[iLane], io_Batch.Inputs[1].z[iLane], 0.0f );
+		}
+
+		vector4 vRainbowFilm[4], vReflectionEnv[4];
+		SampleTextureQuad( vRainbowFilm, 0, vFilmCoords );
+		SampleTextureQuad( vReflectionEnv, 1, vReflections );
+
+		for( uint32 iLane = 0; iLane < 4; ++iLane )
+		{
+			const float32 fFresnel = 1.0f - fabsf( io_Batch.Inputs[2].x[iLane] );
+
+			float32 fAlpha = fSaturate( 4.0f * ( vReflectionEnv[iLane].a * vReflectionEnv[iLane].a - 0.75f ) );
+			const vector4 vBaseEnvColor = ( vRainbowFilm[iLane] * vReflectionEnv[iLane] * 2.0f ).saturate();
+
+			vector4 vColor;
+			vVector4Lerp( vColor, vBaseEnvColor, vReflectionEnv[iLane], fAlpha );
+
+			fAlpha += 0.6f * fFresnel + 0.1f;
+
+			vector4 vPixelColor( io_Batch.Color.x[iLane], io_Batch.Color.y[iLane], io_Batch.Color.z[iLane], io_Batch.Color.w[iLane] );
+			vVector4Lerp( vPixelColor, vPixelColor, vColor, fSaturate( fAlpha ) );
+			io_Batch.Color.x[iLane] = vPixelColor.r;
+			io_Batch.Color.y[iLane] = vPixelColor.g;
+			io_Batch.Color.z[iLane] = vPixelColor.b;
+			io_Batch.Color.w[iLane] = vPixelColor.a;
+		}
+	}
+	#endif
 };
 
 m3dvertexelement VertexDeclaration[] =
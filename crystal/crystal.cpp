@@ -171,13 +171,14 @@ void CCrystal::Render( uint32 i_iPass )
 	CModel *pModel = (CModel *)pResManager->pGetResource( m_hModel );
 	pGraphics->SetVertexFormat( pModel->pGetVertexFormat() );
 	pGraphics->SetVertexStream( 0, pModel->pGetVertexBuffer(), 0, pModel->iGetStride() );
+	pGraphics->SetIndexBuffer( pModel->pGetIndexBuffer() );
 
 	pGraphics->SetVertexShader( m_pVertexShader );
 	pGraphics->SetPixelShader( m_pPixelShader );
 
 	pGraphics->SetRenderState( m3drs_cullmode, m3dcull_cw );
-	pGraphics->pGetM3DDevice()->DrawPrimitive( m3dpt_trianglelist, 0, pModel->iGetNumFaces() );
+	pGraphics->pGetM3DDevice()->DrawIndexedPrimitive( m3dpt_trianglelist, 0, 0, pModel->iGetNumVertices(), 0, pModel->iGetNumFaces() );
 
 	pGraphics->SetRenderState( m3drs_cullmode, m3dcull_ccw );
-	pGraphics->pGetM3DDevice()->DrawPrimitive( m3dpt_trianglelist, 0, pModel->iGetNumFaces() );
+	pGraphics->pGetM3DDevice()->DrawIndexedPrimitive( m3dpt_trianglelist, 0, 0, pModel->iGetNumVertices(), 0, pModel->iGetNumFaces() );
 }
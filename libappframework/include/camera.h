@@ -33,10 +33,11 @@ public:
 	// RenderPass sets the necessary states to render a specific pass and then calls the scene's render function
 	virtual void RenderPass( int32 i_iPass = -1 ) = 0; // -1 = render all passes
 	
-	void EndRender( bool i_bPresentToScreen = false );
+	void EndRender( bool i_bPresentToScreen = false ); // Presenting is asynchronous: The next frame is rendered to a second colorbuffer
 
 private:
 	void BuildFrustum();
+	void SwapColorBuffers();
 
 public:
 	inline class CGraphics *pGetParent() { return m_pParent; }
@@ -76,6 +77,10 @@ public:
 	CMuli3DRenderTarget *m_pRenderTarget;
 	bool m_bLockedSurfacesViewport;
 
+	CMuli3DSurface *m_pColorBuffers[2];
+	uint32 m_iPresentFences[2]; // Fences of the last presents of the colorbuffers
+	uint32 m_iCurColorBuffer;
+
 	matrix44	m_matWorld, m_matView, m_matProjection;
 	plane		m_plFrustum[6];
 
@@ -0,0 +1,41 @@
+
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include "base.h"
+#include "../../libmuli3d/include/m3d.h"
+
+#ifdef WIN32
+#include <windows.h>
+#endif
+
+// Maps a file into memory. The mapping is copy-on-write: the contents may be
+// modified, but changes are private to the process and never written back.
+// Pages are shared with other processes mapping the same file until they are
+// written to. On AmigaOS the file is read into memory instead.
+class CMappedFile : public IBase
+{
+public:
+	CMappedFile();
+
+	bool bOpen( const char *i_szFilename );
+
+	inline byte *pGetData() { return m_pData; }
+	inline uint32 iGetSize() { return m_iSize; }
+
+protected:
+	~CMappedFile();
+
+private:
+	byte *m_pData;
+	uint32 m_iSize;
+#ifdef WIN32
+	HANDLE m_hFile, m_hMapping;
+#endif
+};
+
+// Retrieves the size and modification time of a file, used to detect whether a
+// file derived from it is stale.
+bool bGetFileStamp( const char *i_szFilename, uint32 &o_iSize, uint64 &o_iTime );
+
+#endif // __MAPPEDFILE_H__
@@ -0,0 +1,50 @@
+
+#ifndef __PAGEFILE_H__
+#define __PAGEFILE_H__
+
+#include "base.h"
+#include "../../libmuli3d/include/m3d.h"
+#include <stdio.h>
+
+// Page files store the pages of a virtual texture: a pagefileheader is followed
+// by the pages of all mip-levels, largest mip-level first and row by row, each
+// page c_iVirtualPageSize x c_iVirtualPageSize pixels. Pages at the right and
+// bottom edges are padded with zeros.
+struct pagefileheader
+{
+	uint32 iMagic;
+	uint32 iWidth, iHeight;
+	uint32 iMipLevels;
+	uint32 iFormat;		// member of m3dformat
+	uint32 iPageSize;	// c_iVirtualPageSize of the writer
+};
+
+// Page source reading the pages of a virtual texture from a page file on the loader thread.
+class CPageFile : public IMuli3DPageSource
+{
+public:
+	CPageFile();
+
+	bool bOpen( const char *i_szFilename );
+	bool bLoadPage( void *o_pData, uint32 i_iMipLevel, uint32 i_iPageX, uint32 i_iPageY );
+
+	inline const pagefileheader &GetHeader() { return m_Header; }
+
+protected:
+	~CPageFile();
+
+private:
+	FILE *m_pFile;
+	pagefileheader m_Header;
+	uint32 m_iPageBytes;
+	uint32 m_iFirstPages[32];	// index of the first page of each mip-level
+	uint32 m_iPagesX[32];		// pages per row of each mip-level
+};
+
+// Writes all mip-levels of a texture to a page file.
+bool bWritePageFile( const char *i_szFilename, CMuli3DTexture *i_pTexture );
+
+// Creates a virtual texture, whose pages are read from a page file.
+bool bCreateVirtualTexture( CMuli3DVirtualTexture **o_ppTexture, CMuli3DDevice *i_pDevice, const char *i_szFilename, uint32 i_iResidentPages );
+
+#endif // __PAGEFILE_H__
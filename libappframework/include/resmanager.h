@@ -3,6 +3,7 @@
 #define __RESMANAGER_H__
 
 #include "base.h"
+#include "slotmap.h"
 #include <map>
 #include <vector>
 
@@ -28,29 +29,74 @@ public:
 
 	void *pGetResource( HRESOURCE i_hResource );
 
+	// Asynchronous loading: returns a handle immediately and loads the resource on one
+	// of the loader threads. pGetResource() returns 0 until the resource has been loaded.
+	// The resource manager itself must only be used by one thread.
+	HRESOURCE hLoadResourceAsync( string i_sFilename );
+	bool bIsResourceLoaded( HRESOURCE i_hResource );	// true if loading has finished, successfully or not
+	bool bWaitForResource( HRESOURCE i_hResource );		// blocks until loading has finished; true if the resource is available
+	void WaitForResources();
+
+	// Used by loaders to decode several files in parallel, e.g. the faces of a cube texture.
+	// Returns 0 if the threads are in use by another loader or if only one loader thread is used.
+	class CMuli3DThreadPool *pAcquireLoaderThreads();
+	void ReleaseLoaderThreads( class CMuli3DThreadPool *i_pThreads );
+
 private:
 
 public:
 	inline class IApplication *pGetParent() { return m_pParent; }
 
+	// Textures loaded afterwards are block-compressed to m3dfmt_bc1, or to m3dfmt_bc3 if they are translucent.
+	inline void SetTextureCompression( bool i_bCompress ) { m_bCompressTextures = i_bCompress; }
+	inline bool bGetTextureCompression() { return m_bCompressTextures; }
+
+	// Number of threads loading resources asynchronously and decoding files in parallel; takes effect before they are used for the first time.
+	inline void SetLoaderThreads( uint32 i_iThreads ) { m_iLoaderThreads = i_iThreads ? i_iThreads : 1; }
+	inline uint32 iGetLoaderThreads() { return m_iLoaderThreads; }
+
 private:
 	class IApplication *m_pParent;
 
 	map<string, PLOADFUNCTION>			m_RegisteredEntityExtensionsLoad;
 	map<string, PUNLOADFUNCTION>		m_RegisteredEntityExtensionsUnload;
 
+	// Passed to a loader thread, which stores the loaded resource in pResource.
+	struct tPendingLoad
+	{
+		CResManager		*pParent;
+		PLOADFUNCTION	pLoadFunction;
+		string			sFilename;
+		void			*pResource;
+		uint32			iQueue, iJob;	// loader thread and sequence number of the job
+	};
+
 	struct tManagedResource
 	{
-		HRESOURCE	hResource;
 		uint32		iReferences;
 		string		sFilename, sExtension;
 		void		*pResource;
+		tPendingLoad *pPendingLoad;	// not null while the resource is loaded asynchronously
 	};
-	vector<tManagedResource>	m_ManagedResources;
-	uint32						m_iNumLoadedResources;
+	CSlotMap<tManagedResource>	m_ManagedResources;
+	vector< vector<HRESOURCE> >	m_FilenameIndex;	// hash index of the filenames of the managed resources
+	bool						m_bCompressTextures;
+
+	uint32							m_iLoaderThreads;
+	vector<class CMuli3DWorkQueue *>	m_LoaderQueues;	// one work queue per loader thread, created on first use
+	uint32							m_iNextLoaderQueue;
+	class CMuli3DThreadPool			*m_pLoaderThreads;
+	volatile int32					m_iLoaderThreadsUsers;
 
 private:
-	vector<tManagedResource>::iterator pGetManagedResourceIterator( HRESOURCE i_hResource );
+	static uint32 iHashFilename( const string &i_sFilename );
+	HRESOURCE hFindResource( const string &i_sFilename );
+	HRESOURCE hAddResource( const tManagedResource &i_Resource );	// inserts the resource and indexes its filename
+	string sGetExtension( string i_sFilename );
+
+	// Takes over the resource of a finished asynchronous load; returns false if it is still loading and i_bWait isn't set.
+	bool bFinishLoad( tManagedResource &io_Resource, bool i_bWait );
+	static void LoadResourceJob( void *i_pPendingLoad, uint32 i_iJob, uint32 i_iThread );
 };
 
 #endif // __RESMANAGER_H__
@@ -8,6 +8,7 @@
 #include <vector>
 
 #include "light.h"
+#include "slotmap.h"
 
 // TODO: implement scene-graph
 
@@ -51,7 +52,7 @@ public:
 	inline void SetAmbientLightColor( vector4 i_vAmbientLightColor ) { m_vAmbientLightColor = i_vAmbientLightColor; }
 	inline const vector4 &vGetAmbientLightColor() { return m_vAmbientLightColor; }
 
-	inline uint32 iGetNumLights() { return (uint32)m_SceneLights.size(); }
+	inline uint32 iGetNumLights() { return m_SceneLights.iGetSize(); }
 	inline CLight *pGetLightFromNum( uint32 i_iNum ) { return m_SceneLights[i_iNum].pLight; }
 	
 	inline void SetCurrentLight( uint32 i_iNum ) { m_iCurLight = i_iNum; }
@@ -65,27 +66,20 @@ private:
 
 	map<string, PCREATEFUNCTION>	m_RegisteredEntityTypes;
 
+	// entities and lights are kept in creation order, which is the order they are processed in
 	struct tSceneEntity
 	{
-		HENTITY			hEntity;
 		class IEntity	*pEntity;
 		bool			bSceneProcess;
 	};
-	vector<tSceneEntity>	m_SceneEntities;
-	uint32					m_iNumCreatedEntities;
+	CSlotMap<tSceneEntity>	m_SceneEntities;
 
 	struct tSceneLight
 	{
-		HLIGHT	hLight;
 		CLight	*pLight;
 	};
-	vector<tSceneLight>	m_SceneLights;
-	uint32				m_iNumCreatedLights;
-	uint32				m_iCurLight;
-
-private:
-	vector<tSceneEntity>::iterator pSceneEntityIterator( HENTITY i_hEntity );
-	vector<tSceneLight>::iterator pGetSceneLightIterator( HLIGHT i_hLight );
+	CSlotMap<tSceneLight>	m_SceneLights;
+	uint32					m_iCurLight;
 };
 
 #endif // __SCENE_H__
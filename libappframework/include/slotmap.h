@@ -0,0 +1,100 @@
+
+#ifndef __SLOTMAP_H__
+#define __SLOTMAP_H__
+
+#include "base.h"
+#include <vector>
+
+// Stores values under generational handles: a handle holds the index of a slot and
+// the generation of the slot, which changes whenever a value is erased, so handles of
+// erased values are rejected. Looking up a handle takes constant time. Handles are never 0.
+// The values are kept in a dense array in insertion order and may be iterated by
+// index; erasing a value is linear in the number of values following it.
+template<class T> class CSlotMap
+{
+public:
+	CSlotMap() { m_iFreeSlot = c_iNoSlot; }
+
+	// Returns 0 if all slots are in use.
+	uint32 hInsert( const T &i_Value )
+	{
+		uint32 iSlot = m_iFreeSlot;
+		if( iSlot != c_iNoSlot )
+			m_iFreeSlot = m_Slots[iSlot].iIndex;
+		else
+		{
+			if( m_Slots.size() > c_iIndexMask )
+				return 0;
+
+			iSlot = (uint32)m_Slots.size();
+			tSlot newSlot = { 1, 0 };
+			m_Slots.push_back( newSlot );
+		}
+
+		tSlot &Slot = m_Slots[iSlot];
+		Slot.iIndex = (uint32)m_Values.size();
+
+		const uint32 hHandle = ( Slot.iGeneration << c_iIndexBits ) | iSlot;
+		m_Values.push_back( i_Value );
+		m_Handles.push_back( hHandle );
+		return hHandle;
+	}
+
+	T *pGet( uint32 i_hHandle )
+	{
+		const uint32 iSlot = i_hHandle & c_iIndexMask;
+		if( iSlot >= m_Slots.size() || m_Slots[iSlot].iGeneration != ( i_hHandle >> c_iIndexBits ) )
+			return 0;
+		return &m_Values[m_Slots[iSlot].iIndex];
+	}
+
+	bool bErase( uint32 i_hHandle )
+	{
+		if( !pGet( i_hHandle ) )
+			return false;
+
+		const uint32 iSlot = i_hHandle & c_iIndexMask;
+		tSlot &Slot = m_Slots[iSlot];
+		const uint32 iIndex = Slot.iIndex;
+
+		m_Values.erase( m_Values.begin() + iIndex );
+		m_Handles.erase( m_Handles.begin() + iIndex );
+		for( uint32 i = iIndex; i < m_Handles.size(); ++i )
+			m_Slots[m_Handles[i] & c_iIndexMask].iIndex = i;
+
+		// generation 0 is skipped, so that handles are never 0
+		Slot.iGeneration = ( Slot.iGeneration + 1 ) & c_iGenerationMask;
+		if( !Slot.iGeneration )
+			Slot.iGeneration = 1;
+
+		Slot.iIndex = m_iFreeSlot;
+		m_iFreeSlot = iSlot;
+		return true;
+	}
+
+	inline uint32 iGetSize() { return (uint32)m_Values.size(); }
+	inline T &operator[]( uint32 i_iIndex ) { return m_Values[i_iIndex]; }
+	inline uint32 hGetHandle( uint32 i_iIndex ) { return m_Handles[i_iIndex]; }
+
+private:
+	enum
+	{
+		c_iIndexBits = 20,
+		c_iIndexMask = ( 1 << c_iIndexBits ) - 1,
+		c_iGenerationMask = ( 1 << ( 32 - c_iIndexBits ) ) - 1,
+		c_iNoSlot = 0xffffffff
+	};
+
+	struct tSlot
+	{
+		uint32 iGeneration;
+		uint32 iIndex;	// index of the value, or the next free slot
+	};
+
+	vector<T>		m_Values;
+	vector<uint32>	m_Handles;	// handle of each value
+	vector<tSlot>	m_Slots;
+	uint32			m_iFreeSlot;
+};
+
+#endif // __SLOTMAP_H__
@@ -0,0 +1,38 @@
+
+#ifndef __TEXCACHE_H__
+#define __TEXCACHE_H__
+
+#include "base.h"
+#include "../../libmuli3d/include/m3d.h"
+
+// Texture caches store a preprocessed texture in its final in-memory layout: a
+// texturecacheheader is followed by the data of all mip-levels, largest mip-level
+// first, as returned by CMuli3DSurface::ReadData(). Loading a cache maps the
+// file and points the mip-levels of the texture straight at the mapping.
+// Caches are written in the byte order of the writer and aren't portable.
+struct texturecacheheader
+{
+	uint32 iMagic;
+	uint32 iVersion;
+	uint32 iWidth, iHeight;
+	uint32 iMipLevels;
+	uint32 iFormat;		// member of m3dformat
+	uint32 iLayout;		// member of m3dtexturelayout
+	uint32 iTileSize;	// c_iTextureTileSize of the writer
+	uint32 iSourceSize;	// size of the source image in bytes
+	uint32 iDataSize;	// size of the mip-level data in bytes
+	uint64 iSourceTime;	// modification time of the source image
+	uint32 iReserved[4];	// pads the header to 64 bytes, keeping the mip-level data aligned
+};
+
+// Writes all mip-levels of a texture to a texture cache, stamped with the size and
+// modification time of the source image it has been created from.
+bool bWriteTextureCache( const char *i_szFilename, CMuli3DTexture *i_pTexture, const char *i_szSourceFilename );
+
+// Creates a texture from a texture cache. Fails if the cache is missing or invalid,
+// if the source image has changed since the cache was written, or if the cache
+// doesn't hold a block-compressed texture when i_bCompressed is set (or vice versa).
+bool bLoadTextureCache( CMuli3DTexture **o_ppTexture, CMuli3DDevice *i_pDevice, const char *i_szFilename,
+	const char *i_szSourceFilename, bool i_bCompressed );
+
+#endif // __TEXCACHE_H__
@@ -0,0 +1,21 @@
+#ifndef __TEXCOMPRESS_H__
+#define __TEXCOMPRESS_H__
+
+#include "base.h"
+#include "../../libmuli3d/include/m3d.h"
+
+// Encoders for the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5. Blocks are
+// encoded from 4x4 pixels of m3dfmt_r8g8b8a8; pixels of m3dfmt_bc1 with an alpha
+// value below 128 are encoded as transparent black.
+void EncodeBlock( byte *o_pBlock, m3dformat i_fmtFormat, const byte *i_pPixels );
+
+// Returns m3dfmt_bc3 if any pixel of a m3dfmt_r8g8b8a8-surface is translucent, otherwise m3dfmt_bc1.
+m3dformat fmtChooseBlockFormat( CMuli3DSurface *i_pSurface );
+
+// Encodes a m3dfmt_r8g8b8a8-surface into a block-compressed surface of the same dimensions.
+bool bCompressSurface( CMuli3DSurface *o_pDest, CMuli3DSurface *i_pSource );
+
+// Creates a block-compressed copy of all mip-levels of a m3dfmt_r8g8b8a8-texture.
+bool bCompressTexture( CMuli3DTexture **o_ppCompressed, CMuli3DTexture *i_pTexture, m3dformat i_fmtFormat );
+
+#endif // __TEXCOMPRESS_H__
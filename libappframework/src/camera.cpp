@@ -13,6 +13,10 @@ CCamera::CCamera( CGraphics *i_pParent )
 
 	m_bLockedSurfacesViewport = false;
 
+	m_pColorBuffers[0] = m_pColorBuffers[1] = 0;
+	m_iPresentFences[0] = m_iPresentFences[1] = 0;
+	m_iCurColorBuffer = 0;
+
 	matMatrix44Identity( m_matWorld );
 	matMatrix44Identity( m_matView );
 	matMatrix44Identity( m_matProjection );
@@ -21,6 +25,8 @@ CCamera::CCamera( CGraphics *i_pParent )
 
 CCamera::~CCamera()
 {
+	SAFE_RELEASE( m_pColorBuffers[0] );
+	SAFE_RELEASE( m_pColorBuffers[1] );
 	SAFE_RELEASE( m_pRenderTarget );
 }
 
@@ -56,7 +62,7 @@ bool CCamera::bCreateRenderCamera( uint32 i_iWidth, uint32 i_iHeight, m3dformat
 	m_pRenderTarget->SetDepthBuffer( pDepthBuffer );
 
 	SAFE_RELEASE( pDepthBuffer );
-	SAFE_RELEASE( pColorBuffer );
+	m_pColorBuffers[0] = pColorBuffer; // the second colorbuffer is created when presenting for the first time
 
 	m_bLockedSurfacesViewport = true;	// Don't allow any more changes to surfaces/viewport!
 
@@ -65,6 +71,9 @@ bool CCamera::bCreateRenderCamera( uint32 i_iWidth, uint32 i_iHeight, m3dformat
 
 void CCamera::BeginRender()
 {
+	// Wait until the colorbuffer has been presented - see EndRender()
+	m_pParent->pGetM3DDevice()->WaitForFence( m_iPresentFences[m_iCurColorBuffer] );
+
 	m_pParent->PushStateBlock();
 
 	m_pParent->SetRenderTarget( m_pRenderTarget );
@@ -83,7 +92,34 @@ void CCamera::EndRender( bool i_bPresentToScreen )
 	m_pParent->PopStateBlock();
 
 	if( i_bPresentToScreen )
-		m_pParent->pGetM3DDevice()->Present( m_pRenderTarget );
+	{
+		// Present in the background and render the next frame to the other colorbuffer
+		CMuli3DDevice *pM3DDevice = m_pParent->pGetM3DDevice();
+		if( FUNC_FAILED( pM3DDevice->PresentAsync( m_pRenderTarget, &m_iPresentFences[m_iCurColorBuffer] ) ) )
+			return;
+
+		SwapColorBuffers();
+	}
+}
+
+void CCamera::SwapColorBuffers()
+{
+	if( !m_pColorBuffers[0] )
+		return;
+
+	if( !m_pColorBuffers[1] )
+	{
+		CMuli3DDevice *pM3DDevice = m_pParent->pGetM3DDevice();
+		if( FUNC_FAILED( pM3DDevice->CreateSurface( &m_pColorBuffers[1], m_pColorBuffers[0]->iGetWidth(),
+			m_pColorBuffers[0]->iGetHeight(), m_pColorBuffers[0]->fmtGetFormat() ) ) )
+		{
+			m_pColorBuffers[1] = 0;
+			return; // keep on rendering to a single colorbuffer - BeginRender() waits for the present
+		}
+	}
+
+	m_iCurColorBuffer ^= 1;
+	m_pRenderTarget->SetColorBuffer( m_pColorBuffers[m_iCurColorBuffer] );
 }
 
 void CCamera::CalculateProjection( float32 i_fFOVAngle, float32 i_fViewDistance, float32 i_fNearClippingPlane, float32 i_fAspect )
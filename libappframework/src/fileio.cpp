@@ -1,9 +1,23 @@
 
 #include "../include/fileio.h"
 #include "../include/application.h"
+#include "../../libmuli3d/include/core/m3dcore_threadpool.h"
 #include <stdio.h>
 #include <stdlib.h>
 
+// Removes carriage returns from a null-terminated string in place and returns its new length.
+static uint32 iStripCarriageReturns( char *io_pText )
+{
+	char *pDest = io_pText;
+	for( const char *pSrc = io_pText; *pSrc; ++pSrc )
+	{
+		if( *pSrc != '\r' )
+			*pDest++ = *pSrc;
+	}
+	*pDest = 0;
+	return (uint32)( pDest - io_pText );
+}
+
 CFileIO::CFileIO( IApplication *i_pParent )
 {
 	m_pParent = i_pParent;
@@ -42,25 +56,7 @@ uint32 CFileIO::iReadFile( string i_sFilename, byte **o_ppData, bool i_bText )
 		(*o_ppData)[iSize] = 0;
 		
 		#ifndef WIN32
-
-		char *pTemp = new char[iSize + 1];
-		strcpy( pTemp, (char *)(*o_ppData) );
-		
-		char *pSrc = pTemp, *pDest = (char *)(*o_ppData);
-		iSize = 0;
-		while( *pSrc )
-		{
-			if( *pSrc != '\r' )
-			{
-				*pDest++ = *pSrc;
-				++iSize;
-			}
-			++pSrc;
-		}
-		*pDest = 0;
-		
-		SAFE_DELETE_ARRAY( pTemp );
-
+		iSize = iStripCarriageReturns( (char *)(*o_ppData) );
 		#endif
 	}
 
@@ -89,24 +85,7 @@ uint32 CFileIO::iReadFile( string i_sFilename, byte *i_pData, uint32 i_iSize, bo
 		i_pData[iSize] = 0;
 		
 		#ifndef WIN32
-		char *pTemp = new char[iSize + 1];
-		strcpy( pTemp, (char *)i_pData );
-		
-		char *pSrc = pTemp, *pDest = (char *)i_pData;
-		iSize = 0;
-		while( *pSrc )
-		{
-			if( *pSrc != '\r' )
-			{
-				*pDest++ = *pSrc;
-				++iSize;
-			}
-			++pSrc;
-		}
-		*pDest = 0;
-		
-		SAFE_DELETE_ARRAY( pTemp );
-
+		iSize = iStripCarriageReturns( (char *)i_pData );
 		#endif
 	}
 		
@@ -143,7 +122,8 @@ bool CFileIO::bFileExists( string i_sFilename )
 
 const char *CFileIO::pDiskFilePath( string i_sFilename )
 {
-	static char szPath[512];
+	// resources may be loaded on several threads
+	static M3D_THREADLOCAL char szPath[512];
 	sprintf( szPath, "%s/%s", BASE_DIR, i_sFilename.c_str() );
 	return szPath;
 }
@@ -0,0 +1,118 @@
+
+#include "../include/mappedfile.h"
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if !defined( WIN32 ) && !defined( __amigaos4__ )
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+CMappedFile::CMappedFile()
+{
+	m_pData = 0;
+	m_iSize = 0;
+#ifdef WIN32
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = 0;
+#endif
+}
+
+CMappedFile::~CMappedFile()
+{
+#ifdef WIN32
+	if( m_pData )
+		UnmapViewOfFile( m_pData );
+	if( m_hMapping )
+		CloseHandle( m_hMapping );
+	if( m_hFile != INVALID_HANDLE_VALUE )
+		CloseHandle( m_hFile );
+#elif defined( __amigaos4__ )
+	SAFE_DELETE_ARRAY( m_pData );
+#else
+	if( m_pData )
+		munmap( m_pData, m_iSize );
+#endif
+}
+
+bool CMappedFile::bOpen( const char *i_szFilename )
+{
+	if( m_pData )
+		return false;
+
+#ifdef WIN32
+	m_hFile = CreateFileA( i_szFilename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+	if( m_hFile == INVALID_HANDLE_VALUE )
+		return false;
+
+	LARGE_INTEGER liSize;
+	if( !GetFileSizeEx( m_hFile, &liSize ) || !liSize.QuadPart || liSize.HighPart )
+		return false;
+
+	m_hMapping = CreateFileMappingA( m_hFile, 0, PAGE_WRITECOPY, 0, 0, 0 );
+	if( !m_hMapping )
+		return false;
+
+	m_pData = (byte *)MapViewOfFile( m_hMapping, FILE_MAP_COPY, 0, 0, 0 );
+	if( !m_pData )
+		return false;
+
+	m_iSize = liSize.LowPart;
+#elif defined( __amigaos4__ )
+	FILE *pFile = fopen( i_szFilename, "rb" );
+	if( !pFile )
+		return false;
+
+	fseek( pFile, 0, SEEK_END );
+	const long iSize = ftell( pFile );
+	rewind( pFile );
+
+	if( iSize > 0 )
+	{
+		m_pData = new byte[iSize];
+		if( fread( m_pData, iSize, 1, pFile ) != 1 )
+			SAFE_DELETE_ARRAY( m_pData );
+	}
+	fclose( pFile );
+
+	if( !m_pData )
+		return false;
+
+	m_iSize = (uint32)iSize;
+#else
+	const int iFile = open( i_szFilename, O_RDONLY );
+	if( iFile < 0 )
+		return false;
+
+	struct stat FileStat;
+	if( fstat( iFile, &FileStat ) != 0 || FileStat.st_size <= 0 || (uint64)FileStat.st_size > 0xffffffff )
+	{
+		close( iFile );
+		return false;
+	}
+
+	// The mapping stays valid after the file has been closed.
+	void *pMapping = mmap( 0, (size_t)FileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, iFile, 0 );
+	close( iFile );
+	if( pMapping == MAP_FAILED )
+		return false;
+
+	m_pData = (byte *)pMapping;
+	m_iSize = (uint32)FileStat.st_size;
+#endif
+
+	return true;
+}
+
+bool bGetFileStamp( const char *i_szFilename, uint32 &o_iSize, uint64 &o_iTime )
+{
+	struct stat FileStat;
+	if( stat( i_szFilename, &FileStat ) != 0 )
+		return false;
+
+	o_iSize = (uint32)FileStat.st_size;
+	o_iTime = (uint64)FileStat.st_mtime;
+	return true;
+}
@@ -0,0 +1,464 @@
+
+#include "../include/model.h"
+#include "../include/mappedfile.h"
+#include <stdio.h>
+
+static const m3dvertexelement c_VertexDeclaration[] =
+{
+	M3DVERTEXFORMATDECL( 0, m3dvet_vector3, 0 ),
+	M3DVERTEXFORMATDECL( 0, m3dvet_vector3, 1 ),
+	M3DVERTEXFORMATDECL( 0, m3dvet_vector2, 2 ),
+	M3DVERTEXFORMATDECL( 0, m3dvet_vector3, 3 ),
+};
+
+static const uint32 c_iNumVertexElements = sizeof( c_VertexDeclaration ) / sizeof( m3dvertexelement );
+
+CModel::CModel( CResManager *i_pParent ) :
+	m_pParent( i_pParent ), m_iNumFaces( 0 ), m_iNumVertices( 0 ), m_pVertexFormat( 0 ), m_pVertexBuffer( 0 ), m_pIndexBuffer( 0 ),
+	m_vBoundsMin( 0, 0, 0 ), m_vBoundsMax( 0, 0, 0 )
+{
+	CMuli3DDevice *pDevice = m_pParent->pGetParent()->pGetGraphics()->pGetM3DDevice();
+	pDevice->CreateVertexFormat( &m_pVertexFormat, c_VertexDeclaration, sizeof( c_VertexDeclaration ) );
+}
+
+// OBJ parsing ----------------------------------------------------------------
+// The parsers advance i_pCur and never read beyond i_pEnd.
+
+static inline bool bIsDigit( char c ) { return c >= '0' && c <= '9'; }
+
+static inline const char *pSkipSpaces( const char *i_pCur, const char *i_pEnd )
+{
+	while( i_pCur < i_pEnd && ( *i_pCur == ' ' || *i_pCur == '\t' || *i_pCur == '\r' ) )
+		++i_pCur;
+	return i_pCur;
+}
+
+static inline const char *pNextLine( const char *i_pCur, const char *i_pEnd )
+{
+	while( i_pCur < i_pEnd && *i_pCur++ != '\n' ) {}
+	return i_pCur;
+}
+
+static const char *pParseFloat( const char *i_pCur, const char *i_pEnd, float32 &o_fValue )
+{
+	i_pCur = pSkipSpaces( i_pCur, i_pEnd );
+
+	bool bNegative = false;
+	if( i_pCur < i_pEnd && ( *i_pCur == '-' || *i_pCur == '+' ) )
+		bNegative = ( *i_pCur++ == '-' );
+
+	// 9 significant digits are enough for a float; further digits only scale the value
+	uint32 iMantissa = 0;
+	int32 iExponent = 0;
+	for( ; i_pCur < i_pEnd && bIsDigit( *i_pCur ); ++i_pCur )
+	{
+		if( iMantissa < 100000000 ) iMantissa = iMantissa * 10 + ( *i_pCur - '0' );
+		else ++iExponent;
+	}
+
+	if( i_pCur < i_pEnd && *i_pCur == '.' )
+	{
+		for( ++i_pCur; i_pCur < i_pEnd && bIsDigit( *i_pCur ); ++i_pCur )
+		{
+			if( iMantissa < 100000000 ) { iMantissa = iMantissa * 10 + ( *i_pCur - '0' ); --iExponent; }
+		}
+	}
+
+	if( i_pCur < i_pEnd && ( *i_pCur == 'e' || *i_pCur == 'E' ) )
+	{
+		++i_pCur;
+		bool bNegativeExponent = false;
+		if( i_pCur < i_pEnd && ( *i_pCur == '-' || *i_pCur == '+' ) )
+			bNegativeExponent = ( *i_pCur++ == '-' );
+
+		int32 iValue = 0;
+		for( ; i_pCur < i_pEnd && bIsDigit( *i_pCur ); ++i_pCur )
+		{
+			if( iValue < 1000 ) iValue = iValue * 10 + ( *i_pCur - '0' );
+		}
+		iExponent += bNegativeExponent ? -iValue : iValue;
+	}
+
+	float64 fScale = 1;
+	for( int32 i = iExponent < 0 ? -iExponent : iExponent; i > 0; --i )
+		fScale *= 10;
+
+	const float64 fValue = iExponent < 0 ? iMantissa / fScale : iMantissa * fScale;
+	o_fValue = (float32)( bNegative ? -fValue : fValue );
+	return i_pCur;
+}
+
+// Parses a 1-based or negative (relative) OBJ index and returns the 1-based index, or 0 if it is missing or out of range.
+static const char *pParseIndex( const char *i_pCur, const char *i_pEnd, uint32 i_iNumElements, uint32 &o_iIndex )
+{
+	bool bNegative = false;
+	if( i_pCur < i_pEnd && *i_pCur == '-' )
+	{
+		bNegative = true;
+		++i_pCur;
+	}
+
+	uint32 iValue = 0;
+	for( ; i_pCur < i_pEnd && bIsDigit( *i_pCur ); ++i_pCur )
+		iValue = iValue * 10 + ( *i_pCur - '0' );
+
+	if( bNegative )
+		iValue = iValue <= i_iNumElements ? i_iNumElements + 1 - iValue : 0;
+	o_iIndex = iValue <= i_iNumElements ? iValue : 0;
+	return i_pCur;
+}
+
+// Vertices are identified by their position, texture coordinate and normal indices.
+struct objvertexkey
+{
+	uint32 iPosition, iTexCoord, iNormal;
+};
+
+static inline uint32 iHashVertexKey( const objvertexkey &i_Key )
+{
+	return ( i_Key.iPosition * 73856093 ) ^ ( i_Key.iTexCoord * 19349663 ) ^ ( i_Key.iNormal * 83492791 );
+}
+
+bool CModel::bLoadModel( const char *i_pData, uint32 i_iLength )
+{
+	vector<vector3> Positions;
+	vector<vector3> Normals;
+	vector<vector2> TexCoords;
+
+	vector<vertexformat> Vertices;
+	vector<objvertexkey> VertexKeys;
+	vector<uint32> Indices;
+
+	// open addressing hash table of vertex indices + 1; kept at most half full
+	vector<uint32> VertexTable( 1024, 0 );
+
+	const char *pCurPos = i_pData, *pEnd = i_pData + i_iLength;
+	while( pCurPos < pEnd )
+	{
+		pCurPos = pSkipSpaces( pCurPos, pEnd );
+		if( pEnd - pCurPos < 2 )
+			break;
+
+		if( pCurPos[0] == 'v' )
+		{
+			switch( pCurPos[1] )
+			{
+			case ' ': case '\t': // position
+				{
+					vector3 vPos;
+					pCurPos = pParseFloat( pCurPos + 1, pEnd, vPos.x );
+					pCurPos = pParseFloat( pCurPos, pEnd, vPos.y );
+					pCurPos = pParseFloat( pCurPos, pEnd, vPos.z );
+					vPos.z = -vPos.z;
+					Positions.push_back( vPos );
+				}
+				break;
+			case 'n': // normal
+				{
+					vector3 vNormal;
+					pCurPos = pParseFloat( pCurPos + 2, pEnd, vNormal.x );
+					pCurPos = pParseFloat( pCurPos, pEnd, vNormal.y );
+					pCurPos = pParseFloat( pCurPos, pEnd, vNormal.z );
+					vNormal.z = -vNormal.z;
+					Normals.push_back( vNormal );
+				}
+				break;
+			case 't': // texcoord
+				{
+					vector2 vTexCoord;
+					pCurPos = pParseFloat( pCurPos + 2, pEnd, vTexCoord.x );
+					pCurPos = pParseFloat( pCurPos, pEnd, vTexCoord.y );
+					vTexCoord.y = 1 - vTexCoord.y;
+					TexCoords.push_back( vTexCoord );
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		else if( pCurPos[0] == 'f' && ( pCurPos[1] == ' ' || pCurPos[1] == '\t' ) )
+		{
+			++pCurPos;
+
+			// polygons are split into a fan of triangles around their first corner
+			uint32 iCorners[3], iNumCorners = 0;
+			for( ;; )
+			{
+				pCurPos = pSkipSpaces( pCurPos, pEnd );
+				if( pCurPos >= pEnd || !( bIsDigit( *pCurPos ) || *pCurPos == '-' ) )
+					break;
+
+				// corners are written as position/texcoord/normal, position//normal, position/texcoord or position
+				objvertexkey Key = { 0, 0, 0 };
+				pCurPos = pParseIndex( pCurPos, pEnd, (uint32)Positions.size(), Key.iPosition );
+				if( pCurPos < pEnd && *pCurPos == '/' )
+				{
+					pCurPos = pParseIndex( pCurPos + 1, pEnd, (uint32)TexCoords.size(), Key.iTexCoord );
+					if( pCurPos < pEnd && *pCurPos == '/' )
+						pCurPos = pParseIndex( pCurPos + 1, pEnd, (uint32)Normals.size(), Key.iNormal );
+				}
+
+				if( !Key.iPosition )
+					return false;
+
+				uint32 iSlot = iHashVertexKey( Key ) & ( (uint32)VertexTable.size() - 1 );
+				for( ; VertexTable[iSlot]; iSlot = ( iSlot + 1 ) & ( (uint32)VertexTable.size() - 1 ) )
+				{
+					const objvertexkey &Other = VertexKeys[VertexTable[iSlot] - 1];
+					if( Other.iPosition == Key.iPosition && Other.iTexCoord == Key.iTexCoord && Other.iNormal == Key.iNormal )
+						break;
+				}
+
+				if( !VertexTable[iSlot] )
+				{
+					vertexformat NewVertex;
+					NewVertex.vPosition = Positions[Key.iPosition - 1];
+					NewVertex.vNormal = Key.iNormal ? Normals[Key.iNormal - 1] : vector3( 0, 0, 0 );
+					NewVertex.vTexCoord0 = Key.iTexCoord ? TexCoords[Key.iTexCoord - 1] : vector2( 0, 0 );
+					NewVertex.vTangent = vector3( 0, 0, 0 );
+					Vertices.push_back( NewVertex );
+					VertexKeys.push_back( Key );
+					VertexTable[iSlot] = (uint32)Vertices.size();
+
+					if( Vertices.size() * 2 > VertexTable.size() )
+					{
+						VertexTable.assign( VertexTable.size() * 2, 0 );
+						for( uint32 iVertex = 0; iVertex < VertexKeys.size(); ++iVertex )
+						{
+							uint32 iNewSlot = iHashVertexKey( VertexKeys[iVertex] ) & ( (uint32)VertexTable.size() - 1 );
+							while( VertexTable[iNewSlot] )
+								iNewSlot = ( iNewSlot + 1 ) & ( (uint32)VertexTable.size() - 1 );
+							VertexTable[iNewSlot] = iVertex + 1;
+						}
+					}
+
+					iCorners[2] = (uint32)Vertices.size() - 1;
+				}
+				else
+					iCorners[2] = VertexTable[iSlot] - 1;
+
+				if( ++iNumCorners == 1 )
+					iCorners[0] = iCorners[2];
+				else if( iNumCorners >= 3 )
+				{
+					vertexformat *pCorners[3] = { &Vertices[iCorners[0]], &Vertices[iCorners[1]], &Vertices[iCorners[2]] };
+
+					// Calculate triangle tangent vector; shared vertices average the tangents of their triangles.
+					const vector3 vDelta[2] = { pCorners[1]->vPosition - pCorners[0]->vPosition,
+						pCorners[2]->vPosition - pCorners[0]->vPosition };
+					const float32 fDeltaV[2] = { pCorners[1]->vTexCoord0.y - pCorners[0]->vTexCoord0.y,
+						pCorners[2]->vTexCoord0.y - pCorners[0]->vTexCoord0.y };
+					vector3 vTangent = vDelta[0] * fDeltaV[1] - vDelta[1] * fDeltaV[0];
+					if( vTangent.lengthsq() > 0 )
+					{
+						vTangent.normalize();
+						pCorners[0]->vTangent += vTangent;
+						pCorners[1]->vTangent += vTangent;
+						pCorners[2]->vTangent += vTangent;
+					}
+
+					Indices.push_back( iCorners[2] );
+					Indices.push_back( iCorners[1] );
+					Indices.push_back( iCorners[0] );
+					++m_iNumFaces;
+				}
+
+				iCorners[1] = iCorners[2];
+			}
+		}
+
+		pCurPos = pNextLine( pCurPos, pEnd );
+	}
+
+	if( !m_iNumFaces )
+		return false;
+
+	m_vBoundsMin = m_vBoundsMax = Vertices[0].vPosition;
+	for( vector<vertexformat>::iterator pVertex = Vertices.begin(); pVertex != Vertices.end(); ++pVertex )
+	{
+		if( pVertex->vTangent.lengthsq() > 0 )
+			pVertex->vTangent.normalize();
+
+		const vector3 &vPos = pVertex->vPosition;
+		if( vPos.x < m_vBoundsMin.x ) m_vBoundsMin.x = vPos.x;
+		if( vPos.y < m_vBoundsMin.y ) m_vBoundsMin.y = vPos.y;
+		if( vPos.z < m_vBoundsMin.z ) m_vBoundsMin.z = vPos.z;
+		if( vPos.x > m_vBoundsMax.x ) m_vBoundsMax.x = vPos.x;
+		if( vPos.y > m_vBoundsMax.y ) m_vBoundsMax.y = vPos.y;
+		if( vPos.z > m_vBoundsMax.z ) m_vBoundsMax.z = vPos.z;
+	}
+
+	m_iNumVertices = (uint32)Vertices.size();
+	CMuli3DDevice *pDevice = m_pParent->pGetParent()->pGetGraphics()->pGetM3DDevice();
+
+	// Reorder triangles for the vertex cache and vertices for fetch locality ---
+	uint32 iVertexCacheSize = 0;
+	pDevice->GetRenderState( m3drs_vertexcachesize, iVertexCacheSize );
+	OptimizeVertexCache( &Indices[0], (uint32)Indices.size(), m_iNumVertices, iVertexCacheSize );
+
+	vector<uint32> Remap( m_iNumVertices );
+	iOptimizeVertexFetch( &Remap[0], &Indices[0], (uint32)Indices.size(), m_iNumVertices );
+
+	const vector<vertexformat> SourceVertices( Vertices );
+	for( uint32 iVertex = 0; iVertex < m_iNumVertices; ++iVertex )
+		Vertices[Remap[iVertex]] = SourceVertices[iVertex];
+
+	// Fill the vertex and index buffers ----------------------------------------
+	if( FUNC_FAILED( pDevice->CreateVertexBuffer( &m_pVertexBuffer, sizeof( vertexformat ) * m_iNumVertices ) ) )
+		return false;
+
+	vertexformat *pDest = 0;
+	if( FUNC_FAILED( m_pVertexBuffer->GetPointer( 0, (void **)&pDest ) ) )
+		return false;
+
+	for( uint32 iVertex = 0; iVertex < m_iNumVertices; ++iVertex )
+		pDest[iVertex] = Vertices[iVertex];
+
+	const bool b16BitIndices = m_iNumVertices <= 65536;
+	if( FUNC_FAILED( pDevice->CreateIndexBuffer( &m_pIndexBuffer, (uint32)Indices.size() * ( b16BitIndices ? sizeof( uint16 ) : sizeof( uint32 ) ),
+		b16BitIndices ? m3dfmt_index16 : m3dfmt_index32 ) ) )
+		return false;
+
+	void *pIndices = 0;
+	if( FUNC_FAILED( m_pIndexBuffer->GetPointer( 0, &pIndices ) ) )
+		return false;
+
+	if( b16BitIndices )
+	{
+		uint16 *pDestIndex = (uint16 *)pIndices;
+		for( uint32 iIndex = 0; iIndex < Indices.size(); ++iIndex )
+			pDestIndex[iIndex] = (uint16)Indices[iIndex];
+	}
+	else
+		memcpy( pIndices, &Indices[0], sizeof( uint32 ) * Indices.size() );
+
+	return true;
+}
+
+// Mesh files -----------------------------------------------------------------
+
+static const uint32 c_iMeshFileMagic = 0x534d334d; // "M3MS"
+static const uint32 c_iMeshFileVersion = 2; // version 1 didn't optimize the triangle order
+
+static inline uint32 iAlignOffset( uint32 i_iOffset ) { return ( i_iOffset + 15 ) & ~15; }
+
+bool CModel::bLoadMeshFile( const char *i_szFilename, const char *i_szSourceFilename )
+{
+	uint32 iSourceSize = 0;
+	uint64 iSourceTime = 0;
+	if( i_szSourceFilename && !bGetFileStamp( i_szSourceFilename, iSourceSize, iSourceTime ) )
+		return false;
+
+	CMappedFile *pFile = new CMappedFile;
+	if( !pFile->bOpen( i_szFilename ) || pFile->iGetSize() < sizeof( meshfileheader ) )
+	{
+		SAFE_RELEASE( pFile );
+		return false;
+	}
+
+	// Only mesh files holding vertices of the model's vertex format are accepted.
+	const meshfileheader &Header = *(const meshfileheader *)pFile->pGetData();
+	const uint32 iFileSize = pFile->iGetSize();
+	const uint32 iIndexSize = Header.iIndexFormat == m3dfmt_index16 ? sizeof( uint16 ) : sizeof( uint32 );
+	const uint64 iVertexDataSize = (uint64)Header.iNumVertices * sizeof( vertexformat );
+	const uint64 iIndexDataSize = (uint64)Header.iNumFaces * 3 * iIndexSize;
+	if( Header.iMagic != c_iMeshFileMagic || Header.iVersion != c_iMeshFileVersion ||
+		( i_szSourceFilename && ( Header.iSourceSize != iSourceSize || Header.iSourceTime != iSourceTime ) ) ||
+		Header.iNumVertexElements != c_iNumVertexElements || Header.iStride != sizeof( vertexformat ) ||
+		( Header.iIndexFormat != m3dfmt_index16 && Header.iIndexFormat != m3dfmt_index32 ) ||
+		!Header.iNumVertices || !Header.iNumFaces ||
+		(uint64)Header.iDeclarationOffset + sizeof( c_VertexDeclaration ) > iFileSize ||
+		(uint64)Header.iVertexOffset + iVertexDataSize > iFileSize ||
+		(uint64)Header.iIndexOffset + iIndexDataSize > iFileSize ||
+		memcmp( pFile->pGetData() + Header.iDeclarationOffset, c_VertexDeclaration, sizeof( c_VertexDeclaration ) ) != 0 )
+	{
+		SAFE_RELEASE( pFile );
+		return false;
+	}
+
+	// The buffers keep a reference to the mapping.
+	CMuli3DDevice *pDevice = m_pParent->pGetParent()->pGetGraphics()->pGetM3DDevice();
+	CMuli3DVertexBuffer *pVertexBuffer = 0;
+	CMuli3DIndexBuffer *pIndexBuffer = 0;
+	const bool bResult =
+		FUNC_SUCCESSFUL( pDevice->CreateVertexBufferFromMemory( &pVertexBuffer, (uint32)iVertexDataSize,
+			pFile->pGetData() + Header.iVertexOffset, pFile ) ) &&
+		FUNC_SUCCESSFUL( pDevice->CreateIndexBufferFromMemory( &pIndexBuffer, (uint32)iIndexDataSize,
+			(m3dformat)Header.iIndexFormat, pFile->pGetData() + Header.iIndexOffset, pFile ) );
+
+	if( bResult )
+	{
+		SAFE_RELEASE( m_pVertexBuffer );
+		SAFE_RELEASE( m_pIndexBuffer );
+		m_pVertexBuffer = pVertexBuffer;
+		m_pIndexBuffer = pIndexBuffer;
+		m_iNumVertices = Header.iNumVertices;
+		m_iNumFaces = Header.iNumFaces;
+		m_vBoundsMin = vector3( Header.fBoundsMin[0], Header.fBoundsMin[1], Header.fBoundsMin[2] );
+		m_vBoundsMax = vector3( Header.fBoundsMax[0], Header.fBoundsMax[1], Header.fBoundsMax[2] );
+	}
+	else
+	{
+		SAFE_RELEASE( pVertexBuffer );
+		SAFE_RELEASE( pIndexBuffer );
+	}
+
+	SAFE_RELEASE( pFile );
+	return bResult;
+}
+
+bool CModel::bWriteMeshFile( const char *i_szFilename, const char *i_szSourceFilename )
+{
+	if( !m_pVertexBuffer || !m_pIndexBuffer )
+		return false;
+
+	meshfileheader Header;
+	memset( &Header, 0, sizeof( Header ) );
+	if( i_szSourceFilename && !bGetFileStamp( i_szSourceFilename, Header.iSourceSize, Header.iSourceTime ) )
+		return false;
+
+	const void *pVertices = 0, *pIndices = 0;
+	if( FUNC_FAILED( m_pVertexBuffer->GetReadPointer( 0, &pVertices ) ) ||
+		FUNC_FAILED( m_pIndexBuffer->GetReadPointer( 0, &pIndices ) ) )
+		return false;
+
+	const uint32 iVertexDataSize = m_iNumVertices * sizeof( vertexformat );
+	const uint32 iIndexDataSize = m_pIndexBuffer->iGetLength();
+
+	Header.iMagic = c_iMeshFileMagic;
+	Header.iVersion = c_iMeshFileVersion;
+	Header.iNumVertexElements = c_iNumVertexElements;
+	Header.iStride = sizeof( vertexformat );
+	Header.iNumVertices = m_iNumVertices;
+	Header.iNumFaces = m_iNumFaces;
+	Header.iIndexFormat = m_pIndexBuffer->fmtGetFormat();
+	Header.fBoundsMin[0] = m_vBoundsMin.x; Header.fBoundsMin[1] = m_vBoundsMin.y; Header.fBoundsMin[2] = m_vBoundsMin.z;
+	Header.fBoundsMax[0] = m_vBoundsMax.x; Header.fBoundsMax[1] = m_vBoundsMax.y; Header.fBoundsMax[2] = m_vBoundsMax.z;
+	Header.iDeclarationOffset = sizeof( Header );
+	Header.iVertexOffset = iAlignOffset( Header.iDeclarationOffset + sizeof( c_VertexDeclaration ) );
+	Header.iIndexOffset = iAlignOffset( Header.iVertexOffset + iVertexDataSize );
+
+	FILE *pFile = fopen( i_szFilename, "wb" );
+	if( !pFile )
+		return false;
+
+	// the sections are padded with zeros up to their aligned offsets
+	static const byte Padding[16] = { 0 };
+	const uint32 iDeclarationPadding = Header.iVertexOffset - Header.iDeclarationOffset - sizeof( c_VertexDeclaration );
+	const uint32 iVertexPadding = Header.iIndexOffset - Header.iVertexOffset - iVertexDataSize;
+	bool bResult = fwrite( &Header, sizeof( Header ), 1, pFile ) == 1 &&
+		fwrite( c_VertexDeclaration, sizeof( c_VertexDeclaration ), 1, pFile ) == 1 &&
+		fwrite( Padding, 1, iDeclarationPadding, pFile ) == iDeclarationPadding &&
+		fwrite( pVertices, iVertexDataSize, 1, pFile ) == 1 &&
+		fwrite( Padding, 1, iVertexPadding, pFile ) == iVertexPadding &&
+		fwrite( pIndices, iIndexDataSize, 1, pFile ) == 1;
+
+	if( fclose( pFile ) != 0 )
+		bResult = false;
+
+	// don't leave a truncated mesh file behind
+	if( !bResult )
+		remove( i_szFilename );
+
+	return bResult;
+}
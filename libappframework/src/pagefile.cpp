@@ -0,0 +1,149 @@
+
+#include "../include/pagefile.h"
+
+static const uint32 c_iPageFileMagic = 0x4650334d; // "M3PF"
+
+// Page files may exceed 2 GB.
+static bool bSeekPage( FILE *i_pFile, uint32 i_iPage, uint32 i_iPageBytes )
+{
+	const uint64 iOffset = sizeof( pagefileheader ) + (uint64)i_iPage * i_iPageBytes;
+#ifdef WIN32
+	return _fseeki64( i_pFile, (__int64)iOffset, SEEK_SET ) == 0;
+#elif defined( __amigaos4__ )
+	return fseek( i_pFile, (long)iOffset, SEEK_SET ) == 0;
+#else
+	return fseeko( i_pFile, (off_t)iOffset, SEEK_SET ) == 0;
+#endif
+}
+
+CPageFile::CPageFile()
+{
+	m_pFile = 0;
+	memset( &m_Header, 0, sizeof( m_Header ) );
+	m_iPageBytes = 0;
+}
+
+CPageFile::~CPageFile()
+{
+	if( m_pFile )
+		fclose( m_pFile );
+}
+
+bool CPageFile::bOpen( const char *i_szFilename )
+{
+	if( m_pFile )
+		return false;
+
+	m_pFile = fopen( i_szFilename, "rb" );
+	if( !m_pFile )
+		return false;
+
+	if( fread( &m_Header, sizeof( m_Header ), 1, m_pFile ) != 1 || m_Header.iMagic != c_iPageFileMagic ||
+		m_Header.iPageSize != c_iVirtualPageSize || !bIsTextureFormat( (m3dformat)m_Header.iFormat ) ||
+		!m_Header.iWidth || !m_Header.iHeight || !m_Header.iMipLevels || m_Header.iMipLevels > 32 )
+	{
+		fclose( m_pFile ); m_pFile = 0;
+		return false;
+	}
+
+	m_iPageBytes = c_iVirtualPageSize * c_iVirtualPageSize * iGetFormatPixelBytes( (m3dformat)m_Header.iFormat );
+
+	uint32 iNumPages = 0;
+	for( uint32 iLevel = 0; iLevel < m_Header.iMipLevels; ++iLevel )
+	{
+		const uint32 iWidth = m_Header.iWidth >> iLevel, iHeight = m_Header.iHeight >> iLevel;
+		m_iFirstPages[iLevel] = iNumPages;
+		m_iPagesX[iLevel] = ( iWidth + c_iVirtualPageSize - 1 ) / c_iVirtualPageSize;
+		iNumPages += m_iPagesX[iLevel] * ( ( iHeight + c_iVirtualPageSize - 1 ) / c_iVirtualPageSize );
+	}
+
+	return true;
+}
+
+bool CPageFile::bLoadPage( void *o_pData, uint32 i_iMipLevel, uint32 i_iPageX, uint32 i_iPageY )
+{
+	if( !m_pFile || i_iMipLevel >= m_Header.iMipLevels )
+		return false;
+
+	const uint32 iPage = m_iFirstPages[i_iMipLevel] + i_iPageY * m_iPagesX[i_iMipLevel] + i_iPageX;
+	if( !bSeekPage( m_pFile, iPage, m_iPageBytes ) )
+		return false;
+
+	return fread( o_pData, m_iPageBytes, 1, m_pFile ) == 1;
+}
+
+bool bWritePageFile( const char *i_szFilename, CMuli3DTexture *i_pTexture )
+{
+	const m3dformat fmtFormat = i_pTexture->fmtGetFormat();
+	if( !bIsTextureFormat( fmtFormat ) )
+		return false;
+
+	FILE *pFile = fopen( i_szFilename, "wb" );
+	if( !pFile )
+		return false;
+
+	pagefileheader Header;
+	Header.iMagic = c_iPageFileMagic;
+	Header.iWidth = i_pTexture->iGetWidth();
+	Header.iHeight = i_pTexture->iGetHeight();
+	Header.iMipLevels = i_pTexture->iGetMipLevels();
+	Header.iFormat = fmtFormat;
+	Header.iPageSize = c_iVirtualPageSize;
+	bool bResult = ( fwrite( &Header, sizeof( Header ), 1, pFile ) == 1 );
+
+	const uint32 iPixelBytes = iGetFormatPixelBytes( fmtFormat );
+	const uint32 iPageRowBytes = c_iVirtualPageSize * iPixelBytes;
+	byte *pPage = new byte[c_iVirtualPageSize * iPageRowBytes];
+
+	for( uint32 iLevel = 0; bResult && iLevel < Header.iMipLevels; ++iLevel )
+	{
+		const byte *pData = 0;
+		if( FUNC_FAILED( i_pTexture->LockRect( iLevel, (void **)&pData, 0 ) ) )
+		{
+			bResult = false;
+			break;
+		}
+
+		const uint32 iWidth = i_pTexture->iGetWidth( iLevel ), iHeight = i_pTexture->iGetHeight( iLevel );
+		for( uint32 iPageY = 0; bResult && iPageY < iHeight; iPageY += c_iVirtualPageSize )
+		{
+			for( uint32 iPageX = 0; bResult && iPageX < iWidth; iPageX += c_iVirtualPageSize )
+			{
+				const uint32 iRows = ( iHeight - iPageY < c_iVirtualPageSize ) ? iHeight - iPageY : c_iVirtualPageSize;
+				const uint32 iColumns = ( iWidth - iPageX < c_iVirtualPageSize ) ? iWidth - iPageX : c_iVirtualPageSize;
+
+				memset( pPage, 0, c_iVirtualPageSize * iPageRowBytes );
+				for( uint32 iRow = 0; iRow < iRows; ++iRow )
+					memcpy( &pPage[iRow * iPageRowBytes], &pData[( ( iPageY + iRow ) * iWidth + iPageX ) * iPixelBytes], iColumns * iPixelBytes );
+
+				bResult = ( fwrite( pPage, c_iVirtualPageSize * iPageRowBytes, 1, pFile ) == 1 );
+			}
+		}
+
+		i_pTexture->UnlockRect( iLevel );
+	}
+
+	SAFE_DELETE_ARRAY( pPage );
+	fclose( pFile );
+	return bResult;
+}
+
+bool bCreateVirtualTexture( CMuli3DVirtualTexture **o_ppTexture, CMuli3DDevice *i_pDevice, const char *i_szFilename, uint32 i_iResidentPages )
+{
+	*o_ppTexture = 0;
+
+	CPageFile *pPageFile = new CPageFile;
+	if( !pPageFile->bOpen( i_szFilename ) )
+	{
+		SAFE_RELEASE( pPageFile );
+		return false;
+	}
+
+	const pagefileheader &Header = pPageFile->GetHeader();
+	result resCreate = i_pDevice->CreateVirtualTexture( o_ppTexture, Header.iWidth, Header.iHeight,
+		Header.iMipLevels, (m3dformat)Header.iFormat, i_iResidentPages, pPageFile );
+
+	// the texture keeps its own reference to the page file
+	SAFE_RELEASE( pPageFile );
+	return FUNC_SUCCESSFUL( resCreate );
+}
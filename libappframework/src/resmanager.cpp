@@ -1,18 +1,28 @@
 
 #include "../include/resmanager.h"
 #include "../include/application.h"
+#include "../../libmuli3d/include/core/m3dcore_threadpool.h"
 
 CResManager::CResManager( IApplication *i_pParent )
 {
 	m_pParent = i_pParent;
 	
-	m_iNumLoadedResources = 0;
+	m_bCompressTextures = false;
+
+	m_iLoaderThreads = 4;
+	m_iNextLoaderQueue = 0;
+	m_pLoaderThreads = 0;
+	m_iLoaderThreadsUsers = 0;
 }
 
 CResManager::~CResManager()
 {
-	while( m_ManagedResources.size() )
-		ReleaseResource( m_ManagedResources.begin()->hResource );
+	while( m_ManagedResources.iGetSize() )
+		ReleaseResource( m_ManagedResources.hGetHandle( 0 ) );
+
+	for( uint32 i = 0; i < m_LoaderQueues.size(); ++i )
+		SAFE_DELETE( m_LoaderQueues[i] );
+	SAFE_DELETE( m_pLoaderThreads );
 }
 
 // Resource loaders -----------------------------------------------------------
@@ -28,14 +38,26 @@ void *pLoadModel( CResManager *i_pParent, string i_sFilename )
 {
 	CGraphics *pGraphics = i_pParent->pGetParent()->pGetGraphics();
 	CFileIO *pFileIO = pGraphics->pGetParent()->pGetFileIO();
+
+	// The model is converted to a mesh file next to it, which is mapped
+	// into memory by subsequent loads instead of parsing the model again.
+	const string sSourcePath = pFileIO->pDiskFilePath( i_sFilename );
+	const string sMeshPath = sSourcePath + ".m3dmesh";
+
+	CModel *pModel = new CModel( g_pResManager );
+	if( pModel->bLoadMeshFile( sMeshPath.c_str(), sSourcePath.c_str() ) )
+		return pModel;
 	
+	// the parser skips carriage returns itself, so the file is read as it is
 	char *pData = 0;
-	uint32 iLength = pFileIO->iReadFile( i_sFilename, (byte **)&pData, true );
+	uint32 iLength = pFileIO->iReadFile( i_sFilename, (byte **)&pData );
 	if( !iLength )
+	{
+		SAFE_DELETE( pModel );
 		return 0;
+	}
 
-	CModel *pModel = new CModel( g_pResManager );
-	bool bResult = pModel->bLoadModel( pData );
+	bool bResult = pModel->bLoadModel( pData, iLength );
 	SAFE_DELETE_ARRAY( pData );
 
 	if( !bResult )
@@ -43,8 +65,26 @@ void *pLoadModel( CResManager *i_pParent, string i_sFilename )
 		SAFE_DELETE( pModel );
 		return 0;
 	}
-	else
-		return pModel;
+
+	// the data directory may be read-only, so a failure to write the mesh file is ignored
+	pModel->bWriteMeshFile( sMeshPath.c_str(), sSourcePath.c_str() );
+
+	return pModel;
+}
+
+void *pLoadMeshFile( CResManager *i_pParent, string i_sFilename )
+{
+	CGraphics *pGraphics = i_pParent->pGetParent()->pGetGraphics();
+	CFileIO *pFileIO = pGraphics->pGetParent()->pGetFileIO();
+
+	CModel *pModel = new CModel( g_pResManager );
+	if( !pModel->bLoadMeshFile( pFileIO->pDiskFilePath( i_sFilename ), 0 ) )
+	{
+		SAFE_DELETE( pModel );
+		return 0;
+	}
+
+	return pModel;
 }
 
 void UnloadModel( CResManager *i_pParent, void *i_pResource )
@@ -56,6 +96,8 @@ void UnloadModel( CResManager *i_pParent, void *i_pResource )
 // Textures -------------------------------------------------------------------
 
 #include "../include/texture.h"
+#include "../include/texcompress.h"
+#include "../include/texcache.h"
 
 #ifdef WIN32
 #include "../libpng/png.h"
@@ -91,9 +133,11 @@ bool bLoadPNGTexture( CMuli3DTexture **o_ppTexture, const byte *i_pData, CMuli3D
 		return false;
 	}
 
+	*o_ppTexture = 0;
 	if( setjmp( png_ptr->jmpbuf ) ) 
 	{
 		png_destroy_read_struct( &png_ptr, &info_ptr, &end_info );
+		SAFE_RELEASE( *o_ppTexture );
         return false;
 	}
 
@@ -108,28 +152,32 @@ bool bLoadPNGTexture( CMuli3DTexture **o_ppTexture, const byte *i_pData, CMuli3D
 	if( color_type == PNG_COLOR_TYPE_GRAY && png_get_bit_depth( png_ptr, info_ptr ) < 8) png_set_expand( png_ptr );
 	if( color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA ) png_set_gray_to_rgb( png_ptr );
 	if( png_get_bit_depth( png_ptr, info_ptr ) == 16 ) png_set_strip_16( png_ptr );
+	png_set_filler( png_ptr, 0xff, PNG_FILLER_AFTER ); // images without alpha channel are opaque
 	png_read_update_info( png_ptr, info_ptr );
 
-	color_type = png_get_color_type( png_ptr, info_ptr );
-	bool bHasAlpha = (color_type == PNG_COLOR_TYPE_RGB_ALPHA);
-	m3dformat fmtTextureFormat = bHasAlpha ? m3dfmt_r32g32b32a32f : m3dfmt_r32g32b32f;
-	
-	if( FUNC_FAILED( i_pDevice->CreateTexture( o_ppTexture, iDimX, iDimY, 0, fmtTextureFormat ) ) )
+	// The 8-bit channels are stored as they are; the texture takes up a quarter
+	// of the memory of a float texture. Textures loaded from files are only sampled,
+	// so they use the tiled layout.
+	if( FUNC_FAILED( i_pDevice->CreateTexture( o_ppTexture, iDimX, iDimY, 0, m3dfmt_r8g8b8a8, m3dtl_tiled ) ) )
 	{
 		png_destroy_read_struct( &png_ptr, &info_ptr, &end_info );
         return false;
 	}
 
-	byte *pData = new byte[ iDimY * png_get_rowbytes( png_ptr, info_ptr ) ];
-	byte *pCurData = pData;
-	byte **pRows = new byte *[iDimY];
-	for( uint32 i = 0; i < iDimY; ++i )
+	byte *pTexData = 0;
+	result resLock = (*o_ppTexture)->LockRect( 0, (void **)&pTexData, 0 );
+	if( FUNC_FAILED( resLock ) )
 	{
-		pRows[i] = pCurData;
-		pCurData += png_get_rowbytes( png_ptr, info_ptr );
+		png_destroy_read_struct( &png_ptr, &info_ptr, &end_info );
+		SAFE_RELEASE( *o_ppTexture );
+		return false;
 	}
 
-	// read the image
+	// read the image directly into the texture
+	byte **pRows = new byte *[iDimY];
+	for( uint32 i = 0; i < iDimY; ++i )
+		pRows[i] = &pTexData[i * iDimX * 4];
+
 	png_read_image( png_ptr, pRows );
 
 	SAFE_DELETE_ARRAY( pRows );
@@ -137,53 +185,131 @@ bool bLoadPNGTexture( CMuli3DTexture **o_ppTexture, const byte *i_pData, CMuli3D
 	png_read_end( png_ptr, end_info );
 	png_destroy_read_struct( &png_ptr, &info_ptr, &end_info );
 
-	float32 *pTexData = 0;
-	result resLock = (*o_ppTexture)->LockRect( 0, (void **)&pTexData, 0 );
-	if( FUNC_FAILED( resLock ) )
+	(*o_ppTexture)->UnlockRect( 0 );
+
+	return true;
+}
+
+// Replaces a texture and its mip-levels by a block-compressed copy; the texture is kept if compression fails.
+static void CompressTexture( CMuli3DTexture **io_ppTexture )
+{
+	CMuli3DSurface *pBaseLevel = (*io_ppTexture)->pGetMipLevel( 0 );
+	const m3dformat fmtFormat = fmtChooseBlockFormat( pBaseLevel );
+	SAFE_RELEASE( pBaseLevel );
+
+	CMuli3DTexture *pCompressed = 0;
+	if( bCompressTexture( &pCompressed, *io_ppTexture, fmtFormat ) )
 	{
-		SAFE_DELETE_ARRAY( pData );
-		return false;
+		SAFE_RELEASE( *io_ppTexture );
+		*io_ppTexture = pCompressed;
 	}
+}
+
+// Decodes one of several PNG files, see bLoadPNGTextures().
+struct pngloadjob
+{
+	CResManager		*pParent;
+	const string	*pFilenames;
+	CMuli3DTexture	**ppTextures;
+	bool			bGenerateMips, bCompress;
+};
+
+static void LoadPNGJob( void *i_pJob, uint32 i_iJob, uint32 i_iThread )
+{
+	pngloadjob *pJob = (pngloadjob *)i_pJob;
+	CGraphics *pGraphics = pJob->pParent->pGetParent()->pGetGraphics();
+	CFileIO *pFileIO = pGraphics->pGetParent()->pGetFileIO();
 
-	const float32 fColorScale = 1.0f / 255.0f;
+	CMuli3DTexture **ppTexture = &pJob->ppTextures[i_iJob];
+	*ppTexture = 0;
 
-	pCurData = pData;
-	for( uint32 iY = 0; iY < iDimY; ++iY )
+	byte *pData = 0;
+	uint32 iLength = pFileIO->iReadFile( pJob->pFilenames[i_iJob], &pData );
+	if( !iLength )
+		return;
+
+	bool bResult = bLoadPNGTexture( ppTexture, pData, pGraphics->pGetM3DDevice() );
+	SAFE_DELETE_ARRAY( pData );
+	if( !bResult )
+		return;
+
+	if( pJob->bGenerateMips )
+		(*ppTexture)->GenerateMipSubLevels( 0 );
+	if( pJob->bCompress )
+		CompressTexture( ppTexture );
+}
+
+// Loads several PNG files into o_ppTextures, in parallel on the resource manager's
+// loader threads if they are available. Fails if any of the files can't be loaded.
+static bool bLoadPNGTextures( CMuli3DTexture **o_ppTextures, CResManager *i_pParent, const vector<string> &i_sFilenames,
+	bool i_bGenerateMips, bool i_bCompress )
+{
+	const uint32 iNumTextures = (uint32)i_sFilenames.size();
+
+	pngloadjob Job;
+	Job.pParent = i_pParent;
+	Job.pFilenames = &i_sFilenames[0];
+	Job.ppTextures = o_ppTextures;
+	Job.bGenerateMips = i_bGenerateMips;
+	Job.bCompress = i_bCompress;
+
+	CMuli3DThreadPool *pThreads = i_pParent->pAcquireLoaderThreads();
+	if( pThreads )
+		pThreads->Execute( LoadPNGJob, &Job, iNumTextures );
+	else
 	{
-		for( uint32 iX = 0; iX < iDimX; ++iX )
-		{
-			(*pTexData++) = (float32)(*pCurData++) * fColorScale;
-			(*pTexData++) = (float32)(*pCurData++) * fColorScale;
-			(*pTexData++) = (float32)(*pCurData++) * fColorScale;
-			if( bHasAlpha )
-				(*pTexData++) = (float32)(*pCurData++) * fColorScale;
-		}
+		for( uint32 i = 0; i < iNumTextures; ++i )
+			LoadPNGJob( &Job, i, 0 );
 	}
+	i_pParent->ReleaseLoaderThreads( pThreads );
 
-	SAFE_DELETE_ARRAY( pData );
+	bool bResult = true;
+	for( uint32 i = 0; i < iNumTextures; ++i )
+	{
+		if( !o_ppTextures[i] )
+			bResult = false;
+	}
 
-	(*o_ppTexture)->UnlockRect( 0 );
+	if( !bResult )
+	{
+		for( uint32 i = 0; i < iNumTextures; ++i )
+			SAFE_RELEASE( o_ppTextures[i] );
+	}
 
-	return true;
+	return bResult;
 }
 
 void *pLoadTexture( CResManager *i_pParent, string i_sFilename )
 {
 	CGraphics *pGraphics = i_pParent->pGetParent()->pGetGraphics();
 	CFileIO *pFileIO = pGraphics->pGetParent()->pGetFileIO();
+
+	// The preprocessed texture is cached next to the image; the cache is mapped
+	// into memory, which spares decoding the image and building the mip-chain.
+	const string sSourcePath = pFileIO->pDiskFilePath( i_sFilename );
+	const string sCachePath = sSourcePath + ".m3dtex";
+	const bool bCompress = i_pParent->bGetTextureCompression();
+
+	CMuli3DTexture *pTexture = 0;
+	if( bLoadTextureCache( &pTexture, pGraphics->pGetM3DDevice(), sCachePath.c_str(), sSourcePath.c_str(), bCompress ) )
+		return new CTexture( g_pResManager, pTexture );
 	
 	byte *pData = 0;
 	uint32 iLength = pFileIO->iReadFile( i_sFilename, &pData );
 	if( !iLength )
 		return 0;
 
-	CMuli3DTexture *pTexture = 0;
 	bool bResult = bLoadPNGTexture( &pTexture, pData, pGraphics->pGetM3DDevice() );
 	SAFE_DELETE_ARRAY( pData );
 	if( !bResult )
 		return 0;
 
 	pTexture->GenerateMipSubLevels( 0 );
+	if( bCompress )
+		CompressTexture( &pTexture );
+
+	// the data directory may be read-only, so a failure to write the cache is ignored
+	bWriteTextureCache( sCachePath.c_str(), pTexture, sSourcePath.c_str() );
 
 	return new CTexture( g_pResManager, pTexture );
 }
@@ -225,78 +351,77 @@ void *pLoadCubeTexture( CResManager *i_pParent, string i_sFilename )
 	if( iNumTextures != 6 )
 		return 0;
 
-	uint32 iEdgeLength = 0;
-	m3dformat fmtCubeFormat = m3dfmt_r32g32b32f;
+	const bool bCompress = i_pParent->bGetTextureCompression();
 
+	// the faces are decoded in parallel; mip-levels can't be generated from compressed data,
+	// so the mip-levels of each face are generated beforehand if the cube texture is compressed
 	CMuli3DTexture **ppTextures = new CMuli3DTexture *[iNumTextures];
-	uint32 i;
-	for( i = 0; i < iNumTextures; ++i )
+	if( !bLoadPNGTextures( ppTextures, i_pParent, sFilenames, bCompress, false ) )
 	{
-		byte *pTexData = 0;
-		uint32 iTexLength = pFileIO->iReadFile( sFilenames[i], &pTexData );
-	
-		if( !iTexLength )
-		{
-			// release created textures up to now
-			for( uint32 j = 0; j < i; ++j )
-				SAFE_RELEASE( ppTextures[j] );
-			SAFE_DELETE_ARRAY( ppTextures );
-			return 0;
-		}
-
-		bool bResult = bLoadPNGTexture( &ppTextures[i], pTexData, pGraphics->pGetM3DDevice() );
-		SAFE_DELETE_ARRAY( pTexData );
-		if( !bResult )
-		{
-			// release created textures up to now
-			for( uint32 j = 0; j < i; ++j )
-				SAFE_RELEASE( ppTextures[j] );
-			SAFE_DELETE_ARRAY( ppTextures );
-			return 0;
-		}
+		SAFE_DELETE_ARRAY( ppTextures );
+		return 0;
+	}
 
-		if( i == 0 )
-		{
-			iEdgeLength = ppTextures[i]->iGetWidth();
-			fmtCubeFormat = ppTextures[i]->fmtGetFormat();
-		}
+	uint32 iEdgeLength = ppTextures[0]->iGetWidth();
+	m3dformat fmtCubeFormat = ppTextures[0]->fmtGetFormat();
 
+	for( uint32 i = 0; i < iNumTextures; ++i )
+	{
 		// make sure that we're building a valid cubemap ...
 		if( ppTextures[i]->iGetWidth() != ppTextures[i]->iGetHeight() ||
 			ppTextures[i]->iGetWidth() != iEdgeLength ||
 			ppTextures[i]->fmtGetFormat() != fmtCubeFormat )
 		{
-			// release created textures up to now
-			for( uint32 j = 0; j < i; ++j )
+			for( uint32 j = 0; j < iNumTextures; ++j )
 				SAFE_RELEASE( ppTextures[j] );
 			SAFE_DELETE_ARRAY( ppTextures );
 			return 0;
 		}
 	}
 
+	if( bCompress )
+	{
+		fmtCubeFormat = m3dfmt_bc1;
+		for( uint32 iFace = 0; iFace < iNumTextures; ++iFace )
+		{
+			CMuli3DSurface *pBaseLevel = ppTextures[iFace]->pGetMipLevel( 0 );
+			if( fmtChooseBlockFormat( pBaseLevel ) == m3dfmt_bc3 )
+				fmtCubeFormat = m3dfmt_bc3;
+			SAFE_RELEASE( pBaseLevel );
+		}
+	}
+
 	CMuli3DCubeTexture *pCubeTexture = 0;
 	if( FUNC_FAILED( pGraphics->pGetM3DDevice()->CreateCubeTexture( &pCubeTexture,
-		iEdgeLength, 0, fmtCubeFormat ) ) )
+		iEdgeLength, 0, fmtCubeFormat, m3dtl_tiled ) ) )
 	{
-		// release created textures up to now
-		for( uint32 j = 0; j < i; ++j )
+		for( uint32 j = 0; j < iNumTextures; ++j )
 			SAFE_RELEASE( ppTextures[j] );
 		SAFE_DELETE_ARRAY( ppTextures );
 		return 0;
 	}
 	
-	uint32 iNumBytes = iEdgeLength * iEdgeLength;
-	switch( fmtCubeFormat )
-	{
-	case m3dfmt_r32f: iNumBytes *= sizeof( float32 ); break;
-	case m3dfmt_r32g32f: iNumBytes *= 2 * sizeof( float32 ); break;
-	case m3dfmt_r32g32b32f: iNumBytes *= 3 * sizeof( float32 ); break;
-	case m3dfmt_r32g32b32a32f: iNumBytes *= 4 * sizeof( float32 ); break;
-	default: /* cannot happen */ break;
-	}
+	const uint32 iNumBytes = iEdgeLength * iEdgeLength * iGetFormatPixelBytes( fmtCubeFormat );
 
 	for( uint32 iFace = m3dcf_positive_x; iFace <= m3dcf_negative_z; ++iFace )
 	{
+		if( bCompress )
+		{
+			// each level is compressed separately
+			CMuli3DTexture *pFace = pCubeTexture->pGetCubeFace( (m3dcubefaces)iFace );
+			for( uint32 iLevel = 0; iLevel < pFace->iGetMipLevels(); ++iLevel )
+			{
+				CMuli3DSurface *pSrc = ppTextures[iFace]->pGetMipLevel( iLevel );
+				CMuli3DSurface *pDest = pFace->pGetMipLevel( iLevel );
+				bCompressSurface( pDest, pSrc );
+				SAFE_RELEASE( pDest );
+				SAFE_RELEASE( pSrc );
+			}
+			SAFE_RELEASE( pFace );
+			SAFE_RELEASE( ppTextures[iFace] );
+			continue;
+		}
+
 		uint8 *pDest = 0;
 		pCubeTexture->LockRect( (m3dcubefaces)iFace, 0, (void **)&pDest, 0 );
 
@@ -311,7 +436,8 @@ void *pLoadCubeTexture( CResManager *i_pParent, string i_sFilename )
 
 	SAFE_DELETE_ARRAY( ppTextures );
 
-	pCubeTexture->GenerateMipSubLevels( 0 );
+	if( !bCompress )
+		pCubeTexture->GenerateMipSubLevels( 0 );
 
 	return new CTexture( g_pResManager, pCubeTexture );
 }
@@ -365,31 +491,10 @@ void *pLoadAnimatedTexture( CResManager *i_pParent, string i_sFilename )
 		return 0;
 
 	CMuli3DTexture **ppTextures = new CMuli3DTexture *[iNumTextures];
-	for( uint32 i = 0; i < iNumTextures; ++i )
+	if( !bLoadPNGTextures( ppTextures, i_pParent, sFilenames, true, i_pParent->bGetTextureCompression() ) )
 	{
-		byte *pTexData = 0;
-		uint32 iTexLength = pFileIO->iReadFile( sFilenames[i], &pTexData );
-		if( !iTexLength )
-		{
-			// release created textures up to now
-			for( uint32 j = 0; j < i; ++j )
-				SAFE_RELEASE( ppTextures[j] );
-			SAFE_DELETE_ARRAY( ppTextures );
-			return 0;
-		}
-
-		bool bResult = bLoadPNGTexture( &ppTextures[i], pTexData, pGraphics->pGetM3DDevice() );
-		SAFE_DELETE_ARRAY( pTexData );
-		if( !bResult )
-		{
-			// release created textures up to now
-			for( uint32 j = 0; j < i; ++j )
-				SAFE_RELEASE( ppTextures[j] );
-			SAFE_DELETE_ARRAY( ppTextures );
-			return 0;
-		}
-
-		ppTextures[i]->GenerateMipSubLevels( 0 );
+		SAFE_DELETE_ARRAY( ppTextures );
+		return 0;
 	}
 
 	return new CTexture( g_pResManager, iNumTextures, fFPS, ppTextures );
@@ -406,6 +511,7 @@ void UnloadTexture( CResManager *i_pParent, void *i_pResource )
 bool CResManager::bInitialize()
 {
 	RegisterResourceExtension( "obj", pLoadModel, UnloadModel );
+	RegisterResourceExtension( "m3dmesh", pLoadMeshFile, UnloadModel );
 
 	RegisterResourceExtension( "png", pLoadTexture, UnloadTexture );
 	RegisterResourceExtension( "cube", pLoadCubeTexture, UnloadTexture );
@@ -423,16 +529,182 @@ void CResManager::RegisterResourceExtension( string i_sExtension, PLOADFUNCTION
 HRESOURCE CResManager::hLoadResource( string i_sFilename )
 {
 	// Look if we have already loaded this resource ---------------------------
-	for( vector<tManagedResource>::iterator pManagedResource = m_ManagedResources.begin(); pManagedResource != m_ManagedResources.end(); ++pManagedResource )
+	HRESOURCE hResource = hFindResource( i_sFilename );
+	if( hResource )
+	{
+		tManagedResource *pManagedResource = m_ManagedResources.pGet( hResource );
+		bFinishLoad( *pManagedResource, true );
+		if( !pManagedResource->pResource )
+			return 0;
+
+		++pManagedResource->iReferences;
+		return hResource;
+	}
+
+	// We have to load it from the disk ---------------------------------------
+	string sExtension = sGetExtension( i_sFilename );
+	PLOADFUNCTION pLoadFunction = m_RegisteredEntityExtensionsLoad[sExtension];
+	if( !pLoadFunction )
+		return 0;
+
+	g_pResManager = this;
+
+	tManagedResource newResource;
+	newResource.pResource = pLoadFunction( this, i_sFilename );
+	if( !newResource.pResource )
+		return 0;
+
+	newResource.iReferences = 1;
+	newResource.sFilename = i_sFilename;
+	newResource.sExtension = sExtension;
+	newResource.pPendingLoad = 0;
+	return hAddResource( newResource );
+}
+
+HRESOURCE CResManager::hLoadResourceAsync( string i_sFilename )
+{
+	HRESOURCE hResource = hFindResource( i_sFilename );
+	if( hResource )
+	{
+		++m_ManagedResources.pGet( hResource )->iReferences;
+		return hResource;
+	}
+
+	string sExtension = sGetExtension( i_sFilename );
+	PLOADFUNCTION pLoadFunction = m_RegisteredEntityExtensionsLoad[sExtension];
+	if( !pLoadFunction )
+		return 0;
+
+	if( m_LoaderQueues.empty() )
 	{
-		if( pManagedResource->sFilename == i_sFilename )
+		for( uint32 i = 0; i < m_iLoaderThreads; ++i )
 		{
-			++pManagedResource->iReferences;
-			return pManagedResource->hResource;
+			CMuli3DWorkQueue *pQueue = new CMuli3DWorkQueue;
+			if( FUNC_FAILED( pQueue->Create() ) )
+			{
+				SAFE_DELETE( pQueue );
+				break;
+			}
+			m_LoaderQueues.push_back( pQueue );
 		}
-	} 
 
-	// We have to load it from the disk ---------------------------------------
+		if( m_LoaderQueues.empty() )
+			return hLoadResource( i_sFilename );
+	}
+
+	g_pResManager = this;
+
+	tPendingLoad *pPendingLoad = new tPendingLoad;
+	pPendingLoad->pParent = this;
+	pPendingLoad->pLoadFunction = pLoadFunction;
+	pPendingLoad->sFilename = i_sFilename;
+	pPendingLoad->pResource = 0;
+
+	tManagedResource newResource;
+	newResource.pResource = 0;
+	newResource.iReferences = 1;
+	newResource.sFilename = i_sFilename;
+	newResource.sExtension = sExtension;
+	newResource.pPendingLoad = pPendingLoad;
+	hResource = hAddResource( newResource );
+	if( !hResource )
+	{
+		SAFE_DELETE( pPendingLoad );
+		return 0;
+	}
+
+	// Loads are handed to the loader threads in turn. Submitting may execute the job right away,
+	// so the handle has to be registered first.
+	pPendingLoad->iQueue = m_iNextLoaderQueue;
+	m_iNextLoaderQueue = ( m_iNextLoaderQueue + 1 ) % (uint32)m_LoaderQueues.size();
+	pPendingLoad->iJob = m_LoaderQueues[pPendingLoad->iQueue]->iSubmit( LoadResourceJob, pPendingLoad );
+
+	return hResource;
+}
+
+void CResManager::LoadResourceJob( void *i_pPendingLoad, uint32 i_iJob, uint32 i_iThread )
+{
+	tPendingLoad *pPendingLoad = (tPendingLoad *)i_pPendingLoad;
+	pPendingLoad->pResource = pPendingLoad->pLoadFunction( pPendingLoad->pParent, pPendingLoad->sFilename );
+}
+
+bool CResManager::bFinishLoad( tManagedResource &io_Resource, bool i_bWait )
+{
+	tPendingLoad *pPendingLoad = io_Resource.pPendingLoad;
+	if( !pPendingLoad )
+		return true;
+
+	CMuli3DWorkQueue *pQueue = m_LoaderQueues[pPendingLoad->iQueue];
+	if( i_bWait )
+		pQueue->Wait( pPendingLoad->iJob );
+	else if( !pQueue->bIsComplete( pPendingLoad->iJob ) )
+		return false;
+
+	io_Resource.pResource = pPendingLoad->pResource;
+	io_Resource.pPendingLoad = 0;
+	SAFE_DELETE( pPendingLoad );
+	return true;
+}
+
+bool CResManager::bIsResourceLoaded( HRESOURCE i_hResource )
+{
+	tManagedResource *pManagedResource = m_ManagedResources.pGet( i_hResource );
+	if( !pManagedResource )
+		return true;
+
+	return bFinishLoad( *pManagedResource, false );
+}
+
+bool CResManager::bWaitForResource( HRESOURCE i_hResource )
+{
+	tManagedResource *pManagedResource = m_ManagedResources.pGet( i_hResource );
+	if( !pManagedResource )
+		return false;
+
+	bFinishLoad( *pManagedResource, true );
+	return pManagedResource->pResource != 0;
+}
+
+void CResManager::WaitForResources()
+{
+	for( uint32 iResource = 0; iResource < m_ManagedResources.iGetSize(); ++iResource )
+		bFinishLoad( m_ManagedResources[iResource], true );
+}
+
+CMuli3DThreadPool *CResManager::pAcquireLoaderThreads()
+{
+	const uint32 iThreads = m_iLoaderThreads < c_iMaxRasterizerThreads ? m_iLoaderThreads : c_iMaxRasterizerThreads;
+	if( iThreads <= 1 )
+		return 0;
+
+	if( iAtomicIncrement( &m_iLoaderThreadsUsers ) != 1 )
+	{
+		// Another loader is using the threads.
+		iAtomicDecrement( &m_iLoaderThreadsUsers );
+		return 0;
+	}
+
+	if( !m_pLoaderThreads )
+	{
+		m_pLoaderThreads = new CMuli3DThreadPool;
+		if( FUNC_FAILED( m_pLoaderThreads->Create( iThreads ) ) )
+			SAFE_DELETE( m_pLoaderThreads );
+	}
+
+	if( !m_pLoaderThreads )
+		iAtomicDecrement( &m_iLoaderThreadsUsers );
+
+	return m_pLoaderThreads;
+}
+
+void CResManager::ReleaseLoaderThreads( CMuli3DThreadPool *i_pThreads )
+{
+	if( i_pThreads )
+		iAtomicDecrement( &m_iLoaderThreadsUsers );
+}
+
+string CResManager::sGetExtension( string i_sFilename )
+{
 	const char *pCheck = i_sFilename.c_str();
 	const char *pExt = 0;
 	while( *pCheck )
@@ -443,63 +715,96 @@ HRESOURCE CResManager::hLoadResource( string i_sFilename )
 	}
 
 	if( !pExt )
-		return 0;
+		return "";
 
-	string sExtension = (pExt + 1);
-	PLOADFUNCTION pLoadFunction = m_RegisteredEntityExtensionsLoad[sExtension];
-	if( !pLoadFunction )
-		return 0;
+	return pExt + 1;
+}
 
-	g_pResManager = this;
+uint32 CResManager::iHashFilename( const string &i_sFilename )
+{
+	// FNV-1a
+	uint32 iHash = 2166136261u;
+	for( const char *pChar = i_sFilename.c_str(); *pChar; ++pChar )
+		iHash = ( iHash ^ (uint8)*pChar ) * 16777619u;
+	return iHash;
+}
 
-	tManagedResource newResource;
-	newResource.pResource = pLoadFunction( this, i_sFilename );
-	if( !newResource.pResource )
+HRESOURCE CResManager::hFindResource( const string &i_sFilename )
+{
+	if( m_FilenameIndex.empty() )
 		return 0;
 
-	newResource.hResource = ++m_iNumLoadedResources;
-	newResource.iReferences = 1;
-	newResource.sFilename = i_sFilename;
-	newResource.sExtension = sExtension;
-	m_ManagedResources.push_back( newResource );
-	return newResource.hResource;
+	const vector<HRESOURCE> &Bucket = m_FilenameIndex[iHashFilename( i_sFilename ) & ( m_FilenameIndex.size() - 1 )];
+	for( uint32 i = 0; i < Bucket.size(); ++i )
+	{
+		if( m_ManagedResources.pGet( Bucket[i] )->sFilename == i_sFilename )
+			return Bucket[i];
+	}
+	return 0;
 }
 
-vector<CResManager::tManagedResource>::iterator CResManager::pGetManagedResourceIterator( HRESOURCE i_hResource )
+HRESOURCE CResManager::hAddResource( const tManagedResource &i_Resource )
 {
-	if( !i_hResource ) return m_ManagedResources.end();
-	for( vector<tManagedResource>::iterator pManagedResource = m_ManagedResources.begin(); pManagedResource != m_ManagedResources.end(); ++pManagedResource )
+	HRESOURCE hResource = m_ManagedResources.hInsert( i_Resource );
+	if( !hResource )
+		return 0;
+
+	// keep at most one resource per bucket on average; the number of buckets is a power of two
+	if( m_ManagedResources.iGetSize() > m_FilenameIndex.size() )
 	{
-		if( pManagedResource->hResource == i_hResource )
-			return pManagedResource;
+		uint32 iNumBuckets = 64;
+		while( iNumBuckets < m_ManagedResources.iGetSize() * 2 )
+			iNumBuckets <<= 1;
+
+		m_FilenameIndex.clear();
+		m_FilenameIndex.resize( iNumBuckets );
+		for( uint32 iResource = 0; iResource < m_ManagedResources.iGetSize(); ++iResource )
+		{
+			const uint32 iBucket = iHashFilename( m_ManagedResources[iResource].sFilename ) & ( iNumBuckets - 1 );
+			m_FilenameIndex[iBucket].push_back( m_ManagedResources.hGetHandle( iResource ) );
+		}
 	}
-	return m_ManagedResources.end();
+	else
+		m_FilenameIndex[iHashFilename( i_Resource.sFilename ) & ( m_FilenameIndex.size() - 1 )].push_back( hResource );
+
+	return hResource;
 }
 
 void CResManager::ReleaseResource( HRESOURCE i_hResource )
 {
-	vector<tManagedResource>::iterator pManagedResource = pGetManagedResourceIterator( i_hResource );
-	if( pManagedResource != m_ManagedResources.end() )
+	tManagedResource *pManagedResource = m_ManagedResources.pGet( i_hResource );
+	if( pManagedResource && --pManagedResource->iReferences == 0 )
 	{
-		if( --pManagedResource->iReferences == 0 )
-		{
-			PUNLOADFUNCTION pUnloadFunction = m_RegisteredEntityExtensionsUnload[pManagedResource->sExtension];
+		PUNLOADFUNCTION pUnloadFunction = m_RegisteredEntityExtensionsUnload[pManagedResource->sExtension];
 
-			uint32 iOldSize = (uint32)m_ManagedResources.size();
-			if( pUnloadFunction )
-				pUnloadFunction( this, pManagedResource->pResource );
+		// a resource still being loaded is unloaded after its loader has finished
+		bFinishLoad( *pManagedResource, true );
 
-			if( iOldSize != m_ManagedResources.size() )
-				pManagedResource = pGetManagedResourceIterator( i_hResource );
-			m_ManagedResources.erase( pManagedResource );
+		vector<HRESOURCE> &Bucket = m_FilenameIndex[iHashFilename( pManagedResource->sFilename ) & ( m_FilenameIndex.size() - 1 )];
+		for( uint32 i = 0; i < Bucket.size(); ++i )
+		{
+			if( Bucket[i] == i_hResource )
+			{
+				Bucket[i] = Bucket.back();
+				Bucket.pop_back();
+				break;
+			}
 		}
+
+		// the resource may release other resources, so it is erased by its handle afterwards
+		if( pUnloadFunction && pManagedResource->pResource )
+			pUnloadFunction( this, pManagedResource->pResource );
+		m_ManagedResources.bErase( i_hResource );
 	}
 }
 
 void *CResManager::pGetResource( HRESOURCE i_hResource )
 {
-	vector<tManagedResource>::iterator pManagedResource = pGetManagedResourceIterator( i_hResource );
-	if( pManagedResource != m_ManagedResources.end() )
+	tManagedResource *pManagedResource = m_ManagedResources.pGet( i_hResource );
+	if( pManagedResource )
+	{
+		bFinishLoad( *pManagedResource, false );
 		return pManagedResource->pResource;
+	}
 	return 0;
 }
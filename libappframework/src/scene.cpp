@@ -9,9 +9,6 @@ CScene::CScene( IApplication *i_pParent )
 {
 	m_pParent = i_pParent;
 
-	m_iNumCreatedEntities = 0;
-	m_iNumCreatedLights = 0;
-
 	SetClearColor( vector4( 0.30f, 0.25f, 0.35f, 1 ) );
 	SetAmbientLightColor( vector4( 0, 0, 0, 1 ) );
 
@@ -20,10 +17,10 @@ CScene::CScene( IApplication *i_pParent )
 
 CScene::~CScene()
 {
-	while( m_SceneEntities.size() )
-		ReleaseEntity( m_SceneEntities.begin()->hEntity );
-	while( m_SceneLights.size() )
-		ReleaseLight( m_SceneLights.begin()->hLight );
+	while( m_SceneEntities.iGetSize() )
+		ReleaseEntity( m_SceneEntities.hGetHandle( 0 ) );
+	while( m_SceneLights.iGetSize() )
+		ReleaseLight( m_SceneLights.hGetHandle( 0 ) );
 }
 
 bool CScene::bInitialize()
@@ -46,96 +43,64 @@ HENTITY CScene::hCreateEntity( string i_sTypeName, bool i_bSceneProcess )
 	if( !pEntity )
 		return 0;
 
-	tSceneEntity newEntity = { ++m_iNumCreatedEntities, pEntity, i_bSceneProcess };
-	m_SceneEntities.push_back( newEntity );
-	return newEntity.hEntity;
-}
-
-vector<CScene::tSceneEntity>::iterator CScene::pSceneEntityIterator( HENTITY i_hEntity )
-{
-	if( !i_hEntity ) return m_SceneEntities.end();
-	for( vector<tSceneEntity>::iterator pSceneEntity = m_SceneEntities.begin(); pSceneEntity != m_SceneEntities.end(); ++pSceneEntity )
-	{
-		if( pSceneEntity->hEntity == i_hEntity )
-			return pSceneEntity;
-	}
-	return m_SceneEntities.end();
+	tSceneEntity newEntity = { pEntity, i_bSceneProcess };
+	HENTITY hEntity = m_SceneEntities.hInsert( newEntity );
+	if( !hEntity )
+		delete pEntity;
+	return hEntity;
 }
 
 void CScene::ReleaseEntity( HENTITY i_hEntity )
 {
-	vector<tSceneEntity>::iterator pSceneEntity = pSceneEntityIterator( i_hEntity );
-	if( pSceneEntity != m_SceneEntities.end() )
+	tSceneEntity *pSceneEntity = m_SceneEntities.pGet( i_hEntity );
+	if( pSceneEntity )
 	{
-		uint32 iOldSize = (uint32)m_SceneEntities.size();
-		if( pSceneEntity->pEntity )
-			delete pSceneEntity->pEntity; // must not use safe_delete here, because after delete the pointer might not be valid anymore!! safe_delete would set it to 0 ...
-		
-		if( iOldSize != m_SceneEntities.size() )
-			pSceneEntity = pSceneEntityIterator( i_hEntity );
-
-		m_SceneEntities.erase( pSceneEntity );
+		// the entity may release other entities, so it is looked up by its handle again afterwards
+		delete pSceneEntity->pEntity;
+		m_SceneEntities.bErase( i_hEntity );
 	}
 }
 
 IEntity *CScene::pGetEntity( HENTITY i_hEntity )
 {
-	vector<tSceneEntity>::iterator pSceneEntity = pSceneEntityIterator( i_hEntity );
-	if( pSceneEntity != m_SceneEntities.end() )
-		return pSceneEntity->pEntity;
-	return 0;
+	tSceneEntity *pSceneEntity = m_SceneEntities.pGet( i_hEntity );
+	return pSceneEntity ? pSceneEntity->pEntity : 0;
 }
 
 HLIGHT CScene::hCreateLight()
 {
-	tSceneLight newLight = { ++m_iNumCreatedEntities, new CLight( this ) };
-	m_SceneLights.push_back( newLight );
-	return newLight.hLight;
-}
-
-vector<CScene::tSceneLight>::iterator CScene::pGetSceneLightIterator( HLIGHT i_hLight )
-{
-	if( !i_hLight ) return m_SceneLights.end();
-	for( vector<tSceneLight>::iterator pSceneLight = m_SceneLights.begin(); pSceneLight != m_SceneLights.end(); ++pSceneLight )
-	{
-		if( pSceneLight->hLight == i_hLight )
-			return pSceneLight;
-	}
-	return m_SceneLights.end();
+	tSceneLight newLight = { new CLight( this ) };
+	HLIGHT hLight = m_SceneLights.hInsert( newLight );
+	if( !hLight )
+		delete newLight.pLight;
+	return hLight;
 }
 
 void CScene::ReleaseLight( HLIGHT i_hLight )
 {
-	vector<tSceneLight>::iterator pSceneLight = pGetSceneLightIterator( i_hLight );
-	if( pSceneLight != m_SceneLights.end() )
+	tSceneLight *pSceneLight = m_SceneLights.pGet( i_hLight );
+	if( pSceneLight )
 	{
-		uint32 iOldSize = (uint32)m_SceneLights.size();
-		if( pSceneLight->pLight )
-			delete pSceneLight->pLight; // must not use safe_delete here, because after delete the pointer might not be valid anymore!! safe_delete would set it to 0 ...
-
-		if( iOldSize != m_SceneLights.size() )
-			pSceneLight = pGetSceneLightIterator( i_hLight );
-
-		m_SceneLights.erase( pSceneLight );
+		delete pSceneLight->pLight;
+		m_SceneLights.bErase( i_hLight );
 	}
 }
 
 CLight *CScene::pGetLight( HLIGHT i_hLight )
 {
-	vector<tSceneLight>::iterator pSceneLight = pGetSceneLightIterator( i_hLight );
-	if( pSceneLight != m_SceneLights.end() )
-		return pSceneLight->pLight;
-	return 0;
+	tSceneLight *pSceneLight = m_SceneLights.pGet( i_hLight );
+	return pSceneLight ? pSceneLight->pLight : 0;
 }
 
 void CScene::FrameMove()
 {
-	for( vector<tSceneEntity>::iterator pSceneEntity = m_SceneEntities.begin(); pSceneEntity != m_SceneEntities.end(); ++pSceneEntity )
+	for( uint32 iEntity = 0; iEntity < m_SceneEntities.iGetSize(); ++iEntity )
 	{
-		if( !pSceneEntity->bSceneProcess )
+		tSceneEntity &SceneEntity = m_SceneEntities[iEntity];
+		if( !SceneEntity.bSceneProcess )
 			continue;
 
-		pSceneEntity->pEntity->bFrameMove();
+		SceneEntity.pEntity->bFrameMove();
 		// TODO: if true, update scene-graph
 	}
 }
@@ -143,13 +108,14 @@ void CScene::FrameMove()
 void CScene::Render( uint32 i_iPass )
 {
 	CGraphics *pGraphics = pGetParent()->pGetGraphics();
-	for( vector<tSceneEntity>::iterator pSceneEntity = m_SceneEntities.begin(); pSceneEntity != m_SceneEntities.end(); ++pSceneEntity )
+	for( uint32 iEntity = 0; iEntity < m_SceneEntities.iGetSize(); ++iEntity )
 	{
-		if( !pSceneEntity->bSceneProcess )
+		tSceneEntity &SceneEntity = m_SceneEntities[iEntity];
+		if( !SceneEntity.bSceneProcess )
 			continue;
 
 		pGraphics->PushStateBlock();
-		pSceneEntity->pEntity->Render( i_iPass );
+		SceneEntity.pEntity->Render( i_iPass );
 		pGraphics->PopStateBlock();
 	}
 }
@@ -0,0 +1,93 @@
+
+#include "../include/texcache.h"
+#include "../include/mappedfile.h"
+#include <stdio.h>
+
+static const uint32 c_iTextureCacheMagic = 0x4354334d; // "M3TC"
+static const uint32 c_iTextureCacheVersion = 1;
+
+bool bWriteTextureCache( const char *i_szFilename, CMuli3DTexture *i_pTexture, const char *i_szSourceFilename )
+{
+	texturecacheheader Header;
+	memset( &Header, 0, sizeof( Header ) );
+	if( !bGetFileStamp( i_szSourceFilename, Header.iSourceSize, Header.iSourceTime ) )
+		return false;
+
+	Header.iMagic = c_iTextureCacheMagic;
+	Header.iVersion = c_iTextureCacheVersion;
+	Header.iWidth = i_pTexture->iGetWidth();
+	Header.iHeight = i_pTexture->iGetHeight();
+	Header.iMipLevels = i_pTexture->iGetMipLevels();
+	Header.iFormat = i_pTexture->fmtGetFormat();
+	Header.iTileSize = c_iTextureTileSize;
+
+	uint32 iMaxLevelSize = 0;
+	for( uint32 iLevel = 0; iLevel < Header.iMipLevels; ++iLevel )
+	{
+		CMuli3DSurface *pLevel = i_pTexture->pGetMipLevel( iLevel );
+		const uint32 iLevelSize = pLevel->iGetDataSize();
+		Header.iLayout = pLevel->GetLayout();
+		Header.iDataSize += iLevelSize;
+		if( iLevelSize > iMaxLevelSize )
+			iMaxLevelSize = iLevelSize;
+		SAFE_RELEASE( pLevel );
+	}
+
+	FILE *pFile = fopen( i_szFilename, "wb" );
+	if( !pFile )
+		return false;
+
+	bool bResult = fwrite( &Header, sizeof( Header ), 1, pFile ) == 1;
+
+	byte *pLevelData = new byte[iMaxLevelSize];
+	for( uint32 iLevel = 0; bResult && iLevel < Header.iMipLevels; ++iLevel )
+	{
+		CMuli3DSurface *pLevel = i_pTexture->pGetMipLevel( iLevel );
+		bResult = FUNC_SUCCESSFUL( pLevel->ReadData( pLevelData ) ) &&
+			fwrite( pLevelData, pLevel->iGetDataSize(), 1, pFile ) == 1;
+		SAFE_RELEASE( pLevel );
+	}
+	SAFE_DELETE_ARRAY( pLevelData );
+
+	if( fclose( pFile ) != 0 )
+		bResult = false;
+
+	// don't leave a truncated cache behind
+	if( !bResult )
+		remove( i_szFilename );
+
+	return bResult;
+}
+
+bool bLoadTextureCache( CMuli3DTexture **o_ppTexture, CMuli3DDevice *i_pDevice, const char *i_szFilename,
+	const char *i_szSourceFilename, bool i_bCompressed )
+{
+	uint32 iSourceSize = 0;
+	uint64 iSourceTime = 0;
+	if( !bGetFileStamp( i_szSourceFilename, iSourceSize, iSourceTime ) )
+		return false;
+
+	CMappedFile *pFile = new CMappedFile;
+	if( !pFile->bOpen( i_szFilename ) || pFile->iGetSize() < sizeof( texturecacheheader ) )
+	{
+		SAFE_RELEASE( pFile );
+		return false;
+	}
+
+	const texturecacheheader &Header = *(const texturecacheheader *)pFile->pGetData();
+	if( Header.iMagic != c_iTextureCacheMagic || Header.iVersion != c_iTextureCacheVersion ||
+		Header.iTileSize != c_iTextureTileSize || Header.iSourceSize != iSourceSize || Header.iSourceTime != iSourceTime ||
+		Header.iDataSize > pFile->iGetSize() - sizeof( Header ) ||
+		bIsBlockFormat( (m3dformat)Header.iFormat ) != i_bCompressed )
+	{
+		SAFE_RELEASE( pFile );
+		return false;
+	}
+
+	// The texture keeps a reference to the mapping.
+	const bool bResult = FUNC_SUCCESSFUL( i_pDevice->CreateTextureFromMemory( o_ppTexture, Header.iWidth, Header.iHeight,
+		Header.iMipLevels, (m3dformat)Header.iFormat, (m3dtexturelayout)Header.iLayout,
+		pFile->pGetData() + sizeof( Header ), Header.iDataSize, pFile ) );
+	SAFE_RELEASE( pFile );
+	return bResult;
+}
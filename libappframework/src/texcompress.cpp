@@ -0,0 +1,348 @@
+
+#include "../include/texcompress.h"
+
+// Block encoders -------------------------------------------------------------
+
+static void WriteColorBlock( byte *o_pBlock, uint32 i_iColor0, uint32 i_iColor1, uint32 i_iIndices )
+{
+	o_pBlock[0] = (byte)( i_iColor0 & 0xff ); o_pBlock[1] = (byte)( i_iColor0 >> 8 );
+	o_pBlock[2] = (byte)( i_iColor1 & 0xff ); o_pBlock[3] = (byte)( i_iColor1 >> 8 );
+	for( uint32 i = 0; i < 4; ++i )
+		o_pBlock[4 + i] = (byte)( i_iIndices >> ( 8 * i ) );
+}
+
+static uint32 iPackEndpoint( const float32 *i_pColor )
+{
+	const float32 fScale[3] = { 31.0f / 255.0f, 63.0f / 255.0f, 31.0f / 255.0f };
+	const int32 iMax[3] = { 31, 63, 31 };
+
+	uint32 iPacked = 0;
+	for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+	{
+		int32 iValue = (int32)( i_pColor[iChannel] * fScale[iChannel] + 0.5f );
+		if( iValue < 0 ) iValue = 0; else if( iValue > iMax[iChannel] ) iValue = iMax[iChannel];
+		iPacked = ( iPacked << ( iChannel == 1 ? 6 : 5 ) ) | (uint32)iValue;
+	}
+	return iPacked;
+}
+
+static void EncodeColorBlock( byte *o_pBlock, const byte *i_pPixels, bool i_bTransparency )
+{
+	// Transparent pixels don't contribute to the endpoints.
+	bool bTransparent[16]; uint32 iOpaque = 0;
+	float32 fMean[3] = { 0, 0, 0 };
+	for( uint32 iPixel = 0; iPixel < 16; ++iPixel )
+	{
+		const byte *pPixel = &i_pPixels[iPixel * 4];
+		bTransparent[iPixel] = i_bTransparency && pPixel[3] < 128;
+		if( bTransparent[iPixel] )
+			continue;
+
+		for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+			fMean[iChannel] += pPixel[iChannel];
+		++iOpaque;
+	}
+
+	if( !iOpaque )
+	{
+		// equal endpoints select three colors + transparent black
+		WriteColorBlock( o_pBlock, 0, 0, 0xffffffff );
+		return;
+	}
+
+	for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+		fMean[iChannel] /= (float32)iOpaque;
+
+	// Fit the endpoints to the principal axis of the colors.
+	float32 fCovariance[3][3] = { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } };
+	float32 fMin[3] = { 255, 255, 255 }, fMax[3] = { 0, 0, 0 };
+	for( uint32 iPixel = 0; iPixel < 16; ++iPixel )
+	{
+		if( bTransparent[iPixel] )
+			continue;
+
+		float32 fDelta[3];
+		for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+		{
+			const float32 fValue = i_pPixels[iPixel * 4 + iChannel];
+			fDelta[iChannel] = fValue - fMean[iChannel];
+			if( fValue < fMin[iChannel] ) fMin[iChannel] = fValue;
+			if( fValue > fMax[iChannel] ) fMax[iChannel] = fValue;
+		}
+
+		for( uint32 iRow = 0; iRow < 3; ++iRow )
+		{
+			for( uint32 iColumn = 0; iColumn < 3; ++iColumn )
+				fCovariance[iRow][iColumn] += fDelta[iRow] * fDelta[iColumn];
+		}
+	}
+
+	float32 fAxis[3] = { fMax[0] - fMin[0], fMax[1] - fMin[1], fMax[2] - fMin[2] };
+	for( uint32 iIteration = 0; iIteration < 4; ++iIteration )
+	{
+		float32 fNext[3];
+		for( uint32 iRow = 0; iRow < 3; ++iRow )
+			fNext[iRow] = fCovariance[iRow][0] * fAxis[0] + fCovariance[iRow][1] * fAxis[1] + fCovariance[iRow][2] * fAxis[2];
+
+		float32 fLength = fNext[0] * fNext[0] + fNext[1] * fNext[1] + fNext[2] * fNext[2];
+		if( fLength <= 0.0f )
+			break;
+
+		fLength = 1.0f / sqrtf( fLength );
+		for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+			fAxis[iChannel] = fNext[iChannel] * fLength;
+	}
+
+	float32 fMinProjection = 0, fMaxProjection = 0;
+	const float32 fAxisLength = fAxis[0] * fAxis[0] + fAxis[1] * fAxis[1] + fAxis[2] * fAxis[2];
+	if( fAxisLength > 0.0f )
+	{
+		for( uint32 iPixel = 0; iPixel < 16; ++iPixel )
+		{
+			if( bTransparent[iPixel] )
+				continue;
+
+			float32 fProjection = 0;
+			for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+				fProjection += ( i_pPixels[iPixel * 4 + iChannel] - fMean[iChannel] ) * fAxis[iChannel];
+			fProjection /= fAxisLength;
+
+			if( fProjection < fMinProjection ) fMinProjection = fProjection;
+			if( fProjection > fMaxProjection ) fMaxProjection = fProjection;
+		}
+	}
+
+	float32 fEndpoint0[3], fEndpoint1[3];
+	for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+	{
+		fEndpoint0[iChannel] = fMean[iChannel] + fAxis[iChannel] * fMaxProjection;
+		fEndpoint1[iChannel] = fMean[iChannel] + fAxis[iChannel] * fMinProjection;
+	}
+
+	uint32 iColor0 = iPackEndpoint( fEndpoint0 ), iColor1 = iPackEndpoint( fEndpoint1 );
+
+	// The order of the endpoints selects four colors (color0 > color1) or
+	// three colors + transparent black.
+	const bool bThreeColors = ( iOpaque < 16 );
+	if( bThreeColors ? iColor0 > iColor1 : iColor0 < iColor1 )
+	{
+		const uint32 iSwap = iColor0; iColor0 = iColor1; iColor1 = iSwap;
+	}
+
+	if( iColor0 == iColor1 && !bThreeColors )
+	{
+		WriteColorBlock( o_pBlock, iColor0, iColor1, 0 );
+		return;
+	}
+
+	// Decode the palette exactly like the sampler does by giving the first four pixels the indices 0 to 3.
+	byte Probe[8], Palette[64];
+	WriteColorBlock( Probe, iColor0, iColor1, 0xe4 );
+	DecodeBlock( Palette, m3dfmt_bc1, Probe );
+
+	const uint32 iNumColors = bThreeColors ? 3 : 4;
+	uint32 iIndices = 0;
+	for( uint32 iPixel = 0; iPixel < 16; ++iPixel )
+	{
+		uint32 iBestIndex = 3;
+		if( !bTransparent[iPixel] )
+		{
+			int32 iBestError = 0x7fffffff;
+			for( uint32 iIndex = 0; iIndex < iNumColors; ++iIndex )
+			{
+				int32 iError = 0;
+				for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+				{
+					const int32 iDelta = (int32)i_pPixels[iPixel * 4 + iChannel] - (int32)Palette[iIndex * 4 + iChannel];
+					iError += iDelta * iDelta;
+				}
+
+				if( iError < iBestError )
+				{
+					iBestError = iError;
+					iBestIndex = iIndex;
+				}
+			}
+		}
+
+		iIndices |= iBestIndex << ( 2 * iPixel );
+	}
+
+	WriteColorBlock( o_pBlock, iColor0, iColor1, iIndices );
+}
+
+static void EncodeValueBlock( byte *o_pBlock, const byte *i_pValues )
+{
+	// i_pValues points to a channel of 16 pixels of four bytes each.
+	byte iMin = 255, iMax = 0;
+	for( uint32 iPixel = 0; iPixel < 16; ++iPixel )
+	{
+		const byte iValue = i_pValues[iPixel * 4];
+		if( iValue < iMin ) iMin = iValue;
+		if( iValue > iMax ) iMax = iValue;
+	}
+
+	// value0 > value1 selects 8 interpolated values
+	memset( o_pBlock, 0, 8 );
+	o_pBlock[0] = iMax; o_pBlock[1] = iMin;
+	if( iMin == iMax )
+		return;
+
+	// Decode the palette exactly like the sampler does by giving the first eight pixels the indices 0 to 7.
+	byte Probe[8], Palette[64];
+	memcpy( Probe, o_pBlock, 8 );
+	Probe[2] = 0x88; Probe[3] = 0xc6; Probe[4] = 0xfa;
+	DecodeBlock( Palette, m3dfmt_bc4, Probe );
+
+	for( uint32 iGroup = 0; iGroup < 2; ++iGroup )
+	{
+		uint32 iIndices = 0;
+		for( uint32 iPixel = 0; iPixel < 8; ++iPixel )
+		{
+			const int32 iValue = i_pValues[( iGroup * 8 + iPixel ) * 4];
+
+			uint32 iBestIndex = 0; int32 iBestError = 256;
+			for( uint32 iIndex = 0; iIndex < 8; ++iIndex )
+			{
+				int32 iError = iValue - (int32)Palette[iIndex * 4];
+				if( iError < 0 ) iError = -iError;
+				if( iError < iBestError )
+				{
+					iBestError = iError;
+					iBestIndex = iIndex;
+				}
+			}
+
+			iIndices |= iBestIndex << ( 3 * iPixel );
+		}
+
+		for( uint32 i = 0; i < 3; ++i )
+			o_pBlock[2 + 3 * iGroup + i] = (byte)( iIndices >> ( 8 * i ) );
+	}
+}
+
+void EncodeBlock( byte *o_pBlock, m3dformat i_fmtFormat, const byte *i_pPixels )
+{
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_bc1:
+		EncodeColorBlock( o_pBlock, i_pPixels, true );
+		break;
+
+	case m3dfmt_bc3:
+		EncodeValueBlock( o_pBlock, &i_pPixels[3] );
+		EncodeColorBlock( &o_pBlock[8], i_pPixels, false );
+		break;
+
+	case m3dfmt_bc4:
+		EncodeValueBlock( o_pBlock, i_pPixels );
+		break;
+
+	case m3dfmt_bc5:
+		EncodeValueBlock( o_pBlock, i_pPixels );
+		EncodeValueBlock( &o_pBlock[8], &i_pPixels[1] );
+		break;
+
+	default:
+		break;
+	}
+}
+
+// Surfaces and textures ------------------------------------------------------
+
+m3dformat fmtChooseBlockFormat( CMuli3DSurface *i_pSurface )
+{
+	byte *pPixels = 0;
+	if( i_pSurface->fmtGetFormat() != m3dfmt_r8g8b8a8 || FUNC_FAILED( i_pSurface->LockRect( (void **)&pPixels, 0 ) ) )
+		return m3dfmt_bc1;
+
+	const uint32 iNumPixels = i_pSurface->iGetWidth() * i_pSurface->iGetHeight();
+	m3dformat fmtFormat = m3dfmt_bc1;
+	for( uint32 i = 0; i < iNumPixels; ++i )
+	{
+		if( pPixels[i * 4 + 3] != 255 )
+		{
+			fmtFormat = m3dfmt_bc3;
+			break;
+		}
+	}
+
+	i_pSurface->UnlockRect();
+	return fmtFormat;
+}
+
+bool bCompressSurface( CMuli3DSurface *o_pDest, CMuli3DSurface *i_pSource )
+{
+	const uint32 iWidth = i_pSource->iGetWidth(), iHeight = i_pSource->iGetHeight();
+	if( i_pSource->fmtGetFormat() != m3dfmt_r8g8b8a8 || !bIsBlockFormat( o_pDest->fmtGetFormat() ) ||
+		o_pDest->iGetWidth() != iWidth || o_pDest->iGetHeight() != iHeight )
+		return false;
+
+	byte *pSrcData = 0;
+	if( FUNC_FAILED( i_pSource->LockRect( (void **)&pSrcData, 0 ) ) )
+		return false;
+
+	byte *pDestData = 0;
+	if( FUNC_FAILED( o_pDest->LockRect( (void **)&pDestData, 0 ) ) )
+	{
+		i_pSource->UnlockRect();
+		return false;
+	}
+
+	const m3dformat fmtFormat = o_pDest->fmtGetFormat();
+	const uint32 iBlockBytes = iGetFormatBlockBytes( fmtFormat );
+	for( uint32 iBlockY = 0; iBlockY < iHeight; iBlockY += c_iCompressedBlockSize )
+	{
+		for( uint32 iBlockX = 0; iBlockX < iWidth; iBlockX += c_iCompressedBlockSize, pDestData += iBlockBytes )
+		{
+			// Blocks exceeding the surface repeat its last row and column.
+			byte Pixels[c_iCompressedBlockSize * c_iCompressedBlockSize * 4];
+			for( uint32 iY = 0; iY < c_iCompressedBlockSize; ++iY )
+			{
+				const uint32 iSrcY = ( iBlockY + iY < iHeight ) ? iBlockY + iY : iHeight - 1;
+				for( uint32 iX = 0; iX < c_iCompressedBlockSize; ++iX )
+				{
+					const uint32 iSrcX = ( iBlockX + iX < iWidth ) ? iBlockX + iX : iWidth - 1;
+					memcpy( &Pixels[( iY * c_iCompressedBlockSize + iX ) * 4], &pSrcData[( iSrcY * iWidth + iSrcX ) * 4], 4 );
+				}
+			}
+
+			EncodeBlock( pDestData, fmtFormat, Pixels );
+		}
+	}
+
+	o_pDest->UnlockRect();
+	i_pSource->UnlockRect();
+	return true;
+}
+
+bool bCompressTexture( CMuli3DTexture **o_ppCompressed, CMuli3DTexture *i_pTexture, m3dformat i_fmtFormat )
+{
+	*o_ppCompressed = 0;
+	if( !bIsBlockFormat( i_fmtFormat ) )
+		return false;
+
+	CMuli3DDevice *pDevice = i_pTexture->pGetDevice();
+	const uint32 iMipLevels = i_pTexture->iGetMipLevels();
+	result resCreate = pDevice->CreateTexture( o_ppCompressed, i_pTexture->iGetWidth(), i_pTexture->iGetHeight(), iMipLevels, i_fmtFormat );
+	SAFE_RELEASE( pDevice );
+	if( FUNC_FAILED( resCreate ) )
+		return false;
+
+	for( uint32 iLevel = 0; iLevel < iMipLevels; ++iLevel )
+	{
+		CMuli3DSurface *pSource = i_pTexture->pGetMipLevel( iLevel );
+		CMuli3DSurface *pDest = ( *o_ppCompressed )->pGetMipLevel( iLevel );
+		const bool bResult = bCompressSurface( pDest, pSource );
+		SAFE_RELEASE( pDest );
+		SAFE_RELEASE( pSource );
+
+		if( !bResult )
+		{
+			SAFE_RELEASE( *o_ppCompressed );
+			return false;
+		}
+	}
+
+	return true;
+}
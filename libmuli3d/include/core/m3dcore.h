@@ -54,16 +54,21 @@ public:
 result CreateMuli3D( class CMuli3D **o_ppMuli3D );
 
 // Include all core-headers ---------------------------------------------------
+#include "m3dcore_blockformat.h"
+#include "m3dcore_commandlist.h"
 #include "m3dcore_cubetexture.h"
 #include "m3dcore_device.h"
 #include "m3dcore_indexbuffer.h"
+#include "m3dcore_pixelformat.h"
 #include "m3dcore_rendertarget.h"
 #include "m3dcore_shaders.h"
 #include "m3dcore_surface.h"
 #include "m3dcore_texture.h"
 #include "m3dcore_primitiveassembler.h"
 #include "m3dcore_vertexbuffer.h"
+#include "m3dcore_vertexcache.h"
 #include "m3dcore_vertexformat.h"
+#include "m3dcore_virtualtexture.h"
 #include "m3dcore_volume.h"
 #include "m3dcore_volumetexture.h"
 
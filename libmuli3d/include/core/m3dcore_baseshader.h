@@ -27,6 +27,7 @@
 #include "../m3dtypes.h"
 
 /// This is the shader base-class, which implements support for float, vector4 and matrix constants-registers.
+/// Command lists record the constants with each draw-call; while a command list is executed, the getters return the recorded values.
 class IMuli3DBaseShader : public IBase
 {
 public:
@@ -58,12 +59,22 @@ public:
 	const matrix44 &matGetMatrix( uint32 i_iIndex );
 
 protected:
+	IMuli3DBaseShader(); ///< The constructor makes the constants-getters return the constants set by the application.
+
 	friend class CMuli3DDevice;
+	friend class CMuli3DCommandList;
 
 	/// Accessible by CMuli3D - Sets the rendering-device.
 	/// @param[in] i_pDevice the device.
 	void SetDevice( class CMuli3DDevice *i_pDevice );
 
+	/// Accessible by CMuli3DCommandList - Returns the constants set by the application.
+	const m3dshaderconstants &GetConstants();
+
+	/// Accessible by CMuli3DCommandList - Sets the constants returned by the constants-getters; used when executing command lists.
+	/// @param[in] i_pConstants pointer to the constants, or 0 to use the constants set by the application.
+	void SetActiveConstants( const m3dshaderconstants *i_pConstants );
+
 	/// Samples the texture and returns the looked-up color. This simply functions
 	/// simply forwards the sampling-call to the device.
 	/// @param[out] o_vColor receives the color of the pixel to be looked up.
@@ -79,11 +90,24 @@ protected:
 		float32 i_fU, float32 i_fV, float32 i_fW = 0.0f,
 		const vector4 *i_pXGradient = 0, const vector4 *i_pYGradient = 0 );
 
+	/// Samples the texture at four locations, which share the same texture gradients, e.g. the pixels of a 2x2 quad or of a pixel shader batch.
+	/// This is cheaper than four calls to SampleTexture(), because the sampler state is evaluated and the mip-level is determined only once.
+	/// This function simply forwards the sampling-call to the device.
+	/// @param[out] o_pColors receives the colors of the four pixels to be looked up.
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_pCoords the four lookup-vectors.
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate (optional, base for mip-level calculations).
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate (optional, base for mip-level calculations).
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result SampleTextureQuad( vector4 *o_pColors, uint32 i_iSamplerNumber,
+		const vector4 *i_pCoords, const vector4 *i_pXGradient = 0,
+		const vector4 *i_pYGradient = 0 );
+
 private:
-	float32				m_fConstants[c_iNumShaderConstants];	///< Single float-constants.
-	vector4				m_vConstants[c_iNumShaderConstants];	///< vector4-constants.
-	matrix44			m_matConstants[c_iNumShaderConstants];	///< Matrix-constants.
-	class CMuli3DDevice	*m_pDevice; ///< The Muli3D-device currently used for rendering.
+	m3dshaderconstants			m_Constants;		///< Constants set by the application.
+	const m3dshaderconstants	*m_pActiveConstants;	///< Constants returned by the constants-getters; points to m_Constants unless a command list is executed.
+	class CMuli3DDevice			*m_pDevice; ///< The Muli3D-device currently used for rendering.
 };
 
 #endif // __M3DCORE_BASESHADER_H__
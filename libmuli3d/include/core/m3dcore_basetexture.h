@@ -53,6 +53,17 @@ protected:
 		float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient,
 		const uint32 *i_pSamplerStates ) = 0;
 
+	/// Samples the texture at four locations, which share the same texture gradients, e.g. the pixels of a 2x2 quad or of a pixel shader batch. The default implementation calls SampleTexture() for each lookup.
+	/// @param[out] o_pColors receives the colors of the four pixels to be looked up.
+	/// @param[in] i_pCoords the four lookup-vectors.
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	virtual result SampleTextureQuad( vector4 *o_pColors, const vector4 *i_pCoords,
+		const vector4 *i_pXGradient, const vector4 *i_pYGradient,
+		const uint32 *i_pSamplerStates );
+
 public:
 	/// Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
 	class CMuli3DDevice *pGetDevice();
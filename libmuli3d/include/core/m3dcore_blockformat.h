@@ -0,0 +1,55 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+/// @file m3dcore_blockformat.h
+/// Decoding of the block-compressed texture formats m3dfmt_bc1 to m3dfmt_bc5 and the per-thread cache of decoded blocks used for sampling them.
+
+#ifndef __M3DCORE_BLOCKFORMAT_H__
+#define __M3DCORE_BLOCKFORMAT_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+
+/// Decodes a block of c_iCompressedBlockSize x c_iCompressedBlockSize pixels.
+/// @param[out] o_pPixels receives the pixels row by row as unsigned normalized bytes like m3dfmt_r8g8b8a8. Channels which are not part of the format are set to 0, alpha to 255.
+/// @param[in] i_fmtFormat format of the block; one of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5.
+/// @param[in] i_pBlock pointer to the block.
+void DecodeBlock( byte *o_pPixels, m3dformat i_fmtFormat, const byte *i_pBlock );
+
+/// Encodes a block, all of whose pixels have the same color. Used for clearing block-compressed surfaces.
+/// @param[out] o_pBlock receives the block.
+/// @param[in] i_fmtFormat format of the block; one of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5.
+/// @param[in] i_vColor color of the block; channels outside of [0.0f,1.0f] are clamped.
+void EncodeSolidBlock( byte *o_pBlock, m3dformat i_fmtFormat, const vector4 &i_vColor );
+
+/// @internal Returns a new identifier for the contents of a block-compressed surface. Surfaces request a new identifier whenever their contents change, so that blocks decoded before are no longer found in the caches. Identifiers are never 0.
+uint32 iGetBlockCacheID();
+
+/// @internal Returns the decoded pixels of a block. The block is looked up in the calling thread's cache of c_iBlockCacheEntries decoded blocks and decoded if it isn't present.
+/// The four blocks of a 2x2 area of a surface never replace each other in the cache, so that bilinear lookups decode each block only once.
+/// @param[in] i_fmtFormat format of the block; one of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5.
+/// @param[in] i_pBlock pointer to the block.
+/// @param[in] i_iCacheID identifier of the surface's contents returned by iGetBlockCacheID().
+/// @param[in] i_iBlockX horizontal position of the block in the surface, in blocks.
+/// @param[in] i_iBlockY vertical position of the block in the surface, in blocks.
+/// @return pointer to the pixels as described by DecodeBlock(). It stays valid until the calling thread looks up a block, which replaces it.
+const byte *pGetCachedBlock( m3dformat i_fmtFormat, const byte *i_pBlock, uint32 i_iCacheID, uint32 i_iBlockX, uint32 i_iBlockY );
+
+#endif // __M3DCORE_BLOCKFORMAT_H__
@@ -0,0 +1,133 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_commandlist.h
+///
+
+#ifndef __M3DCORE_COMMANDLIST_H__
+#define __M3DCORE_COMMANDLIST_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+#include "m3dcore_device.h"
+
+/// Defines the types of commands recorded by command lists.
+/// @note This enumeration is used internally by command lists.
+enum m3dcommandtype
+{
+	m3dcmd_drawprimitive = 0,		///< CMuli3DDevice::DrawPrimitive().
+	m3dcmd_drawindexedprimitive,	///< CMuli3DDevice::DrawIndexedPrimitive().
+	m3dcmd_drawdynamicprimitive,	///< CMuli3DDevice::DrawDynamicPrimitive().
+	m3dcmd_clearcolorbuffer,		///< CMuli3DRenderTarget::ClearColorBuffer().
+	m3dcmd_cleardepthbuffer			///< CMuli3DRenderTarget::ClearDepthBuffer().
+};
+
+/// This class defines a Muli3D command list. A command list records draw-calls together with the device's states, which are active at the time of recording, and is executed asynchronously by the device's render thread.
+/// Draw-calls issued between CMuli3DDevice::BeginCommandList() and CMuli3DDevice::EndCommandList() are recorded instead of being executed; render target clears can be recorded with ClearColorBuffer() and ClearDepthBuffer().
+/// Recorded states include shaders, shader constants, vertex format, streams, index buffer, textures, sampler states, render target, scissor rect and clipping planes; referenced objects are kept alive until the command list is recorded again or released.
+/// The contents of referenced objects, e.g. vertex buffers, textures or the members of shader-classes, are read at execution time - don't modify them while the command list is executing.
+class CMuli3DCommandList : public IBase
+{
+protected:
+	~CMuli3DCommandList(); ///< Accessible by IBase. The destructor is called when the reference count reaches zero.
+
+	friend class CMuli3DDevice;
+	/// Accessible by CMuli3DDevice which is the only class that may create a command list.
+	/// @param[in] i_pParent a pointer to the parent CMuli3DDevice-object.
+	CMuli3DCommandList( class CMuli3DDevice *i_pParent );
+
+public:
+	class CMuli3DDevice *pGetDevice(); ///< Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
+
+	/// Records clearing the colorbuffer of a rendertarget; see CMuli3DRenderTarget::ClearColorBuffer().
+	/// @param[in] i_pRenderTarget rendertarget whose colorbuffer is cleared.
+	/// @param[in] i_vColor color to clear the colorbuffer to.
+	/// @param[in] i_pRect rectangle to restrict clearing to.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the command list is not being recorded.
+	result ClearColorBuffer( class CMuli3DRenderTarget *i_pRenderTarget, const vector4 &i_vColor, const m3drect *i_pRect );
+
+	/// Records clearing the depthbuffer of a rendertarget; see CMuli3DRenderTarget::ClearDepthBuffer().
+	/// @param[in] i_pRenderTarget rendertarget whose depthbuffer is cleared.
+	/// @param[in] i_fDepth depth to clear the depthbuffer to.
+	/// @param[in] i_pRect rectangle to restrict clearing to.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the command list is not being recorded.
+	result ClearDepthBuffer( class CMuli3DRenderTarget *i_pRenderTarget, float32 i_fDepth, const m3drect *i_pRect );
+
+	uint32 iGetNumCommands(); ///< Returns the number of recorded commands.
+
+	bool bIsExecuting(); ///< Returns true while the command list is waiting for or being executed by the render thread.
+
+private:
+	/// Releases all recorded commands and the objects referenced by them.
+	void ReleaseCommands();
+
+	/// Appends a draw-call, which uses the device's active states.
+	/// @param[in] i_Type type of the command; one of the draw-call types.
+	/// @param[in] i_pParameters parameters of the draw-call in the order of the device's draw-function.
+	/// @param[in] i_iNumParameters number of parameters.
+	void RecordDrawCall( m3dcommandtype i_Type, const uint32 *i_pParameters, uint32 i_iNumParameters );
+
+	/// Appends a render target clear.
+	/// @param[in] i_Type type of the command; either m3dcmd_clearcolorbuffer or m3dcmd_cleardepthbuffer.
+	/// @param[in] i_pRenderTarget rendertarget to be cleared.
+	/// @param[in] i_vValue clear color or, in the x-component, clear depth.
+	/// @param[in] i_pRect rectangle to restrict clearing to.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the command list is not being recorded.
+	result RecordClear( m3dcommandtype i_Type, class CMuli3DRenderTarget *i_pRenderTarget, const vector4 &i_vValue, const m3drect *i_pRect );
+
+	/// Returns the index of the recorded constants of a shader matching its current constants; records them if necessary.
+	/// @param[in] i_pShader the shader, may be 0.
+	/// @param[in] i_iSlot 0 for the vertex shader, 1 for the triangle shader, 2 for the pixel shader.
+	/// @return index into m_Constants, or c_iNoConstants if i_pShader is 0.
+	uint32 iRecordConstants( class IMuli3DBaseShader *i_pShader, uint32 i_iSlot );
+
+	/// Executes the recorded commands using the given device; called by the render thread.
+	/// @param[in] i_pDevice the device used for execution.
+	void Execute( class CMuli3DDevice *i_pDevice );
+
+private:
+	/// @internal Describes a recorded command.
+	/// @note This structure is used internally by command lists.
+	struct command
+	{
+		m3dcommandtype Type;		///< Type of the command.
+		uint32 iState;					///< Index of the device states in m_States; draw-calls only.
+		uint32 iConstants[3];			///< Indices of the vertex, triangle and pixel shader constants in m_Constants; draw-calls only.
+		uint32 iParameters[6];			///< Parameters of the draw-call in the order of the device's draw-function.
+		class CMuli3DRenderTarget *pRenderTarget;	///< Rendertarget to be cleared; clears only.
+		vector4 vClearValue;			///< Clear color or, in the x-component, clear depth; clears only.
+		m3drect ClearRect;				///< Rectangle to restrict clearing to; clears only.
+		bool bClearRect;				///< True if clearing is restricted to ClearRect; clears only.
+	};
+
+	class CMuli3DDevice						*m_pParent;		///< Pointer to parent.
+	std::vector<command>					m_Commands;		///< Recorded commands in execution order.
+	std::vector<CMuli3DDevice::devicestate>	m_States;		///< Recorded device states; consecutive draw-calls using the same states share an entry.
+	std::vector<m3dshaderconstants>			m_Constants;	///< Recorded shader constants; consecutive draw-calls using the same constants share an entry.
+	uint32									m_iLastConstants[3];	///< Index of the last recorded constants of the vertex, triangle and pixel shader.
+	uint32									m_iExecution;	///< Sequence number of the last submission to the render thread; 0 if never submitted.
+};
+
+#endif // __M3DCORE_COMMANDLIST_H__
@@ -42,13 +42,14 @@ protected:
 	/// Accessible by CMuli3DDevice which is the only class that may create a cube texture.
 	/// @param[in] i_iEdgeLength edge length of the cube texture to be created in pixels.
 	/// @param[in] i_iMipLevels number of mip-levels to be created. Specify 0 to create a full mip-chain.
-	/// @param[in] i_fmtFormat format of the texture to be created. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	/// @param[in] i_fmtFormat format of the texture to be created. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5 or one of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5.
+	/// @param[in] i_Layout memory layout of the mip-levels to be created. Member of the enumeration m3dtexturelayout.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	/// @return e_invalidformat if an invalid format was encountered.
 	result Create( uint32 i_iEdgeLength, uint32 i_iMipLevels,
-		m3dformat i_fmtFormat );
+		m3dformat i_fmtFormat, m3dtexturelayout i_Layout );
 
 	m3dtexsampleinput eGetTexSampleInput(); ///< Sampling this texture requires a 3-dimensional floating point vector.
 
@@ -68,9 +69,11 @@ protected:
 
 public:
 	/// Generates mip-sublevels through downsampling (using a box-filter) a given source mip-level.
+	/// If m3ddeviceparameters::iMipThreads is larger than 1, the six cube faces are processed in parallel.
 	/// @param[in] i_iSrcLevel the mip-level which will be taken as the starting point.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidformat if the texture is block-compressed; generate the mip-levels of an uncompressed texture and compress them instead.
 	result GenerateMipSubLevels( uint32 i_iSrcLevel );
 
 	/// Returns a pointer to the contents of a given mip-level.
@@ -92,8 +95,8 @@ public:
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	result UnlockRect( m3dcubefaces i_Face, uint32 i_iMipLevel );
 
-	m3dformat fmtGetFormat();	///< Returns the format of the texture. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
-	uint32 iGetFormatFloats();  ///< Returns the number of floats of the format, e [1,4].
+	m3dformat fmtGetFormat();	///< Returns the format of the texture. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5 or one of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5.
+	uint32 iGetFormatFloats();  ///< Returns the number of floats of the format, e [1,4], or 0 for the compact 8- and 16-bit formats and the block-compressed formats.
 	uint32 iGetMipLevels();		///< Returns the number of mip-levels this texture consists of.
 	
 	/// Returns the edge length of the given mip-level in pixels.
@@ -105,6 +108,21 @@ public:
 	/// @param[in] i_Face member of the enumeration m3dcubefaces.
 	class CMuli3DTexture *pGetCubeFace( m3dcubefaces i_Face );
 
+private:
+	/// Thread pool job: generates the mip-sublevels of a cube face.
+	/// @param[in] i_pGeneration pointer to a mipfacejob.
+	/// @param[in] i_iJob index of the cube face.
+	/// @param[in] i_iThread index of the executing thread (unused).
+	static void GenerateFaceMipsJob( void *i_pGeneration, uint32 i_iJob, uint32 i_iThread );
+
+	/// @internal Describes the generation of the mip-sublevels of all cube faces.
+	struct mipfacejob
+	{
+		CMuli3DCubeTexture	*pTexture;		///< The cube texture.
+		uint32				iSrcLevel;		///< The mip-level which is taken as the starting point.
+		result				resFaces[6];	///< Receives the results of the cube faces.
+	};
+
 private:
 	class CMuli3DTexture	*m_ppCubeFaces[6]; ///< Pointer to the 6 cube faces.
 };
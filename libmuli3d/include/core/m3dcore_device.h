@@ -27,6 +27,7 @@
 #include "../m3dtypes.h"
 
 /// The Muli3D device.
+/// Devices don't share any state, so several devices may be used from different threads at the same time. Calls to a single device have to be serialized.
 class CMuli3DDevice : public IBase
 {
 protected:
@@ -53,7 +54,8 @@ public:
 
 	// Drawing ----------------------------------------------------------------
 	
-	/// Presents the contents of a given rendertarget's colorbuffer.
+	/// Presents the contents of a given rendertarget's colorbuffer. Waits for submitted command lists and asynchronous presents to finish.
+	/// The colorbuffer must have the format m3dfmt_r32g32b32f, m3dfmt_r32g32b32a32f, m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5; the fixed-point formats are copied to the display without float conversion.
 	/// @param[in] i_pRenderTarget the rendertarget to be presented.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
@@ -62,6 +64,29 @@ public:
 	/// @return e_unknown if a present-target related problem was encountered.
 	result Present( class CMuli3DRenderTarget *i_pRenderTarget );
 
+	/// Presents the contents of a given rendertarget's colorbuffer asynchronously: The colorbuffer is converted and displayed by the render thread, while the application continues rendering the next frame, e.g. to a rendertarget with a second colorbuffer.
+	/// The colorbuffer remains locked until the present has completed - call WaitForFence() before accessing it again. Presents are executed in submission order after previously submitted command lists.
+	/// @param[in] i_pRenderTarget the rendertarget to be presented.
+	/// @param[out] o_pFence receives a fence, which is signaled when the present has completed (optional).
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidformat if an invalid format was encountered.
+	/// @return e_invalidstate if an invalid state was encountered.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_unknown if the colorbuffer couldn't be accessed or the render thread could not be created.
+	result PresentAsync( class CMuli3DRenderTarget *i_pRenderTarget, uint32 *o_pFence = 0 );
+
+	/// Copies the oldest presented frame from the frame queue and removes it from the queue; waits for pending asynchronous presents.
+	/// Only available if the device has been created with the m3dptt_framequeue present-target.
+	/// @param[out] o_pPixels receives the frame as 8-bit RGB-triplets, top row first; iBackbufferWidth * iBackbufferHeight * 3 bytes.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the device doesn't present to a frame queue or if the queue is empty.
+	result ReadPresentedFrame( byte *o_pPixels );
+
+	/// Returns the number of frames in the frame queue of a m3dptt_framequeue present-target; waits for pending asynchronous presents.
+	uint32 iGetNumPresentedFrames();
+
 	/// Renders nonindexed primitives of the specified type from the currently set vertex streams.
 	/// @param[in] i_PrimitiveType member of the enumeration m3dprimitivetype, specifies the primitives' type.
 	/// @param[in] i_iStartVertex Beginning at this vertex the correct number used for rendering this batch will be read from the vertex streams.
@@ -94,6 +119,44 @@ public:
 	/// @return e_invalidstate if an invalid state was encountered.
 	result DrawDynamicPrimitive( uint32 i_iStartVertex, uint32 i_iNumVertices );
 
+	// Command lists ----------------------------------------------------------
+
+	/// Begins recording a command list: Until EndCommandList() is called, draw-calls are appended to the command list together with the active states instead of being executed; they return s_ok and errors are only detected at execution time.
+	/// The command list's previous contents are released; if it is still executing, the function waits for it to finish.
+	/// @param[in] i_pCommandList the command list to be recorded.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if a command list is already being recorded.
+	result BeginCommandList( class CMuli3DCommandList *i_pCommandList );
+
+	/// Ends recording of the command list passed to BeginCommandList().
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidstate if no command list is being recorded.
+	result EndCommandList();
+
+	/// Submits a command list for asynchronous execution by the render thread and returns immediately. Command lists are executed in submission order and may be submitted multiple times.
+	/// Draw-calls, which are executed immediately, and Present() wait for submitted command lists to finish. Draw-call statistics like iGetRenderedPixels() are not updated by command lists.
+	/// @param[in] i_pCommandList the command list to be executed.
+	/// @param[out] o_pFence receives a fence, which is signaled when the command list has been executed (optional).
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the command list is being recorded.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_unknown if the render thread could not be created.
+	result ExecuteCommandList( class CMuli3DCommandList *i_pCommandList, uint32 *o_pFence = 0 );
+
+	void WaitForCommandLists(); ///< Blocks until all submitted command lists have been executed.
+
+	// Fences -----------------------------------------------------------------
+
+	/// Returns true if the work, which has been submitted to the render thread by the call returning the fence, has completed.
+	/// @param[in] i_iFence fence returned by PresentAsync() or ExecuteCommandList().
+	bool bIsFenceComplete( uint32 i_iFence );
+
+	/// Blocks until the work, which has been submitted to the render thread by the call returning the fence, has completed.
+	/// @param[in] i_iFence fence returned by PresentAsync() or ExecuteCommandList().
+	void WaitForFence( uint32 i_iFence );
+
 	// Resource creation ------------------------------------------------------
 
 	/// Creates a vertex format from a vertex declaration. A vertex format describes the layout of vertex data in the vertex streams.
@@ -117,6 +180,19 @@ public:
 	result CreateIndexBuffer( class CMuli3DIndexBuffer **o_ppIndexBuffer,
 		uint32 i_iLength, m3dformat i_fmtFormat );
 
+	/// Creates a read-only index buffer whose indices are stored in the given memory instead of being allocated, e.g. a memory-mapped mesh file. No data is copied.
+	/// @param[out] o_ppIndexBuffer receives a pointer to the created index buffer.
+	/// @param[in] i_iLength length of the index buffer in bytes.
+	/// @param[in] i_fmtFormat format of the indices. Member of the enumeration m3dformat; either m3dfmt_index16 or m3dfmt_index32.
+	/// @param[in] i_pData memory holding the indices. It has to stay valid for the lifetime of the index buffer.
+	/// @param[in] i_pDataOwner object owning the memory i_pData points to, or 0. The index buffer keeps a reference to it, so the memory may be freed by the owner's destructor.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_invalidformat if an invalid format was encountered.
+	result CreateIndexBufferFromMemory( class CMuli3DIndexBuffer **o_ppIndexBuffer,
+		uint32 i_iLength, m3dformat i_fmtFormat, const void *i_pData, IBase *i_pDataOwner );
+
 	/// Creates a vertex buffer for vertex storage.
 	/// @param[out] o_ppVertexBuffer receives a pointer to the created vertex buffer.
 	/// @param[in] i_iLength length of the vertex buffer to be created in bytes.
@@ -126,39 +202,73 @@ public:
 	result CreateVertexBuffer( class CMuli3DVertexBuffer **o_ppVertexBuffer,
 		uint32 i_iLength );
 
+	/// Creates a read-only vertex buffer whose vertices are stored in the given memory instead of being allocated, e.g. a memory-mapped mesh file. No data is copied.
+	/// @param[out] o_ppVertexBuffer receives a pointer to the created vertex buffer.
+	/// @param[in] i_iLength length of the vertex buffer in bytes.
+	/// @param[in] i_pData memory holding the vertices. It has to stay valid for the lifetime of the vertex buffer.
+	/// @param[in] i_pDataOwner object owning the memory i_pData points to, or 0. The vertex buffer keeps a reference to it, so the memory may be freed by the owner's destructor.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result CreateVertexBufferFromMemory( class CMuli3DVertexBuffer **o_ppVertexBuffer,
+		uint32 i_iLength, const void *i_pData, IBase *i_pDataOwner );
+
 	/// Creates a surface.
 	/// @param[out] o_ppSurface receives a pointer to the created surface.
 	/// @param[in] i_iWidth width of the surface in pixels.
 	/// @param[in] i_iHeight height of the surface in pixels.
 	/// @param[in] i_fmtFormat format of the new surface. Member of the enumeration m3dformat; either m3dfmt_index16 or m3dfmt_index32.
+	/// @param[in] i_Layout memory layout of the new surface. Member of the enumeration m3dtexturelayout; defaults to m3dtl_linear.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	result CreateSurface( class CMuli3DSurface **o_ppSurface, uint32 i_iWidth,
-		uint32 i_iHeight, m3dformat i_fmtFormat );
+		uint32 i_iHeight, m3dformat i_fmtFormat, m3dtexturelayout i_Layout = m3dtl_linear );
 
 	/// Creates a standard 2d texture, which may either be used for texture data storage or as a target for rendering-operations (as frame- or depthbuffer).
+	/// Textures of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5 can only be locked and sampled; they need a quarter to an eighth of the memory of m3dfmt_r8g8b8a8.
 	/// @param[out] o_ppTexture receives a pointer to the created texture.
 	/// @param[in] i_iWidth width of the texture in pixels.
 	/// @param[in] i_iHeight height of the texture in pixels.
 	/// @param[in] i_iMipLevels number of miplevels of the new texture; specify 0 to create a full mip-chain.
 	/// @param[in] i_fmtFormat format of the new texture. Member of the enumeration m3dformat; either m3dfmt_index16 or m3dfmt_index32.
+	/// @param[in] i_Layout memory layout of the mip-levels of the new texture. Member of the enumeration m3dtexturelayout; defaults to m3dtl_linear. m3dtl_tiled speeds up filtered lookups of minified or rotated textures, but makes locking and rendering to the texture slower.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	result CreateTexture( class CMuli3DTexture **o_ppTexture, uint32 i_iWidth,
-		uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat );
+		uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout = m3dtl_linear );
+
+	/// Creates a standard 2d texture whose mip-levels are stored in the given memory instead of being allocated, e.g. a memory-mapped cache of a preprocessed texture. No data is copied.
+	/// @param[out] o_ppTexture receives a pointer to the created texture.
+	/// @param[in] i_iWidth width of the texture in pixels.
+	/// @param[in] i_iHeight height of the texture in pixels.
+	/// @param[in] i_iMipLevels number of miplevels of the new texture; specify 0 to create a full mip-chain.
+	/// @param[in] i_fmtFormat format of the new texture. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5 or one of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5.
+	/// @param[in] i_Layout memory layout of the mip-levels. Member of the enumeration m3dtexturelayout.
+	/// @param[in] i_pData memory holding the data of all mip-levels one after another, as returned by CMuli3DSurface::ReadData() for each level. It has to stay valid and writable for the lifetime of the texture, as the texture may be locked.
+	/// @param[in] i_iDataSize size of the memory i_pData points to in bytes.
+	/// @param[in] i_pDataOwner object owning the memory i_pData points to, or 0. The texture keeps a reference to it, so the memory may be freed by the owner's destructor.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_invalidformat if an invalid format was encountered.
+	result CreateTextureFromMemory( class CMuli3DTexture **o_ppTexture, uint32 i_iWidth,
+		uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout,
+		void *i_pData, uint32 i_iDataSize, IBase *i_pDataOwner );
 
 	/// Creates a cube texture. A pointer to each of the 6 faces can be obtained and used as a target for renderin-operations like a standard 2d texture.
+	/// Textures of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5 can only be locked and sampled; they need a quarter to an eighth of the memory of m3dfmt_r8g8b8a8.
 	/// @param[out] o_ppCubeTexture receives a pointer to the created texture.
 	/// @param[in] i_iEdgeLength edge length of the texture in pixels.
 	/// @param[in] i_iMipLevels number of miplevels of the new texture; specify 0 to create a full mip-chain.
 	/// @param[in] i_fmtFormat format of the new texture. Member of the enumeration m3dformat; either m3dfmt_index16 or m3dfmt_index32.
+	/// @param[in] i_Layout memory layout of the mip-levels of the new texture. Member of the enumeration m3dtexturelayout; defaults to m3dtl_linear.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	result CreateCubeTexture( class CMuli3DCubeTexture **o_ppCubeTexture,
-		uint32 i_iEdgeLength, uint32 i_iMipLevels, m3dformat i_fmtFormat );
+		uint32 i_iEdgeLength, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout = m3dtl_linear );
 
 	/// Creates a volume.
 	/// @param[out] o_ppVolume receives a pointer to the created volume.
@@ -166,11 +276,12 @@ public:
 	/// @param[in] i_iHeight height of the volume in pixels.
 	/// @param[in] i_iDepth depth of the volume in pixels.
 	/// @param[in] i_fmtFormat format of the new surface. Member of the enumeration m3dformat; either m3dfmt_index16 or m3dfmt_index32.
+	/// @param[in] i_Layout memory layout of the new volume. Member of the enumeration m3dtexturelayout; defaults to m3dtl_linear.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	result CreateVolume( class CMuli3DVolume **o_ppVolume, uint32 i_iWidth,
-		uint32 i_iHeight, uint32 i_iDepth, m3dformat i_fmtFormat );
+		uint32 i_iHeight, uint32 i_iDepth, m3dformat i_fmtFormat, m3dtexturelayout i_Layout = m3dtl_linear );
 
 	/// Creates a volume texture. Volume texture cannot be used as a target for rendering-operations.
 	/// @param[out] o_ppVolumeTexture receives a pointer to the created texture.
@@ -179,12 +290,37 @@ public:
 	/// @param[in] i_iDepth depth of the texture in pixels.
 	/// @param[in] i_iMipLevels number of miplevels of the new texture; specify 0 to create a full mip-chain.
 	/// @param[in] i_fmtFormat format of the new texture. Member of the enumeration m3dformat; either m3dfmt_index16 or m3dfmt_index32.
+	/// @param[in] i_Layout memory layout of the mip-levels of the new texture. Member of the enumeration m3dtexturelayout; defaults to m3dtl_linear. m3dtl_tiled keeps neighbouring pixels of adjacent slices close to each other in memory.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	result CreateVolumeTexture( class CMuli3DVolumeTexture **o_ppVolumeTexture,
 		uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth,
-		uint32 i_iMipLevels, m3dformat i_fmtFormat );
+		uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout = m3dtl_linear );
+
+	/// Creates a virtual texture, whose pages are loaded from a page source when they are sampled. Virtual textures cannot be used as a target for rendering-operations.
+	/// @param[out] o_ppVirtualTexture receives a pointer to the created texture.
+	/// @param[in] i_iWidth width of the texture in pixels.
+	/// @param[in] i_iHeight height of the texture in pixels.
+	/// @param[in] i_iMipLevels number of miplevels of the new texture; specify 0 to create a full mip-chain. The last mip-level has to fit into a single page.
+	/// @param[in] i_fmtFormat format of the new texture. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
+	/// @param[in] i_iResidentPages number of pages of c_iVirtualPageSize x c_iVirtualPageSize pixels kept in memory. Has to exceed the number of mip-levels fitting into a single page, which are always resident.
+	/// @param[in] i_pPageSource page source providing the pages of the texture. The texture keeps a reference to it.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_invalidformat if an invalid format was encountered.
+	/// @return e_unknown if the loader thread could not be created or a page failed to load.
+	result CreateVirtualTexture( class CMuli3DVirtualTexture **o_ppVirtualTexture,
+		uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat,
+		uint32 i_iResidentPages, class IMuli3DPageSource *i_pPageSource );
+
+	/// Creates a command list for recording draw-calls.
+	/// @param[out] o_ppCommandList receives a pointer to the created command list.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result CreateCommandList( class CMuli3DCommandList **o_ppCommandList );
 
 	/// Creates a render target.
 	/// @param[out] o_ppVertexFormat receives a pointer to the created render target.
@@ -314,6 +450,19 @@ public:
 		float32 i_fU, float32 i_fV, float32 i_fW,
 		const vector4 *i_pXGradient, const vector4 *i_pYGradient );
 
+	/// Samples the texture at four locations, which share the same texture gradients, e.g. the pixels of a 2x2 quad or of a pixel shader batch.
+	/// The sampler is validated, the addressing modes are looked up and the mip-level is determined only once for all four lookups.
+	/// @param[out] o_pColors receives the colors of the four pixels to be looked up.
+	/// @param[in] i_iSamplerNumber number of the sampler.
+	/// @param[in] i_pCoords the four lookup-vectors.
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @note For a 2x2 quad of pixels ordered top-left, top-right, bottom-left, bottom-right the gradients can be computed as i_pCoords[1] - i_pCoords[0] and i_pCoords[2] - i_pCoords[0].
+	result SampleTextureQuad( vector4 *o_pColors, uint32 i_iSamplerNumber,
+		const vector4 *i_pCoords, const vector4 *i_pXGradient, const vector4 *i_pYGradient );
+
 	/// Sets the render target.
 	/// @param[in] i_pRenderTarget pointer to the render target.
 	void SetRenderTarget( class CMuli3DRenderTarget *i_pRenderTarget );
@@ -348,12 +497,81 @@ public:
 	result GetClippingPlane( m3dclippingplanes i_eIndex, plane &o_plane );
 
 	uint32 iGetRenderedPixels(); ///< Returns the number of pixels that passed the depth-test during the last Draw*Primitive() call.
+	uint32 iGetVertexCacheHits(); ///< Returns the number of vertex fetches that were served by the post-transform vertex cache during the last Draw*Primitive() call.
+	uint32 iGetVertexCacheMisses(); ///< Returns the number of vertex fetches that missed the post-transform vertex cache during the last Draw*Primitive() call.
 
 private:
+	struct rastercontext;
+	struct devicestate;
+	friend class CMuli3DCommandList;
+
 	void SetDefaultRenderStates();	///< Initializes renderstates to default values.
 	void SetDefaultTextureSamplerStates();	///< Initializes samplerstates to default values.
 	void SetDefaultClippingPlanes(); ///< Initializes the frustum clipping planes.
 
+	/// Copies the active states to a device state structure; used for recording command lists.
+	/// @param[out] o_State receives the states.
+	void CaptureState( devicestate &o_State );
+
+	/// Activates states, which have been captured by CaptureState(); used for executing command lists.
+	/// @param[in] i_State the states.
+	void ApplyState( const devicestate &i_State );
+
+	friend class CMuli3DTexture;
+	friend class CMuli3DCubeTexture;
+	friend class CMuli3DVolumeTexture;
+	/// Accessible by textures. Returns the threads used for generating mip-levels, which are created on first use.
+	/// Only one caller at a time may use the threads; the function returns 0 if m3ddeviceparameters::iMipThreads is smaller than 2, if the threads couldn't be created or if they are in use by another thread.
+	class CMuli3DThreadPool *pAcquireMipThreads();
+
+	/// Accessible by textures. Hands back threads returned by pAcquireMipThreads().
+	/// @param[in] i_pThreads the threads; may be 0.
+	void ReleaseMipThreads( class CMuli3DThreadPool *i_pThreads );
+
+	/// Accessible by textures. Creates a surface like CreateSurface(), which stores its pixels in the given memory.
+	/// @param[out] o_ppSurface receives a pointer to the created surface.
+	/// @param[in] i_iWidth width of the surface in pixels.
+	/// @param[in] i_iHeight height of the surface in pixels.
+	/// @param[in] i_fmtFormat format of the new surface. Member of the enumeration m3dformat.
+	/// @param[in] i_Layout memory layout of the new surface. Member of the enumeration m3dtexturelayout.
+	/// @param[in] i_pData memory of CMuli3DSurface::iGetDataSize() bytes, which isn't freed by the surface, or 0 to allocate it.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result CreateSurfaceInMemory( class CMuli3DSurface **o_ppSurface, uint32 i_iWidth,
+		uint32 i_iHeight, m3dformat i_fmtFormat, m3dtexturelayout i_Layout, byte *i_pData );
+
+	/// Work queue job: executes a command list on the render thread and releases it.
+	/// @param[in] i_pCommandList pointer to the command list.
+	/// @param[in] i_iJob sequence number of the job.
+	/// @param[in] i_iThread index of the executing thread.
+	static void ExecuteCommandListJob( void *i_pCommandList, uint32 i_iJob, uint32 i_iThread );
+
+	/// Creates the render thread if it doesn't exist yet.
+	/// @return s_ok if the function succeeds.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_unknown if the thread could not be created.
+	result CreateRenderThread();
+
+	/// Validates a rendertarget for presentation and locks its colorbuffer.
+	/// @param[in] i_pRenderTarget the rendertarget to be presented.
+	/// @param[out] o_ppColorBuffer receives the locked colorbuffer; the caller has to unlock and release it.
+	/// @param[out] o_ppSource receives a pointer to the colorbuffer's data.
+	/// @param[out] o_fmtSource receives the format of the colorbuffer.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidformat if an invalid format was encountered.
+	/// @return e_invalidstate if an invalid state was encountered.
+	/// @return e_unknown if the colorbuffer couldn't be accessed.
+	result LockPresentSource( class CMuli3DRenderTarget *i_pRenderTarget, class CMuli3DSurface **o_ppColorBuffer,
+		const void **o_ppSource, m3dformat &o_fmtSource );
+
+	/// Work queue job: presents a colorbuffer on the render thread, unlocks and releases it.
+	/// @param[in] i_pPresent pointer to a presentjob-structure, which is deleted by the job.
+	/// @param[in] i_iJob sequence number of the job.
+	/// @param[in] i_iThread index of the executing thread.
+	static void PresentJob( void *i_pPresent, uint32 i_iJob, uint32 i_iThread );
+
 	/// Prepares internal structure with information used for rendering.
 	/// Checks if all necessary objects (vertexbuffer, vertex format, etc.) have been set + if renderstates are valid.
 	/// @return s_ok if the function succeeds.
@@ -378,6 +596,13 @@ private:
 	/// @param[in] i_iVertex index of the vertex.
 	result FetchVertex( m3dvertexcacheentry **io_ppVertex, uint32 i_iVertex );
 
+	/// Loads a run of consecutive vertices from the vertex streams and transforms them using the vertex shader's batch-function. The run is limited by m_iVertexRangeEnd.
+	/// @param[in] i_iVertex index of the first vertex.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if an invalid state was encountered.
+	result TransformVertexBatch( uint32 i_iVertex );
+
 	/// Begins the processing-pipeline that works on a per-triangle base. Either continues to the clipping-stage or takes care of subdivision.
 	/// @param[in] i_pVSOutput0 vertex A.
 	/// @param[in] i_pVSOutput1 vertex B.
@@ -480,72 +705,177 @@ private:
 	void ProjectVertex( m3dvsoutput *io_pVSOutput );
 
 	/// Calculates gradients for shader registers.
+	/// @param[in,out] io_pContext rasterization context receiving the gradients.
 	/// @param[in] i_pVSOutput0 vertex A.
 	/// @param[in] i_pVSOutput1 vertex B.
 	/// @param[in] i_pVSOutput2 vertex C.
-	void CalculateTriangleGradients( const m3dvsoutput *i_pVSOutput0,
+	void CalculateTriangleGradients( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0,
 		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
 
 	/// Sets shader registers from triangle gradients.
+	/// @param[in] i_pContext rasterization context.
 	/// @param[in,out] io_pVSOutput vertex shader output.
 	/// @param[in] i_fX screen space x-coordinate.
 	/// @param[in] i_fY screen space y-coordinate.
-	void SetVSOutputFromGradient( m3dvsoutput *o_pVSOutput, float32 i_fX, float32 i_fY );
+	void SetVSOutputFromGradient( const rastercontext *i_pContext, m3dvsoutput *o_pVSOutput, float32 i_fX, float32 i_fY );
 
 	/// Updates shader registers from triangle gradients performing a step to the next pixel in the current scanline.
+	/// @param[in] i_pContext rasterization context.
 	/// @param[in,out] io_pVSOutput vertex shader output.
-	void StepXVSOutputFromGradient( m3dvsoutput *io_pVSOutput );
+	void StepXVSOutputFromGradient( const rastercontext *i_pContext, m3dvsoutput *io_pVSOutput );
 
-	/// Rasterizes a single triangle: Performs triangle setup and does scanline-conversion.
+	/// Rasterizes a single triangle: Performs triangle setup and does scanline-conversion. Only pixels inside the context's tile rectangle are drawn.
+	/// @param[in,out] io_pContext rasterization context.
 	/// @param[in] i_pVSOutput0 vertex A.
 	/// @param[in] i_pVSOutput1 vertex B.
 	/// @param[in] i_pVSOutput2 vertex C.
-	void RasterizeTriangle( const m3dvsoutput *i_pVSOutput0,
+	void RasterizeTriangle( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0,
 		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
 
+	/// Rasterizes a single triangle using fixed point edge functions: The triangle's bounding box is traversed in blocks of 2x2 pixel quads; blocks that lie completely outside of the triangle are skipped. Only pixels inside the context's tile rectangle are drawn.
+	/// @note Triangle gradients have to be calculated before calling this function.
+	/// @param[in,out] io_pContext rasterization context.
+	/// @param[in] i_pVSOutput0 vertex A.
+	/// @param[in] i_pVSOutput1 vertex B.
+	/// @param[in] i_pVSOutput2 vertex C.
+	void RasterizeTriangle_HalfSpace( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0,
+		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
+
+	/// Interpolates vertex data for a quad of 2x2 pixels and draws the covered pixels.
+	/// @param[in,out] io_pContext rasterization context.
+	/// @param[in] i_iX position of the quad's upper left pixel in rendertarget along x-axis.
+	/// @param[in] i_iY position of the quad's upper left pixel in rendertarget along y-axis.
+	/// @param[in] i_iCoverageMask pixels to be drawn; bit 0 is the upper left, bit 1 the upper right, bit 2 the lower left and bit 3 the lower right pixel.
+	void RasterizeQuad( rastercontext *io_pContext, uint32 i_iX, uint32 i_iY, uint32 i_iCoverageMask );
+
+	/// Determines the blocks of the hierarchical depth buffer overlapped by a triangle and its depth range. If possible the triangle is tested against the blocks; if it passes the depth-test everywhere, per-pixel depth-testing is disabled for the triangle.
+	/// @note Triangle gradients have to be calculated before calling this function.
+	/// @param[in,out] io_pContext rasterization context.
+	/// @param[in] i_pVSOutput0 vertex A.
+	/// @param[in] i_pVSOutput1 vertex B.
+	/// @param[in] i_pVSOutput2 vertex C.
+	/// @return false if the triangle is hidden completely or doesn't overlap the context's tile.
+	bool bHiZTestTriangle( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0,
+		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
+
+	/// Extends the bounds of the hierarchical depth buffer blocks overlapped by the current triangle by the triangle's depth range; called after the triangle has been rasterized.
+	/// @param[in] i_pContext rasterization context.
+	void HiZUpdateTriangle( const rastercontext *i_pContext );
+
+	/// Extends the bounds of a block of the hierarchical depth buffer by a depth range, which might have been written to the block, and flags it for recomputation.
+	/// @param[in] i_iBlock index of the block.
+	/// @param[in] i_fMinZ minimum depth.
+	/// @param[in] i_fMaxZ maximum depth.
+	void HiZExtendBlock( uint32 i_iBlock, float32 i_fMinZ, float32 i_fMaxZ );
+
+	/// Compares a depth range with the bounds of a block of the hierarchical depth buffer using the active depth compare-function.
+	/// @param[in] i_fMinZ minimum depth.
+	/// @param[in] i_fMaxZ maximum depth.
+	/// @param[in] i_pBounds minimum and maximum depth of the block.
+	/// @return -1 if the depth range fails the depth-test everywhere, 1 if it passes everywhere, 0 otherwise.
+	int32 iHiZCompare( float32 i_fMinZ, float32 i_fMaxZ, const float32 *i_pBounds );
+
+	/// Copies a projected triangle to the triangle bins of all screen tiles it overlaps. Used for multithreaded rasterization.
+	/// @param[in] i_pVSOutput0 vertex A.
+	/// @param[in] i_pVSOutput1 vertex B.
+	/// @param[in] i_pVSOutput2 vertex C.
+	void BinTriangle( const m3dvsoutput *i_pVSOutput0,
+		const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 );
+
+	/// Rasterizes all binned triangles using the thread pool and empties the bins.
+	void RasterizeBinnedTriangles();
+
+	/// Thread pool job: rasterizes the triangles of a single screen tile in submission order.
+	/// @param[in] i_pDevice pointer to the device.
+	/// @param[in] i_iTile index of the tile.
+	/// @param[in] i_iThread index of the executing thread.
+	static void RasterizeTileJob( void *i_pDevice, uint32 i_iTile, uint32 i_iThread );
+
 	/// Rasterizes a line.
+	/// @param[in,out] io_pContext rasterization context.
 	/// @param[in] i_pVSOutput0 vertex A.
 	/// @param[in] i_pVSOutput1 vertex B.
-	void RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1 );
+	void RasterizeLine( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1 );
+
+	/// Rasterization-function for scanlines; see RasterizeScanline_ColorOnly().
+	typedef void (CMuli3DDevice::*rasterizescanlinefunc)( rastercontext *, uint32, uint32, uint32, m3dvsoutput * );
+
+	/// Returns the scanline-function for the active pixel shader type, write masks and colorbuffer format.
+	/// @param[in] i_DepthCompare depth compare-function the scanline-function is specialized for.
+	/// @return pointer to an instantiation of RasterizeScanline_ColorOnly() or RasterizeScanline_ColorDepth().
+	rasterizescanlinefunc fpGetRasterizeScanline( m3dcmpfunc i_DepthCompare );
+
+	/// Returns the scanline-function for a given depth compare-function; see fpGetRasterizeScanline().
+	template<m3dcmpfunc DepthCompare>
+	rasterizescanlinefunc fpGetRasterizeScanline_WriteMasks();
+
+	/// Returns the scanline-function for a given depth compare-function and write masks; see fpGetRasterizeScanline().
+	template<m3dcmpfunc DepthCompare, bool bDepthWrite, bool bColorWrite>
+	rasterizescanlinefunc fpGetRasterizeScanline_Output();
 
-	/// Rasterizes a scanline span on screen. Writes the pixel color, which is outputted by the pixel shader, to the colorbuffer; writes the pixel depth, which has been interpolated from the base triangle's vertices to the depth buffer. Does not support pixel-killing.
+	/// Rasterizes a scanline span on screen. Writes the pixel color, which is outputted by the pixel shader, to the colorbuffer; writes the pixel depth, which has been interpolated from the base triangle's vertices to the depth buffer.
+	/// The function is instantiated for every combination of render-states which stay constant during a draw-call, so that pixels can be processed without testing them. fpGetRasterizeScanline() returns the instantiation matching the current states.
+	/// @param DepthCompare depth compare-function.
+	/// @param bDepthWrite true if writing to the depthbuffer has been enabled.
+	/// @param bColorWrite true if writing to the colorbuffer has been enabled.
+	/// @param iColorLayout layout of the colorbuffer-pixels: number of floats per pixel e [1,4] for the 32-bit float formats, 5 for m3dfmt_r8g8b8a8 and 6 for m3dfmt_r5g6b5; 0 if the colorbuffer isn't accessed.
+	/// @param bMightKillPixels true if the pixel shader may kill pixels; otherwise the depthbuffer is updated before the pixel shader is executed.
+	/// @param[in,out] io_pContext rasterization context.
 	/// @param[in] i_iY position in rendertarget along y-axis.
 	/// @param[in] i_iX left position in rendertarget along x-axis.
 	/// @param[in] i_iX2 right position in rendertarget along x-axis.
 	/// @param[in,out] io_pVSOutput interpolated vertex data.
-	void RasterizeScanline_ColorOnly( uint32 i_iY,
+	template<m3dcmpfunc DepthCompare, bool bDepthWrite, bool bColorWrite, uint32 iColorLayout, bool bMightKillPixels>
+	void RasterizeScanline_ColorOnly( rastercontext *io_pContext, uint32 i_iY,
 		uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput );
 
-	/// Rasterizes a scanline span on screen. Writes the pixel color, which is outputted by the pixel shader, to the colorbuffer; writes the pixel depth, which has been interpolated from the base triangle's vertices to the depth buffer.
+	/// Rasterizes a scanline span on screen. Writes the pixel color, which is outputted by the pixel shader, to the colorbuffer; writes the pixel depth, which has been computed by the pixel shader to the depth buffer.
+	/// Template parameters are the same as for RasterizeScanline_ColorOnly().
+	/// @note Early depth-testing is disabled, which may lead to worse performance because regardless of the depth value the pixel shader will always be called for a given pixel.
+	/// @param[in,out] io_pContext rasterization context.
 	/// @param[in] i_iY position in rendertarget along y-axis.
 	/// @param[in] i_iX left position in rendertarget along x-axis.
 	/// @param[in] i_iX2 right position in rendertarget along x-axis.
 	/// @param[in,out] io_pVSOutput interpolated vertex data.
-	void RasterizeScanline_ColorOnly_MightKillPixels( uint32 i_iY,
+	template<m3dcmpfunc DepthCompare, bool bDepthWrite, bool bColorWrite, uint32 iColorLayout>
+	void RasterizeScanline_ColorDepth( rastercontext *io_pContext, uint32 i_iY,
 		uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput );
 
-	/// Rasterizes a scanline span on screen. Writes the pixel color, which is outputted by the pixel shader, to the colorbuffer; writes the pixel depth, which has been computed by the pixel shader to the depth buffer.
-	/// @note Early depth-testing is disabled, which may lead to worse performance because regardless of the depth value the pixel shader will always be called for a given pixel.
+	/// Rasterizes a scanline span on screen using the pixel shader's batch-function. Pixels are collected in the context's pixel batch, which is processed whenever it is full; supports all pixel shader types.
+	/// @param[in,out] io_pContext rasterization context.
 	/// @param[in] i_iY position in rendertarget along y-axis.
 	/// @param[in] i_iX left position in rendertarget along x-axis.
 	/// @param[in] i_iX2 right position in rendertarget along x-axis.
 	/// @param[in,out] io_pVSOutput interpolated vertex data.
-	void RasterizeScanline_ColorDepth( uint32 i_iY,
+	void RasterizeScanline_Batch( rastercontext *io_pContext, uint32 i_iY,
 		uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput );
 
+	/// Adds a pixel to the context's pixel batch, unless it fails the early depth-test. Processes the batch if it is full.
+	/// @param[in,out] io_pContext rasterization context.
+	/// @param[in] i_iX position in rendertarget along x-axis.
+	/// @param[in] i_iY position in rendertarget along y-axis.
+	/// @param[in] i_pVSOutput interpolated vertex data, not yet divided by position w component.
+	void BatchPixel( rastercontext *io_pContext, uint32 i_iX, uint32 i_iY, const m3dvsoutput *i_pVSOutput );
+
+	/// Executes the pixel shader for the pixels in the context's pixel batch and writes the results to the rendertarget. Has to be called before the triangle gradients change.
+	/// @param[in,out] io_pContext rasterization context.
+	void FlushPixelBatch( rastercontext *io_pContext );
+
 	/// Draws a single pixels. Writes the pixel color, which is outputted by the pixel shader, to the colorbuffer; writes the pixel depth, which has been interpolated from the vertices to the depth buffer. Does not support pixel-killing.
+	/// @param[in,out] io_pContext rasterization context.
 	/// @param[in] i_iX position in rendertarget along x-axis.
 	/// @param[in] i_iY position in rendertarget along y-axis.
 	/// @param[in] i_pVSOutput interpolated vertex data, already divided by position w component.
-	void DrawPixel_ColorOnly( uint32 i_iX,
+	void DrawPixel_ColorOnly( rastercontext *io_pContext, uint32 i_iX,
 		uint32 i_iY, const m3dvsoutput *i_pVSOutput );
 
 	/// Rasterizes a scanline span on screen. Writes the pixel color, which is outputted by the pixel shader, to the colorbuffer; writes the pixel depth, which has been computed by the pixel shader to the depth buffer.
 	/// @note Early depth-testing is disabled, which may lead to worse performance because regardless of the depth value the pixel shader will always be called for a given pixel.
+	/// @param[in,out] io_pContext rasterization context.
 	/// @param[in] i_iX position in rendertarget along x-axis.
 	/// @param[in] i_iY position in rendertarget along y-axis.
 	/// @param[in] i_pVSOutput interpolated vertex data, already divided by position w component.
-	void DrawPixel_ColorDepth( uint32 i_iX,
+	void DrawPixel_ColorDepth( rastercontext *io_pContext, uint32 i_iX,
 		uint32 i_iY, const m3dvsoutput *i_pVSOutput );
 
 private:
@@ -584,25 +914,64 @@ private:
 
 	m3drect	m_ScissorRect;	///< The active scissor rect.
 
+	/// @internal States captured by command lists for each draw-call.
+	/// @note This structure is used internally by devices and command lists.
+	struct devicestate
+	{
+		uint32 iRenderStates[m3drs_numrenderstates];	///< The renderstates.
+
+		class CMuli3DVertexFormat		*pVertexFormat;			///< The vertex format.
+		class IMuli3DPrimitiveAssembler	*pPrimitiveAssembler;	///< The primitive assembler.
+		class IMuli3DVertexShader		*pVertexShader;			///< The vertex shader.
+		class IMuli3DTriangleShader		*pTriangleShader;		///< The triangle shader (optional).
+		class IMuli3DPixelShader		*pPixelShader;			///< The pixel shader.
+		class CMuli3DIndexBuffer		*pIndexBuffer;			///< The index buffer.
+
+		vertexstream VertexStreams[c_iMaxVertexStreams];		///< The vertex streams.
+		texturesampler TextureSamplers[c_iMaxTextureSamplers];	///< The texture samplers.
+
+		class CMuli3DRenderTarget		*pRenderTarget;			///< The render target.
+
+		m3drect ScissorRect;				///< The scissor rect.
+		plane ScissorPlanes[4];				///< Scissor planes created from ScissorRect.
+		plane ClippingPlanes[m3dcp_numplanes];	///< Frustum and user clipping planes.
+		bool bClippingPlaneEnabled[m3dcp_numplanes]; ///< Signals if a particular clipping plane is enabled.
+		m3dshaderregtype VSInputs[c_iVertexShaderRegisters]; ///< Types of the vertex shader input-registers derived from the vertex format.
+	};
+
 	struct m3drenderinfo
 	{
 		m3dshaderregtype VSInputs[c_iVertexShaderRegisters]; ///< Holds information about the type of a particular input-register.
 		m3dshaderregtype VSOutputs[c_iPixelShaderRegisters]; ///< Type of vertex shader output-registers.
+		uint32 iNumVSOutputs;		///< Index of the last used vertex shader output-register + 1. Registers below are interpolated as vectors; gradients of unused components are 0.
+		uint32 iVertexBatchSize;	///< Number of vertices passed to the vertex shader's batch-function; 0 if vertices are transformed one by one.
 
-		float32 *pFrameData;		///< Holds a pointer to the colorbuffer data.
-		uint32 iColorFloats;		///< Number of floats in colorbuffer, e.g. 2 for a vector2-texture.
-		uint32 iColorBufferPitch;	///< Colorbuffer width * number of floats; pitch in multiples of sizeof( float32 ).
+		byte *pFrameData;			///< Holds a pointer to the colorbuffer data.
+		uint32 iColorLayout;		///< Layout of the colorbuffer-pixels, see RasterizeScanline_ColorOnly(); 0 if no colorbuffer is available.
+		uint32 iColorPixelBytes;	///< Size of a colorbuffer-pixel in bytes.
+		uint32 iColorBufferPitch;	///< Colorbuffer width * iColorPixelBytes; pitch in bytes.
 		bool bColorWrite;			///< True if writing to the colorbuffer has been enabled + if a colorbuffer is available.
 
-		float32 *pDepthData;		///< Holds a pointer to the depthbuffer data.
-		uint32 iDepthBufferPitch;	///< Depthbuffer width * 1 (depthbuffers may only contain a single float); pitch in multiples of sizeof( float32 ).
+		byte *pDepthData;			///< Holds a pointer to the depthbuffer data.
+		m3dformat DepthFormat;		///< Format of the depthbuffer: m3dfmt_r32f, m3dfmt_d16 or m3dfmt_d24.
+		uint32 iDepthPixelBytes;	///< Size of a depthbuffer-pixel in bytes.
+		uint32 iDepthBufferPitch;	///< Depthbuffer width * iDepthPixelBytes; pitch in bytes.
 		m3dcmpfunc DepthCompare;	///< Depth compare-function. If no depthbuffer is available this is m3dcmp_always.
 		bool bDepthWrite;			///< True if writing to the depthbuffer has been enabled + if a depthbuffer is available.
 
-		void (CMuli3DDevice::*fpRasterizeScanline)( uint32, uint32, uint32,
-			m3dvsoutput * );	///< Rasterization-function for scanlines (triangle-drawing).
+		float32 *pHiZ;				///< Minimum and maximum depth of each block of the depthbuffer's hierarchical depth buffer; 0 if it isn't used by the current draw-call.
+		byte *pHiZDirty;			///< Flags blocks of the hierarchical depth buffer, whose bounds have been extended and have to be recomputed.
+		uint32 iHiZPitch;			///< Number of blocks of the hierarchical depth buffer per row.
+		bool bHiZTest;				///< True if the depth compare-function allows culling and accepting blocks using the hierarchical depth buffer.
+		bool bMightKillPixels;		///< True if the pixel shader is of type m3dpso_colordepth or if its bMightKillPixels() returns true.
 
-		void (CMuli3DDevice::*fpDrawPixel)( uint32, uint32, const m3dvsoutput * );	///< Drawing-function for individual pixels.
+		rasterizescanlinefunc fpRasterizeScanline;			///< Rasterization-function for scanlines (triangle-drawing).
+		rasterizescanlinefunc fpRasterizeScanlineNoDepthTest;	///< Rasterization-function for scanlines of triangles, which have passed the hierarchical depth-test everywhere.
+
+		void (CMuli3DDevice::*fpDrawPixel)( rastercontext *, uint32, uint32, const m3dvsoutput * );	///< Drawing-function for individual pixels.
+
+		uint32 iPixelBatchSize;		///< Number of pixels passed to the pixel shader's batch-function; 0 if pixels are shaded one by one.
+		m3dpixelshaderoutput PixelShaderOutput;	///< Type of the pixel shader.
 
 		uint32 iRenderedPixels;		///< Counts the number of pixels that pass the depth-test.
 
@@ -612,13 +981,67 @@ private:
 		bool bClippingPlaneEnabled[m3dcp_numplanes]; ///< Signals if a particular clipping plane is enabled.
 		plane ScissorPlanes[4];					///< Scissor planes used for clipping created from m_ScissorRect;
 
-	} m_RenderInfo;	///< Contains information that serves as the base for rendering-processes.
+		bool bBinTriangles;		///< True if triangles are binned into screen tiles and rasterized by multiple threads.
 
-	m3dtriangleinfo m_TriangleInfo; ///< Contains gradient information that serves as the base for scanline-conversion.
+	} m_RenderInfo;	///< Contains information that serves as the base for rendering-processes.
 
-	uint32 m_iNumValidCacheEntries;	///< Number of valid vertex cache entries - reset before each draw-call.
-	uint32 m_iFetchedVertices;		///< Amount of fetched vertices - reset before each draw-call.
-	m3dvertexcacheentry m_VertexCache[c_iVertexCacheSize];	///< Vertex cache contents.
+	/// @internal Per-thread rasterization state.
+	/// @note This structure is used internally by devices.
+	struct rastercontext
+	{
+		m3dtriangleinfo TriangleInfo;	///< Contains gradient information that serves as the base for scanline-conversion.
+		int32 iTileLeft, iTileTop;		///< Upper left corner of the screen tile rasterization is restricted to.
+		int32 iTileRight, iTileBottom;	///< Lower right corner (exclusive) of the screen tile rasterization is restricted to.
+		uint32 iRenderedPixels;			///< Counts the number of pixels that pass the depth-test.
+
+		m3dcmpfunc DepthCompare;		///< Depth compare-function used for m3dpso_coloronly-pixels drawn one by one or batched; m3dcmp_always in areas which have passed the hierarchical depth-test.
+		int32 iHiZLeft, iHiZTop;		///< First block of the hierarchical depth buffer overlapped by the current triangle.
+		int32 iHiZRight, iHiZBottom;	///< Last block (inclusive) of the hierarchical depth buffer overlapped by the current triangle.
+		float32 fHiZMinZ, fHiZMaxZ;		///< Depth range of the current triangle.
+
+		m3dpixelbatch PixelBatch;		///< Pixels waiting for the pixel shader's batch-function.
+		uint32 iBatchedPixels;			///< Number of pixels in the batch.
+		float32 fBatchedDepth[c_iMaxShaderBatchSize];	///< Interpolated depth of the batched pixels.
+	};
+
+	std::vector<rastercontext> m_RasterContexts;	///< Rasterization contexts, one per rasterizer thread; the first one is used for single-threaded rendering.
+
+	class CMuli3DThreadPool *m_pThreadPool;		///< Threads used for tile-binned rasterization; created on demand.
+	uint32 m_iNumTilesX, m_iNumTilesY;			///< Number of screen tiles along the x- and y-axis.
+	std::vector< std::vector<uint32> > m_TileBins;	///< Indices of the binned triangles overlapping each screen tile in submission order.
+	std::vector<m3dvsoutput> m_BinnedVertices;	///< Projected vertices of binned triangles, three per triangle.
+	uint32 m_iNumBinnedTriangles;				///< Number of binned triangles waiting for rasterization.
+
+	class CMuli3DThreadPool *m_pMipThreads;		///< Threads used for generating mip-levels; created on demand.
+	volatile int32 m_iMipThreadsUsers;			///< Number of callers trying to use m_pMipThreads; only the one incrementing it to 1 may use the threads.
+
+	class CMuli3DCommandList *m_pRecordingCommandList;	///< Command list receiving draw-calls between BeginCommandList() and EndCommandList(); 0 if draw-calls are executed immediately.
+	class CMuli3DWorkQueue *m_pRenderThread;	///< Render thread executing command lists and asynchronous presents; created on demand.
+	CMuli3DDevice *m_pExecutionDevice;		///< Device used by the render thread to execute command lists, so that their states don't interfere with the states set by the application; created on demand.
+	uint32 m_iLastCommandList;				///< Sequence number of the last command list submitted to the render thread.
+
+	/// @internal Describes a present submitted to the render thread.
+	/// @note This structure is used internally by devices.
+	struct presentjob
+	{
+		CMuli3DDevice *pDevice;					///< The device.
+		class CMuli3DSurface *pColorBuffer;		///< The locked colorbuffer.
+		const void *pSource;					///< Pointer to the colorbuffer's data.
+		m3dformat fmtSource;					///< Format of the colorbuffer.
+	};
+
+	uint32 m_iFetchedVertices;		///< Amount of fetched vertices; continues counting across draw-calls.
+	uint32 m_iFirstFetchTime;		///< Value of m_iFetchedVertices at the beginning of the current draw-call; cache entries with an older fetch-time are invalid.
+	uint32 m_iVertexCacheSetMask;	///< Number of sets of the vertex cache - 1; masks vertex indices to select a set.
+	uint32 m_iVertexCacheHits;		///< Number of vertices that were found in the vertex cache during the last draw-call.
+	uint32 m_iVertexCacheMisses;	///< Number of vertices that were not found in the vertex cache during the last draw-call.
+	std::vector<m3dvertexcacheentry> m_VertexCache;	///< Vertex cache contents, sets of c_iVertexCacheWays consecutive entries.
+
+	uint32 m_iVertexRangeEnd;		///< Index following the last vertex that may be accessed by the active draw-call; batched vertex transformation never reads beyond.
+	uint32 m_iFirstBatchedVertex;	///< Index of the first vertex in m_BatchedVertices.
+	uint32 m_iNumBatchedVertices;	///< Number of valid entries in m_BatchedVertices - reset before each draw-call.
+	m3dvsoutput m_BatchedVertices[c_iMaxShaderBatchSize];	///< Vertices transformed by the last call to the vertex shader's batch-function.
+	m3dvertexbatch m_VertexBatch;	///< Vertex shader registers in structure-of-arrays layout, passed to the vertex shader's batch-function.
 
 	m3dvsoutput m_ClipVertices[20];	///< Storage for vertices, that are created during clipping.
 	uint32		m_iNextFreeClipVertex;	///< Keeps the next index of m_ClipVertices that can be used for the creation of vertices during clipping.
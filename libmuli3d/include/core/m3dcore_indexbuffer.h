@@ -25,6 +25,7 @@
 
 #include "../m3dbase.h"
 #include "../m3dtypes.h"
+#include "m3dcore_vertexcache.h"
 
 /// Index buffers contain a list of vertex indices either in 16-bit or 32-bit format.
 class CMuli3DIndexBuffer : public IBase
@@ -40,11 +41,13 @@ protected:
 	/// Accessible by CMuli3DDevice which is the only class that may create an index buffer.
 	/// @param[in] i_iLength length of the index buffer to be created in bytes.
 	/// @param[in] i_fmtFormat format of the index buffer to be created. Member of the enumeration m3dformat; either m3dfmt_index16 or m3dfmt_index32.
+	/// @param[in] i_pData memory holding the indices, or 0 to allocate the buffer. The buffer is read-only if it is passed.
+	/// @param[in] i_pDataOwner object owning the memory i_pData points to, or 0. The index buffer keeps a reference to it.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	/// @return e_invalidformat if an invalid format was encountered.
-	result Create( uint32 i_iLength, m3dformat i_fmtFormat );
+	result Create( uint32 i_iLength, m3dformat i_fmtFormat, const void *i_pData = 0, IBase *i_pDataOwner = 0 );
 
 public:
 	class CMuli3DDevice *pGetDevice(); ///< Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
@@ -54,10 +57,46 @@ public:
 	/// @param[out] o_ppData receives the pointer to the vertex buffer.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the buffer is read-only.
 	result GetPointer( uint32 i_iOffset, void **o_ppData );
 
+	/// Returns a pointer to the desired position in the buffer, which may only be used for reading. This function also succeeds for read-only buffers.
+	/// @param[in] i_iOffset has to be specified in bytes.
+	/// @param[out] o_ppData receives the pointer to the index buffer.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result GetReadPointer( uint32 i_iOffset, const void **o_ppData );
+
 	uint32 iGetLength();		///< Returns the length of the buffer in bytes.
 	m3dformat fmtGetFormat();	///< Returns the format of the buffer. Member of the enumeration m3dformat; either m3dfmt_index16 or m3dfmt_index32.
+	bool bIsReadOnly();			///< Returns true if the buffer has been created from externally owned memory, which mustn't be written to.
+
+	/// Simulates the vertex cache of the device while drawing the buffer as an indexed triangle list, see ::AnalyzeVertexCache().
+	/// @param[out] o_Stats receives the statistics of the triangle list.
+	/// @param[in] i_iVertexCacheSize number of entries of the vertex cache, or 0 to use the device's current value of m3drs_vertexcachesize.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the buffer doesn't hold a single triangle.
+	result AnalyzeVertexCache( m3dvertexcachestats &o_Stats, uint32 i_iVertexCacheSize = 0 );
+
+	/// Reorders the triangles of the buffer, which has to hold an indexed triangle list, for the vertex cache of the device, see ::OptimizeVertexCache().
+	/// @param[in] i_iVertexCacheSize number of entries of the vertex cache to optimize for, or 0 to use the device's current value of m3drs_vertexcachesize.
+	/// @param[out] o_pBefore receives the statistics of the triangle list before the optimization, or 0.
+	/// @param[out] o_pAfter receives the statistics of the triangle list after the optimization, or 0.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the buffer is read-only or doesn't hold a single triangle.
+	result OptimizeVertexCache( uint32 i_iVertexCacheSize = 0, m3dvertexcachestats *o_pBefore = 0, m3dvertexcachestats *o_pAfter = 0 );
+
+	/// Renumbers the vertices referenced by the buffer in the order they are first referenced and reorders the vertices of a vertex buffer accordingly, see ::iOptimizeVertexFetch().
+	/// Call OptimizeVertexCache() first. All vertices of the vertex buffer have to be referenced through this index buffer only.
+	/// @param[in,out] io_pVertexBuffer vertex buffer holding the vertices, which are reordered in place.
+	/// @param[in] i_iStride distance between two vertices in the vertex buffer in bytes.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid, e.g. an index exceeds the vertex buffer.
+	/// @return e_invalidstate if one of the buffers is read-only or the index buffer doesn't hold a single triangle.
+	/// @return e_outofmemory if memory allocation failed.
+	result OptimizeVertexFetch( class CMuli3DVertexBuffer *io_pVertexBuffer, uint32 i_iStride );
 
 protected:
 	/// Accessible by CMuli3DDevice: This function returns the index-value at a given index in the buffer, that means an index of 3 returns the third stored vertex-index in the buffer regardless of its format.
@@ -68,10 +107,24 @@ protected:
 	result GetVertexIndex( uint32 i_iArrayIndex, uint32 &o_iValue );
 
 private:
+	/// Copies all indices to o_Indices, converting them to 32-bit.
+	/// @param[out] o_Indices receives the indices.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidstate if the buffer doesn't hold a single triangle.
+	result ReadIndices( std::vector<uint32> &o_Indices );
+
+	/// Stores indices in the buffer, converting them to its format; the buffer mustn't be read-only.
+	void WriteIndices( const std::vector<uint32> &i_Indices );
+
+	/// Returns i_iVertexCacheSize, or the device's current value of m3drs_vertexcachesize if it is 0.
+	uint32 iGetVertexCacheSize( uint32 i_iVertexCacheSize );
+
 	class CMuli3DDevice	*m_pParent;		///< Pointer to parent.
 	uint32				m_iLength;		///< Length of the index buffer in bytes.
 	m3dformat			m_fmtFormat;	///< Format of the index buffer. Member of the enumeration m3dformat; either m3dfmt_index16 or m3dfmt_index32.
-	byte				*m_pData;		///< Pointer to the index buffer data.
+	const byte			*m_pData;		///< Pointer to the index buffer data.
+	bool				m_bOwnsData;	///< False if the indices have been passed to Create(); the buffer is read-only then.
+	IBase				*m_pDataOwner;	///< Object owning the indices if they have been passed to Create(), or 0.
 };
 
 #endif // __M3DCORE_INDEXBUFFER_H__
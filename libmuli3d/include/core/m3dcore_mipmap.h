@@ -0,0 +1,54 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_mipmap.h
+/// Box-filter used by textures and volume-textures to generate their mip-levels.
+
+#ifndef __M3DCORE_MIPMAP_H__
+#define __M3DCORE_MIPMAP_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+
+const uint32 c_iMipRowsPerJob = 16;				///< Number of destination rows filtered by a single thread pool job.
+const uint32 c_iMipMinParallelPixels = 16384;	///< Mip-levels with fewer destination pixels are always filtered by the calling thread.
+
+/// @internal Describes the generation of a mip-level from the next larger mip-level. Both levels are stored in row by row order without padding.
+/// @note This structure is used internally by textures and volume-textures.
+struct m3dmipgeneration
+{
+	m3dformat	fmtFormat;		///< Format of both levels; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
+	const byte	*pSource;		///< Pixels of the larger level.
+	byte		*pDestination;	///< Receives the pixels of the generated level.
+
+	/// Dimensions of the larger level in pixels; 2-dimensional levels have a depth of 1.
+	uint32	iSrcWidth, iSrcHeight, iSrcDepth;
+
+	/// Dimensions of the generated level in pixels. Each one is either half the source's dimension, rounded down, or equals it.
+	uint32	iDestWidth, iDestHeight, iDestDepth;
+};
+
+/// @internal Generates a mip-level by box-filtering the next larger level.
+/// Even dimensions are halved by averaging pairs of pixels; odd dimensions 2n+1 are reduced to n pixels by a 3-tap filter, whose weights are chosen so that every source pixel contributes equally to the generated level.
+/// Rows are filtered with SSE if M3D_SSE is defined; 8-bit formats with even dimensions are averaged exactly in integer arithmetic.
+/// @param[in] i_Generation describes the levels.
+/// @param[in] i_pThreads threads the rows of large levels are split across, or 0 to filter on the calling thread only.
+void GenerateMipLevel( const m3dmipgeneration &i_Generation, class CMuli3DThreadPool *i_pThreads );
+
+#endif // __M3DCORE_MIPMAP_H__
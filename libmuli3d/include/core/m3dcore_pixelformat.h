@@ -0,0 +1,193 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_pixelformat.h
+/// Helper-functions for reading and writing pixels of the texture and depthbuffer formats.
+
+#ifndef __M3DCORE_PIXELFORMAT_H__
+#define __M3DCORE_PIXELFORMAT_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+
+/// Returns true if the format is a texture format.
+/// @param[in] i_fmtFormat member of the enumeration m3dformat.
+inline bool bIsTextureFormat( m3dformat i_fmtFormat )
+{
+	return i_fmtFormat >= m3dfmt_r32f && i_fmtFormat <= m3dfmt_r5g6b5;
+}
+
+/// Returns true if the format is one of the block-compressed texture formats m3dfmt_bc1 to m3dfmt_bc5.
+/// @param[in] i_fmtFormat member of the enumeration m3dformat.
+inline bool bIsBlockFormat( m3dformat i_fmtFormat )
+{
+	return i_fmtFormat >= m3dfmt_bc1 && i_fmtFormat <= m3dfmt_bc5;
+}
+
+/// Returns the size of a block of c_iCompressedBlockSize x c_iCompressedBlockSize pixels of a block-compressed format in bytes, or 0 for other formats.
+/// @param[in] i_fmtFormat member of the enumeration m3dformat.
+inline uint32 iGetFormatBlockBytes( m3dformat i_fmtFormat )
+{
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_bc1: case m3dfmt_bc4: return 8;
+	case m3dfmt_bc3: case m3dfmt_bc5: return 16;
+	default: return 0;
+	}
+}
+
+/// Returns true if the format is a fixed-point depthbuffer format.
+/// @param[in] i_fmtFormat member of the enumeration m3dformat.
+inline bool bIsDepthFormat( m3dformat i_fmtFormat )
+{
+	return i_fmtFormat == m3dfmt_d16 || i_fmtFormat == m3dfmt_d24;
+}
+
+/// Returns true if the format stores its channels as 32-bit floats; only these formats may be locked as arrays of float32.
+/// @param[in] i_fmtFormat member of the enumeration m3dformat.
+inline bool bIsFloat32Format( m3dformat i_fmtFormat )
+{
+	return i_fmtFormat >= m3dfmt_r32f && i_fmtFormat <= m3dfmt_r32g32b32a32f;
+}
+
+/// Returns the number of channels stored per pixel, e [1,4], or 0 for index formats.
+/// @param[in] i_fmtFormat member of the enumeration m3dformat.
+inline uint32 iGetFormatChannels( m3dformat i_fmtFormat )
+{
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_r32f: case m3dfmt_r8: case m3dfmt_d16: case m3dfmt_d24: return 1;
+	case m3dfmt_r32g32f: case m3dfmt_r16g16f: return 2;
+	case m3dfmt_r32g32b32f: case m3dfmt_r5g6b5: return 3;
+	case m3dfmt_r32g32b32a32f: case m3dfmt_r8g8b8a8: case m3dfmt_r16g16b16a16f: return 4;
+	default: return 0;
+	}
+}
+
+/// Returns the size of a pixel in bytes, or 0 for index formats and block-compressed formats.
+/// @param[in] i_fmtFormat member of the enumeration m3dformat.
+inline uint32 iGetFormatPixelBytes( m3dformat i_fmtFormat )
+{
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_bc1: case m3dfmt_bc3: case m3dfmt_bc4: case m3dfmt_bc5: return 0;
+	case m3dfmt_r8: return 1;
+	case m3dfmt_r5g6b5: case m3dfmt_d16: return 2;
+	case m3dfmt_r16g16f: case m3dfmt_r8g8b8a8: case m3dfmt_d24: return 4;
+	case m3dfmt_r16g16b16a16f: return 8;
+	default: return iGetFormatChannels( i_fmtFormat ) * sizeof( float32 );
+	}
+}
+
+/// Converts a color-channel e [0.0f,1.0f] to an unsigned normalized byte.
+/// @param[in] i_fVal value of the channel; values outside of [0.0f,1.0f] are clamped.
+/// @return nearest byte.
+inline byte iFloatToUNorm8( float32 i_fVal )
+{
+	return (byte)( fSaturate( i_fVal ) * 255.0f + 0.5f );
+}
+
+/// Converts a depth-value e [0.0f,1.0f] to the unsigned short stored by m3dfmt_d16.
+/// @param[in] i_fVal depth-value; values outside of [0.0f,1.0f] are clamped.
+/// @return nearest value.
+inline uint16 iFloatToUNorm16( float32 i_fVal )
+{
+	return (uint16)( fSaturate( i_fVal ) * 65535.0f + 0.5f );
+}
+
+/// Converts a depth-value e [0.0f,1.0f] to the 24-bit unsigned integer stored by m3dfmt_d24.
+/// @param[in] i_fVal depth-value; values outside of [0.0f,1.0f] are clamped.
+/// @return nearest value.
+inline uint32 iFloatToUNorm24( float32 i_fVal )
+{
+	return (uint32)( fSaturate( i_fVal ) * 16777215.0f + 0.5f );
+}
+
+/// Packs a color into the unsigned short stored by m3dfmt_r5g6b5.
+/// @param[in] i_vColor color; channels outside of [0.0f,1.0f] are clamped, alpha is ignored.
+/// @return packed color.
+inline uint16 iPackR5G6B5( const vector4 &i_vColor )
+{
+	return (uint16)( ( (uint32)( fSaturate( i_vColor.r ) * 31.0f + 0.5f ) << 11 ) |
+		( (uint32)( fSaturate( i_vColor.g ) * 63.0f + 0.5f ) << 5 ) |
+		(uint32)( fSaturate( i_vColor.b ) * 31.0f + 0.5f ) );
+}
+
+/// Reads a single pixel of a texture or depthbuffer format. Undefined channels are set to 0.0f, an undefined alpha channel to 1.0f; depth is returned in the red channel.
+/// @param[out] o_vColor receives the color of the pixel.
+/// @param[in] i_fmtFormat format of the pixel. Must not be an index format.
+/// @param[in] i_pPixel pointer to the pixel.
+inline void DecodePixel( vector4 &o_vColor, m3dformat i_fmtFormat, const byte *i_pPixel )
+{
+	const float32 fByteScale = 1.0f / 255.0f;
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_r32f: o_vColor = vector4( ((const float32 *)i_pPixel)[0], 0, 0, 1 ); break;
+	case m3dfmt_r32g32f: o_vColor = vector4( ((const float32 *)i_pPixel)[0], ((const float32 *)i_pPixel)[1], 0, 1 ); break;
+	case m3dfmt_r32g32b32f: o_vColor = vector4( ((const float32 *)i_pPixel)[0], ((const float32 *)i_pPixel)[1], ((const float32 *)i_pPixel)[2], 1 ); break;
+	case m3dfmt_r32g32b32a32f: o_vColor = *(const vector4 *)i_pPixel; break;
+	case m3dfmt_r8: o_vColor = vector4( i_pPixel[0] * fByteScale, 0, 0, 1 ); break;
+	case m3dfmt_r8g8b8a8: o_vColor = vector4( i_pPixel[0] * fByteScale, i_pPixel[1] * fByteScale, i_pPixel[2] * fByteScale, i_pPixel[3] * fByteScale ); break;
+	case m3dfmt_r16g16f:
+		o_vColor = vector4( fHalfToFloat( ((const uint16 *)i_pPixel)[0] ), fHalfToFloat( ((const uint16 *)i_pPixel)[1] ), 0, 1 );
+		break;
+	case m3dfmt_r16g16b16a16f:
+		o_vColor = vector4( fHalfToFloat( ((const uint16 *)i_pPixel)[0] ), fHalfToFloat( ((const uint16 *)i_pPixel)[1] ),
+			fHalfToFloat( ((const uint16 *)i_pPixel)[2] ), fHalfToFloat( ((const uint16 *)i_pPixel)[3] ) );
+		break;
+	case m3dfmt_r5g6b5:
+		{
+			const uint32 iPixel = *(const uint16 *)i_pPixel;
+			o_vColor = vector4( ( iPixel >> 11 ) * ( 1.0f / 31.0f ), ( ( iPixel >> 5 ) & 63 ) * ( 1.0f / 63.0f ), ( iPixel & 31 ) * ( 1.0f / 31.0f ), 1 );
+		}
+		break;
+	case m3dfmt_d16: o_vColor = vector4( *(const uint16 *)i_pPixel * ( 1.0f / 65535.0f ), 0, 0, 1 ); break;
+	case m3dfmt_d24: o_vColor = vector4( *(const uint32 *)i_pPixel * ( 1.0f / 16777215.0f ), 0, 0, 1 ); break;
+	default: // cannot happen
+		o_vColor = vector4( 0, 0, 0, 1 );
+		break;
+	}
+}
+
+/// Writes a single pixel of a texture or depthbuffer format. Channels which are not part of the format are ignored; depth is taken from the red channel.
+/// @param[out] o_pPixel pointer to the pixel.
+/// @param[in] i_fmtFormat format of the pixel. Must not be an index format.
+/// @param[in] i_vColor color to be written.
+inline void EncodePixel( byte *o_pPixel, m3dformat i_fmtFormat, const vector4 &i_vColor )
+{
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_r32g32b32a32f: ((float32 *)o_pPixel)[3] = i_vColor.a;
+	case m3dfmt_r32g32b32f: ((float32 *)o_pPixel)[2] = i_vColor.b;
+	case m3dfmt_r32g32f: ((float32 *)o_pPixel)[1] = i_vColor.g;
+	case m3dfmt_r32f: ((float32 *)o_pPixel)[0] = i_vColor.r; break;
+	case m3dfmt_r8g8b8a8:
+		o_pPixel[3] = iFloatToUNorm8( i_vColor.a ); o_pPixel[2] = iFloatToUNorm8( i_vColor.b ); o_pPixel[1] = iFloatToUNorm8( i_vColor.g );
+	case m3dfmt_r8: o_pPixel[0] = iFloatToUNorm8( i_vColor.r ); break;
+	case m3dfmt_r16g16b16a16f: ((uint16 *)o_pPixel)[3] = iFloatToHalf( i_vColor.a ); ((uint16 *)o_pPixel)[2] = iFloatToHalf( i_vColor.b );
+	case m3dfmt_r16g16f: ((uint16 *)o_pPixel)[1] = iFloatToHalf( i_vColor.g ); ((uint16 *)o_pPixel)[0] = iFloatToHalf( i_vColor.r ); break;
+	case m3dfmt_r5g6b5: *(uint16 *)o_pPixel = iPackR5G6B5( i_vColor ); break;
+	case m3dfmt_d16: *(uint16 *)o_pPixel = iFloatToUNorm16( i_vColor.r ); break;
+	case m3dfmt_d24: *(uint32 *)o_pPixel = iFloatToUNorm24( i_vColor.r ); break;
+	default: // cannot happen
+		break;
+	}
+}
+
+#endif // __M3DCORE_PIXELFORMAT_H__
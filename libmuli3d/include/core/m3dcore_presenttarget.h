@@ -25,6 +25,19 @@
 
 #include "../m3dbase.h"
 #include "../m3dtypes.h"
+#include <string>
+
+/// @internal Defines the pixel layouts, to which present-targets convert colorbuffers.
+/// @note This enumeration is used internally by present-targets.
+enum m3dpresentpixelformat
+{
+	m3dppf_packed16 = 0,	///< 16-bit pixels; the channels are scaled to m_i16bitMaxVal and shifted by m_i16bitShift, e.g. 565.
+	m3dppf_bgr24,			///< 24-bit pixels: blue, green, red.
+	m3dppf_bgra32,			///< 32-bit pixels: blue, green, red, alpha.
+	m3dppf_rgb24,			///< 24-bit pixels: red, green, blue.
+
+	m3dppf_numformats		///< Number of pixel layouts.
+};
 
 /// Present-targets provide the base for platform-independet rendering output to the screen.
 class IMuli3DPresentTarget : public IBase
@@ -46,19 +59,159 @@ public:
 
 	/// Presents the contents of a given rendertarget's colorbuffer.
 	/// @param[in] i_pSource pointer to the data of the colorbuffer to be presented (backbuffer dimensions).
-	/// @param[in] i_iFloats format of the data (number of float32s).
+	/// @param[in] i_fmtSource format of the data: m3dfmt_r32g32b32f, m3dfmt_r32g32b32a32f, m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_invalidformat if an invalid format was encountered.
 	/// @return e_invalidstate if an invalid state was encountered.
 	/// @return e_unknown if a present-target related problem was encountered.
-	virtual result Present( const float32 *i_pSource, uint32 i_iFloats ) = 0;
+	virtual result Present( const void *i_pSource, m3dformat i_fmtSource ) = 0;
 
 	/// Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
 	class CMuli3DDevice *pGetDevice();
 
+protected:
+	/// Converts a colorbuffer with backbuffer dimensions to display pixels: Float colors are clamped to [0;1], scaled to the range of the destination format and truncated.
+	/// m3dfmt_r8g8b8a8 and m3dfmt_r5g6b5-colorbuffers are converted without floating point math, through table-lookups, byte-swizzles or plain copies if the layouts match.
+	/// If the device parameters specify a gamma, it is applied through a lookup-table. The rows are split across m3ddeviceparameters::iPresentThreads threads.
+	/// @param[in] i_Format layout of the display pixels.
+	/// @param[out] o_pDestination receives the display pixels.
+	/// @param[in] i_iDestinationPitch distance between two rows of display pixels in bytes.
+	/// @param[in] i_pSource pointer to the colorbuffer's data.
+	/// @param[in] i_fmtSource format of the data: m3dfmt_r32g32b32f, m3dfmt_r32g32b32a32f, m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5.
+	void ConvertPixels( m3dpresentpixelformat i_Format, byte *o_pDestination, uint32 i_iDestinationPitch,
+		const void *i_pSource, m3dformat i_fmtSource );
+
+private:
+	/// Converts a single row of float pixels using the parameters of the active conversion.
+	/// @param[out] o_pDestination receives the display pixels.
+	/// @param[in] i_pSource pointer to the first pixel of the row.
+	/// @param[in] i_iPixels number of pixels.
+	void ConvertRow( byte *o_pDestination, const float32 *i_pSource, uint32 i_iPixels );
+
+	/// Converts a single row of m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5-pixels using the parameters of the active conversion.
+	/// @param[out] o_pDestination receives the display pixels.
+	/// @param[in] i_pSource pointer to the first pixel of the row.
+	/// @param[in] i_iPixels number of pixels.
+	void ConvertRowFixed( byte *o_pDestination, const byte *i_pSource, uint32 i_iPixels );
+
+	/// Fills the gamma lookup-table for a pixel layout.
+	/// @param[in] i_Format layout of the display pixels.
+	/// @param[in] i_fGamma gamma of the display.
+	void BuildGammaLUT( m3dpresentpixelformat i_Format, float32 i_fGamma );
+
+	/// Fills the lookup-table, which maps the channels of fixed-point colorbuffers to display values.
+	/// @param[in] i_Format layout of the display pixels.
+	/// @param[in] i_fGamma gamma of the display; 1.0f if no gamma correction is applied.
+	void BuildFixedLUT( m3dpresentpixelformat i_Format, float32 i_fGamma );
+
+	/// Thread pool job: converts a band of rows.
+	/// @param[in] i_pPresentTarget pointer to the present-target.
+	/// @param[in] i_iJob index of the band.
+	/// @param[in] i_iThread index of the executing thread.
+	static void ConvertRowsJob( void *i_pPresentTarget, uint32 i_iJob, uint32 i_iThread );
+
 protected:
 	class CMuli3DDevice	*m_pParent;	///< Pointer to parent.
+
+	uint16	m_i16bitMaxVal[3];	///< Used when presenting to a 16-bit backbuffer. Masks and maximum color-values per channel, e.g. (31,63,31) for 16-bit 565 mode.
+	uint16	m_i16bitShift[3];	///< Used when presenting to a 16-bit backbuffer. Shifts for the individual color channels, e.g. (11,5,0) for 16-bit 565 mode.
+
+private:
+	class CMuli3DThreadPool	*m_pConversionThreads;	///< Threads used for converting pixels; created on demand.
+
+	std::vector<uint32>		m_GammaLUT;			///< Gamma lookup-table; display values of the red, green and blue channel for c_iGammaLUTSize equally spaced intensities each.
+	m3dpresentpixelformat	m_GammaLUTFormat;	///< Pixel layout the gamma lookup-table has been built for.
+	float32					m_fGammaLUTGamma;	///< Gamma the gamma lookup-table has been built for.
+
+	std::vector<uint32>		m_FixedLUT;			///< Display values of the red, green and blue channel for the 256 intensities of a byte each.
+	m3dpresentpixelformat	m_FixedLUTFormat;	///< Pixel layout the fixed-point lookup-table has been built for.
+	float32					m_fFixedLUTGamma;	///< Gamma the fixed-point lookup-table has been built for.
+
+	// Parameters of the active conversion
+	m3dpresentpixelformat	m_ConvertFormat;		///< Layout of the display pixels.
+	bool					m_bConvertGamma;		///< True if the gamma lookup-table is applied.
+	byte					*m_pConvertDestination;	///< Destination of the first row.
+	uint32					m_iConvertPitch;		///< Distance between two destination rows in bytes.
+	const byte				*m_pConvertSource;		///< Colorbuffer data.
+	m3dformat				m_fmtConvertSource;		///< Format of the colorbuffer.
+	uint32					m_iConvertSourceBytes;	///< Size of a colorbuffer pixel in bytes.
+	uint32					m_iConvertWidth;		///< Number of pixels per row.
+	uint32					m_iConvertHeight;		///< Number of rows.
+};
+
+// Offscreen present-targets --------------------------------------------------
+
+/// This class defines a Muli3D presenttarget, which keeps presented frames in a queue in memory. It neither needs a window nor a display and is available on all platforms.
+class CMuli3DPresentTargetFrameQueue : public IMuli3DPresentTarget
+{
+protected:
+	virtual ~CMuli3DPresentTargetFrameQueue(); ///< Accessible by IBase. The destructor is called when the reference count reaches zero.
+
+	friend class CMuli3DDevice;
+	/// Accessible by CMuli3DDevice which is the only class that may create a present target.
+	/// @param[in] i_pParent a pointer to the parent CMuli3DDevice-object.
+	CMuli3DPresentTargetFrameQueue( class CMuli3DDevice *i_pParent );
+
+public:
+	/// Creates and initializes the presenttarget.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result Create();
+
+	/// Appends the contents of a given rendertarget's colorbuffer to the frame queue; drops the oldest frame if the queue is full.
+	/// @param[in] i_pSource pointer to the data of the colorbuffer to be presented (backbuffer dimensions).
+	/// @param[in] i_fmtSource format of the data: m3dfmt_r32g32b32f, m3dfmt_r32g32b32a32f, m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5.
+	/// @return s_ok if the function succeeds.
+	result Present( const void *i_pSource, m3dformat i_fmtSource );
+
+	/// Copies the oldest frame of the queue and removes it from the queue.
+	/// @param[out] o_pPixels receives the frame as 8-bit RGB-triplets, top row first; iBackbufferWidth * iBackbufferHeight * 3 bytes.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the queue is empty.
+	result ReadFrame( byte *o_pPixels );
+
+	uint32 iGetNumFrames(); ///< Returns the number of frames in the queue.
+
+private:
+	std::vector<byte>	m_Frames;		///< Ring buffer of m_iQueueLength frames.
+	uint32				m_iFrameSize;	///< Size of a single frame in bytes.
+	uint32				m_iQueueLength;	///< Maximum number of frames in the queue.
+	uint32				m_iFirstFrame;	///< Index of the oldest frame in the ring buffer.
+	uint32				m_iNumFrames;	///< Number of frames in the queue.
+};
+
+/// This class defines a Muli3D presenttarget, which writes each presented frame to a binary PPM image file. It neither needs a window nor a display and is available on all platforms.
+class CMuli3DPresentTargetPPMFiles : public IMuli3DPresentTarget
+{
+protected:
+	virtual ~CMuli3DPresentTargetPPMFiles(); ///< Accessible by IBase. The destructor is called when the reference count reaches zero.
+
+	friend class CMuli3DDevice;
+	/// Accessible by CMuli3DDevice which is the only class that may create a present target.
+	/// @param[in] i_pParent a pointer to the parent CMuli3DDevice-object.
+	CMuli3DPresentTargetPPMFiles( class CMuli3DDevice *i_pParent );
+
+public:
+	/// Creates and initializes the presenttarget.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	result Create();
+
+	/// Writes the contents of a given rendertarget's colorbuffer to the next image file of the sequence.
+	/// @param[in] i_pSource pointer to the data of the colorbuffer to be presented (backbuffer dimensions).
+	/// @param[in] i_fmtSource format of the data: m3dfmt_r32g32b32f, m3dfmt_r32g32b32a32f, m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5.
+	/// @return s_ok if the function succeeds.
+	/// @return e_unknown if the file couldn't be written.
+	result Present( const void *i_pSource, m3dformat i_fmtSource );
+
+private:
+	std::string			m_strFileNamePattern;	///< printf-style pattern receiving the frame number.
+	uint32				m_iFrameNumber;			///< Number of the next frame.
+	std::vector<byte>	m_Pixels;				///< Converted pixels of a frame.
 };
 
 // Platform-dependent code ----------------------------------------------------
@@ -89,13 +242,13 @@ public:
 
 	/// Presents the contents of a given rendertarget's colorbuffer.
 	/// @param[in] i_pSource pointer to the data of the colorbuffer to be presented (backbuffer dimensions).
-	/// @param[in] i_iFloats format of the data (number of float32s).
+	/// @param[in] i_fmtSource format of the data: m3dfmt_r32g32b32f, m3dfmt_r32g32b32a32f, m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_invalidformat if an invalid format was encountered.
 	/// @return e_invalidstate if an invalid state was encountered.
 	/// @return e_unknown if a present-target related problem was encountered.
-	result Present( const float32 *i_pSource, uint32 i_iFloats );
+	result Present( const void *i_pSource, m3dformat i_fmtSource );
 
 private:
 	/// Returns low-bit and number of bits for a given color-channel mask.
@@ -109,9 +262,6 @@ private:
 	LPDIRECTDRAWCLIPPER		m_pDirectDrawClipper;		///< Pointer to a DirectDraw clipper.
 	LPDIRECTDRAWSURFACE7	m_pDirectDrawSurfaces[2];	///< Pointer to DirectDraw surfaces.
 	bool					m_bDDSurfaceLost;			///< True if DirectDraw surfaces have been lost and need to be restored.
-
-	uint16	m_i16bitMaxVal[3];	///< Used when presenting to a 16-bit backbuffer. Masks and maximum color-values per channel, e.g. (31,63,31) for 16-bit 565 mode.
-	uint16	m_i16bitShift[3];	///< Used when presenting to a 16-bit backbuffer. Shifts for the individual color channels, e.g. (
 };
 
 #endif
@@ -138,22 +288,19 @@ public:
 
 	/// Presents the contents of a given rendertarget's colorbuffer.
 	/// @param[in] i_pSource pointer to the data of the colorbuffer to be presented (backbuffer dimensions).
-	/// @param[in] i_iFloats format of the data (number of float32s).
+	/// @param[in] i_fmtSource format of the data: m3dfmt_r32g32b32f, m3dfmt_r32g32b32a32f, m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_invalidformat if an invalid format was encountered.
 	/// @return e_invalidstate if an invalid state was encountered.
 	/// @return e_unknown if a present-target related problem was encountered.
-	result Present( const float32 *i_pSource, uint32 i_iFloats );
+	result Present( const void *i_pSource, m3dformat i_fmtSource );
 
 private:
 	Display	*m_pDisplay;	///< The X11 display.
 	GC		m_WindowGC;		///< The graphic context.
 	XImage	*m_pXImage;		///< The X-image used for output to the screen.
 	uint32	m_iPixelBytes;	///< Number of bytes per pixel for output.
-
-	uint16	m_i16bitMaxVal[3];	///< Used when presenting to a 16-bit backbuffer. Masks and maximum color-values per channel, e.g. (31,63,31) for 16-bit 565 mode.
-	uint16	m_i16bitShift[3];	///< Used when presenting to a 16-bit backbuffer. Shifts for the individual color channels, e.g. (
 };
 
 #endif
@@ -180,13 +327,13 @@ public:
 
 	/// Presents the contents of a given rendertarget's colorbuffer.
 	/// @param[in] i_pSource pointer to the data of the colorbuffer to be presented (backbuffer dimensions).
-	/// @param[in] i_iFloats format of the data (number of float32s).
+	/// @param[in] i_fmtSource format of the data: m3dfmt_r32g32b32f, m3dfmt_r32g32b32a32f, m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_invalidformat if an invalid format was encountered.
 	/// @return e_invalidstate if an invalid state was encountered.
 	/// @return e_unknown if a present-target related problem was encountered.
-	result Present( const float32 *i_pSource, uint32 i_iFloats );
+	result Present( const void *i_pSource, m3dformat i_fmtSource );
 
 private:
 	struct BitMap *m_pBitMap; ///< Pointer to the bitmap to be blitted into Window's RastPort
@@ -58,6 +58,7 @@ public:
 
 	/// Associates a CMuli3DSurface as colorbuffer with this rendertarget, releasing the currently set colorbuffer.
 	/// Calling this function will increase the internal reference count of the surface.
+	/// Colorbuffers may have one of the 32-bit float formats or m3dfmt_r8g8b8a8 or m3dfmt_r5g6b5; the latter are written by the rasterizer directly and need a quarter or an eighth of the memory bandwidth.
 	/// @param[in] i_pColorBuffer new colorbuffer.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidformat if an invalid format was encountered.
@@ -65,6 +66,7 @@ public:
 
 	/// Associates a CMuli3DSurface as depthbuffer with this rendertarget, releasing the currently set depthbuffer.
 	/// Calling this function will increase the internal reference count of the surface.
+	/// Depthbuffers may have the format m3dfmt_r32f or one of the fixed-point formats m3dfmt_d16 and m3dfmt_d24. Only m3dfmt_r32f-depthbuffers maintain a hierarchical depth buffer.
 	/// @param[in] i_pDepthBuffer new depthbuffer.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidformat if an invalid format was encountered.
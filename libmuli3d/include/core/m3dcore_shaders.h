@@ -41,6 +41,21 @@ protected:
 	virtual void Execute( const shaderreg *i_pInput, vector4 &o_vPosition,
 		shaderreg *o_pOutput ) = 0;
 
+	/// Accessible by CMuli3DDevice. Returns the number of vertices the shader processes per call to ExecuteBatch(); e [1;c_iMaxShaderBatchSize]. Default: 0, which means that ExecuteBatch() has not been implemented and Execute() is called for each vertex.
+	virtual uint32 iGetBatchSize() { return 0; }
+
+	/// Accessible by CMuli3DDevice.
+	/// Batched version of Execute(): Processes iGetBatchSize() vertices at once, which are stored in structure-of-arrays layout. The device feeds runs of consecutive vertices from the vertex streams; lanes beyond i_iNumVertices contain copies of the first vertex.
+	/// @param[in,out] io_Batch the vertices' input registers; receives positions and output registers.
+	/// @param[in] i_iNumVertices number of valid vertices in the batch.
+	virtual void ExecuteBatch( m3dvertexbatch &io_Batch, uint32 i_iNumVertices ) {}
+
+	/// Transforms a batch register by a matrix, treating each lane like a row vector; equal to vector4 * matrix44.
+	/// @param[out] o_Dest destination register. May be the same as the source register.
+	/// @param[in] i_Src source register.
+	/// @param[in] i_matMatrix transformation matrix.
+	void TransformBatch( m3dshaderregbatch &o_Dest, const m3dshaderregbatch &i_Src, const matrix44 &i_matMatrix ) const;
+
 	/// Returns the type of a particular output register. Member of the enumeration m3dshaderregtype; if a given register is not used, return m3dsrt_unused.
 	/// @param[in] i_iRegister index of register, e [0;c_iPixelShaderRegisters[.
 	virtual m3dshaderregtype GetOutputRegisters( uint32 i_iRegister ) = 0;
@@ -74,6 +89,10 @@ protected:
 	/// @param[in] i_pVSOutputs pointer to the pixel shader input register-types.
 	/// @param[in] i_pTriangleInfo pointer to the triangle info structure.
 	void SetInfo( const m3dshaderregtype *i_pVSOutputs, const struct m3dtriangleinfo *i_pTriangleInfo );
+
+	/// Accessible by CMuli3DDevice - Overrides the triangle info for the calling thread; used by rasterization threads, which work on their own triangle info.
+	/// @param[in] i_pTriangleInfo pointer to the triangle info structure, or 0 to use the one passed to SetInfo().
+	static void SetThreadTriangleInfo( const struct m3dtriangleinfo *i_pTriangleInfo );
 	
 	/// Accessible by CMuli3DDevice.
 	/// This is the core function of a pixel shader: It receives interpolated register data from the vertex shader and can output a new color and depth value for the pixel currently being drawn.
@@ -84,13 +103,40 @@ protected:
 	virtual bool bExecute( const shaderreg *i_pInput, vector4 &io_vColor,
 		float32 &io_fDepth ) = 0;
 
+	/// Accessible by CMuli3DDevice. Returns the number of pixels the shader processes per call to ExecuteBatch(); either 4 or 8. Default: 0, which means that ExecuteBatch() has not been implemented and bExecute() is called for each pixel.
+	virtual uint32 iGetBatchSize() { return 0; }
+
+	/// Accessible by CMuli3DDevice.
+	/// Batched version of bExecute(): Processes up to iGetBatchSize() pixels of the same triangle at once. Input registers, colors and depth values are stored in structure-of-arrays layout, which allows the shader to process one pixel per SIMD-lane.
+	/// @note Batches are only used when writing to the colorbuffer has been enabled; bExecute() is called otherwise.
+	/// @param[in,out] io_Batch the pixels; see bExecute() for a description of the colors and depth values.
+	/// @param[in,out] io_iLaneMask bit i is set if lane i contains a pixel. Clear bits to kill the respective pixels; m3dpso_coloronly-shaders have to return true in bMightKillPixels() to do so.
+	virtual void ExecuteBatch( m3dpixelbatch &io_Batch, uint32 &io_iLaneMask ) {}
+
 	/// This functions computes the partial derivatives of a shader register with respect to the screen space coordinates.
 	/// @param[in] i_iRegister index of the source shader register.
 	/// @param[out] o_vDdx partial derivative with respect to the x-screen space coordinate.
 	/// @param[out] o_vDdy partial derivative with respect to the y-screen space coordinate.
 	void GetDerivatives( uint32 i_iRegister, vector4 &o_vDdx, vector4 &o_vDdy ) const;
 
+	/// This functions computes the partial derivatives of a shader register for a pixel of a batch with respect to the screen space coordinates.
+	/// @param[in] i_Batch the batch passed to ExecuteBatch().
+	/// @param[in] i_iLane index of the pixel in the batch.
+	/// @param[in] i_iRegister index of the source shader register.
+	/// @param[out] o_vDdx partial derivative with respect to the x-screen space coordinate.
+	/// @param[out] o_vDdy partial derivative with respect to the y-screen space coordinate.
+	void GetDerivatives( const m3dpixelbatch &i_Batch, uint32 i_iLane, uint32 i_iRegister, vector4 &o_vDdx, vector4 &o_vDdy ) const;
+
 private:
+	/// Computes the partial derivatives of a shader register at a given pixel of the current triangle.
+	/// @param[in] i_iRegister index of the source shader register.
+	/// @param[in] i_fPixelX x-coordinate of the pixel.
+	/// @param[in] i_fPixelY y-coordinate of the pixel.
+	/// @param[in] i_fInvW 1.0f / w of the pixel.
+	/// @param[out] o_vDdx partial derivative with respect to the x-screen space coordinate.
+	/// @param[out] o_vDdy partial derivative with respect to the y-screen space coordinate.
+	void ComputeDerivatives( uint32 i_iRegister, float32 i_fPixelX, float32 i_fPixelY, float32 i_fInvW, vector4 &o_vDdx, vector4 &o_vDdy ) const;
+
 	const m3dshaderregtype			*m_pVSOutputs; ///< Register type info.
 	const struct m3dtriangleinfo	*m_pTriangleInfo; ///< Gradient info about the triangle that is currently being drawn.
 };
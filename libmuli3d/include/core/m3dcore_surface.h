@@ -40,15 +40,34 @@ protected:
 	/// Accessible by CMuli3DDevice which is the only class that may create a surface.
 	/// @param[in] i_iWidth width of the surface to be created in pixels.
 	/// @param[in] i_iHeight height of the surface to be created in pixels.
-	/// @param[in] i_fmtFormat format of the surface to be created. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	/// @param[in] i_fmtFormat format of the surface to be created. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5, one of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5 or one of the depthbuffer formats m3dfmt_d16 and m3dfmt_d24.
+	/// @param[in] i_Layout memory layout of the surface to be created. Member of the enumeration m3dtexturelayout. Ignored by block-compressed surfaces, whose blocks are always stored row by row.
+	/// @param[in] i_pData memory of iGetDataSize() bytes the surface stores its pixels in, or 0 to allocate it. The surface doesn't free this memory.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	/// @return e_invalidformat if an invalid format was encountered.
-	result Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat );
+	result Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat, m3dtexturelayout i_Layout, byte *i_pData = 0 );
+
+	/// Accessible by CMuli3DDevice. Locks the entire surface like LockRect() and returns the hierarchical depth buffer of the surface, which is created or rebuilt if necessary.
+	/// The hierarchical depth buffer stores the minimum and maximum value of each block of c_iHiZBlockSize x c_iHiZBlockSize pixels. It stays valid while the surface is locked with this function; the caller is responsible for keeping it up to date.
+	/// @param[out] o_ppData receives the pointer to the surface-data.
+	/// @param[out] o_ppHiZ receives the pointer to the block bounds, two floats (minimum, maximum) per block, or 0 if no memory could be allocated or the surface doesn't use the m3dtl_linear layout.
+	/// @param[out] o_ppHiZDirty receives the pointer to one flag per block; set flags to have the bounds of the respective blocks recomputed by UpdateHiZ().
+	/// @param[out] o_iHiZPitch receives the number of blocks per row.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidstate if the surface is already locked or its format is not m3dfmt_r32f.
+	result LockRectHiZ( void **o_ppData, float32 **o_ppHiZ, byte **o_ppHiZDirty, uint32 &o_iHiZPitch );
+
+	/// Accessible by CMuli3DDevice. Recomputes the bounds of all blocks, which have been flagged dirty.
+	void UpdateHiZ();
+
+	/// Accessible by CMuli3DDevice. Marks the hierarchical depth buffer as invalid; it will be rebuilt when it is needed the next time.
+	void InvalidateHiZ();
 
 public:
 	/// Samples the surface using nearest point sampling.
+	/// Block-compressed surfaces are decoded block by block through the calling thread's cache of decoded blocks.
 	/// @param[out] o_vColor receives the color of the pixel to be looked up.
 	/// @param[in] i_fU u-component of the lookup-vector.
 	/// @param[in] i_fV v-component of the lookup-vector.
@@ -64,7 +83,7 @@ public:
 	/// @param[in] i_vColor color to clear the surface to.
 	/// @param[in] i_pRect rectangle to restrict clearing to.
 	/// @return s_ok if the function succeeds.
-	/// @return e_invalidparameters if the clear-rectangle exceeds the surface's dimensions.
+	/// @return e_invalidparameters if the clear-rectangle exceeds the surface's dimensions or if it isn't aligned to the blocks of a block-compressed surface.
 	result Clear( const vector4 &i_vColor, const m3drect *i_pRect );
 
 	/// Copies the contents of the surface to another surface using the specified filtering method.
@@ -75,17 +94,19 @@ public:
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one of the two rectangles is invalid or exceeds surface-dimensions.
 	/// @return e_invalidstate if the destination surface couldn't be locked.
+	/// @return e_invalidformat if the destination surface is block-compressed.
 	result CopyToSurface( const m3drect *i_pSrcRect, CMuli3DSurface *i_pDestSurface,
 		const m3drect *i_pDestRect, m3dtexturefilter i_Filter );
 
 	/// Returns a pointer to the contents of the surface.
 	/// @param[out] o_ppData receives the pointer to the surface-data.
-	/// @param[in] i_pRect area that will be locked and accessible. (Pass in 0 to lock the entire surface.)
+	/// @param[in] i_pRect area that will be locked and accessible. (Pass in 0 to lock the entire surface.) The rectangle of a block-compressed surface has to be aligned to its blocks, except at the right and bottom edge of the surface.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_invalidstate if the surface is already locked.
 	/// @return e_outofmemory if memory allocation failed.
-	/// @note Locking the entire surface is a lot faster than locking a sub-region, because no lock-buffer has to be created and the application may write to the surface directly.
+	/// @note The data is laid out as described by the surface's format: arrays of float32 for the 32-bit float formats, bytes for m3dfmt_r8 and m3dfmt_r8g8b8a8 and half-floats for m3dfmt_r16g16f and m3dfmt_r16g16b16a16f, unsigned shorts for m3dfmt_r5g6b5 and m3dfmt_d16 and unsigned integers for m3dfmt_d24. Block-compressed surfaces expose their blocks of c_iCompressedBlockSize x c_iCompressedBlockSize pixels row by row; partial blocks at the right and bottom edge are stored completely.
+	/// @note Locking the entire surface is a lot faster than locking a sub-region, because no lock-buffer has to be created and the application may write to the surface directly. This doesn't apply to surfaces using the m3dtl_tiled layout: their pixels are always copied to a lock-buffer in row by row order and written back when the surface is unlocked.
 	result LockRect( void **o_ppData, const m3drect *i_pRect );
 
 	/// Unlocks the surface; modifications to its contents will become active.
@@ -93,8 +114,18 @@ public:
 	/// @return e_invalidstate if the surface is not locked.
 	result UnlockRect();
 
-	m3dformat fmtGetFormat();	///< Returns the format of the surface. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
-	uint32 iGetFormatFloats();	///< Returns the number of floats of the format, e [1,4].
+	/// Copies the pixels of the surface as they are stored in memory, i.e. in the surface's layout and including the padding of the m3dtl_tiled layout. Caches of preprocessed textures store this data and pass it to CMuli3DDevice::CreateTextureFromMemory().
+	/// @param[out] o_pData receives iGetDataSize() bytes.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidstate if the surface is locked.
+	result ReadData( void *o_pData );
+
+	uint32 iGetDataSize();	///< Returns the size of the memory the pixels of the surface are stored in, in bytes.
+
+	m3dformat fmtGetFormat();	///< Returns the format of the surface. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5, one of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5 or one of the depthbuffer formats m3dfmt_d16 and m3dfmt_d24.
+	uint32 iGetFormatFloats();	///< Returns the number of floats of the format, e [1,4], or 0 for the compact 8- and 16-bit formats and the block-compressed formats.
+	uint32 iGetPixelBytes();	///< Returns the size of a pixel in bytes, or the size of a block for the block-compressed formats.
+	m3dtexturelayout GetLayout();	///< Returns the memory layout of the surface. Member of the enumeration m3dtexturelayout.
 	
 	uint32 iGetWidth(); ///< Returns the width of the surface in pixels.
 	uint32 iGetHeight(); ///< Returns the height of the surface in pixels.
@@ -102,20 +133,62 @@ public:
 	/// Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
 	class CMuli3DDevice *pGetDevice();
 
+private:
+	/// Returns the index of a pixel in the surface data, taking the layout of the surface into account.
+	/// @param[in] i_iX x-coordinate of the pixel.
+	/// @param[in] i_iY y-coordinate of the pixel.
+	uint32 iGetPixelIndex( uint32 i_iX, uint32 i_iY );
+
+	/// Returns true if a rectangle is aligned to the blocks of a block-compressed surface. Its right and bottom edge may also coincide with the surface's edges.
+	/// @param[in] i_Rect the rectangle.
+	bool bIsBlockAligned( const m3drect &i_Rect );
+
+	/// Reads a pixel of a block-compressed surface through the calling thread's cache of decoded blocks.
+	/// @param[out] o_pPixel receives the four unsigned normalized bytes of the pixel like m3dfmt_r8g8b8a8.
+	/// @param[in] i_iX x-coordinate of the pixel.
+	/// @param[in] i_iY y-coordinate of the pixel.
+	void ReadBlockPixel( byte *o_pPixel, uint32 i_iX, uint32 i_iY );
+
+	/// Copies the pixels of a rectangle of the surface row by row to a buffer.
+	/// Rectangles of block-compressed surfaces have to be aligned to their blocks; their blocks are copied row by row.
+	/// @param[out] o_pDest destination buffer.
+	/// @param[in] i_Rect rectangle to be copied.
+	void ReadRect( byte *o_pDest, const m3drect &i_Rect );
+
+	/// Copies the pixels of a rectangle of the surface row by row from a buffer.
+	/// Rectangles of block-compressed surfaces have to be aligned to their blocks; their blocks are copied row by row.
+	/// @param[in] i_pSrc source buffer.
+	/// @param[in] i_Rect rectangle to be copied.
+	void WriteRect( const byte *i_pSrc, const m3drect &i_Rect );
+
 private:
 	class CMuli3DDevice	*m_pParent;	///< Pointer to parent.
 
-	m3dformat	m_fmtFormat;	///< Format of the surface. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	m3dformat	m_fmtFormat;	///< Format of the surface. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5, one of the block-compressed formats m3dfmt_bc1 to m3dfmt_bc5 or one of the depthbuffer formats m3dfmt_d16 and m3dfmt_d24.
 	uint32		m_iWidth;		///< Width of the surface in pixels.
 	uint32		m_iHeight;		///< Height of the surface in pixels.
 	uint32		m_iWidthMin1;	///< Width - 1 of the surface in pixels.
 	uint32		m_iHeightMin1;	///< Height - 1 of the surface in pixels.
+	uint32		m_iPixelBytes;	///< Size of a pixel in bytes; size of a block for block-compressed surfaces.
+	uint32		m_iBlocksPerRow;	///< Number of blocks per row if the surface is block-compressed, otherwise 0.
+	uint32		m_iBlockCacheID;	///< Identifier of the surface's contents in the caches of decoded blocks, renewed whenever they change; see iGetBlockCacheID().
+
+	m3dtexturelayout	m_Layout;			///< Memory layout of the surface. Member of the enumeration m3dtexturelayout.
+	uint32				m_iTilesPerRow;		///< Number of tiles per row if the surface uses the m3dtl_tiled layout.
 
 	bool	m_bLockedComplete;		///< True if the whole surface has been locked.
 	m3drect	m_PartialLockRect;		///< Information about the locked rectangle.
-	float32	*m_pPartialLockData;	///< Not null if a sub-rectangle of the surface has been locked.
+	byte	*m_pPartialLockData;	///< Not null if a sub-rectangle of the surface has been locked.
+
+	byte	*m_pData;	///< Pointer to surface data.
+	uint32	m_iDataSize;	///< Size of the surface data in bytes.
+	bool	m_bOwnsData;	///< False if the surface data has been passed to Create(), which isn't freed by the surface.
 
-	float32	*m_pData;	///< Pointer to surface data.
+	float32	*m_pHiZ;		///< Minimum and maximum value of each block of the surface; only allocated for depthbuffers.
+	byte	*m_pHiZDirty;	///< One flag per block, set if the block's bounds have to be recomputed.
+	uint32	m_iHiZWidth;	///< Number of blocks per row.
+	uint32	m_iHiZHeight;	///< Number of block rows.
+	bool	m_bHiZValid;	///< True if the hierarchical depth buffer matches the surface's contents.
 };
 
 #endif // __M3DCORE_SURFACE_H__
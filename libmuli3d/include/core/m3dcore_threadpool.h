@@ -0,0 +1,192 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_threadpool.h
+///
+
+#ifndef __M3DCORE_THREADPOOL_H__
+#define __M3DCORE_THREADPOOL_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+#include <deque>
+
+// Platform-dependent definitions and includes --------------------------------
+
+#ifdef WIN32
+
+#define M3D_THREADLOCAL __declspec( thread )	///< Declares a variable with thread-local storage.
+
+#elif defined( __amigaos4__ )
+
+#define M3D_THREADLOCAL		///< No worker threads are created on AmigaOS 4, so thread-local storage is not required.
+
+#else
+
+#include <pthread.h>
+#define M3D_THREADLOCAL __thread	///< Declares a variable with thread-local storage.
+
+#endif
+
+/// Job-function executed by the thread pool.
+/// @param[in] i_pUserData user-defined data passed to CMuli3DThreadPool::Execute().
+/// @param[in] i_iJob index of the job, e [0;i_iNumJobs[.
+/// @param[in] i_iThread index of the thread executing the job, e [0;iGetNumThreads()[. The calling thread always has index 0.
+typedef void (*m3dthreadjob)( void *i_pUserData, uint32 i_iJob, uint32 i_iThread );
+
+/// @internal A simple pool of worker threads used by the device to rasterize screen tiles in parallel.
+/// @note This class is used internally by devices.
+class CMuli3DThreadPool
+{
+public:
+	CMuli3DThreadPool();
+	~CMuli3DThreadPool(); ///< Terminates and joins all worker threads.
+
+	/// Creates the worker threads.
+	/// @param[in] i_iNumThreads total number of threads including the calling thread, e [1;c_iMaxRasterizerThreads].
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_unknown if a thread could not be created.
+	result Create( uint32 i_iNumThreads );
+
+	/// Executes a number of jobs on all threads of the pool, including the calling thread, and returns when all of them have finished.
+	/// Jobs are handed out in ascending order, but may complete in any order.
+	/// @param[in] i_pJob job-function.
+	/// @param[in] i_pUserData user-defined data passed to the job-function.
+	/// @param[in] i_iNumJobs number of jobs to execute.
+	void Execute( m3dthreadjob i_pJob, void *i_pUserData, uint32 i_iNumJobs );
+
+	uint32 iGetNumThreads(); ///< Returns the total number of threads including the calling thread.
+
+private:
+	/// Fetches and executes jobs until none are left.
+	/// @param[in] i_iThread index of the executing thread.
+	void ProcessJobs( uint32 i_iThread );
+
+	/// @internal Start parameters of a worker thread.
+	struct workerthread
+	{
+		CMuli3DThreadPool	*pPool;		///< Pointer to the owning pool.
+		uint32				iThread;	///< Index of the thread.
+		#ifdef WIN32
+		HANDLE				hThread;	///< Thread handle.
+		HANDLE				hStart;		///< Signaled when a new batch of jobs is available.
+		HANDLE				hDone;		///< Signaled by the worker when it has finished its jobs.
+		#elif !defined( __amigaos4__ )
+		pthread_t			Thread;		///< Thread handle.
+		uint32				iGeneration;	///< Last batch of jobs the worker has seen.
+		#endif
+	};
+
+	#ifdef WIN32
+	static DWORD WINAPI WorkerThread( LPVOID i_pParam );
+	#elif !defined( __amigaos4__ )
+	static void *WorkerThread( void *i_pParam );
+	#endif
+
+	void Destroy(); ///< Terminates and joins all worker threads.
+
+private:
+	uint32			m_iNumThreads;		///< Total number of threads including the calling thread.
+	workerthread	*m_pWorkers;		///< Worker threads; m_iNumThreads - 1 entries.
+
+	m3dthreadjob	m_pJob;				///< Active job-function.
+	void			*m_pUserData;		///< User-data of the active job-function.
+	uint32			m_iNumJobs;			///< Number of jobs in the active batch.
+	uint32			m_iNextJob;			///< Next job to be handed out; protected by the pool's lock.
+	bool			m_bShutdown;		///< Set when the workers shall terminate.
+
+	#ifdef WIN32
+	CRITICAL_SECTION	m_Lock;			///< Protects m_iNextJob.
+	#elif !defined( __amigaos4__ )
+	pthread_mutex_t		m_Lock;			///< Protects job-state.
+	pthread_cond_t		m_WorkAvailable;	///< Signaled when a new batch of jobs is available.
+	pthread_cond_t		m_WorkDone;		///< Signaled when the last worker has finished its jobs.
+	uint32				m_iGeneration;	///< Incremented for each batch of jobs.
+	uint32				m_iBusyWorkers;	///< Number of workers still working on the active batch.
+	#endif
+};
+
+/// @internal A single worker thread, which executes jobs one after another in submission order. Used by the device to execute command lists asynchronously.
+/// @note This class is used internally by devices.
+class CMuli3DWorkQueue
+{
+public:
+	CMuli3DWorkQueue();
+	~CMuli3DWorkQueue(); ///< Waits for all submitted jobs and joins the worker thread.
+
+	/// Creates the worker thread.
+	/// @return s_ok if the function succeeds.
+	/// @return e_unknown if the thread could not be created.
+	result Create();
+
+	/// Appends a job to the queue and returns immediately. On AmigaOS 4 the job is executed by the calling thread.
+	/// @param[in] i_pJob job-function; called with i_iJob set to the job's sequence number and i_iThread set to 0.
+	/// @param[in] i_pUserData user-defined data passed to the job-function.
+	/// @return sequence number of the job; sequence numbers start at 1 and increase by one with each submitted job.
+	uint32 iSubmit( m3dthreadjob i_pJob, void *i_pUserData );
+
+	/// Returns true if the job with the given sequence number has finished. Jobs finish in submission order; sequence number 0 is always finished.
+	/// @param[in] i_iJob sequence number of the job.
+	bool bIsComplete( uint32 i_iJob );
+
+	/// Blocks until the job with the given sequence number has finished. Must not be called from several threads at the same time.
+	/// @param[in] i_iJob sequence number of the job.
+	void Wait( uint32 i_iJob );
+
+	void WaitIdle(); ///< Blocks until all submitted jobs have finished.
+
+private:
+	/// @internal Describes a submitted job.
+	struct queuedjob
+	{
+		m3dthreadjob	pJob;		///< Job-function.
+		void			*pUserData;	///< User-defined data passed to the job-function.
+		uint32			iJob;		///< Sequence number.
+	};
+
+	#ifdef WIN32
+	static DWORD WINAPI WorkerThread( LPVOID i_pParam );
+	#elif !defined( __amigaos4__ )
+	static void *WorkerThread( void *i_pParam );
+	#endif
+
+	void Destroy(); ///< Waits for all submitted jobs and joins the worker thread.
+
+private:
+	std::deque<queuedjob>	m_Jobs;			///< Jobs waiting for execution; protected by the queue's lock.
+	uint32					m_iSubmitted;	///< Sequence number of the last submitted job.
+	volatile uint32			m_iCompleted;	///< Sequence number of the last finished job; protected by the queue's lock.
+	bool					m_bCreated;		///< True if the worker thread is running.
+	bool					m_bShutdown;	///< Set when the worker shall terminate after finishing all jobs.
+
+	#ifdef WIN32
+	CRITICAL_SECTION	m_Lock;				///< Protects the job-state.
+	HANDLE				m_hThread;			///< Thread handle.
+	HANDLE				m_hWorkAvailable;	///< Semaphore counting waiting jobs.
+	HANDLE				m_hJobDone;			///< Signaled by the worker whenever it has finished a job.
+	#elif !defined( __amigaos4__ )
+	pthread_mutex_t		m_Lock;				///< Protects the job-state.
+	pthread_t			m_Thread;			///< Thread handle.
+	pthread_cond_t		m_WorkAvailable;	///< Signaled when a job has been submitted.
+	pthread_cond_t		m_JobDone;			///< Signaled whenever the worker has finished a job.
+	#endif
+};
+
+#endif // __M3DCORE_THREADPOOL_H__
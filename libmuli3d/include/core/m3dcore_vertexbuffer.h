@@ -39,10 +39,12 @@ protected:
 
 	/// Accessible by CMuli3DDevice which is the only class that may create a vertex buffer.
 	/// @param[in] i_iLength length of the vertex buffer to be created in bytes.
+	/// @param[in] i_pData memory holding the vertex data, or 0 to allocate the buffer. The buffer is read-only if it is passed.
+	/// @param[in] i_pDataOwner object owning the memory i_pData points to, or 0. The vertex buffer keeps a reference to it.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
-	result Create( uint32 i_iLength );
+	result Create( uint32 i_iLength, const void *i_pData = 0, IBase *i_pDataOwner = 0 );
 
 public:
 	class CMuli3DDevice *pGetDevice(); ///< Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
@@ -52,14 +54,25 @@ public:
 	/// @param[out] o_ppData receives the pointer to the vertex buffer.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_invalidstate if the buffer is read-only.
 	result GetPointer( uint32 i_iOffset, void **o_ppData );
 
+	/// Returns a pointer to the desired position in the buffer, which may only be used for reading. This function also succeeds for read-only buffers.
+	/// @param[in] i_iOffset has to be specified in bytes.
+	/// @param[out] o_ppData receives the pointer to the vertex buffer.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	result GetReadPointer( uint32 i_iOffset, const void **o_ppData );
+
 	uint32 iGetLength(); ///< Returns the length of the buffer in bytes.
+	bool bIsReadOnly(); ///< Returns true if the buffer has been created from externally owned memory, which mustn't be written to.
 
 private:
-	class CMuli3DDevice	*m_pParent;	///< Pointer to parent.
-	uint32				m_iLength;	///< Length of the vertex buffer in bytes.
-	byte				*m_pData;	///< Pointer to the vertex buffer data.
+	class CMuli3DDevice	*m_pParent;		///< Pointer to parent.
+	uint32				m_iLength;		///< Length of the vertex buffer in bytes.
+	const byte			*m_pData;		///< Pointer to the vertex buffer data.
+	bool				m_bOwnsData;	///< False if the vertex data has been passed to Create(); the buffer is read-only then.
+	IBase				*m_pDataOwner;	///< Object owning the vertex data if it has been passed to Create(), or 0.
 };
 
 #endif // __M3DCORE_VERTEXBUFFER_H__
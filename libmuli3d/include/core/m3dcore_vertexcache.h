@@ -0,0 +1,63 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_vertexcache.h
+/// Analysis and optimization of indexed triangle lists for the post-transform vertex cache.
+
+#ifndef __M3DCORE_VERTEXCACHE_H__
+#define __M3DCORE_VERTEXCACHE_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+
+/// Describes how well an indexed triangle list uses the post-transform vertex cache.
+struct m3dvertexcachestats
+{
+	uint32	iNumTriangles;			///< Number of triangles of the list.
+	uint32	iNumVertices;			///< Number of distinct vertices referenced by the list.
+	uint32	iTransformedVertices;	///< Number of vertices that missed the cache and had to be transformed.
+	float32	fACMR;					///< Average cache miss ratio: transformed vertices per triangle. Lies between about 0.5 for large regular meshes and 3.
+	float32	fATVR;					///< Average transform to vertex ratio: transformed vertices per referenced vertex. 1 is optimal.
+};
+
+/// Simulates the vertex cache of the device while drawing an indexed triangle list: the cache is c_iVertexCacheWays-way set-associative, the low bits of a vertex index select its set.
+/// @param[out] o_Stats receives the statistics of the triangle list.
+/// @param[in] i_pIndices indices of the triangle list.
+/// @param[in] i_iNumIndices number of indices; a multiple of 3.
+/// @param[in] i_iVertexCacheSize number of entries of the cache, see m3drs_vertexcachesize.
+void AnalyzeVertexCache( m3dvertexcachestats &o_Stats, const uint32 *i_pIndices, uint32 i_iNumIndices, uint32 i_iVertexCacheSize );
+
+/// Reorders the triangles of an indexed triangle list, so that consecutive triangles share vertices and the vertex cache is hit more often.
+/// This is Tom Forsyth's linear-speed vertex cache optimization: it repeatedly emits the triangle whose vertices score best, the score rewarding vertices that are recently used and those that are only referenced by few remaining triangles. The vertices of a triangle keep their winding.
+/// @param[in,out] io_pIndices indices of the triangle list, which are reordered in place.
+/// @param[in] i_iNumIndices number of indices; a multiple of 3.
+/// @param[in] i_iNumVertices number of vertices; all indices have to be smaller.
+/// @param[in] i_iVertexCacheSize number of entries of the cache to optimize for, see m3drs_vertexcachesize.
+void OptimizeVertexCache( uint32 *io_pIndices, uint32 i_iNumIndices, uint32 i_iNumVertices, uint32 i_iVertexCacheSize );
+
+/// Renumbers the vertices of an indexed triangle list in the order they are first referenced, so that vertices are fetched from memory almost sequentially and consecutive cache misses fall into different sets of the vertex cache. Vertices that aren't referenced are moved to the end.
+/// Optimize the triangle order with OptimizeVertexCache() first; the vertices have to be reordered according to the remap table afterwards.
+/// @param[out] o_pRemap receives the new index of each vertex; has to hold i_iNumVertices entries.
+/// @param[in,out] io_pIndices indices of the triangle list, which are replaced by the new indices.
+/// @param[in] i_iNumIndices number of indices.
+/// @param[in] i_iNumVertices number of vertices; all indices have to be smaller.
+/// @return the number of referenced vertices, which come first in the new order.
+uint32 iOptimizeVertexFetch( uint32 *o_pRemap, uint32 *io_pIndices, uint32 i_iNumIndices, uint32 i_iNumVertices );
+
+#endif // __M3DCORE_VERTEXCACHE_H__
@@ -0,0 +1,231 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/// @file m3dcore_virtualtexture.h
+///
+
+#ifndef __M3DCORE_VIRTUALTEXTURE_H__
+#define __M3DCORE_VIRTUALTEXTURE_H__
+
+#include "../m3dbase.h"
+#include "../m3dtypes.h"
+
+#include "m3dcore_basetexture.h"
+
+/// This is the page source base-class. Page sources provide the pages of virtual textures, e.g. by reading them from disk, and are implemented by the application.
+class IMuli3DPageSource : public IBase
+{
+public:
+	/// Loads a page of a virtual texture. This function is called on the loader thread of the virtual texture, except for the pages of the mip-levels which are always resident; these are loaded when the texture is created.
+	/// @param[out] o_pData receives the pixels of the page in the format of the texture, rows of c_iVirtualPageSize pixels each. Pages at the right and bottom edges of a mip-level only need to provide the pixels inside the mip-level.
+	/// @param[in] i_iMipLevel mip-level of the page, 0 being the largest mip-level.
+	/// @param[in] i_iPageX horizontal index of the page in the mip-level.
+	/// @param[in] i_iPageY vertical index of the page in the mip-level.
+	/// @return true if the page has been loaded. Pages which failed to load are never requested again.
+	virtual bool bLoadPage( void *o_pData, uint32 i_iMipLevel, uint32 i_iPageX, uint32 i_iPageY ) = 0;
+};
+
+/// CMuli3DVirtualTexture implements a 2-dimensional texture, whose mip-levels are split into pages of c_iVirtualPageSize x c_iVirtualPageSize pixels, which are only loaded when they are sampled.
+/// A fixed number of pages is resident in memory. Texture lookups which hit a page that is not resident record it as missing and fall back to the next coarser mip-level that is resident; the mip-levels fitting into a single page are always resident. UpdatePages() passes the missing pages to a background thread, which loads them from the page source of the texture, and maps loaded pages into the page table, replacing the least recently used ones.
+class CMuli3DVirtualTexture : public IMuli3DBaseTexture
+{
+protected:
+	~CMuli3DVirtualTexture(); ///< Accessible by IBase. The destructor is called when the reference count reaches zero.
+
+	friend class CMuli3DDevice;
+	/// Accessible by CMuli3DDevice which is the only class that may create a virtual texture.
+	/// @param[in] i_pParent a pointer to the parent CMuli3DDevice-object.
+	CMuli3DVirtualTexture( class CMuli3DDevice *i_pParent );
+
+	/// Accessible by CMuli3DDevice which is the only class that may create a virtual texture.
+	/// @param[in] i_iWidth width of the texture to be created in pixels.
+	/// @param[in] i_iHeight height of the texture to be created in pixels.
+	/// @param[in] i_iMipLevels number of mip-levels to be created. Specify 0 to create a full mip-chain. The last mip-level has to fit into a single page.
+	/// @param[in] i_fmtFormat format of the texture to be created. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
+	/// @param[in] i_iResidentPages number of pages kept in memory. Has to exceed the number of pages of the mip-levels which are always resident.
+	/// @param[in] i_pPageSource page source providing the pages of the texture.
+	/// @return s_ok if the function succeeds.
+	/// @return e_invalidparameters if one or more parameters were invalid.
+	/// @return e_outofmemory if memory allocation failed.
+	/// @return e_invalidformat if an invalid format was encountered.
+	/// @return e_unknown if the loader thread could not be created or a page of the mip-levels which are always resident failed to load.
+	result Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels,
+		m3dformat i_fmtFormat, uint32 i_iResidentPages, IMuli3DPageSource *i_pPageSource );
+
+	m3dtexsampleinput eGetTexSampleInput(); ///< Sampling this texture requires 2 floating point coordinates.
+
+	/// Accessible by CMuli3DDevice.
+	/// Samples the texture and returns the looked-up color.
+	/// @param[out] o_vColor receives the color of the pixel to be looked up.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fW w-component of the lookup-vector (unused).
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	result SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV,
+		float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient,
+		const uint32 *i_pSamplerStates );
+
+	/// Accessible by CMuli3DDevice.
+	/// Samples the texture at four locations, which share the same texture gradients. The mip-level is determined only once for all four lookups.
+	/// @param[out] o_pColors receives the colors of the four pixels to be looked up.
+	/// @param[in] i_pCoords the four lookup-vectors.
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	result SampleTextureQuad( vector4 *o_pColors, const vector4 *i_pCoords,
+		const vector4 *i_pXGradient, const vector4 *i_pYGradient,
+		const uint32 *i_pSamplerStates );
+
+public:
+	/// Maps the pages which have finished loading and starts loading the pages which have been recorded as missing by texture lookups since the last call. Coarser mip-levels are loaded first.
+	/// Call this function once per frame while the texture is not being sampled, i.e. not while the device is rendering or executing command lists asynchronously.
+	/// @param[in] i_bWaitForLoads if true, the function waits for all pages which are loading before mapping them.
+	/// @return s_ok if the function succeeds.
+	result UpdatePages( bool i_bWaitForLoads = false );
+
+	m3dformat fmtGetFormat();	///< Returns the format of the texture. Member of the enumeration m3dformat.
+	uint32 iGetMipLevels();		///< Returns the number of mip-levels this texture consists of.
+	uint32 iGetResidentPages();	///< Returns the number of pages which are currently mapped, including the ones of the mip-levels which are always resident.
+	uint32 iGetLoadingPages();	///< Returns the number of pages which are currently being loaded.
+
+	/// Returns the width of the given mip-level in pixels.
+	/// @param[in] i_iMipLevel the mip-level whose width is requested.
+	uint32 iGetWidth( uint32 i_iMipLevel = 0 );
+
+	/// Returns the height of the given mip-level in pixels.
+	/// @param[in] i_iMipLevel the mip-level whose height is requested.
+	uint32 iGetHeight( uint32 i_iMipLevel = 0 );
+
+private:
+	/// Determines the mip-level and the texture filter from the texture gradients.
+	/// @param[out] o_fMipLevel receives the mip-level, which may have a fractional part.
+	/// @param[out] o_iTexFilter receives the texture filter; member of the enumeration m3dtexturefilter.
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate, or 0.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate, or 0.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	void ComputeMipLevel( float32 &o_fMipLevel, uint32 &o_iTexFilter, const vector4 *i_pXGradient,
+		const vector4 *i_pYGradient, const uint32 *i_pSamplerStates );
+
+	/// Samples the mip-chain at a given mip-level.
+	/// @param[out] o_vColor receives the color of the pixel to be looked up.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fMipLevel mip-level as returned by ComputeMipLevel().
+	/// @param[in] i_iTexFilter texture filter as returned by ComputeMipLevel().
+	/// @param[in] i_iMipFilter mip filter; member of the enumeration m3dtexturefilter.
+	void SampleMipLevel( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fMipLevel,
+		uint32 i_iTexFilter, uint32 i_iMipFilter );
+
+	/// Samples a single mip-level, if the pages required are resident.
+	/// @param[out] o_vColor receives the color of the pixel to be looked up.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_iMipLevel mip-level to be sampled.
+	/// @param[in] i_iTexFilter texture filter; member of the enumeration m3dtexturefilter.
+	/// @return false if a page required is not resident.
+	bool bSampleLevel( vector4 &o_vColor, float32 i_fU, float32 i_fV, uint32 i_iMipLevel, uint32 i_iTexFilter );
+
+	/// Returns a pointer to the pixels of a page, or 0 if the page is not resident. Missing pages are recorded for UpdatePages().
+	/// @param[in] i_iMipLevel mip-level of the page.
+	/// @param[in] i_iPageX horizontal index of the page in the mip-level.
+	/// @param[in] i_iPageY vertical index of the page in the mip-level.
+	const byte *pGetPage( uint32 i_iMipLevel, uint32 i_iPageX, uint32 i_iPageY );
+
+	/// Chooses a physical page for loading a page: either a free one or the least recently used one, which hasn't been sampled since the last call to UpdatePages().
+	/// @return index of the physical page, or -1 if none is available.
+	int32 iAcquirePhysicalPage();
+
+	/// Job-function of the loader thread.
+	/// @param[in] i_pPageLoad pointer to the pageload-structure describing the page.
+	/// @param[in] i_iJob sequence number of the job (unused).
+	/// @param[in] i_iThread index of the thread (unused).
+	static void LoadPageJob( void *i_pPageLoad, uint32 i_iJob, uint32 i_iThread );
+
+	/// @internal States of the entries of the page table.
+	enum pagestate
+	{
+		ps_missing = 0,	///< The page is not resident.
+		ps_requested,	///< The page has been recorded as missing by a texture lookup.
+		ps_loading,		///< The page is being loaded.
+		ps_resident,	///< The page is resident.
+		ps_failed		///< The page failed to load and is never requested again.
+	};
+
+	/// @internal Describes a mip-level of the texture.
+	struct miplevel
+	{
+		uint32	iWidth, iHeight;	///< Dimensions of the mip-level in pixels.
+		uint32	iPagesX, iPagesY;	///< Number of pages in horizontal and vertical direction.
+		uint32	iFirstPage;			///< Index of the first page of the mip-level in the page table.
+	};
+
+	/// @internal Describes a physical page, i.e. c_iVirtualPageSize x c_iVirtualPageSize pixels of memory a page can be loaded into.
+	struct physicalpage
+	{
+		int32			iPage;		///< Index of the page in the page table which is mapped to this physical page, or -1.
+		volatile uint32	iLastUse;	///< Value of m_iFrame when the page was last sampled.
+		bool			bPinned;	///< True for the pages of the mip-levels which are always resident.
+	};
+
+	/// @internal Describes a page being loaded by the loader thread.
+	struct pageload
+	{
+		CMuli3DVirtualTexture	*pTexture;	///< Pointer to the texture.
+		uint32					iPage;		///< Index of the page in the page table.
+		uint32					iMipLevel;	///< Mip-level of the page.
+		uint32					iPageX, iPageY;	///< Position of the page in the mip-level.
+		int32					iPhysicalPage;	///< Physical page receiving the pixels, or -1 if this entry is unused.
+		uint32					iJob;		///< Sequence number of the job loading the page.
+		bool					bLoaded;	///< Set by the loader thread if the page has been loaded.
+	};
+
+private:
+	m3dformat				m_fmtFormat;		///< Format of the texture.
+	uint32					m_iPixelBytes;		///< Size of a pixel in bytes.
+	uint32					m_iMipLevels;		///< Number of mip-levels.
+	miplevel				*m_pMipLevels;		///< Descriptions of the mip-levels.
+	float32					m_fSquaredWidth, m_fSquaredHeight; ///< Squared dimensions of the base mip-level, used for mip-calculations.
+
+	uint32					m_iNumPages;		///< Number of entries of the page table.
+	volatile int32			*m_pPageTable;		///< Physical page every page is mapped to, or -1 if it is not resident.
+	volatile int32			*m_pPageStates;		///< State of every page; member of the enumeration pagestate.
+
+	uint32					m_iNumPhysicalPages;	///< Number of physical pages.
+	uint32					m_iPhysicalPageSize;	///< Size of a physical page in bytes.
+	byte					*m_pPhysicalData;	///< Memory of the physical pages.
+	physicalpage			*m_pPhysicalPages;	///< Descriptions of the physical pages.
+	int32					*m_pFreePhysicalPages;	///< Stack of physical pages which aren't mapped.
+	uint32					m_iNumFreePhysicalPages;	///< Number of entries of m_pFreePhysicalPages.
+	uint32					m_iNumResidentPages;	///< Number of mapped physical pages.
+	uint32					m_iFrame;			///< Incremented by UpdatePages().
+
+	volatile int32			m_iNumPageRequests;	///< Number of pages recorded as missing since the last call to UpdatePages(); may exceed c_iMaxPageRequests.
+	uint32					m_iPageRequests[c_iMaxPageRequests];	///< Pages recorded as missing.
+
+	pageload				m_PageLoads[c_iMaxPageLoads];	///< Pages being loaded.
+	uint32					m_iNumPageLoads;	///< Number of used entries of m_PageLoads.
+	class CMuli3DWorkQueue	*m_pLoader;			///< Loader thread.
+	IMuli3DPageSource		*m_pPageSource;		///< Page source providing the pages.
+};
+
+#endif // __M3DCORE_VIRTUALTEXTURE_H__
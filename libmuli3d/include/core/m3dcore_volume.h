@@ -41,13 +41,14 @@ protected:
 	/// @param[in] i_iWidth width of the volume to be created in pixels.
 	/// @param[in] i_iHeight height of the volume to be created in pixels.
 	/// @param[in] i_iDepth depth of the volume to be created in pixels.
-	/// @param[in] i_fmtFormat format of the volume to be created. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	/// @param[in] i_fmtFormat format of the volume to be created. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
+	/// @param[in] i_Layout memory layout of the volume to be created. Member of the enumeration m3dtexturelayout.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	/// @return e_invalidformat if an invalid format was encountered.
 	result Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth,
-		m3dformat i_fmtFormat );
+		m3dformat i_fmtFormat, m3dtexturelayout i_Layout );
 
 public:
 	/// Samples the volume using nearest point sampling.
@@ -89,7 +90,8 @@ public:
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_invalidstate if the volume is already locked.
 	/// @return e_outofmemory if memory allocation failed.
-	/// @note Locking the entire volume is a lot faster than locking a sub-region, because no lock-buffer has to be created and the application may write to the volume directly.
+	/// @note The data is laid out as described by the volume's format: arrays of float32 for the 32-bit float formats, bytes for m3dfmt_r8 and m3dfmt_r8g8b8a8 and half-floats for m3dfmt_r16g16f and m3dfmt_r16g16b16a16f and unsigned shorts for m3dfmt_r5g6b5.
+	/// @note Locking the entire volume is a lot faster than locking a sub-region, because no lock-buffer has to be created and the application may write to the volume directly. This doesn't apply to volumes using the m3dtl_tiled layout: their pixels are always copied to a lock-buffer in slice by slice and row by row order and written back when the volume is unlocked.
 	result LockBox( void **o_ppData, const m3dbox *i_pBox );
 
 	/// Unlocks the volume; modifications to its contents will become active.
@@ -97,8 +99,10 @@ public:
 	/// @return e_invalidstate if the volume is not locked.
 	result UnlockBox();
 
-	m3dformat fmtGetFormat();	///< Returns the format of the volume. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
-	uint32 iGetFormatFloats();	///< Returns the number of floats of the format, e [1,4].
+	m3dformat fmtGetFormat();	///< Returns the format of the volume. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
+	uint32 iGetFormatFloats();	///< Returns the number of floats of the format, e [1,4], or 0 for the compact 8- and 16-bit formats.
+	uint32 iGetPixelBytes();	///< Returns the size of a pixel in bytes.
+	m3dtexturelayout GetLayout();	///< Returns the memory layout of the volume. Member of the enumeration m3dtexturelayout.
 	
 	uint32 iGetWidth(); ///< Returns the width of the volume in pixels.
 	uint32 iGetHeight(); ///< Returns the height of the volume in pixels.
@@ -107,22 +111,44 @@ public:
 	/// Returns a pointer to the associated device. Calling this function will increase the internal reference count of the device. Failure to call Release() when finished using the pointer will result in a memory leak.
 	class CMuli3DDevice *pGetDevice();
 
+private:
+	/// Returns the index of a pixel in the volume data, taking the layout of the volume into account.
+	/// @param[in] i_iX x-coordinate of the pixel.
+	/// @param[in] i_iY y-coordinate of the pixel.
+	/// @param[in] i_iZ z-coordinate of the pixel.
+	uint32 iGetPixelIndex( uint32 i_iX, uint32 i_iY, uint32 i_iZ );
+
+	/// Copies the pixels of a box of the volume slice by slice and row by row to a buffer.
+	/// @param[out] o_pDest destination buffer.
+	/// @param[in] i_Box box to be copied.
+	void ReadBox( byte *o_pDest, const m3dbox &i_Box );
+
+	/// Copies the pixels of a box of the volume slice by slice and row by row from a buffer.
+	/// @param[in] i_pSrc source buffer.
+	/// @param[in] i_Box box to be copied.
+	void WriteBox( const byte *i_pSrc, const m3dbox &i_Box );
+
 private:
 	class CMuli3DDevice	*m_pParent;	///< Pointer to parent.
 
-	m3dformat	m_fmtFormat;	///< Format of the volume. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	m3dformat	m_fmtFormat;	///< Format of the volume. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
 	uint32		m_iWidth;		///< Width of the volume in pixels.
 	uint32		m_iHeight;		///< Height of the volume in pixels.
 	uint32		m_iDepth;		///< Depth of the volume in pixels.
 	uint32		m_iWidthMin1;	///< Width - 1 of the volume in pixels.
 	uint32		m_iHeightMin1;	///< Height - 1 of the volume in pixels.
 	uint32		m_iDepthMin1;	///< Depth - 1 of the volume in pixels.
+	uint32		m_iPixelBytes;	///< Size of a pixel in bytes.
+
+	m3dtexturelayout	m_Layout;			///< Memory layout of the volume. Member of the enumeration m3dtexturelayout.
+	uint32				m_iTilesPerRow;		///< Number of bricks per row if the volume uses the m3dtl_tiled layout.
+	uint32				m_iTilesPerSlice;	///< Number of bricks per slice of bricks if the volume uses the m3dtl_tiled layout.
 
 	bool	m_bLockedComplete;		///< True if the whole volume has been locked.
 	m3dbox	m_PartialLockBox;		///< Information about the locked box.
-	float32	*m_pPartialLockData;	///< Not null if a sub-box of the volume has been locked.
+	byte	*m_pPartialLockData;	///< Not null if a sub-box of the volume has been locked.
 
-	float32	*m_pData;	///< Pointer to volume data.
+	byte	*m_pData;	///< Pointer to volume data.
 };
 
 #endif // __M3DCORE_VOLUME_H__
@@ -44,13 +44,14 @@ protected:
 	/// @param[in] i_iHeight height of the texture to be created in pixels.
 	/// @param[in] i_iDepth depth of the texture to be created in pixels.
 	/// @param[in] i_iMipLevels number of mip-levels to be created. Specify 0 to create a full mip-chain.
-	/// @param[in] i_fmtFormat format of the texture to be created. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
+	/// @param[in] i_fmtFormat format of the texture to be created. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
+	/// @param[in] i_Layout memory layout of the mip-levels to be created. Member of the enumeration m3dtexturelayout.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
 	/// @return e_outofmemory if memory allocation failed.
 	/// @return e_invalidformat if an invalid format was encountered.
 	result Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth,
-		uint32 i_iMipLevels, m3dformat i_fmtFormat );
+		uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout );
 
 	m3dtexsampleinput eGetTexSampleInput(); ///< Sampling this texture requires 3 floating point coordinates.
 
@@ -68,8 +69,21 @@ protected:
 		float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient,
 		const uint32 *i_pSamplerStates );
 
+	/// Accessible by CMuli3DDevice.
+	/// Samples the texture at four locations, which share the same texture gradients, e.g. the pixels of a 2x2 quad or of a pixel shader batch. The mip-level is determined only once for all four lookups.
+	/// @param[out] o_pColors receives the colors of the four pixels to be looked up.
+	/// @param[in] i_pCoords the four lookup-vectors.
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate. If 0 the base mip-level will be chosen and the minification filter will be used for texture sampling.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	/// @return s_ok if the function succeeds.
+	result SampleTextureQuad( vector4 *o_pColors, const vector4 *i_pCoords,
+		const vector4 *i_pXGradient, const vector4 *i_pYGradient,
+		const uint32 *i_pSamplerStates );
+
 public:
 	/// Generates mip-sublevels through downsampling (using a box-filter) a given source mip-level.
+	/// Odd dimensions are reduced with a 3-tap filter, so that no source pixels are dropped. The rows of large mip-levels are split across m3ddeviceparameters::iMipThreads threads.
 	/// @param[in] i_iSrcLevel the mip-level which will be taken as the starting point.
 	/// @return s_ok if the function succeeds.
 	/// @return e_invalidparameters if one or more parameters were invalid.
@@ -105,8 +119,8 @@ public:
 	/// @param[in] i_iMipLevel mip-level, 0 being the largest mip-level.
 	class CMuli3DVolume *pGetMipLevel( uint32 i_iMipLevel );
 
-	m3dformat fmtGetFormat();	///< Returns the format of the texture. Member of the enumeration m3dformat; m3dfmt_r32f, m3dfmt_r32g32f, m3dfmt_r32g32b32f or m3dfmt_r32g32b32a32f.
-	uint32 iGetFormatFloats();	///< Returns the number of floats of the format, e [1,4].
+	m3dformat fmtGetFormat();	///< Returns the format of the texture. Member of the enumeration m3dformat; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
+	uint32 iGetFormatFloats();	///< Returns the number of floats of the format, e [1,4], or 0 for the compact 8- and 16-bit formats.
 	uint32 iGetMipLevels();		///< Returns the number of mip-levels this texture consists of.
 	
 	/// Returns the width of the given mip-level in pixels.
@@ -121,6 +135,27 @@ public:
 	/// @param[in] i_iMipLevel the mip-level whose depth is requested.
 	uint32 iGetDepth( uint32 i_iMipLevel = 0 );
 
+private:
+	/// Determines the mip-level and the texture filter from the texture gradients.
+	/// @param[out] o_fMipLevel receives the mip-level, which may have a fractional part.
+	/// @param[out] o_iTexFilter receives the texture filter; member of the enumeration m3dtexturefilter.
+	/// @param[in] i_pXGradient partial derivatives of the texture coordinates with respect to the screen-space x coordinate, or 0.
+	/// @param[in] i_pYGradient partial derivatives of the texture coordinates with respect to the screen-space y coordinate, or 0.
+	/// @param[in] i_pSamplerStates texture sampler states.
+	void ComputeMipLevel( float32 &o_fMipLevel, uint32 &o_iTexFilter, const vector4 *i_pXGradient,
+		const vector4 *i_pYGradient, const uint32 *i_pSamplerStates );
+
+	/// Samples the mip-chain at a given mip-level.
+	/// @param[out] o_vColor receives the color of the pixel to be looked up.
+	/// @param[in] i_fU u-component of the lookup-vector.
+	/// @param[in] i_fV v-component of the lookup-vector.
+	/// @param[in] i_fW w-component of the lookup-vector.
+	/// @param[in] i_fMipLevel mip-level as returned by ComputeMipLevel().
+	/// @param[in] i_iTexFilter texture filter as returned by ComputeMipLevel().
+	/// @param[in] i_iMipFilter mip filter; member of the enumeration m3dtexturefilter.
+	void SampleMipLevel( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, float32 i_fMipLevel,
+		uint32 i_iTexFilter, uint32 i_iMipFilter );
+
 private:
 	uint32				m_iMipLevels;			///< Number of mip-levels.
 	float32				m_fSquaredWidth, m_fSquaredHeight, m_fSquaredDepth; ///< Squared dimensions of the base mip-level, used for mip-calculations.
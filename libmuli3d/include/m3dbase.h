@@ -33,6 +33,16 @@
 #endif
 #include <vector>
 
+#if defined( __SSE__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 1 )
+#	define M3D_SSE	///< Defined if the target processor supports SSE.
+#	include <xmmintrin.h>
+#endif
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#	define M3D_SSE2	///< Defined if the target processor supports SSE2.
+#	include <emmintrin.h>
+#endif
+
 // Basic macro definitions ----------------------------------------------------
 
 /// If the pointer is not null, the memory it is pointing to is deleted and the pointer is set to null to ease debugging and to make sure it is not deleted again using SAFE_DELETE().
@@ -58,6 +68,13 @@ typedef signed int          int32;		///< 32-bit signed integer
 typedef unsigned char       uint8;		///< 8-bit unsigned integer
 typedef unsigned short      uint16;		///< 16-bit unsigned integer
 typedef unsigned int        uint32;		///< 32-bit unsigned integer
+#ifdef _MSC_VER
+typedef signed __int64      int64;		///< 64-bit signed integer
+typedef unsigned __int64    uint64;		///< 64-bit unsigned integer
+#else
+typedef signed long long    int64;		///< 64-bit signed integer
+typedef unsigned long long  uint64;		///< 64-bit unsigned integer
+#endif
 
 typedef float				float32;	///< 32-bit float
 typedef double				float64;	///< 64-bit float
@@ -77,7 +94,7 @@ inline void fpuReset() { _controlfp( _CW_DEFAULT, _MCW_RC|_MCW_PC ); }		///< Res
 
 #endif
 
-#ifdef LINUX_X11
+#if defined( LINUX_X11 ) || defined( LINUX_HEADLESS )
 
 #include <fpu_control.h>
 
@@ -111,9 +128,11 @@ inline void fpuReset()
 
 #endif
 
-/// ftol() performs fast float to integer-conversion.
-/// Ensure that fpuTruncate() has been called before using this function, otherwise
-/// ftol() will round to the nearest integer. After calling fpuTruncate() it is advised to 
+/// ftol() performs fast float to integer-conversion, rounding down.
+/// If M3D_SSE is defined, the conversion doesn't depend on the FPU control word
+/// and may be used from any thread. Otherwise ensure that fpuTruncate() has been
+/// called on the calling thread before using this function, else ftol() will round
+/// to the nearest integer. After calling fpuTruncate() it is advised to 
 /// reset the fpu to rounding-mode using fpuReset().
 /// @param[in] f The floating pointer number to be converted to an integer.
 /// @return an integer.
@@ -133,12 +152,16 @@ typedef union
 
 inline int32 ftol( float32 f )
 {
-#ifdef __amigaos4__
-	static hexdouble hd;
+#if defined( M3D_SSE )
+	// cvttss2si always truncates towards zero, correct negative fractions.
+	const int32 i = _mm_cvtt_ss2si( _mm_set_ss( f ) );
+	return i - ( f < (float32)i );
+#elif defined( __amigaos4__ )
+	hexdouble hd;
 	__asm__ ( "fctiw %0, %1" : "=f" (hd.d) : "f" (f) );
 	return hd.i.lo;
 #else
-	static int32 tmp;
+	int32 tmp;
 
 	#if _MSC_VER > 1000
 	__asm
@@ -154,6 +177,34 @@ inline int32 ftol( float32 f )
 #endif
 }
 
+// Atomic operations ----------------------------------------------------------
+
+#ifdef WIN32
+
+extern "C" long __cdecl _InterlockedIncrement( long volatile * );
+extern "C" long __cdecl _InterlockedDecrement( long volatile * );
+extern "C" long __cdecl _InterlockedCompareExchange( long volatile *, long, long );
+#pragma intrinsic( _InterlockedIncrement, _InterlockedDecrement, _InterlockedCompareExchange )
+
+inline int32 iAtomicIncrement( volatile int32 *io_pValue ) { return _InterlockedIncrement( (long volatile *)io_pValue ); }	///< Atomically increments the value and returns the result.
+inline int32 iAtomicDecrement( volatile int32 *io_pValue ) { return _InterlockedDecrement( (long volatile *)io_pValue ); }	///< Atomically decrements the value and returns the result.
+inline int32 iAtomicCompareExchange( volatile int32 *io_pValue, int32 i_iExchange, int32 i_iComparand ) { return _InterlockedCompareExchange( (long volatile *)io_pValue, i_iExchange, i_iComparand ); }	///< Atomically replaces the value with i_iExchange if it equals i_iComparand and returns the initial value.
+
+#elif defined( __amigaos4__ )
+
+// No worker threads are created on AmigaOS 4.
+inline int32 iAtomicIncrement( volatile int32 *io_pValue ) { return ++*io_pValue; }	///< Increments the value and returns the result.
+inline int32 iAtomicDecrement( volatile int32 *io_pValue ) { return --*io_pValue; }	///< Decrements the value and returns the result.
+inline int32 iAtomicCompareExchange( volatile int32 *io_pValue, int32 i_iExchange, int32 i_iComparand ) { const int32 iValue = *io_pValue; if( iValue == i_iComparand ) *io_pValue = i_iExchange; return iValue; }	///< Replaces the value with i_iExchange if it equals i_iComparand and returns the initial value.
+
+#else
+
+inline int32 iAtomicIncrement( volatile int32 *io_pValue ) { return __sync_add_and_fetch( io_pValue, 1 ); }	///< Atomically increments the value and returns the result.
+inline int32 iAtomicDecrement( volatile int32 *io_pValue ) { return __sync_sub_and_fetch( io_pValue, 1 ); }	///< Atomically decrements the value and returns the result.
+inline int32 iAtomicCompareExchange( volatile int32 *io_pValue, int32 i_iExchange, int32 i_iComparand ) { return __sync_val_compare_and_swap( io_pValue, i_iComparand, i_iExchange ); }	///< Atomically replaces the value with i_iExchange if it equals i_iComparand and returns the initial value.
+
+#endif
+
 // Functions and return-values ------------------------------------------------
 
 /// Describes function return values.
@@ -202,6 +253,7 @@ enum result
 // Muli3D base-class definition -----------------------------------------------
 
 /// IBase is the base class for all Muli3D classes. It implements a reference-counter with functions AddRef() and Release() known from COM interfaces.
+/// The reference-counter is updated atomically, so references may be added and released from different threads.
 class IBase
 {
 protected:
@@ -209,15 +261,15 @@ protected:
 	virtual inline ~IBase() {}
 
 public:
-	inline void AddRef() { ++m_iRefCount; }	///< AddRef() increases the reference count.
-	inline void Release() { if( --m_iRefCount == 0 ) delete this; }	///< Release() decreases the reference count and calls the destructor when it is 0.
+	inline void AddRef() { iAtomicIncrement( &m_iRefCount ); }	///< AddRef() increases the reference count.
+	inline void Release() { if( iAtomicDecrement( &m_iRefCount ) == 0 ) delete this; }	///< Release() decreases the reference count and calls the destructor when it is 0.
 
 private:
 	IBase( const IBase & ) {}								///< Private copy-operator to avoid object copying.
 	IBase &operator =( const IBase & ) { return *this; }	///< Private assignment-operator to avoid object copying. Returns a value to avoid compiler warnings.
 
 private:
-	uint32 m_iRefCount;
+	volatile int32 m_iRefCount;
 };
 
 #endif // __M3DBASE_H__
@@ -46,6 +46,13 @@ typedef Window windowhandle;		///< Define window-handle for the Linux-platform.
 #endif
 
 
+#ifdef LINUX_HEADLESS
+
+typedef unsigned long windowhandle;	///< Define window-handle for the Linux-platform without X11; unused, because only offscreen present-targets are available.
+
+#endif
+
+
 #ifdef __amigaos4__
 
 #include <intuition/intuition.h>
@@ -55,12 +62,24 @@ typedef struct Window *windowhandle; ///< Define window-handle for the AmigaOS-p
 
 // Constants ------------------------------------------------------------------
 
-const uint32 c_iVertexCacheSize = 32;		///< Specifies the size of the vertex cache. Minimum is 3!
 const uint32 c_iVertexShaderRegisters = 8;	///< Specifies the amount of available vertex shader input registers.
 const uint32 c_iPixelShaderRegisters = 8;	///< Specifies the amount of available vertex shader output registers, which are simulateously used as pixel shader input registers.
 const uint32 c_iNumShaderConstants = 32;	///< Specifies the amount of available shader constants-registers for both vertex and pixel shaders.
 const uint32 c_iMaxVertexStreams = 8;		///< Specifies the amount of available vertex streams.
 const uint32 c_iMaxTextureSamplers = 16;	///< Specifies the amount of available texture samplers.
+const uint32 c_iMaxRasterizerThreads = 32;	///< Specifies the maximum amount of threads used for rasterization.
+const uint32 c_iMaxVertexCacheSize = 4096;	///< Specifies the maximum amount of entries of the post-transform vertex cache.
+const uint32 c_iVertexCacheWays = 4;		///< Specifies the amount of entries per set of the post-transform vertex cache; has to be at least 3, so that fetching a triangle's vertices never evicts one of the others.
+const uint32 c_iRasterizerTileSize = 64;	///< Specifies the edge length of screen tiles in pixels when rasterizing with multiple threads.
+const uint32 c_iHiZBlockSize = 8;			///< Specifies the edge length of the blocks of the hierarchical depth buffer in pixels. c_iRasterizerTileSize has to be a multiple of this.
+const uint32 c_iTextureTileSize = 4;		///< Specifies the edge length of the tiles of surfaces and volumes, which use the m3dtl_tiled layout, in pixels.
+const uint32 c_iCompressedBlockSize = 4;	///< Specifies the edge length of the blocks of the block-compressed formats in pixels.
+const uint32 c_iBlockCacheEntries = 64;	///< Specifies the amount of decoded blocks of the block-compressed formats kept by each thread sampling textures. Has to be a power of 2 and at least 16.
+const uint32 c_iVirtualPageSize = 128;		///< Specifies the edge length of the pages of virtual textures in pixels. Has to be a power of 2.
+const uint32 c_iMaxPageRequests = 256;		///< Specifies the amount of missing pages a virtual texture records between two calls to CMuli3DVirtualTexture::UpdatePages().
+const uint32 c_iMaxPageLoads = 16;			///< Specifies the amount of pages a virtual texture may be loading at the same time.
+const uint32 c_iMaxShaderBatchSize = 8;	///< Specifies the maximum amount of pixels or vertices passed to a shader's ExecuteBatch()-function.
+const uint32 c_iDefaultFrameQueueLength = 4;	///< Specifies the amount of frames kept by a m3dptt_framequeue present-target if the device parameters don't specify it.
 
 // Enumerations ---------------------------------------------------------------
 
@@ -87,6 +106,12 @@ enum m3drenderstate
 	
 	m3drs_linethickness,			///< Controls the thickness of rendered lines Valid values are integers >= 1. Default: 1.
 
+	m3drs_rasterizerthreads,		///< Number of threads used for rasterization, including the calling thread. If set to a value > 1, projected triangles are binned into screen tiles of c_iRasterizerTileSize pixels, which are rasterized in parallel when a draw-call finishes. Output is identical to single-threaded rendering; however, pixel shaders must not modify shared state in bExecute(). Wireframe-rendering is always single-threaded. Valid values are integers e [1;c_iMaxRasterizerThreads]. Default: 1.
+
+	m3drs_rasterizer,				///< Triangle rasterization algorithm. Set this renderstate to a member of the enumeration m3drasterizer. Default: m3drast_scanline.
+
+	m3drs_vertexcachesize,			///< Number of entries of the post-transform vertex cache. The cache is 4-way set-associative: a vertex may only be stored in the set selected by the low bits of its index, in which the least recently used entry is replaced. Valid values are powers of two e [4;c_iMaxVertexCacheSize]. Default: 32.
+
 	m3drs_numrenderstates
 };
 
@@ -118,6 +143,13 @@ enum m3dfill
 	m3dfill_wireframe	///< Only triangle's edges are drawn.
 };
 
+/// Defines the supported triangle rasterization algorithms.
+enum m3drasterizer
+{
+	m3drast_scanline,	///< Triangles are scan-converted by stepping along their edges in floating point (default).
+	m3drast_halfspace	///< Triangles are rasterized by evaluating fixed point edge functions for blocks of 2x2 pixel quads inside the triangle's bounding box. Applies the top-left fill-rule.
+};
+
 /// Defines the available texturesamplerstates.
 enum m3dtexturesamplerstate
 {
@@ -159,6 +191,9 @@ enum m3dsubdiv
 /// Defines the supported texture and buffer formats.
 /// The default value for formats that contain undefined channels is 1.0f for the undefined alpha channel and 0.0f for undefined color channels.
 /// E.g. m3dfmt_r32g32b32f doesn't define the alpha channel, which is therefore set to 1.0f.
+/// When locked, surfaces and volumes of the 8-bit formats expose bytes (0 maps to 0.0f, 255 to 1.0f) and those of the 16-bit float formats expose IEEE 754 half-floats; see m3dcore_pixelformat.h.
+/// Pixels of m3dfmt_r5g6b5 and of the depthbuffer formats are unsigned integers, whose maximum value maps to 1.0f.
+/// The block-compressed formats m3dfmt_bc1 to m3dfmt_bc5 may only be used by textures and cube-textures. Their surfaces store blocks of 4x4 pixels row by row, are locked block by block and are decoded when they are sampled; see m3dcore_pixelformat.h.
 enum m3dformat
 {
 	// Texture formats
@@ -166,12 +201,35 @@ enum m3dformat
 	m3dfmt_r32g32f,			///< 64-bit texture format, two floats mapped to the red and green channel.
 	m3dfmt_r32g32b32f,		///< 96-bit texture format, three floats mapped to the three color channel.
 	m3dfmt_r32g32b32a32f,	///< 128-bit texture format, four floats mapped to the three color channel plus the alpha channel.
+	m3dfmt_r8,				///< 8-bit texture format, one unsigned normalized byte mapped to the red channel.
+	m3dfmt_r8g8b8a8,		///< 32-bit texture format, four unsigned normalized bytes mapped to the three color channels plus the alpha channel.
+	m3dfmt_r16g16f,			///< 32-bit texture format, two half-floats mapped to the red and green channel.
+	m3dfmt_r16g16b16a16f,	///< 64-bit texture format, four half-floats mapped to the three color channels plus the alpha channel.
+	m3dfmt_r5g6b5,			///< 16-bit texture format, an unsigned short holding red in the upper 5 bits, green in the middle 6 bits and blue in the lower 5 bits.
+
+	// Block-compressed texture formats
+	m3dfmt_bc1,				///< 4 bits per pixel, blocks of 4x4 pixels holding two r5g6b5 endpoints and 2-bit interpolation indices. Pixels with the fourth index of blocks whose first endpoint isn't larger than the second one are black and transparent.
+	m3dfmt_bc3,				///< 8 bits per pixel, blocks of 4x4 pixels holding an alpha block like m3dfmt_bc4, followed by a color block like m3dfmt_bc1, which always interpolates between its endpoints.
+	m3dfmt_bc4,				///< 4 bits per pixel, blocks of 4x4 pixels holding two 8-bit endpoints and 3-bit interpolation indices mapped to the red channel.
+	m3dfmt_bc5,				///< 8 bits per pixel, blocks of 4x4 pixels holding a block like m3dfmt_bc4 for the red channel, followed by one for the green channel. Well suited for normal maps.
+
+	// Depthbuffer formats
+	m3dfmt_d16,				///< 16-bit depthbuffer format, depth e [0.0f,1.0f] stored as unsigned short. May only be used by surfaces.
+	m3dfmt_d24,				///< 24-bit depthbuffer format, depth e [0.0f,1.0f] stored in the lower 24 bits of an unsigned integer. May only be used by surfaces.
 
 	// Indexbuffer formats
 	m3dfmt_index16,			///< 16-bit indexbuffer format, indices are shorts.
 	m3dfmt_index32			///< 32-bit indexbuffer format, indices are integers.
 };
 
+/// Defines the memory layouts of surfaces and volumes.
+/// The layout is transparent to the application: locking always exposes the pixels row by row (and slice by slice).
+enum m3dtexturelayout
+{
+	m3dtl_linear,	///< Pixels are stored row by row and slice by slice. Complete locks give direct access to the data.
+	m3dtl_tiled		///< Pixels are stored in tiles of c_iTextureTileSize x c_iTextureTileSize pixels (bricks of c_iTextureTileSize slices for volumes), so that the pixels read by filtered lookups are close to each other in memory. Every lock converts the locked area to and from the linear layout.
+};
+
 /// Defines the supported primitive types.
 enum m3dprimitivetype
 {
@@ -234,6 +292,14 @@ enum m3dshaderregtype
 	m3dsrt_vector4			///< Specifies that the register should be treated as a 4-dimensional vector.
 };
 
+/// Defines the available present-targets.
+enum m3dpresenttargettype
+{
+	m3dptt_window = 0,		///< Frames are displayed in the output window by the platform's present-target. Not available on LINUX_HEADLESS builds.
+	m3dptt_framequeue,		///< Frames are kept in memory; the application reads them with CMuli3DDevice::ReadPresentedFrame().
+	m3dptt_ppmfiles			///< Every frame is written to a binary PPM image file; the file names are built from m3ddeviceparameters::pFileNamePattern.
+};
+
 enum m3dclippingplanes
 {
 	m3dcp_left = 0,			///< Left frustum clipping plane.
@@ -277,6 +343,14 @@ struct m3ddeviceparameters
 	
 	/// Dimension of the backbuffer in Pixels.
 	uint32	iBackbufferWidth, iBackbufferHeight;
+
+	m3dpresenttargettype	PresentTarget;		///< Destination of presented frames. Member of the enumeration m3dpresenttargettype; defaults to m3dptt_window.
+	uint32					iFrameQueueLength;	///< Maximum number of frames kept by a m3dptt_framequeue present-target; when the queue is full, the oldest frame is dropped. 0 selects c_iDefaultFrameQueueLength.
+	const char				*pFileNamePattern;	///< printf-style pattern receiving the frame number for m3dptt_ppmfiles present-targets, e.g. "frame%05u.ppm".
+
+	float32					fPresentGamma;		///< Gamma of the display: presented colors are raised to the power of 1 / fPresentGamma, e.g. 2.2 to display colors rendered in linear space. 0 and 1 disable gamma correction.
+	uint32					iPresentThreads;	///< Number of threads converting the colorbuffer to display pixels when presenting, e [1;c_iMaxRasterizerThreads]. 0 selects 1.
+	uint32					iMipThreads;		///< Number of threads generating mip-levels in GenerateMipSubLevels(), e [1;c_iMaxRasterizerThreads]. 0 selects 1.
 };
 
 /// Describes a vertex element.
@@ -290,6 +364,36 @@ struct m3dvertexelement
 #define M3DVERTEXFORMATDECL( i_iStream, i_Type, i_Register ) \
 	{ i_iStream, i_Type, i_Register } ///< Helper-macro for vertex format declaration.
 
+/// Describes a shader register for a batch of pixels or vertices in structure-of-arrays layout: Each component is stored once per pixel or vertex (lane).
+struct m3dshaderregbatch
+{
+	float32 x[c_iMaxShaderBatchSize];
+	float32 y[c_iMaxShaderBatchSize];
+	float32 z[c_iMaxShaderBatchSize];
+	float32 w[c_iMaxShaderBatchSize];
+};
+
+/// Describes a batch of pixels which is passed to IMuli3DPixelShader::ExecuteBatch().
+/// Only the first IMuli3DPixelShader::iGetBatchSize() lanes are used.
+struct m3dpixelbatch
+{
+	m3dshaderregbatch	Inputs[c_iPixelShaderRegisters];	///< Pixel shader input registers, which have been set up in the vertex shader and interpolated during rasterization. Unused components are 0.
+	m3dshaderregbatch	Color;								///< Contains the pixels' colors in the rendertarget; receives the new colors.
+	float32				fDepth[c_iMaxShaderBatchSize];		///< Contains the pixels' interpolated depth; m3dpso_colordepth-shaders may set new values.
+	uint32				iX[c_iMaxShaderBatchSize];			///< Integer x-coordinates of the pixels.
+	uint32				iY[c_iMaxShaderBatchSize];			///< Integer y-coordinates of the pixels.
+	float32				fInvW[c_iMaxShaderBatchSize];		///< 1.0f / w of the pixels; needed for computation of partial derivatives.
+};
+
+/// Describes a batch of vertices which is passed to IMuli3DVertexShader::ExecuteBatch().
+/// Only the first IMuli3DVertexShader::iGetBatchSize() lanes are used.
+struct m3dvertexbatch
+{
+	m3dshaderregbatch	Inputs[c_iVertexShaderRegisters];	///< Vertex shader input registers, data is loaded from the active vertex streams.
+	m3dshaderregbatch	Position;							///< Receives the vertex positions transformed to homogeneous clipping space.
+	m3dshaderregbatch	Outputs[c_iPixelShaderRegisters];	///< Receives the vertex shader output registers.
+};
+
 
 // Internal structures --------------------------------------------------------
 
@@ -334,13 +438,22 @@ struct m3dtriangleinfo
 	float32 fCurPixelInvW; ///< 1.0f / w of the current pixel; needed by pixel shader for computation of partial derivatives.
 };
 
+/// Describes the constants-registers of a shader.
+/// @note This structure is used internally by shaders and command lists.
+struct m3dshaderconstants
+{
+	float32		fConstants[c_iNumShaderConstants];		///< Single float-constants.
+	vector4		vConstants[c_iNumShaderConstants];		///< vector4-constants.
+	matrix44	matConstants[c_iNumShaderConstants];	///< Matrix-constants.
+};
+
 /// Describes a structure that is used for vertex caching.
 /// @note This structure is used internally by devices.
 struct m3dvertexcacheentry
 {
 	uint32		iVertexIndex;	///< Index of the contained vertex in the vertex buffer.
 	m3dvsoutput	VertexOutput;	///< Vertex shader output, vertex data.
-	uint32		iFetchTime;		///< Whenever a vertex cache entry is reserved for drawing (updated or simply 'touched and returned') its fetch-time is set to m_iFetchedVertices.
+	uint32		iFetchTime;		///< Whenever a vertex cache entry is reserved for drawing (updated or simply 'touched and returned') its fetch-time is set to m_iFetchedVertices. Entries fetched before the current draw-call are invalid.
 };
 
 #endif // __M3DTYPES_H__
@@ -90,4 +90,69 @@ inline float32 fLerp( const float32 i_fValA, const float32 i_fValB,
 	return i_fValA + ( i_fValB - i_fValA ) * i_fInterpolation;
 }
 
+/// Approximates the base 2 logarithm of a value by splitting it into exponent and mantissa; the logarithm of the mantissa is approximated with a cubic polynomial.
+/// @param[in] i_fVal value, has to be greater than 0.0f and finite.
+/// @return log2( i_fVal ) with an absolute error below 0.0013.
+inline float32 fFastLog2( const float32 i_fVal )
+{
+	union { float32 f; uint32 i; } Value;
+	Value.f = i_fVal;
+	const float32 fExponent = (float32)( (int32)( ( Value.i >> 23 ) & 0xff ) - 127 );
+	Value.i = ( Value.i & 0x007fffff ) | 0x3f800000; // mantissa e [1.0f,2.0f[
+	const float32 fMantissa = Value.f;
+	return fExponent + ( ( 0.15824870f * fMantissa - 1.05187502f ) * fMantissa + 3.04788415f ) * fMantissa - 2.15419383f;
+}
+
+/// Converts an IEEE 754 half-float to a float.
+/// @param[in] i_iHalf bit-pattern of the half-float.
+/// @return float with the same value; denormals, infinities and NaNs are preserved.
+inline float32 fHalfToFloat( const uint16 i_iHalf )
+{
+	const uint32 iSign = (uint32)( i_iHalf & 0x8000 ) << 16;
+	const uint32 iExponent = ( i_iHalf >> 10 ) & 0x1f;
+	const uint32 iMantissa = i_iHalf & 0x3ff;
+
+	union { uint32 i; float32 f; } Value;
+	if( iExponent == 0x1f )
+		Value.i = iSign | 0x7f800000 | ( iMantissa << 13 ); // infinity or NaN
+	else if( iExponent )
+		Value.i = iSign | ( ( iExponent + 112 ) << 23 ) | ( iMantissa << 13 ); // rebias 15 -> 127
+	else
+	{
+		// zero or denormal: mantissa * 2^-24
+		Value.f = (float32)iMantissa * ( 1.0f / 16777216.0f );
+		Value.i |= iSign;
+	}
+
+	return Value.f;
+}
+
+/// Converts a float to an IEEE 754 half-float, rounding to the nearest representable value.
+/// @param[in] i_fVal value to convert; values beyond the range of half-floats become infinities.
+/// @return bit-pattern of the half-float.
+inline uint16 iFloatToHalf( const float32 i_fVal )
+{
+	union { float32 f; uint32 i; } Value;
+	Value.f = i_fVal;
+
+	const uint32 iSign = ( Value.i >> 16 ) & 0x8000;
+	const uint32 iAbs = Value.i & 0x7fffffff;
+
+	if( iAbs >= 0x7f800000 ) // infinity or NaN
+		return (uint16)( iSign | 0x7c00 | ( iAbs > 0x7f800000 ? 0x200 : 0 ) );
+
+	if( iAbs >= 0x477ff000 ) // >= 65520 rounds to infinity
+		return (uint16)( iSign | 0x7c00 );
+
+	if( iAbs < 0x38800000 ) // < 2^-14: denormal or zero
+	{
+		Value.i = iAbs;
+		return (uint16)( iSign | (uint32)( Value.f * 16777216.0f + 0.5f ) );
+	}
+
+	// Rebias the exponent and round the mantissa to nearest even.
+	const uint32 iRounded = iAbs + 0x0fff + ( ( iAbs >> 13 ) & 1 );
+	return (uint16)( iSign | ( ( iRounded - 0x38000000 ) >> 13 ) );
+}
+
 #endif // __M3DMATH_COMMON_H__
@@ -20,34 +20,39 @@
 #include "../../include/core/m3dcore_baseshader.h"
 #include "../../include/core/m3dcore_device.h"
 
+IMuli3DBaseShader::IMuli3DBaseShader()
+	: m_pActiveConstants( &m_Constants ), m_pDevice( 0 )
+{
+}
+
 void IMuli3DBaseShader::SetFloat( uint32 i_iIndex, float32 i_fValue )
 {
-	m_fConstants[i_iIndex] = i_fValue;
+	m_Constants.fConstants[i_iIndex] = i_fValue;
 }
 
 float32 IMuli3DBaseShader::fGetFloat( uint32 i_iIndex )
 {
-	return m_fConstants[i_iIndex];
+	return m_pActiveConstants->fConstants[i_iIndex];
 }
 
 void IMuli3DBaseShader::SetVector( uint32 i_iIndex, const vector4 &i_vVector )
 {
-	m_vConstants[i_iIndex] = i_vVector;
+	m_Constants.vConstants[i_iIndex] = i_vVector;
 }
 
 const vector4 &IMuli3DBaseShader::vGetVector( uint32 i_iIndex )
 {
-	return m_vConstants[i_iIndex];
+	return m_pActiveConstants->vConstants[i_iIndex];
 }
 
 void IMuli3DBaseShader::SetMatrix( uint32 i_iIndex, const matrix44 &i_matMatrix )
 {
-	m_matConstants[i_iIndex] = i_matMatrix;
+	m_Constants.matConstants[i_iIndex] = i_matMatrix;
 }
 
 const matrix44 &IMuli3DBaseShader::matGetMatrix( uint32 i_iIndex )
 {
-	return m_matConstants[i_iIndex];
+	return m_pActiveConstants->matConstants[i_iIndex];
 }
 
 void IMuli3DBaseShader::SetDevice( CMuli3DDevice *i_pDevice )
@@ -55,6 +60,16 @@ void IMuli3DBaseShader::SetDevice( CMuli3DDevice *i_pDevice )
 	m_pDevice = i_pDevice;
 }
 
+const m3dshaderconstants &IMuli3DBaseShader::GetConstants()
+{
+	return m_Constants;
+}
+
+void IMuli3DBaseShader::SetActiveConstants( const m3dshaderconstants *i_pConstants )
+{
+	m_pActiveConstants = i_pConstants ? i_pConstants : &m_Constants;
+}
+
 result IMuli3DBaseShader::SampleTexture( vector4 &o_vColor, uint32 i_iSamplerNumber, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient )
 {
 	/* if( !m_pDevice )
@@ -62,3 +77,8 @@ result IMuli3DBaseShader::SampleTexture( vector4 &o_vColor, uint32 i_iSamplerNum
 	
 	return m_pDevice->SampleTexture( o_vColor, i_iSamplerNumber, i_fU, i_fV, i_fW, i_pXGradient, i_pYGradient );
 }
+
+result IMuli3DBaseShader::SampleTextureQuad( vector4 *o_pColors, uint32 i_iSamplerNumber, const vector4 *i_pCoords, const vector4 *i_pXGradient, const vector4 *i_pYGradient )
+{
+	return m_pDevice->SampleTextureQuad( o_pColors, i_iSamplerNumber, i_pCoords, i_pXGradient, i_pYGradient );
+}
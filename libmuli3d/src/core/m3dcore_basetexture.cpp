@@ -31,6 +31,19 @@ IMuli3DBaseTexture::~IMuli3DBaseTexture()
 	SAFE_RELEASE( m_pParent );
 }
 
+result IMuli3DBaseTexture::SampleTextureQuad( vector4 *o_pColors, const vector4 *i_pCoords, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+	{
+		result resSample = SampleTexture( o_pColors[iPixel], i_pCoords[iPixel].x, i_pCoords[iPixel].y, i_pCoords[iPixel].z,
+			i_pXGradient, i_pYGradient, i_pSamplerStates );
+		if( FUNC_FAILED( resSample ) )
+			return resSample;
+	}
+
+	return s_ok;
+}
+
 CMuli3DDevice *IMuli3DBaseTexture::pGetDevice()
 {
 	if( m_pParent )
@@ -0,0 +1,200 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+
+#include "../../include/core/m3dcore_blockformat.h"
+#include "../../include/core/m3dcore_pixelformat.h"
+#include "../../include/core/m3dcore_threadpool.h"
+
+/// A decoded block in the cache of a thread.
+struct m3dblockcacheentry
+{
+	uint32		iCacheID;	///< Identifier of the contents of the surface the block belongs to; 0 if the entry is unused.
+	const byte	*pBlock;	///< Pointer to the encoded block.
+	byte		Pixels[c_iCompressedBlockSize * c_iCompressedBlockSize * 4];	///< The decoded pixels, row by row.
+};
+
+static M3D_THREADLOCAL m3dblockcacheentry g_BlockCache[c_iBlockCacheEntries];	///< Decoded blocks of the calling thread.
+static volatile int32 g_iLastBlockCacheID = 0;	///< Last identifier returned by iGetBlockCacheID().
+
+/// Expands a r5g6b5-color to four bytes; alpha is set to 255.
+/// @param[out] o_pColor receives the color.
+/// @param[in] i_iColor the packed color.
+inline void UnpackR5G6B5( byte *o_pColor, uint32 i_iColor )
+{
+	const uint32 iRed = i_iColor >> 11, iGreen = ( i_iColor >> 5 ) & 63, iBlue = i_iColor & 31;
+	o_pColor[0] = (byte)( ( iRed << 3 ) | ( iRed >> 2 ) );
+	o_pColor[1] = (byte)( ( iGreen << 2 ) | ( iGreen >> 4 ) );
+	o_pColor[2] = (byte)( ( iBlue << 3 ) | ( iBlue >> 2 ) );
+	o_pColor[3] = 255;
+}
+
+/// Decodes the color block of m3dfmt_bc1 and m3dfmt_bc3.
+/// @param[out] o_pPixels receives 16 pixels of four bytes each.
+/// @param[in] i_pBlock pointer to the 8 bytes of the color block.
+/// @param[in] i_bFourColors true if the block always interpolates between its endpoints (m3dfmt_bc3); otherwise the order of the endpoints selects the mode.
+static void DecodeColorBlock( byte *o_pPixels, const byte *i_pBlock, bool i_bFourColors )
+{
+	const uint32 iColor0 = i_pBlock[0] | ( i_pBlock[1] << 8 ), iColor1 = i_pBlock[2] | ( i_pBlock[3] << 8 );
+
+	byte Palette[4][4];
+	UnpackR5G6B5( Palette[0], iColor0 );
+	UnpackR5G6B5( Palette[1], iColor1 );
+	if( i_bFourColors || iColor0 > iColor1 )
+	{
+		for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+		{
+			Palette[2][iChannel] = (byte)( ( 2 * Palette[0][iChannel] + Palette[1][iChannel] + 1 ) / 3 );
+			Palette[3][iChannel] = (byte)( ( Palette[0][iChannel] + 2 * Palette[1][iChannel] + 1 ) / 3 );
+		}
+		Palette[2][3] = Palette[3][3] = 255;
+	}
+	else
+	{
+		// Three colors and transparent black
+		for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+		{
+			Palette[2][iChannel] = (byte)( ( Palette[0][iChannel] + Palette[1][iChannel] + 1 ) / 2 );
+			Palette[3][iChannel] = 0;
+		}
+		Palette[2][3] = 255; Palette[3][3] = 0;
+	}
+
+	const uint32 iIndices = i_pBlock[4] | ( i_pBlock[5] << 8 ) | ( i_pBlock[6] << 16 ) | ( (uint32)i_pBlock[7] << 24 );
+	for( uint32 iPixel = 0; iPixel < 16; ++iPixel )
+		memcpy( &o_pPixels[iPixel * 4], Palette[( iIndices >> ( 2 * iPixel ) ) & 3], 4 );
+}
+
+/// Decodes the single-channel block of m3dfmt_bc3 (alpha), m3dfmt_bc4 and m3dfmt_bc5.
+/// @param[out] o_pValues receives 16 values; consecutive values are 4 bytes apart.
+/// @param[in] i_pBlock pointer to the 8 bytes of the block.
+static void DecodeValueBlock( byte *o_pValues, const byte *i_pBlock )
+{
+	const uint32 iValue0 = i_pBlock[0], iValue1 = i_pBlock[1];
+
+	byte Palette[8];
+	Palette[0] = (byte)iValue0; Palette[1] = (byte)iValue1;
+	if( iValue0 > iValue1 )
+	{
+		for( uint32 iStep = 1; iStep < 7; ++iStep )
+			Palette[iStep + 1] = (byte)( ( ( 7 - iStep ) * iValue0 + iStep * iValue1 + 3 ) / 7 );
+	}
+	else
+	{
+		for( uint32 iStep = 1; iStep < 5; ++iStep )
+			Palette[iStep + 1] = (byte)( ( ( 5 - iStep ) * iValue0 + iStep * iValue1 + 2 ) / 5 );
+		Palette[6] = 0; Palette[7] = 255;
+	}
+
+	// 48 bits of 3-bit indices; each group of 3 bytes holds the indices of 8 pixels.
+	for( uint32 iGroup = 0; iGroup < 2; ++iGroup )
+	{
+		const byte *pIndices = &i_pBlock[2 + 3 * iGroup];
+		const uint32 iIndices = pIndices[0] | ( pIndices[1] << 8 ) | ( pIndices[2] << 16 );
+		for( uint32 iPixel = 0; iPixel < 8; ++iPixel )
+			o_pValues[( iGroup * 8 + iPixel ) * 4] = Palette[( iIndices >> ( 3 * iPixel ) ) & 7];
+	}
+}
+
+void DecodeBlock( byte *o_pPixels, m3dformat i_fmtFormat, const byte *i_pBlock )
+{
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_bc1:
+		DecodeColorBlock( o_pPixels, i_pBlock, false );
+		break;
+
+	case m3dfmt_bc3:
+		DecodeColorBlock( o_pPixels, &i_pBlock[8], true );
+		DecodeValueBlock( &o_pPixels[3], i_pBlock );
+		break;
+
+	case m3dfmt_bc4:
+	case m3dfmt_bc5:
+		for( uint32 iPixel = 0; iPixel < 16; ++iPixel )
+		{
+			o_pPixels[iPixel * 4 + 1] = o_pPixels[iPixel * 4 + 2] = 0;
+			o_pPixels[iPixel * 4 + 3] = 255;
+		}
+		DecodeValueBlock( o_pPixels, i_pBlock );
+		if( i_fmtFormat == m3dfmt_bc5 )
+			DecodeValueBlock( &o_pPixels[1], &i_pBlock[8] );
+		break;
+
+	default: // cannot happen
+		memset( o_pPixels, 0, c_iCompressedBlockSize * c_iCompressedBlockSize * 4 );
+		break;
+	}
+}
+
+void EncodeSolidBlock( byte *o_pBlock, m3dformat i_fmtFormat, const vector4 &i_vColor )
+{
+	// Both endpoints are set to the color and all indices select the first endpoint.
+	memset( o_pBlock, 0, iGetFormatBlockBytes( i_fmtFormat ) );
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_bc1:
+	case m3dfmt_bc3:
+		{
+			const uint16 iColor = iPackR5G6B5( i_vColor );
+			byte *pColorBlock = ( i_fmtFormat == m3dfmt_bc3 ) ? &o_pBlock[8] : o_pBlock;
+			pColorBlock[0] = pColorBlock[2] = (byte)( iColor & 0xff );
+			pColorBlock[1] = pColorBlock[3] = (byte)( iColor >> 8 );
+			if( i_fmtFormat == m3dfmt_bc3 )
+				o_pBlock[0] = o_pBlock[1] = iFloatToUNorm8( i_vColor.a );
+		}
+		break;
+
+	case m3dfmt_bc5:
+		o_pBlock[8] = o_pBlock[9] = iFloatToUNorm8( i_vColor.g );
+	case m3dfmt_bc4:
+		o_pBlock[0] = o_pBlock[1] = iFloatToUNorm8( i_vColor.r );
+		break;
+
+	default: // cannot happen
+		break;
+	}
+}
+
+uint32 iGetBlockCacheID()
+{
+	uint32 iCacheID;
+	do
+	{
+		iCacheID = (uint32)iAtomicIncrement( &g_iLastBlockCacheID );
+	}
+	while( !iCacheID ); // skip 0 after wrapping around
+	return iCacheID;
+}
+
+const byte *pGetCachedBlock( m3dformat i_fmtFormat, const byte *i_pBlock, uint32 i_iCacheID, uint32 i_iBlockX, uint32 i_iBlockY )
+{
+	// Blocks of an 8x8 area map to different entries; the identifier spreads
+	// the blocks of different surfaces across the cache.
+	const uint32 iEntry = ( ( i_iBlockY & 7 ) * 8 + ( i_iBlockX & 7 ) + ( ( i_iCacheID * 0x9e3779b1 ) >> 24 ) ) & ( c_iBlockCacheEntries - 1 );
+	m3dblockcacheentry &Entry = g_BlockCache[iEntry];
+	if( Entry.iCacheID != i_iCacheID || Entry.pBlock != i_pBlock )
+	{
+		DecodeBlock( Entry.Pixels, i_fmtFormat, i_pBlock );
+		Entry.iCacheID = i_iCacheID;
+		Entry.pBlock = i_pBlock;
+	}
+
+	return Entry.Pixels;
+}
@@ -0,0 +1,260 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "../../include/core/m3dcore_commandlist.h"
+#include "../../include/core/m3dcore_basetexture.h"
+#include "../../include/core/m3dcore_indexbuffer.h"
+#include "../../include/core/m3dcore_primitiveassembler.h"
+#include "../../include/core/m3dcore_rendertarget.h"
+#include "../../include/core/m3dcore_shaders.h"
+#include "../../include/core/m3dcore_threadpool.h"
+#include "../../include/core/m3dcore_vertexbuffer.h"
+#include "../../include/core/m3dcore_vertexformat.h"
+
+const uint32 c_iNoConstants = 0xffffffff;
+
+CMuli3DCommandList::CMuli3DCommandList( CMuli3DDevice *i_pParent )
+	: m_pParent( i_pParent ), m_iExecution( 0 )
+{
+	m_pParent->AddRef();
+
+	for( uint32 iSlot = 0; iSlot < 3; ++iSlot )
+		m_iLastConstants[iSlot] = c_iNoConstants;
+}
+
+CMuli3DCommandList::~CMuli3DCommandList()
+{
+	ReleaseCommands();
+
+	SAFE_RELEASE( m_pParent );
+}
+
+CMuli3DDevice *CMuli3DCommandList::pGetDevice()
+{
+	if( m_pParent )
+		m_pParent->AddRef();
+	return m_pParent;
+}
+
+result CMuli3DCommandList::ClearColorBuffer( CMuli3DRenderTarget *i_pRenderTarget, const vector4 &i_vColor, const m3drect *i_pRect )
+{
+	return RecordClear( m3dcmd_clearcolorbuffer, i_pRenderTarget, i_vColor, i_pRect );
+}
+
+result CMuli3DCommandList::ClearDepthBuffer( CMuli3DRenderTarget *i_pRenderTarget, float32 i_fDepth, const m3drect *i_pRect )
+{
+	return RecordClear( m3dcmd_cleardepthbuffer, i_pRenderTarget, vector4( i_fDepth, 0, 0, 0 ), i_pRect );
+}
+
+uint32 CMuli3DCommandList::iGetNumCommands()
+{
+	return (uint32)m_Commands.size();
+}
+
+bool CMuli3DCommandList::bIsExecuting()
+{
+	if( !m_iExecution || !m_pParent->m_pRenderThread )
+		return false;
+
+	return !m_pParent->m_pRenderThread->bIsComplete( m_iExecution );
+}
+
+void CMuli3DCommandList::ReleaseCommands()
+{
+	for( std::vector<CMuli3DDevice::devicestate>::iterator pState = m_States.begin(); pState != m_States.end(); ++pState )
+	{
+		SAFE_RELEASE( pState->pVertexFormat );
+		SAFE_RELEASE( pState->pPrimitiveAssembler );
+		SAFE_RELEASE( pState->pVertexShader );
+		SAFE_RELEASE( pState->pTriangleShader );
+		SAFE_RELEASE( pState->pPixelShader );
+		SAFE_RELEASE( pState->pIndexBuffer );
+
+		for( uint32 iStream = 0; iStream < c_iMaxVertexStreams; ++iStream )
+			SAFE_RELEASE( pState->VertexStreams[iStream].pVertexBuffer );
+
+		for( uint32 iSampler = 0; iSampler < c_iMaxTextureSamplers; ++iSampler )
+			SAFE_RELEASE( pState->TextureSamplers[iSampler].pTexture );
+
+		SAFE_RELEASE( pState->pRenderTarget );
+	}
+
+	for( std::vector<command>::iterator pCommand = m_Commands.begin(); pCommand != m_Commands.end(); ++pCommand )
+		SAFE_RELEASE( pCommand->pRenderTarget );
+
+	m_Commands.clear();
+	m_States.clear();
+	m_Constants.clear();
+
+	for( uint32 iSlot = 0; iSlot < 3; ++iSlot )
+		m_iLastConstants[iSlot] = c_iNoConstants;
+}
+
+void CMuli3DCommandList::RecordDrawCall( m3dcommandtype i_Type, const uint32 *i_pParameters, uint32 i_iNumParameters )
+{
+	CMuli3DDevice::devicestate State;
+	m_pParent->CaptureState( State );
+
+	// Only record the states if they have changed since the last draw-call ----
+	if( m_States.empty() || memcmp( &m_States.back(), &State, sizeof( CMuli3DDevice::devicestate ) ) != 0 )
+	{
+		if( State.pVertexFormat ) State.pVertexFormat->AddRef();
+		if( State.pPrimitiveAssembler ) State.pPrimitiveAssembler->AddRef();
+		if( State.pVertexShader ) State.pVertexShader->AddRef();
+		if( State.pTriangleShader ) State.pTriangleShader->AddRef();
+		if( State.pPixelShader ) State.pPixelShader->AddRef();
+		if( State.pIndexBuffer ) State.pIndexBuffer->AddRef();
+
+		for( uint32 iStream = 0; iStream < c_iMaxVertexStreams; ++iStream )
+		{
+			if( State.VertexStreams[iStream].pVertexBuffer )
+				State.VertexStreams[iStream].pVertexBuffer->AddRef();
+		}
+
+		for( uint32 iSampler = 0; iSampler < c_iMaxTextureSamplers; ++iSampler )
+		{
+			if( State.TextureSamplers[iSampler].pTexture )
+				State.TextureSamplers[iSampler].pTexture->AddRef();
+		}
+
+		if( State.pRenderTarget ) State.pRenderTarget->AddRef();
+
+		m_States.push_back( State );
+	}
+
+	command Command;
+	memset( &Command, 0, sizeof( command ) );
+	Command.Type = i_Type;
+	Command.iState = (uint32)m_States.size() - 1;
+	Command.iConstants[0] = iRecordConstants( State.pVertexShader, 0 );
+	Command.iConstants[1] = iRecordConstants( State.pTriangleShader, 1 );
+	Command.iConstants[2] = iRecordConstants( State.pPixelShader, 2 );
+	memcpy( Command.iParameters, i_pParameters, sizeof( uint32 ) * i_iNumParameters );
+
+	m_Commands.push_back( Command );
+}
+
+result CMuli3DCommandList::RecordClear( m3dcommandtype i_Type, CMuli3DRenderTarget *i_pRenderTarget, const vector4 &i_vValue, const m3drect *i_pRect )
+{
+	if( m_pParent->m_pRecordingCommandList != this )
+	{
+		FUNC_FAILING( "CMuli3DCommandList::RecordClear: command list is not being recorded.\n" );
+		return e_invalidstate;
+	}
+
+	if( !i_pRenderTarget )
+	{
+		FUNC_FAILING( "CMuli3DCommandList::RecordClear: parameter i_pRenderTarget points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	command Command;
+	memset( &Command, 0, sizeof( command ) );
+	Command.Type = i_Type;
+	Command.pRenderTarget = i_pRenderTarget;
+	Command.vClearValue = i_vValue;
+	if( i_pRect )
+	{
+		Command.ClearRect = *i_pRect;
+		Command.bClearRect = true;
+	}
+
+	i_pRenderTarget->AddRef();
+	m_Commands.push_back( Command );
+
+	return s_ok;
+}
+
+uint32 CMuli3DCommandList::iRecordConstants( IMuli3DBaseShader *i_pShader, uint32 i_iSlot )
+{
+	if( !i_pShader )
+		return c_iNoConstants;
+
+	// Consecutive draw-calls usually share most of their constants; compare
+	// against the last constants recorded for this slot only.
+	const m3dshaderconstants &Constants = i_pShader->GetConstants();
+	const uint32 iLast = m_iLastConstants[i_iSlot];
+	if( iLast != c_iNoConstants && memcmp( &m_Constants[iLast], &Constants, sizeof( m3dshaderconstants ) ) == 0 )
+		return iLast;
+
+	m_Constants.push_back( Constants );
+	m_iLastConstants[i_iSlot] = (uint32)m_Constants.size() - 1;
+	return m_iLastConstants[i_iSlot];
+}
+
+void CMuli3DCommandList::Execute( CMuli3DDevice *i_pDevice )
+{
+	uint32 iAppliedState = c_iNoConstants;
+	for( std::vector<command>::const_iterator pCommand = m_Commands.begin(); pCommand != m_Commands.end(); ++pCommand )
+	{
+		switch( pCommand->Type )
+		{
+		case m3dcmd_clearcolorbuffer:
+			pCommand->pRenderTarget->ClearColorBuffer( pCommand->vClearValue, pCommand->bClearRect ? &pCommand->ClearRect : 0 );
+			break;
+
+		case m3dcmd_cleardepthbuffer:
+			pCommand->pRenderTarget->ClearDepthBuffer( pCommand->vClearValue.x, pCommand->bClearRect ? &pCommand->ClearRect : 0 );
+			break;
+
+		default:
+			{
+				const CMuli3DDevice::devicestate &State = m_States[pCommand->iState];
+				if( pCommand->iState != iAppliedState )
+				{
+					i_pDevice->ApplyState( State );
+					iAppliedState = pCommand->iState;
+				}
+
+				IMuli3DBaseShader *pShaders[3] = { State.pVertexShader, State.pTriangleShader, State.pPixelShader };
+				for( uint32 iSlot = 0; iSlot < 3; ++iSlot )
+				{
+					if( pShaders[iSlot] )
+						pShaders[iSlot]->SetActiveConstants( &m_Constants[pCommand->iConstants[iSlot]] );
+				}
+
+				const uint32 *pParameters = pCommand->iParameters;
+				switch( pCommand->Type )
+				{
+				case m3dcmd_drawprimitive:
+					i_pDevice->DrawPrimitive( (m3dprimitivetype)pParameters[0], pParameters[1], pParameters[2] );
+					break;
+
+				case m3dcmd_drawindexedprimitive:
+					i_pDevice->DrawIndexedPrimitive( (m3dprimitivetype)pParameters[0], (int32)pParameters[1], pParameters[2],
+						pParameters[3], pParameters[4], pParameters[5] );
+					break;
+
+				case m3dcmd_drawdynamicprimitive:
+					i_pDevice->DrawDynamicPrimitive( pParameters[0], pParameters[1] );
+					break;
+
+				default: break;
+				}
+
+				for( uint32 iSlot = 0; iSlot < 3; ++iSlot )
+				{
+					if( pShaders[iSlot] )
+						pShaders[iSlot]->SetActiveConstants( 0 );
+				}
+			}
+			break;
+		}
+	}
+}
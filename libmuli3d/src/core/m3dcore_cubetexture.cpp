@@ -20,6 +20,8 @@
 #include "../../include/core/m3dcore_cubetexture.h"
 #include "../../include/core/m3dcore_texture.h"
 #include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_pixelformat.h"
+#include "../../include/core/m3dcore_threadpool.h"
 
 CMuli3DCubeTexture::CMuli3DCubeTexture( CMuli3DDevice *i_pParent )
 	: IMuli3DBaseTexture( i_pParent )
@@ -28,7 +30,7 @@ CMuli3DCubeTexture::CMuli3DCubeTexture( CMuli3DDevice *i_pParent )
 		m_ppCubeFaces[iFace] = 0;
 }
 
-result CMuli3DCubeTexture::Create( uint32 i_iEdgeLength, uint32 i_iMipLevels, m3dformat i_fmtFormat )
+result CMuli3DCubeTexture::Create( uint32 i_iEdgeLength, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout )
 {
 	if( !i_iEdgeLength )
 	{
@@ -36,7 +38,7 @@ result CMuli3DCubeTexture::Create( uint32 i_iEdgeLength, uint32 i_iMipLevels, m3
 		return e_invalidparameters;
 	}
 	
-	if( i_fmtFormat < m3dfmt_r32f || i_fmtFormat > m3dfmt_r32g32b32a32f )
+	if( !bIsTextureFormat( i_fmtFormat ) && !bIsBlockFormat( i_fmtFormat ) )
 	{
 		FUNC_FAILING( "CMuli3DCubeTexture::Create: invalid format specified.\n" );
 		return e_invalidparameters;
@@ -45,7 +47,7 @@ result CMuli3DCubeTexture::Create( uint32 i_iEdgeLength, uint32 i_iMipLevels, m3
 	result resCreate;
 	for( uint32 iFace = m3dcf_positive_x; iFace <= m3dcf_negative_z; ++iFace )
 	{
-		resCreate = m_pParent->CreateTexture( &m_ppCubeFaces[iFace], i_iEdgeLength, i_iEdgeLength, i_iMipLevels, i_fmtFormat );
+		resCreate = m_pParent->CreateTexture( &m_ppCubeFaces[iFace], i_iEdgeLength, i_iEdgeLength, i_iMipLevels, i_fmtFormat, i_Layout );
 		if( FUNC_FAILED( resCreate ) )
 			return resCreate;
 	}
@@ -66,15 +68,45 @@ m3dtexsampleinput CMuli3DCubeTexture::eGetTexSampleInput()
 
 result CMuli3DCubeTexture::GenerateMipSubLevels( uint32 i_iSrcLevel )
 {
+	if( bIsBlockFormat( fmtGetFormat() ) )
+	{
+		FUNC_FAILING( "CMuli3DCubeTexture::GenerateMipSubLevels: cannot generate mip-levels of a block-compressed texture.\n" );
+		return e_invalidformat;
+	}
+
+	CMuli3DThreadPool *pThreads = m_pParent->pAcquireMipThreads();
+	if( !pThreads )
+	{
+		for( uint32 iFace = m3dcf_positive_x; iFace <= m3dcf_negative_z; ++iFace )
+		{
+			result resFace = m_ppCubeFaces[iFace]->GenerateMipChain( i_iSrcLevel, 0 );
+			if( resFace != s_ok )
+				return resFace;
+		}
+		return s_ok;
+	}
+
+	// Each thread generates the mip-levels of a whole cube face.
+	mipfacejob Job;
+	Job.pTexture = this;
+	Job.iSrcLevel = i_iSrcLevel;
+	pThreads->Execute( GenerateFaceMipsJob, &Job, 6 );
+	m_pParent->ReleaseMipThreads( pThreads );
+
 	for( uint32 iFace = m3dcf_positive_x; iFace <= m3dcf_negative_z; ++iFace )
 	{
-		result resFace = m_ppCubeFaces[iFace]->GenerateMipSubLevels( i_iSrcLevel );
-		if( resFace != s_ok )
-			return resFace;
+		if( Job.resFaces[iFace] != s_ok )
+			return Job.resFaces[iFace];
 	}
 	return s_ok;
 }
 
+void CMuli3DCubeTexture::GenerateFaceMipsJob( void *i_pGeneration, uint32 i_iJob, uint32 i_iThread )
+{
+	mipfacejob *pJob = (mipfacejob *)i_pGeneration;
+	pJob->resFaces[i_iJob] = pJob->pTexture->m_ppCubeFaces[i_iJob]->GenerateMipChain( pJob->iSrcLevel, 0 );
+}
+
 result CMuli3DCubeTexture::LockRect( m3dcubefaces i_Face, uint32 i_iMipLevel, void **o_ppData, const m3drect *i_pRect )
 {
 	if( i_Face < 0 || i_Face >= 6 )
@@ -20,6 +20,7 @@
 #include "../../include/core/m3dcore_device.h"
 #include "../../include/core/m3dcore.h"
 #include "../../include/core/m3dcore_basetexture.h"
+#include "../../include/core/m3dcore_commandlist.h"
 #include "../../include/core/m3dcore_cubetexture.h"
 #include "../../include/core/m3dcore_indexbuffer.h"
 #include "../../include/core/m3dcore_presenttarget.h"
@@ -27,16 +28,28 @@
 #include "../../include/core/m3dcore_shaders.h"
 #include "../../include/core/m3dcore_surface.h"
 #include "../../include/core/m3dcore_texture.h"
+#include "../../include/core/m3dcore_threadpool.h"
 #include "../../include/core/m3dcore_primitiveassembler.h"
 #include "../../include/core/m3dcore_vertexbuffer.h"
 #include "../../include/core/m3dcore_vertexformat.h"
 #include "../../include/core/m3dcore_volume.h"
 #include "../../include/core/m3dcore_volumetexture.h"
+#include "../../include/core/m3dcore_virtualtexture.h"
+#include <limits.h>
+
+const uint32 c_iSubPixelBits = 4; ///< Number of sub-pixel bits of vertex positions used by the half-space rasterizer.
+const uint32 c_iHalfSpaceBlockSize = c_iHiZBlockSize; ///< Edge length of the pixel blocks traversed by the half-space rasterizer; has to be a power of two and a multiple of 2. Matches the hierarchical depth buffer, so that its blocks can be tested one by one.
+const float32 c_fHiZEpsilon = 1.0f / 1024.0f; ///< Tolerance used when comparing depth ranges with blocks of the hierarchical depth buffer; covers rounding differences of interpolated depth-values.
+const uint32 c_iMaxBinnedTriangles = 4096; ///< Binned triangles are rasterized whenever this amount has been reached, which limits memory consumption of tile-binned rasterization.
+const uint32 c_iColorLayoutR8G8B8A8 = 5; ///< Colorbuffer-layout of m3dfmt_r8g8b8a8; layouts 1 to 4 denote the 32-bit float formats with as many channels.
+const uint32 c_iColorLayoutR5G6B5 = 6; ///< Colorbuffer-layout of m3dfmt_r5g6b5.
 
 CMuli3DDevice::CMuli3DDevice( CMuli3D *i_pParent, const m3ddeviceparameters *i_pDeviceParameters )
 	: m_pParent( i_pParent ), m_pPresentTarget( 0 ), m_pVertexFormat( 0 ), m_pPrimitiveAssembler( 0 ),
 	  m_pVertexShader( 0 ), m_pTriangleShader( 0 ), m_pPixelShader( 0 ), m_pIndexBuffer( 0 ),
-	  m_pRenderTarget( 0 )
+	  m_pRenderTarget( 0 ), m_pThreadPool( 0 ), m_iNumTilesX( 0 ), m_iNumTilesY( 0 ),
+	  m_iNumBinnedTriangles( 0 ), m_pMipThreads( 0 ), m_iMipThreadsUsers( 0 ), m_pRecordingCommandList( 0 ), m_pRenderThread( 0 ),
+	  m_pExecutionDevice( 0 ), m_iLastCommandList( 0 )
 {
 	m_pParent->AddRef();
 
@@ -46,9 +59,15 @@ CMuli3DDevice::CMuli3DDevice( CMuli3D *i_pParent, const m3ddeviceparameters *i_p
 	memset( m_TextureSamplers, 0, sizeof( m_TextureSamplers ) );
 	memset( &m_ScissorRect, 0, sizeof( m_ScissorRect ) );
 	memset( &m_RenderInfo, 0, sizeof( m_RenderInfo ) );
-	memset( &m_TriangleInfo, 0, sizeof( m_TriangleInfo ) );
 
-	memset( &m_VertexCache, 0, sizeof( m_VertexCache ) );
+	m_RasterContexts.resize( 1 );
+	memset( &m_RasterContexts[0], 0, sizeof( rastercontext ) );
+
+	m_iFetchedVertices = 1; // fetch-time 0 marks unused cache entries
+	m_iFirstFetchTime = 1;
+	m_iVertexCacheSetMask = 0;
+	m_iVertexCacheHits = 0;
+	m_iVertexCacheMisses = 0;
 
 	memset( &m_ClipVertices, 0, sizeof( m_ClipVertices ) );
 	memset( &m_pClipVertices, 0, sizeof( m_pClipVertices ) );
@@ -60,6 +79,14 @@ CMuli3DDevice::CMuli3DDevice( CMuli3D *i_pParent, const m3ddeviceparameters *i_p
 
 CMuli3DDevice::~CMuli3DDevice()
 {
+	// Submitted command lists hold a reference to the device; pending
+	// asynchronous presents are finished before the present-target goes away.
+	SAFE_DELETE( m_pRenderThread );
+	SAFE_RELEASE( m_pExecutionDevice );
+
+	SAFE_DELETE( m_pThreadPool );
+	SAFE_DELETE( m_pMipThreads );
+
 	SAFE_RELEASE( m_pPresentTarget );
 
 	SAFE_RELEASE( m_pParent );
@@ -68,19 +95,35 @@ CMuli3DDevice::~CMuli3DDevice()
 result CMuli3DDevice::Create()
 {
 	// Create the present-target ----------------------------------------------
+	switch( m_DeviceParameters.PresentTarget )
+	{
+	case m3dptt_window:
+		// NOTE: add support for other platforms here
+		#ifdef WIN32
+		m_pPresentTarget = new CMuli3DPresentTargetWin32( this );
+		#endif
+
+		#ifdef LINUX_X11
+		m_pPresentTarget = new CMuli3DPresentTargetLinuxX11( this );
+		#endif
+
+		#ifdef __amigaos4__
+		m_pPresentTarget = new CMuli3DPresentTargetAmigaOS4( this );
+		#endif
+
+		#ifdef LINUX_HEADLESS
+		FUNC_FAILING( "CMuli3DDevice::Create: presenting to a window is not supported without X11 - use an offscreen present-target.\n" );
+		return e_invalidparameters;
+		#endif
+		break;
 
-	// NOTE: add support for other platforms here
-	#ifdef WIN32
-	m_pPresentTarget = new CMuli3DPresentTargetWin32( this );
-	#endif
-	
-	#ifdef LINUX_X11
-	m_pPresentTarget = new CMuli3DPresentTargetLinuxX11( this );
-	#endif
+	case m3dptt_framequeue: m_pPresentTarget = new CMuli3DPresentTargetFrameQueue( this ); break;
+	case m3dptt_ppmfiles: m_pPresentTarget = new CMuli3DPresentTargetPPMFiles( this ); break;
 
-	#ifdef __amigaos4__
-	m_pPresentTarget = new CMuli3DPresentTargetAmigaOS4( this );
-	#endif
+	default:
+		FUNC_FAILING( "CMuli3DDevice::Create: invalid present-target type.\n" );
+		return e_invalidparameters;
+	}
 
 	if( !m_pPresentTarget )
 	{
@@ -113,6 +156,11 @@ void CMuli3DDevice::SetDefaultRenderStates()
 	SetRenderState( m3drs_scissortestenable, false );
 
 	SetRenderState( m3drs_linethickness, 1 );
+
+	SetRenderState( m3drs_rasterizerthreads, 1 );
+	SetRenderState( m3drs_rasterizer, m3drast_scanline );
+
+	SetRenderState( m3drs_vertexcachesize, 32 );
 }
 
 void CMuli3DDevice::SetDefaultTextureSamplerStates()
@@ -480,6 +528,82 @@ result CMuli3DDevice::SampleTexture( vector4 &o_vColor, uint32 i_iSamplerNumber,
 		i_pXGradient, i_pYGradient, TextureSampler.iTextureSamplerStates );
 }
 
+result CMuli3DDevice::SampleTextureQuad( vector4 *o_pColors, uint32 i_iSamplerNumber, const vector4 *i_pCoords, const vector4 *i_pXGradient, const vector4 *i_pYGradient )
+{
+	if( i_iSamplerNumber >= c_iMaxTextureSamplers )
+	{
+		o_pColors[0] = o_pColors[1] = o_pColors[2] = o_pColors[3] = vector4( 0, 0, 0, 0 );
+		FUNC_FAILING( "CMuli3DDevice::SampleTextureQuad: i_iSamplerNumber exceeds number of available texture samplers.\n" );
+		return e_invalidparameters;
+	}
+
+	const texturesampler &TextureSampler = m_TextureSamplers[i_iSamplerNumber];
+
+	IMuli3DBaseTexture *pTexture = TextureSampler.pTexture;
+	if( !pTexture )
+	{
+		o_pColors[0] = o_pColors[1] = o_pColors[2] = o_pColors[3] = vector4( 0, 0, 0, 0 );
+		return s_ok;
+	}
+
+	// Look up the addressing modes once; m3dta_wrap takes the fractional part
+	// of a coordinate before it is clamped like with m3dta_clamp.
+	const uint32 iAddressU = TextureSampler.iTextureSamplerStates[m3dtss_addressu];
+	const uint32 iAddressV = TextureSampler.iTextureSamplerStates[m3dtss_addressv];
+	const uint32 iAddressW = TextureSampler.iTextureSamplerStates[m3dtss_addressw];
+
+	vector4 vCoords[4];
+	switch( TextureSampler.TextureSampleInput )
+	{
+	case m3dtsi_vector:
+		for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		{
+			const vector4 &vCoord = i_pCoords[iPixel];
+			if( vCoord.x == 0.0f && vCoord.y == 0.0f && vCoord.z == 0.0f )
+			{
+				o_pColors[0] = o_pColors[1] = o_pColors[2] = o_pColors[3] = vector4( 0, 0, 0, 0 );
+				FUNC_FAILING( "CMuli3DDevice::SampleTextureQuad: sampling vector [u,v,w] = [0,0,0].\n" );
+				return e_invalidparameters;
+			}
+			vCoords[iPixel] = vCoord;
+		}
+		break;
+
+	case m3dtsi_3coords:
+	case m3dtsi_2coords:
+		if( ( iAddressU != m3dta_wrap && iAddressU != m3dta_clamp ) ||
+			( iAddressV != m3dta_wrap && iAddressV != m3dta_clamp ) ||
+			( TextureSampler.TextureSampleInput == m3dtsi_3coords && iAddressW != m3dta_wrap && iAddressW != m3dta_clamp ) )
+		{
+			o_pColors[0] = o_pColors[1] = o_pColors[2] = o_pColors[3] = vector4( 0, 0, 0, 0 );
+			FUNC_FAILING( "CMuli3DDevice::SampleTextureQuad: value of texture sampler state m3dtss_addressu, m3dtss_addressv or m3dtss_addressw is invalid.\n" );
+			return e_invalidstate;
+		}
+
+		for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		{
+			float32 fU = i_pCoords[iPixel].x, fV = i_pCoords[iPixel].y, fW = i_pCoords[iPixel].z;
+			if( iAddressU == m3dta_wrap ) fU -= ftol( fU );
+			if( iAddressV == m3dta_wrap ) fV -= ftol( fV );
+			if( TextureSampler.TextureSampleInput == m3dtsi_3coords )
+			{
+				if( iAddressW == m3dta_wrap ) fW -= ftol( fW );
+				fW = fSaturate( fW );
+			}
+			vCoords[iPixel] = vector4( fSaturate( fU ), fSaturate( fV ), fW, 0 );
+		}
+		break;
+
+	default:
+		o_pColors[0] = o_pColors[1] = o_pColors[2] = o_pColors[3] = vector4( 0, 0, 0, 0 );
+		FUNC_FAILING( "CMuli3DDevice::SampleTextureQuad: invalid texture-sampling input!\n" );
+		return e_invalidstate;
+	}
+
+	return pTexture->SampleTextureQuad( o_pColors, vCoords,
+		i_pXGradient, i_pYGradient, TextureSampler.iTextureSamplerStates );
+}
+
 void CMuli3DDevice::SetRenderTarget( CMuli3DRenderTarget *i_pRenderTarget )
 {
 	m_pRenderTarget = i_pRenderTarget;
@@ -572,6 +696,16 @@ uint32 CMuli3DDevice::iGetRenderedPixels()
 	return m_RenderInfo.iRenderedPixels;
 }
 
+uint32 CMuli3DDevice::iGetVertexCacheHits()
+{
+	return m_iVertexCacheHits;
+}
+
+uint32 CMuli3DDevice::iGetVertexCacheMisses()
+{
+	return m_iVertexCacheMisses;
+}
+
 result CMuli3DDevice::CreateVertexFormat( CMuli3DVertexFormat **o_ppVertexFormat, const m3dvertexelement *i_pVertexDeclaration, uint32 i_iVertexDeclSize )
 {
 	if( !o_ppVertexFormat )
@@ -622,6 +756,31 @@ result CMuli3DDevice::CreateIndexBuffer( CMuli3DIndexBuffer **o_ppIndexBuffer, u
 	return s_ok;
 }
 
+result CMuli3DDevice::CreateIndexBufferFromMemory( CMuli3DIndexBuffer **o_ppIndexBuffer, uint32 i_iLength, m3dformat i_fmtFormat, const void *i_pData, IBase *i_pDataOwner )
+{
+	if( !o_ppIndexBuffer || !i_pData )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateIndexBufferFromMemory: parameter o_ppIndexBuffer or i_pData points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppIndexBuffer = new CMuli3DIndexBuffer( this );
+	if( !(*o_ppIndexBuffer) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateIndexBufferFromMemory: out of memory, cannot create indexbuffer.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = (*o_ppIndexBuffer)->Create( i_iLength, i_fmtFormat, i_pData, i_pDataOwner );
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_RELEASE( *o_ppIndexBuffer );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
 result CMuli3DDevice::CreateVertexBuffer( CMuli3DVertexBuffer **o_ppVertexBuffer, uint32 i_iLength )
 {
 	if( !o_ppVertexBuffer )
@@ -647,7 +806,37 @@ result CMuli3DDevice::CreateVertexBuffer( CMuli3DVertexBuffer **o_ppVertexBuffer
 	return s_ok;
 }
 
-result CMuli3DDevice::CreateSurface( CMuli3DSurface **o_ppSurface, uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat )
+result CMuli3DDevice::CreateVertexBufferFromMemory( CMuli3DVertexBuffer **o_ppVertexBuffer, uint32 i_iLength, const void *i_pData, IBase *i_pDataOwner )
+{
+	if( !o_ppVertexBuffer || !i_pData )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateVertexBufferFromMemory: parameter o_ppVertexBuffer or i_pData points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppVertexBuffer = new CMuli3DVertexBuffer( this );
+	if( !(*o_ppVertexBuffer) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateVertexBufferFromMemory: out of memory, cannot create vertexbuffer.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = (*o_ppVertexBuffer)->Create( i_iLength, i_pData, i_pDataOwner );
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_RELEASE( *o_ppVertexBuffer );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
+result CMuli3DDevice::CreateSurface( CMuli3DSurface **o_ppSurface, uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat, m3dtexturelayout i_Layout )
+{
+	return CreateSurfaceInMemory( o_ppSurface, i_iWidth, i_iHeight, i_fmtFormat, i_Layout, 0 );
+}
+
+result CMuli3DDevice::CreateSurfaceInMemory( CMuli3DSurface **o_ppSurface, uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat, m3dtexturelayout i_Layout, byte *i_pData )
 {
 	if( !o_ppSurface )
 	{
@@ -662,7 +851,7 @@ result CMuli3DDevice::CreateSurface( CMuli3DSurface **o_ppSurface, uint32 i_iWid
 		return e_outofmemory;
 	}
 
-	result resCreate = (*o_ppSurface)->Create( i_iWidth, i_iHeight, i_fmtFormat );
+	result resCreate = (*o_ppSurface)->Create( i_iWidth, i_iHeight, i_fmtFormat, i_Layout, i_pData );
 	if( FUNC_FAILED( resCreate ) )
 	{
 		SAFE_RELEASE( *o_ppSurface );
@@ -672,7 +861,7 @@ result CMuli3DDevice::CreateSurface( CMuli3DSurface **o_ppSurface, uint32 i_iWid
 	return s_ok;
 }
 
-result CMuli3DDevice::CreateTexture( CMuli3DTexture **o_ppTexture, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat )
+result CMuli3DDevice::CreateTexture( CMuli3DTexture **o_ppTexture, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout )
 {
 	if( !o_ppTexture )
 	{
@@ -687,7 +876,32 @@ result CMuli3DDevice::CreateTexture( CMuli3DTexture **o_ppTexture, uint32 i_iWid
 		return e_outofmemory;
 	}
 
-	result resCreate = (*o_ppTexture)->Create( i_iWidth, i_iHeight, i_iMipLevels, i_fmtFormat );
+	result resCreate = (*o_ppTexture)->Create( i_iWidth, i_iHeight, i_iMipLevels, i_fmtFormat, i_Layout );
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_RELEASE( *o_ppTexture );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
+result CMuli3DDevice::CreateTextureFromMemory( CMuli3DTexture **o_ppTexture, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout, void *i_pData, uint32 i_iDataSize, IBase *i_pDataOwner )
+{
+	if( !o_ppTexture || !i_pData )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateTextureFromMemory: parameter o_ppTexture or i_pData points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppTexture = new CMuli3DTexture( this );
+	if( !(*o_ppTexture) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateTextureFromMemory: out of memory, cannot create texture.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = (*o_ppTexture)->Create( i_iWidth, i_iHeight, i_iMipLevels, i_fmtFormat, i_Layout, (byte *)i_pData, i_iDataSize, i_pDataOwner );
 	if( FUNC_FAILED( resCreate ) )
 	{
 		SAFE_RELEASE( *o_ppTexture );
@@ -697,7 +911,7 @@ result CMuli3DDevice::CreateTexture( CMuli3DTexture **o_ppTexture, uint32 i_iWid
 	return s_ok;
 }
 
-result CMuli3DDevice::CreateCubeTexture( CMuli3DCubeTexture **o_ppCubeTexture, uint32 i_iEdgeLength, uint32 i_iMipLevels, m3dformat i_fmtFormat )
+result CMuli3DDevice::CreateCubeTexture( CMuli3DCubeTexture **o_ppCubeTexture, uint32 i_iEdgeLength, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout )
 {
 	if( !o_ppCubeTexture )
 	{
@@ -712,7 +926,7 @@ result CMuli3DDevice::CreateCubeTexture( CMuli3DCubeTexture **o_ppCubeTexture, u
 		return e_outofmemory;
 	}
 
-	result resCreate = (*o_ppCubeTexture)->Create( i_iEdgeLength, i_iMipLevels, i_fmtFormat );
+	result resCreate = (*o_ppCubeTexture)->Create( i_iEdgeLength, i_iMipLevels, i_fmtFormat, i_Layout );
 	if( FUNC_FAILED( resCreate ) )
 	{
 		SAFE_RELEASE( *o_ppCubeTexture );
@@ -722,7 +936,7 @@ result CMuli3DDevice::CreateCubeTexture( CMuli3DCubeTexture **o_ppCubeTexture, u
 	return s_ok;
 }
 
-result CMuli3DDevice::CreateVolume( CMuli3DVolume **o_ppSurface, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, m3dformat i_fmtFormat )
+result CMuli3DDevice::CreateVolume( CMuli3DVolume **o_ppSurface, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, m3dformat i_fmtFormat, m3dtexturelayout i_Layout )
 {
 	if( !o_ppSurface )
 	{
@@ -737,7 +951,7 @@ result CMuli3DDevice::CreateVolume( CMuli3DVolume **o_ppSurface, uint32 i_iWidth
 		return e_outofmemory;
 	}
 
-	result resCreate = (*o_ppSurface)->Create( i_iWidth, i_iHeight, i_iDepth, i_fmtFormat );
+	result resCreate = (*o_ppSurface)->Create( i_iWidth, i_iHeight, i_iDepth, i_fmtFormat, i_Layout );
 	if( FUNC_FAILED( resCreate ) )
 	{
 		SAFE_RELEASE( *o_ppSurface );
@@ -747,7 +961,7 @@ result CMuli3DDevice::CreateVolume( CMuli3DVolume **o_ppSurface, uint32 i_iWidth
 	return s_ok;
 }
 
-result CMuli3DDevice::CreateVolumeTexture( CMuli3DVolumeTexture **o_ppVolumeTexture, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, uint32 i_iMipLevels, m3dformat i_fmtFormat )
+result CMuli3DDevice::CreateVolumeTexture( CMuli3DVolumeTexture **o_ppVolumeTexture, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout )
 {
 	if( !o_ppVolumeTexture )
 	{
@@ -762,7 +976,7 @@ result CMuli3DDevice::CreateVolumeTexture( CMuli3DVolumeTexture **o_ppVolumeText
 		return e_outofmemory;
 	}
 
-	result resCreate = (*o_ppVolumeTexture)->Create( i_iWidth, i_iHeight, i_iDepth, i_iMipLevels, i_fmtFormat );
+	result resCreate = (*o_ppVolumeTexture)->Create( i_iWidth, i_iHeight, i_iDepth, i_iMipLevels, i_fmtFormat, i_Layout );
 	if( FUNC_FAILED( resCreate ) )
 	{
 		SAFE_RELEASE( *o_ppVolumeTexture );
@@ -772,6 +986,63 @@ result CMuli3DDevice::CreateVolumeTexture( CMuli3DVolumeTexture **o_ppVolumeText
 	return s_ok;
 }
 
+result CMuli3DDevice::CreateVirtualTexture( CMuli3DVirtualTexture **o_ppVirtualTexture, uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat, uint32 i_iResidentPages, IMuli3DPageSource *i_pPageSource )
+{
+	if( !o_ppVirtualTexture )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateVirtualTexture: parameter o_ppVirtualTexture points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppVirtualTexture = new CMuli3DVirtualTexture( this );
+	if( !(*o_ppVirtualTexture) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateVirtualTexture: out of memory, cannot create virtual texture.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = (*o_ppVirtualTexture)->Create( i_iWidth, i_iHeight, i_iMipLevels, i_fmtFormat, i_iResidentPages, i_pPageSource );
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_RELEASE( *o_ppVirtualTexture );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
+CMuli3DThreadPool *CMuli3DDevice::pAcquireMipThreads()
+{
+	const uint32 iThreads = m_DeviceParameters.iMipThreads < c_iMaxRasterizerThreads ? m_DeviceParameters.iMipThreads : c_iMaxRasterizerThreads;
+	if( iThreads <= 1 )
+		return 0;
+
+	if( iAtomicIncrement( &m_iMipThreadsUsers ) != 1 )
+	{
+		// Another thread is generating mip-levels.
+		iAtomicDecrement( &m_iMipThreadsUsers );
+		return 0;
+	}
+
+	if( !m_pMipThreads )
+	{
+		m_pMipThreads = new CMuli3DThreadPool;
+		if( m_pMipThreads && FUNC_FAILED( m_pMipThreads->Create( iThreads ) ) )
+			SAFE_DELETE( m_pMipThreads );
+	}
+
+	if( !m_pMipThreads )
+		iAtomicDecrement( &m_iMipThreadsUsers );
+
+	return m_pMipThreads;
+}
+
+void CMuli3DDevice::ReleaseMipThreads( CMuli3DThreadPool *i_pThreads )
+{
+	if( i_pThreads )
+		iAtomicDecrement( &m_iMipThreadsUsers );
+}
+
 result CMuli3DDevice::CreateRenderTarget( CMuli3DRenderTarget **o_ppRenderTarget )
 {
 	if( !o_ppRenderTarget )
@@ -790,6 +1061,24 @@ result CMuli3DDevice::CreateRenderTarget( CMuli3DRenderTarget **o_ppRenderTarget
 	return s_ok;
 }
 
+result CMuli3DDevice::CreateCommandList( CMuli3DCommandList **o_ppCommandList )
+{
+	if( !o_ppCommandList )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateCommandList: parameter o_ppCommandList points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	*o_ppCommandList = new CMuli3DCommandList( this );
+	if( !(*o_ppCommandList) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateCommandList: out of memory, cannot create command list.\n" );
+		return e_outofmemory;
+	}
+
+	return s_ok;
+}
+
 CMuli3D *CMuli3DDevice::pGetMuli3D()
 {
 	if( m_pParent )
@@ -803,6 +1092,86 @@ const m3ddeviceparameters &CMuli3DDevice::GetDeviceParameters()
 }
 
 result CMuli3DDevice::Present( CMuli3DRenderTarget *i_pRenderTarget )
+{
+	// Command lists may still render to the colorbuffer, asynchronous presents
+	// use the present-target ...
+	if( m_pRenderThread )
+		m_pRenderThread->WaitIdle();
+
+	CMuli3DSurface *pColorBuffer;
+	const void *pSource;
+	m3dformat fmtSource;
+	result resLock = LockPresentSource( i_pRenderTarget, &pColorBuffer, &pSource, fmtSource );
+	if( FUNC_FAILED( resLock ) )
+		return resLock;
+
+	result resPresent = m_pPresentTarget->Present( pSource, fmtSource );
+
+	pColorBuffer->UnlockRect();
+
+	SAFE_RELEASE( pColorBuffer );
+
+	return resPresent;
+}
+
+result CMuli3DDevice::PresentAsync( CMuli3DRenderTarget *i_pRenderTarget, uint32 *o_pFence )
+{
+	result resThread = CreateRenderThread();
+	if( FUNC_FAILED( resThread ) )
+		return resThread;
+
+	// The colorbuffer stays locked until the render thread has presented it,
+	// so that accessing it before waiting for the fence fails.
+	presentjob *pPresent = new presentjob;
+	if( !pPresent )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PresentAsync: out of memory, cannot create present job.\n" );
+		return e_outofmemory;
+	}
+
+	result resLock = LockPresentSource( i_pRenderTarget, &pPresent->pColorBuffer, &pPresent->pSource, pPresent->fmtSource );
+	if( FUNC_FAILED( resLock ) )
+	{
+		SAFE_DELETE( pPresent );
+		return resLock;
+	}
+
+	pPresent->pDevice = this;
+
+	const uint32 iFence = m_pRenderThread->iSubmit( PresentJob, pPresent );
+	if( o_pFence )
+		*o_pFence = iFence;
+
+	return s_ok;
+}
+
+result CMuli3DDevice::ReadPresentedFrame( byte *o_pPixels )
+{
+	if( m_DeviceParameters.PresentTarget != m3dptt_framequeue || !m_pPresentTarget )
+	{
+		FUNC_FAILING( "CMuli3DDevice::ReadPresentedFrame: device doesn't present to a frame queue.\n" );
+		return e_invalidstate;
+	}
+
+	if( m_pRenderThread )
+		m_pRenderThread->WaitIdle(); // the render thread may be appending a frame
+
+	return ( (CMuli3DPresentTargetFrameQueue *)m_pPresentTarget )->ReadFrame( o_pPixels );
+}
+
+uint32 CMuli3DDevice::iGetNumPresentedFrames()
+{
+	if( m_DeviceParameters.PresentTarget != m3dptt_framequeue || !m_pPresentTarget )
+		return 0;
+
+	if( m_pRenderThread )
+		m_pRenderThread->WaitIdle();
+
+	return ( (CMuli3DPresentTargetFrameQueue *)m_pPresentTarget )->iGetNumFrames();
+}
+
+result CMuli3DDevice::LockPresentSource( CMuli3DRenderTarget *i_pRenderTarget, CMuli3DSurface **o_ppColorBuffer,
+	const void **o_ppSource, m3dformat &o_fmtSource )
 {
 	if( !i_pRenderTarget )
 	{
@@ -826,88 +1195,268 @@ result CMuli3DDevice::Present( CMuli3DRenderTarget *i_pRenderTarget )
 		return e_invalidstate;
 	}
 
-	const uint32 iFloats = pColorBuffer->iGetFormatFloats();
-	if( iFloats < 3 )
+	o_fmtSource = pColorBuffer->fmtGetFormat();
+	if( o_fmtSource != m3dfmt_r32g32b32f && o_fmtSource != m3dfmt_r32g32b32a32f && o_fmtSource != m3dfmt_r8g8b8a8 && o_fmtSource != m3dfmt_r5g6b5 )
 	{
 		SAFE_RELEASE( pColorBuffer );
-		FUNC_FAILING( "CMuli3DDevice::Present: invalid colorbuffer format - only m3dfmt_r32g32b32f and m3dfmt_r32g32b32a32f are supported!\n" );
+		FUNC_FAILING( "CMuli3DDevice::Present: invalid colorbuffer format - only m3dfmt_r32g32b32f, m3dfmt_r32g32b32a32f, m3dfmt_r8g8b8a8 and m3dfmt_r5g6b5 are supported!\n" );
 		return e_invalidformat;
 	}
 
-	const float32 *pSource;
-	if( FUNC_FAILED( pColorBuffer->LockRect( (void **)&pSource, 0 ) ) )
+	if( FUNC_FAILED( pColorBuffer->LockRect( (void **)o_ppSource, 0 ) ) )
 	{
 		SAFE_RELEASE( pColorBuffer );
 		FUNC_FAILING( "CMuli3DDevice::Present: couldn't access colorbuffer.\n" );
 		return e_unknown;
 	}
 
-	result resPresent = m_pPresentTarget->Present( pSource, iFloats );
-
-	pColorBuffer->UnlockRect();
+	*o_ppColorBuffer = pColorBuffer;
+	return s_ok;
+}
 
-	SAFE_RELEASE( pColorBuffer );
+void CMuli3DDevice::PresentJob( void *i_pPresent, uint32 i_iJob, uint32 i_iThread )
+{
+	presentjob *pPresent = (presentjob *)i_pPresent;
+	pPresent->pDevice->m_pPresentTarget->Present( pPresent->pSource, pPresent->fmtSource );
 
-	return resPresent;
+	pPresent->pColorBuffer->UnlockRect();
+	SAFE_RELEASE( pPresent->pColorBuffer );
+	SAFE_DELETE( pPresent );
 }
 
-result CMuli3DDevice::PreRender()
+result CMuli3DDevice::BeginCommandList( CMuli3DCommandList *i_pCommandList )
 {
-	if( !m_pVertexFormat )
+	if( !i_pCommandList || i_pCommandList->m_pParent != this )
 	{
-		FUNC_FAILING( "CMuli3DDevice::PreRender: no vertex format has been set.\n" );
-		return e_invalidstate;
+		FUNC_FAILING( "CMuli3DDevice::BeginCommandList: invalid command list.\n" );
+		return e_invalidparameters;
 	}
 
-	if( !m_pVertexShader )
+	if( m_pRecordingCommandList )
 	{
-		FUNC_FAILING( "CMuli3DDevice::PreRender: no vertex shader has been set.\n" );
+		FUNC_FAILING( "CMuli3DDevice::BeginCommandList: a command list is already being recorded.\n" );
 		return e_invalidstate;
 	}
 
-	if( !m_pPixelShader )
-	{
-		FUNC_FAILING( "CMuli3DDevice::PreRender: no pixel shader has been set.\n" );
-		return e_invalidstate;
-	}
+	if( m_pRenderThread )
+		m_pRenderThread->Wait( i_pCommandList->m_iExecution );
 
-	if( !m_pRenderTarget )
+	i_pCommandList->ReleaseCommands();
+
+	m_pRecordingCommandList = i_pCommandList;
+	m_pRecordingCommandList->AddRef();
+	return s_ok;
+}
+
+result CMuli3DDevice::EndCommandList()
+{
+	if( !m_pRecordingCommandList )
 	{
-		FUNC_FAILING( "CMuli3DDevice::PreRender: no rendertarget has been set.\n" );
+		FUNC_FAILING( "CMuli3DDevice::EndCommandList: no command list is being recorded.\n" );
 		return e_invalidstate;
 	}
 
-	const matrix44 &matViewportMatrix = m_pRenderTarget->matGetViewportMatrix();
-	m_RenderInfo.ViewportRect.iLeft = (uint32)(matViewportMatrix._41 - matViewportMatrix._11);
-	m_RenderInfo.ViewportRect.iRight = (uint32)(matViewportMatrix._41 + matViewportMatrix._11);
-	m_RenderInfo.ViewportRect.iTop = (uint32)(matViewportMatrix._42 + matViewportMatrix._22);
-	m_RenderInfo.ViewportRect.iBottom = (uint32)(matViewportMatrix._42 - matViewportMatrix._22);
+	SAFE_RELEASE( m_pRecordingCommandList );
+	return s_ok;
+}
 
-	if( m_RenderInfo.ViewportRect.iLeft >= m_RenderInfo.ViewportRect.iRight ||
-		m_RenderInfo.ViewportRect.iTop >= m_RenderInfo.ViewportRect.iBottom )
+result CMuli3DDevice::ExecuteCommandList( CMuli3DCommandList *i_pCommandList, uint32 *o_pFence )
+{
+	if( !i_pCommandList || i_pCommandList->m_pParent != this )
 	{
-		FUNC_FAILING( "CMuli3DDevice::PreRender: invalid viewport matrix.\n" );
-		return e_invalidstate;
+		FUNC_FAILING( "CMuli3DDevice::ExecuteCommandList: invalid command list.\n" );
+		return e_invalidparameters;
 	}
 
-	CMuli3DSurface *pColorBuffer = m_pRenderTarget->pGetColorBuffer();
-	CMuli3DSurface *pDepthBuffer = m_pRenderTarget->pGetDepthBuffer();
-	if( !pColorBuffer && !pDepthBuffer )
+	if( i_pCommandList == m_pRecordingCommandList )
 	{
-		FUNC_FAILING( "CMuli3DDevice::PreRender: rendertarget has no associated frame- and depthbuffer.\n" );
+		FUNC_FAILING( "CMuli3DDevice::ExecuteCommandList: command list is being recorded.\n" );
 		return e_invalidstate;
 	}
 
-	if( pColorBuffer && ( pColorBuffer->iGetWidth() < m_RenderInfo.ViewportRect.iRight ||
-		pColorBuffer->iGetHeight() < m_RenderInfo.ViewportRect.iBottom ) )
+	// Create the render thread and its device on first use -------------------
+	if( !m_pExecutionDevice )
 	{
-		FUNC_FAILING( "CMuli3DDevice::PreRender: colorbuffer's dimensions are smaller than set viewport.\n" );
-		SAFE_RELEASE( pColorBuffer );
-		SAFE_RELEASE( pDepthBuffer );
-		return e_invalidstate;
+		m_pExecutionDevice = new CMuli3DDevice( m_pParent, &m_DeviceParameters );
+		if( !m_pExecutionDevice )
+		{
+			FUNC_FAILING( "CMuli3DDevice::ExecuteCommandList: out of memory, cannot create execution device.\n" );
+			return e_outofmemory;
+		}
 	}
 
-	if( pDepthBuffer && ( pDepthBuffer->iGetWidth() < m_RenderInfo.ViewportRect.iRight ||
+	result resThread = CreateRenderThread();
+	if( FUNC_FAILED( resThread ) )
+		return resThread;
+
+	i_pCommandList->AddRef(); // released by the job
+	i_pCommandList->m_iExecution = m_pRenderThread->iSubmit( ExecuteCommandListJob, i_pCommandList );
+	m_iLastCommandList = i_pCommandList->m_iExecution;
+	if( o_pFence )
+		*o_pFence = m_iLastCommandList;
+
+	return s_ok;
+}
+
+void CMuli3DDevice::WaitForCommandLists()
+{
+	// Asynchronous presents submitted later don't need to be waited for.
+	if( m_pRenderThread )
+		m_pRenderThread->Wait( m_iLastCommandList );
+}
+
+bool CMuli3DDevice::bIsFenceComplete( uint32 i_iFence )
+{
+	if( !m_pRenderThread )
+		return true;
+
+	return m_pRenderThread->bIsComplete( i_iFence );
+}
+
+void CMuli3DDevice::WaitForFence( uint32 i_iFence )
+{
+	if( m_pRenderThread )
+		m_pRenderThread->Wait( i_iFence );
+}
+
+result CMuli3DDevice::CreateRenderThread()
+{
+	if( m_pRenderThread )
+		return s_ok;
+
+	m_pRenderThread = new CMuli3DWorkQueue;
+	if( !m_pRenderThread )
+	{
+		FUNC_FAILING( "CMuli3DDevice::CreateRenderThread: out of memory, cannot create render thread.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = m_pRenderThread->Create();
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_DELETE( m_pRenderThread );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
+void CMuli3DDevice::ExecuteCommandListJob( void *i_pCommandList, uint32 i_iJob, uint32 i_iThread )
+{
+	CMuli3DCommandList *pCommandList = (CMuli3DCommandList *)i_pCommandList;
+	pCommandList->Execute( pCommandList->m_pParent->m_pExecutionDevice );
+	pCommandList->Release();
+}
+
+void CMuli3DDevice::CaptureState( devicestate &o_State )
+{
+	memset( &o_State, 0, sizeof( devicestate ) ); // command lists compare states bytewise
+
+	memcpy( o_State.iRenderStates, m_iRenderStates, sizeof( m_iRenderStates ) );
+
+	o_State.pVertexFormat = m_pVertexFormat;
+	o_State.pPrimitiveAssembler = m_pPrimitiveAssembler;
+	o_State.pVertexShader = m_pVertexShader;
+	o_State.pTriangleShader = m_pTriangleShader;
+	o_State.pPixelShader = m_pPixelShader;
+	o_State.pIndexBuffer = m_pIndexBuffer;
+
+	memcpy( o_State.VertexStreams, m_VertexStreams, sizeof( m_VertexStreams ) );
+	memcpy( o_State.TextureSamplers, m_TextureSamplers, sizeof( m_TextureSamplers ) );
+
+	o_State.pRenderTarget = m_pRenderTarget;
+
+	o_State.ScissorRect = m_ScissorRect;
+	memcpy( o_State.ScissorPlanes, m_RenderInfo.ScissorPlanes, sizeof( m_RenderInfo.ScissorPlanes ) );
+	memcpy( o_State.ClippingPlanes, m_RenderInfo.ClippingPlanes, sizeof( m_RenderInfo.ClippingPlanes ) );
+	memcpy( o_State.bClippingPlaneEnabled, m_RenderInfo.bClippingPlaneEnabled, sizeof( m_RenderInfo.bClippingPlaneEnabled ) );
+	memcpy( o_State.VSInputs, m_RenderInfo.VSInputs, sizeof( m_RenderInfo.VSInputs ) );
+}
+
+void CMuli3DDevice::ApplyState( const devicestate &i_State )
+{
+	memcpy( m_iRenderStates, i_State.iRenderStates, sizeof( m_iRenderStates ) );
+
+	m_pVertexFormat = i_State.pVertexFormat;
+	m_pPrimitiveAssembler = i_State.pPrimitiveAssembler;
+	m_pVertexShader = i_State.pVertexShader;
+	m_pTriangleShader = i_State.pTriangleShader;
+	m_pPixelShader = i_State.pPixelShader;
+	m_pIndexBuffer = i_State.pIndexBuffer;
+
+	memcpy( m_VertexStreams, i_State.VertexStreams, sizeof( m_VertexStreams ) );
+	memcpy( m_TextureSamplers, i_State.TextureSamplers, sizeof( m_TextureSamplers ) );
+
+	m_pRenderTarget = i_State.pRenderTarget;
+
+	m_ScissorRect = i_State.ScissorRect;
+	memcpy( m_RenderInfo.ScissorPlanes, i_State.ScissorPlanes, sizeof( m_RenderInfo.ScissorPlanes ) );
+	memcpy( m_RenderInfo.ClippingPlanes, i_State.ClippingPlanes, sizeof( m_RenderInfo.ClippingPlanes ) );
+	memcpy( m_RenderInfo.bClippingPlaneEnabled, i_State.bClippingPlaneEnabled, sizeof( m_RenderInfo.bClippingPlaneEnabled ) );
+	memcpy( m_RenderInfo.VSInputs, i_State.VSInputs, sizeof( m_RenderInfo.VSInputs ) );
+}
+
+result CMuli3DDevice::PreRender()
+{
+	// Command lists may still be rendering to the same buffers or using the
+	// same shaders ...
+	WaitForCommandLists();
+
+	if( !m_pVertexFormat )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: no vertex format has been set.\n" );
+		return e_invalidstate;
+	}
+
+	if( !m_pVertexShader )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: no vertex shader has been set.\n" );
+		return e_invalidstate;
+	}
+
+	if( !m_pPixelShader )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: no pixel shader has been set.\n" );
+		return e_invalidstate;
+	}
+
+	if( !m_pRenderTarget )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: no rendertarget has been set.\n" );
+		return e_invalidstate;
+	}
+
+	const matrix44 &matViewportMatrix = m_pRenderTarget->matGetViewportMatrix();
+	m_RenderInfo.ViewportRect.iLeft = (uint32)(matViewportMatrix._41 - matViewportMatrix._11);
+	m_RenderInfo.ViewportRect.iRight = (uint32)(matViewportMatrix._41 + matViewportMatrix._11);
+	m_RenderInfo.ViewportRect.iTop = (uint32)(matViewportMatrix._42 + matViewportMatrix._22);
+	m_RenderInfo.ViewportRect.iBottom = (uint32)(matViewportMatrix._42 - matViewportMatrix._22);
+
+	if( m_RenderInfo.ViewportRect.iLeft >= m_RenderInfo.ViewportRect.iRight ||
+		m_RenderInfo.ViewportRect.iTop >= m_RenderInfo.ViewportRect.iBottom )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: invalid viewport matrix.\n" );
+		return e_invalidstate;
+	}
+
+	CMuli3DSurface *pColorBuffer = m_pRenderTarget->pGetColorBuffer();
+	CMuli3DSurface *pDepthBuffer = m_pRenderTarget->pGetDepthBuffer();
+	if( !pColorBuffer && !pDepthBuffer )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: rendertarget has no associated frame- and depthbuffer.\n" );
+		return e_invalidstate;
+	}
+
+	if( pColorBuffer && ( pColorBuffer->iGetWidth() < m_RenderInfo.ViewportRect.iRight ||
+		pColorBuffer->iGetHeight() < m_RenderInfo.ViewportRect.iBottom ) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: colorbuffer's dimensions are smaller than set viewport.\n" );
+		SAFE_RELEASE( pColorBuffer );
+		SAFE_RELEASE( pDepthBuffer );
+		return e_invalidstate;
+	}
+
+	if( pDepthBuffer && ( pDepthBuffer->iGetWidth() < m_RenderInfo.ViewportRect.iRight ||
 		pDepthBuffer->iGetHeight() < m_RenderInfo.ViewportRect.iBottom ) )
 	{
 		FUNC_FAILING( "CMuli3DDevice::PreRender: depthbuffers's dimensions are smaller than set viewport.\n" );
@@ -949,6 +1498,27 @@ result CMuli3DDevice::PreRender()
 		return e_invalidstate;
 	}
 
+	// Check number of rasterizer threads -------------------------------------
+	if( !m_iRenderStates[m3drs_rasterizerthreads] || m_iRenderStates[m3drs_rasterizerthreads] > c_iMaxRasterizerThreads )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: number of rasterizer threads is invalid.\n" );
+		return e_invalidstate;
+	}
+
+	// Check rasterization algorithm ------------------------------------------
+	if( m_iRenderStates[m3drs_rasterizer] != m3drast_scanline && m_iRenderStates[m3drs_rasterizer] != m3drast_halfspace )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: rasterizer is invalid.\n" );
+		return e_invalidstate;
+	}
+
+	// Check vertex cache size ------------------------------------------------
+	const uint32 iVertexCacheSize = m_iRenderStates[m3drs_vertexcachesize];
+	if( iVertexCacheSize < c_iVertexCacheWays || iVertexCacheSize > c_iMaxVertexCacheSize || ( iVertexCacheSize & ( iVertexCacheSize - 1 ) ) )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: vertex cache size is invalid.\n" );
+		return e_invalidstate;
+	}
 
 	// Check if renderstates for subdivision-mode are valid -------------------
 	switch( m_iRenderStates[m3drs_subdivisionmode] )
@@ -1019,6 +1589,19 @@ result CMuli3DDevice::PreRender()
 		FUNC_NOTIFY( "CMuli3DDevice::PreRender: nothing will be rendered - writing to the colorbuffer and the depthbuffer has been disabled.\n" );
 	}
 
+	if( m_pVertexShader->iGetBatchSize() > c_iMaxShaderBatchSize )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: vertexshader's batch size is invalid.\n" );
+		return e_invalidstate;
+	}
+
+	const uint32 iPixelBatchSize = m_pPixelShader->iGetBatchSize();
+	if( iPixelBatchSize && iPixelBatchSize != 4 && iPixelBatchSize != 8 )
+	{
+		FUNC_FAILING( "CMuli3DDevice::PreRender: pixelshader's batch size is invalid.\n" );
+		return e_invalidstate;
+	}
+
 	// TODO? add more checks
 
 	// Initialize internal render-info structure ------------------------------
@@ -1026,8 +1609,49 @@ result CMuli3DDevice::PreRender()
 	// note: m_RenderInfo.ShaderInputRegisterType is initialized when a vertex format is set
 
 	// Store output types in the internal render-info structure.
+	m_RenderInfo.iNumVSOutputs = 0;
 	for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg )
+	{
 		m_RenderInfo.VSOutputs[iReg] = m_pVertexShader->GetOutputRegisters( iReg );
+		if( m_RenderInfo.VSOutputs[iReg] != m3dsrt_unused )
+			m_RenderInfo.iNumVSOutputs = iReg + 1;
+	}
+
+	// Set up tile-binned rasterization ---------------------------------------
+	const uint32 iRasterizerThreads = m_iRenderStates[m3drs_rasterizerthreads];
+	m_RenderInfo.bBinTriangles = ( iRasterizerThreads > 1 && m_iRenderStates[m3drs_fillmode] == m3dfill_solid );
+	if( m_RenderInfo.bBinTriangles && ( !m_pThreadPool || m_pThreadPool->iGetNumThreads() != iRasterizerThreads ) )
+	{
+		if( !m_pThreadPool )
+			m_pThreadPool = new CMuli3DThreadPool;
+
+		if( !m_pThreadPool || FUNC_FAILED( m_pThreadPool->Create( iRasterizerThreads ) ) )
+		{
+			// Output is the same either way, so don't fail the draw-call.
+			FUNC_NOTIFY( "CMuli3DDevice::PreRender: couldn't create rasterizer threads, falling back to single-threaded rasterization.\n" );
+			m_RenderInfo.bBinTriangles = false;
+		}
+	}
+
+	if( m_RenderInfo.bBinTriangles )
+	{
+		m_iNumTilesX = ( m_RenderInfo.ViewportRect.iRight + c_iRasterizerTileSize - 1 ) / c_iRasterizerTileSize;
+		m_iNumTilesY = ( m_RenderInfo.ViewportRect.iBottom + c_iRasterizerTileSize - 1 ) / c_iRasterizerTileSize;
+		if( m_TileBins.size() < m_iNumTilesX * m_iNumTilesY )
+			m_TileBins.resize( m_iNumTilesX * m_iNumTilesY );
+
+		if( m_BinnedVertices.size() < 3 * c_iMaxBinnedTriangles )
+			m_BinnedVertices.resize( 3 * c_iMaxBinnedTriangles );
+
+		if( m_RasterContexts.size() < iRasterizerThreads )
+			m_RasterContexts.resize( iRasterizerThreads );
+
+		m_iNumBinnedTriangles = 0;
+	}
+
+	// The first context is used for single-threaded rasterization and isn't restricted to a tile.
+	m_RasterContexts[0].iTileLeft = m_RasterContexts[0].iTileTop = INT_MIN;
+	m_RasterContexts[0].iTileRight = m_RasterContexts[0].iTileBottom = INT_MAX;
 
 	// Get colorbuffer-related states -----------------------------------------
 	pColorBuffer = m_pRenderTarget->pGetColorBuffer();
@@ -1041,21 +1665,29 @@ result CMuli3DDevice::PreRender()
 			return resBuffer;
 		}
 
-		m_RenderInfo.iColorFloats = pColorBuffer->iGetFormatFloats();
-		if( !m_RenderInfo.iColorFloats )
+		switch( pColorBuffer->fmtGetFormat() )
+		{
+		case m3dfmt_r8g8b8a8: m_RenderInfo.iColorLayout = c_iColorLayoutR8G8B8A8; break;
+		case m3dfmt_r5g6b5: m_RenderInfo.iColorLayout = c_iColorLayoutR5G6B5; break;
+		default: m_RenderInfo.iColorLayout = pColorBuffer->iGetFormatFloats(); break;
+		}
+
+		if( !m_RenderInfo.iColorLayout )
 		{
 			pColorBuffer->UnlockRect();
 			SAFE_RELEASE( pColorBuffer );
 			return e_unknown;
 		}
 
-		m_RenderInfo.iColorBufferPitch = pColorBuffer->iGetWidth() * m_RenderInfo.iColorFloats;
+		m_RenderInfo.iColorPixelBytes = pColorBuffer->iGetPixelBytes();
+		m_RenderInfo.iColorBufferPitch = pColorBuffer->iGetWidth() * m_RenderInfo.iColorPixelBytes;
 		m_RenderInfo.bColorWrite = m_iRenderStates[m3drs_colorwriteenable] ? true : false;
 	}
 	else
 	{
 		m_RenderInfo.pFrameData = 0;
-		m_RenderInfo.iColorFloats = 0;
+		m_RenderInfo.iColorLayout = 0;
+		m_RenderInfo.iColorPixelBytes = 0;
 		m_RenderInfo.iColorBufferPitch = 0;
 		m_RenderInfo.bColorWrite = false;
 	}
@@ -1064,7 +1696,24 @@ result CMuli3DDevice::PreRender()
 	pDepthBuffer = m_iRenderStates[m3drs_zenable] ? m_pRenderTarget->pGetDepthBuffer() : 0;
 	if( pDepthBuffer )
 	{
-		result resBuffer = pDepthBuffer->LockRect( (void **)&m_RenderInfo.pDepthData, 0 );
+		// Pixel shaders which output depth-values make the hierarchical depth buffer useless for
+		// this draw-call. If they also write to the depthbuffer, plain locking invalidates it.
+		// Fixed-point depthbuffers don't maintain a hierarchical depth buffer.
+		m_RenderInfo.bDepthWrite = m_iRenderStates[m3drs_zwriteenable] ? true : false;
+		m_RenderInfo.DepthFormat = pDepthBuffer->fmtGetFormat();
+		result resBuffer;
+		if( ( m_pPixelShader->GetShaderOutput() == m3dpso_colordepth && m_RenderInfo.bDepthWrite ) || m_RenderInfo.DepthFormat != m3dfmt_r32f )
+		{
+			resBuffer = pDepthBuffer->LockRect( (void **)&m_RenderInfo.pDepthData, 0 );
+			m_RenderInfo.pHiZ = 0;
+		}
+		else
+		{
+			resBuffer = pDepthBuffer->LockRectHiZ( (void **)&m_RenderInfo.pDepthData, &m_RenderInfo.pHiZ, &m_RenderInfo.pHiZDirty, m_RenderInfo.iHiZPitch );
+			if( m_pPixelShader->GetShaderOutput() == m3dpso_colordepth )
+				m_RenderInfo.pHiZ = 0;
+		}
+
 		if( FUNC_FAILED( resBuffer ) )
 		{
 			FUNC_NOTIFY( "CMuli3DDevice::PreRender: couldn't access depthbuffer.\n" );
@@ -1074,39 +1723,71 @@ result CMuli3DDevice::PreRender()
 			return resBuffer;
 		}
 
-		m_RenderInfo.iDepthBufferPitch = pDepthBuffer->iGetWidth();
+		m_RenderInfo.iDepthPixelBytes = pDepthBuffer->iGetPixelBytes();
+		m_RenderInfo.iDepthBufferPitch = pDepthBuffer->iGetWidth() * m_RenderInfo.iDepthPixelBytes;
 		m_RenderInfo.DepthCompare = (m3dcmpfunc)m_iRenderStates[m3drs_zfunc];
-		m_RenderInfo.bDepthWrite = m_iRenderStates[m3drs_zwriteenable] ? true : false;
 	}
 	else
 	{
 		m_RenderInfo.pDepthData = 0;
+		m_RenderInfo.DepthFormat = m3dfmt_r32f;
+		m_RenderInfo.iDepthPixelBytes = 0;
 		m_RenderInfo.iDepthBufferPitch = 0;
 		m_RenderInfo.DepthCompare = m3dcmp_always;
 		m_RenderInfo.bDepthWrite = false;
+		m_RenderInfo.pHiZ = 0;
+	}
+
+	// Blocks of the hierarchical depth buffer can only be rejected or accepted as a whole for ordered compare-functions.
+	switch( m_RenderInfo.DepthCompare )
+	{
+	case m3dcmp_less: case m3dcmp_lessequal: case m3dcmp_greater: case m3dcmp_greaterequal:
+		m_RenderInfo.bHiZTest = ( m_RenderInfo.pHiZ != 0 ); break;
+	default: m_RenderInfo.bHiZTest = false; break;
 	}
+	m_RenderInfo.bMightKillPixels = ( m_pPixelShader->GetShaderOutput() == m3dpso_colordepth ) || m_pPixelShader->bMightKillPixels();
 
 	SAFE_RELEASE( pColorBuffer );
 	SAFE_RELEASE( pDepthBuffer );
 
-	// reset pixel-counter to 0
+	// reset pixel-counters to 0
 	m_RenderInfo.iRenderedPixels = 0;
+	for( std::vector<rastercontext>::iterator pContext = m_RasterContexts.begin(); pContext != m_RasterContexts.end(); ++pContext )
+	{
+		pContext->iRenderedPixels = 0;
+		pContext->iBatchedPixels = 0;
+		pContext->DepthCompare = m_RenderInfo.DepthCompare;
+	}
 
-	// Depending on m_pPixelShader->GetShaderOutput() chose the appropriate
+	// Depending on m_pPixelShader->GetShaderOutput() and the states chose the appropriate
 	// RasterizeScanline-function and assign it to the function pointer
-	switch( m_pPixelShader->GetShaderOutput() )
+	m_RenderInfo.PixelShaderOutput = m_pPixelShader->GetShaderOutput();
+	switch( m_RenderInfo.PixelShaderOutput )
 	{
 	case m3dpso_coloronly:
-		m_RenderInfo.fpRasterizeScanline = m_pPixelShader->bMightKillPixels() ? &CMuli3DDevice::RasterizeScanline_ColorOnly_MightKillPixels : &CMuli3DDevice::RasterizeScanline_ColorOnly;
 		m_RenderInfo.fpDrawPixel = &CMuli3DDevice::DrawPixel_ColorOnly;
 		break;
 	case m3dpso_colordepth:
-		m_RenderInfo.fpRasterizeScanline = &CMuli3DDevice::RasterizeScanline_ColorDepth;
 		m_RenderInfo.fpDrawPixel = &CMuli3DDevice::DrawPixel_ColorDepth;
 		break;
 	default: FUNC_FAILING( "CMuli3DDevice::PreRender: type of pixelshader is invalid.\n" ); return e_invalidstate;
 	}
 
+	m_RenderInfo.fpRasterizeScanline = fpGetRasterizeScanline( m_RenderInfo.DepthCompare );
+	m_RenderInfo.fpRasterizeScanlineNoDepthTest = m_RenderInfo.bHiZTest ? fpGetRasterizeScanline( m3dcmp_always ) : m_RenderInfo.fpRasterizeScanline;
+
+	// Use the vertex shader's batch-function if it has been implemented.
+	m_RenderInfo.iVertexBatchSize = m_pVertexShader->iGetBatchSize();
+
+	// Use the pixel shader's batch-function if it has been implemented.
+	// Lines and points are always drawn pixel by pixel.
+	m_RenderInfo.iPixelBatchSize = 0;
+	if( iPixelBatchSize && m_RenderInfo.bColorWrite )
+	{
+		m_RenderInfo.iPixelBatchSize = iPixelBatchSize;
+		m_RenderInfo.fpRasterizeScanline = m_RenderInfo.fpRasterizeScanlineNoDepthTest = &CMuli3DDevice::RasterizeScanline_Batch;
+	}
+
 	// Initialize shaders' pointer to the rendering device --------------------
 	// have to do this right before drawing and not at set-time, because a shader
 	// may be used with different devices ...
@@ -1115,11 +1796,27 @@ result CMuli3DDevice::PreRender()
 	m_pPixelShader->SetDevice( this );
 
 	// Initialize pixel shader's pointers to info structures ------------------
-	m_pPixelShader->SetInfo( m_RenderInfo.VSOutputs, &m_TriangleInfo );
+	m_pPixelShader->SetInfo( m_RenderInfo.VSOutputs, &m_RasterContexts[0].TriangleInfo );
 
 	// Initialize vertex cache ------------------------------------------------
-	m_iNumValidCacheEntries = 0;
-	m_iFetchedVertices = 0;
+	// Entries of previous draw-calls are invalidated by their fetch-time, so
+	// the cache doesn't have to be cleared; only when the counter is about to
+	// wrap around all fetch-times are reset.
+	if( m_VertexCache.size() != iVertexCacheSize )
+		m_VertexCache.resize( iVertexCacheSize );
+	if( m_iFetchedVertices >= 0x80000000 )
+	{
+		for( std::vector<m3dvertexcacheentry>::iterator pEntry = m_VertexCache.begin(); pEntry != m_VertexCache.end(); ++pEntry )
+			pEntry->iFetchTime = 0;
+		m_iFetchedVertices = 1;
+	}
+	m_iFirstFetchTime = m_iFetchedVertices;
+	m_iVertexCacheSetMask = iVertexCacheSize / c_iVertexCacheWays - 1;
+	m_iVertexCacheHits = 0;
+	m_iVertexCacheMisses = 0;
+
+	m_iVertexRangeEnd = 0; // set by the draw-calls
+	m_iNumBatchedVertices = 0;
 
 	fpuTruncate(); // ftol() returns expected integer values
 	return s_ok;
@@ -1127,6 +1824,13 @@ result CMuli3DDevice::PreRender()
 
 void CMuli3DDevice::PostRender()
 {
+	// Rasterize triangles which are still waiting in the tile bins
+	if( m_RenderInfo.bBinTriangles )
+		RasterizeBinnedTriangles();
+
+	for( std::vector<rastercontext>::iterator pContext = m_RasterContexts.begin(); pContext != m_RasterContexts.end(); ++pContext )
+		m_RenderInfo.iRenderedPixels += pContext->iRenderedPixels;
+
 	fpuReset(); // reset FPU to (default)rounding mode
 
 	if( m_RenderInfo.pFrameData )
@@ -1144,7 +1848,13 @@ void CMuli3DDevice::PostRender()
 		CMuli3DSurface *pDepthBuffer = m_pRenderTarget->pGetDepthBuffer();
 
 		if( pDepthBuffer )
+		{
+			// Recompute the bounds of blocks, which have been written to.
+			if( m_RenderInfo.pHiZ && m_RenderInfo.bDepthWrite )
+				pDepthBuffer->UpdateHiZ();
+
 			pDepthBuffer->UnlockRect();
+		}
 
 		SAFE_RELEASE( pDepthBuffer );
 	}
@@ -1163,7 +1873,7 @@ result CMuli3DDevice::DecodeVertexStream( m3dvsinput &o_VertexShaderInput, uint3
 			return e_unknown;
 		}
 
-		result resVB = pCurVertexStream->pVertexBuffer->GetPointer( iOffset, (void **)&pVertex[iStream] );
+		result resVB = pCurVertexStream->pVertexBuffer->GetReadPointer( iOffset, (const void **)&pVertex[iStream] );
 		if( FUNC_FAILED( resVB ) )
 			return resVB;
 	}
@@ -1209,50 +1919,117 @@ result CMuli3DDevice::FetchVertex( m3dvertexcacheentry **io_ppVertex, uint32 i_i
 	if( *io_ppVertex && (*io_ppVertex)->iVertexIndex == i_iVertex )
 	{
 		(*io_ppVertex)->iFetchTime = m_iFetchedVertices++;
+		++m_iVertexCacheHits;
 		return s_ok;
 	}
 
-	const bool bCanAppend = ( m_iNumValidCacheEntries < c_iVertexCacheSize );
-
-	// Find vertex in cache
-	m3dvertexcacheentry *pCacheEntry = &m_VertexCache[0], *pDestEntry = pCacheEntry;
-	for( uint32 iCurEntry = 0; iCurEntry < m_iNumValidCacheEntries; ++iCurEntry, ++pCacheEntry )
+	// Find vertex in its set; the low bits of the index select the set, so
+	// that neighbouring vertices never compete for the same entries.
+	m3dvertexcacheentry *pCacheEntry = &m_VertexCache[( i_iVertex & m_iVertexCacheSetMask ) * c_iVertexCacheWays], *pDestEntry = pCacheEntry;
+	for( uint32 iWay = 0; iWay < c_iVertexCacheWays; ++iWay, ++pCacheEntry )
 	{
-		if( pCacheEntry->iVertexIndex == i_iVertex )
+		if( pCacheEntry->iVertexIndex == i_iVertex && pCacheEntry->iFetchTime >= m_iFirstFetchTime )
 		{
 			// Vertex is already in cache, return it.
 			pCacheEntry->iFetchTime = m_iFetchedVertices++;
+			++m_iVertexCacheHits;
 			*io_ppVertex = pCacheEntry;
 			return s_ok;
 		}
 
-		// if( !bCanAppend ) // Profiling turned out, that leaving this away is faster because most of the time we can't append anyway.
-		{
-			// The vertex cache is full, so we have to look for the oldest entry and replace it in case we cannot find the desired vertex in the cache.
-			if( pCacheEntry->iFetchTime < pDestEntry->iFetchTime )
-				pDestEntry = pCacheEntry;
-		}
+		// Replace the least recently used entry of the set in case we cannot find the desired vertex; invalid entries are always older.
+		if( pCacheEntry->iFetchTime < pDestEntry->iFetchTime )
+			pDestEntry = pCacheEntry;
 	}
 
-	if( bCanAppend ) // The cache is not full yet, so we can append a new vertex.
-		pDestEntry = &m_VertexCache[m_iNumValidCacheEntries++];
+	++m_iVertexCacheMisses;
 
 	// Update the destination cache entry and return it -----------------------
 	pDestEntry->iVertexIndex = i_iVertex;
 	pDestEntry->iFetchTime = m_iFetchedVertices++;
 
-	result resDecode = DecodeVertexStream( pDestEntry->VertexOutput.SourceInput, i_iVertex );
-	if( FUNC_FAILED( resDecode ) )
-		return resDecode;
+	if( m_RenderInfo.iVertexBatchSize && i_iVertex < m_iVertexRangeEnd )
+	{
+		// Transform a new run of vertices, if the vertex isn't part of the last one.
+		// note: unsigned subtraction, indices before the run wrap around.
+		if( i_iVertex - m_iFirstBatchedVertex >= m_iNumBatchedVertices )
+		{
+			result resTransform = TransformVertexBatch( i_iVertex );
+			if( FUNC_FAILED( resTransform ) )
+				return resTransform;
+		}
+
+		pDestEntry->VertexOutput = m_BatchedVertices[i_iVertex - m_iFirstBatchedVertex];
+	}
+	else
+	{
+		result resDecode = DecodeVertexStream( pDestEntry->VertexOutput.SourceInput, i_iVertex );
+		if( FUNC_FAILED( resDecode ) )
+			return resDecode;
 
-	m_pVertexShader->Execute( pDestEntry->VertexOutput.SourceInput.ShaderInputs,
-		pDestEntry->VertexOutput.vPosition, pDestEntry->VertexOutput.ShaderOutputs );
+		m_pVertexShader->Execute( pDestEntry->VertexOutput.SourceInput.ShaderInputs,
+			pDestEntry->VertexOutput.vPosition, pDestEntry->VertexOutput.ShaderOutputs );
+	}
 
 	*io_ppVertex = pDestEntry;
 
 	return s_ok;
 }
 
+result CMuli3DDevice::TransformVertexBatch( uint32 i_iVertex )
+{
+	uint32 iNumVertices = m_iVertexRangeEnd - i_iVertex;
+	if( iNumVertices > m_RenderInfo.iVertexBatchSize )
+		iNumVertices = m_RenderInfo.iVertexBatchSize;
+
+	m_iFirstBatchedVertex = i_iVertex;
+	m_iNumBatchedVertices = 0;
+
+	for( uint32 iVertex = 0; iVertex < iNumVertices; ++iVertex )
+	{
+		result resDecode = DecodeVertexStream( m_BatchedVertices[iVertex].SourceInput, i_iVertex + iVertex );
+		if( FUNC_FAILED( resDecode ) )
+		{
+			// Only the first vertex has actually been requested; the run
+			// may end early if the range exceeds the vertex buffers.
+			if( !iVertex )
+				return resDecode;
+
+			iNumVertices = iVertex;
+			break;
+		}
+	}
+
+	// Convert to structure-of-arrays layout; unused lanes are filled with the first vertex.
+	for( uint32 iLane = 0; iLane < m_RenderInfo.iVertexBatchSize; ++iLane )
+	{
+		const shaderreg *pSrc = m_BatchedVertices[iLane < iNumVertices ? iLane : 0].SourceInput.ShaderInputs;
+		m3dshaderregbatch *pDest = m_VertexBatch.Inputs;
+		for( uint32 iReg = 0; iReg < c_iVertexShaderRegisters; ++iReg, ++pSrc, ++pDest )
+		{
+			pDest->x[iLane] = pSrc->x; pDest->y[iLane] = pSrc->y;
+			pDest->z[iLane] = pSrc->z; pDest->w[iLane] = pSrc->w;
+		}
+	}
+
+	m_pVertexShader->ExecuteBatch( m_VertexBatch, iNumVertices );
+
+	for( uint32 iLane = 0; iLane < iNumVertices; ++iLane )
+	{
+		m3dvsoutput &Vertex = m_BatchedVertices[iLane];
+		Vertex.vPosition = vector4( m_VertexBatch.Position.x[iLane], m_VertexBatch.Position.y[iLane],
+			m_VertexBatch.Position.z[iLane], m_VertexBatch.Position.w[iLane] );
+
+		shaderreg *pDest = Vertex.ShaderOutputs;
+		const m3dshaderregbatch *pSrc = m_VertexBatch.Outputs;
+		for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg, ++pSrc, ++pDest )
+			*pDest = shaderreg( pSrc->x[iLane], pSrc->y[iLane], pSrc->z[iLane], pSrc->w[iLane] );
+	}
+
+	m_iNumBatchedVertices = iNumVertices;
+	return s_ok;
+}
+
 inline void CMuli3DDevice::ProcessTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
 {
 	switch( m_iRenderStates[m3drs_subdivisionmode] )
@@ -1283,10 +2060,19 @@ result CMuli3DDevice::DrawPrimitive( m3dprimitivetype i_PrimitiveType, uint32 i_
 	default: FUNC_FAILING( "CMuli3DDevice::DrawPrimitive: invalid primitive type specified.\n" ); return e_invalidparameters;
 	}
 
+	if( m_pRecordingCommandList )
+	{
+		const uint32 iParameters[] = { i_PrimitiveType, i_iStartVertex, i_iPrimitiveCount };
+		m_pRecordingCommandList->RecordDrawCall( m3dcmd_drawprimitive, iParameters, 3 );
+		return s_ok;
+	}
+
 	result resCheck = PreRender();
 	if( FUNC_FAILED( resCheck ) )
 		return resCheck;
 
+	m_iVertexRangeEnd = i_iStartVertex + iNumVertices;
+
 	uint32 iVertexIndices[3] = { i_iStartVertex, i_iStartVertex + 1, i_iStartVertex + 2 };
 	bool bFlip = false; // used when drawing tristrips
 	while( i_iPrimitiveCount-- )
@@ -1362,10 +2148,19 @@ result CMuli3DDevice::DrawIndexedPrimitive( m3dprimitivetype i_PrimitiveType, in
 		return e_invalidstate;
 	}
 
+	if( m_pRecordingCommandList )
+	{
+		const uint32 iParameters[] = { i_PrimitiveType, (uint32)i_iBaseVertexIndex, i_iMinIndex, i_iNumVertices, i_iStartIndex, i_iPrimitiveCount };
+		m_pRecordingCommandList->RecordDrawCall( m3dcmd_drawindexedprimitive, iParameters, 6 );
+		return s_ok;
+	}
+
 	result resCheck = PreRender();
 	if( FUNC_FAILED( resCheck ) )
 		return resCheck;
 
+	m_iVertexRangeEnd = i_iBaseVertexIndex + i_iMinIndex + i_iNumVertices;
+
 	uint32 iIndexIndices[3] = { i_iStartIndex, i_iStartIndex + 1, i_iStartIndex + 2 };
 	bool bFlip = false; // used when drawing tristrips
 	while( i_iPrimitiveCount-- )
@@ -1439,6 +2234,13 @@ result CMuli3DDevice::DrawDynamicPrimitive( uint32 i_iStartVertex, uint32 i_iNum
 		return e_invalidstate;
 	}
 
+	if( m_pRecordingCommandList )
+	{
+		const uint32 iParameters[] = { i_iStartVertex, i_iNumVertices };
+		m_pRecordingCommandList->RecordDrawCall( m3dcmd_drawdynamicprimitive, iParameters, 2 );
+		return s_ok;
+	}
+
 	result resCheck = PreRender();
 	if( FUNC_FAILED( resCheck ) )
 		return resCheck;
@@ -1458,6 +2260,12 @@ result CMuli3DDevice::DrawDynamicPrimitive( uint32 i_iStartVertex, uint32 i_iNum
 	if( !iPrimitiveCount )
 		return s_ok;
 
+	for( std::vector<uint32>::iterator pVertexIndex = VertexIndices.begin(); pVertexIndex != VertexIndices.end(); ++pVertexIndex )
+	{
+		if( *pVertexIndex >= m_iVertexRangeEnd )
+			m_iVertexRangeEnd = *pVertexIndex + 1;
+	}
+
 	std::vector<uint32>::iterator pVertexIndexIterator = VertexIndices.begin();
 
 	uint32 iVertexIndices[3] = { *pVertexIndexIterator++, *pVertexIndexIterator++, *pVertexIndexIterator++ };
@@ -1541,24 +2349,15 @@ void CMuli3DDevice::InterpolateVertexShaderOutput( m3dvsoutput *o_pVSOutput, con
 
 inline void CMuli3DDevice::MultiplyVertexShaderOutputRegisters( m3dvsoutput *o_pDest, const m3dvsoutput *i_pSrc, float32 i_fVal )
 {
+	// Unused components are multiplied as well, which is cheaper than testing the register types.
 	shaderreg *pDest = o_pDest->ShaderOutputs;
 	const shaderreg *pSrc = i_pSrc->ShaderOutputs;
-	for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg, ++pDest, ++pSrc )
+	for( uint32 iReg = 0; iReg < m_RenderInfo.iNumVSOutputs; ++iReg, ++pDest, ++pSrc )
 	{
-		switch( m_RenderInfo.VSOutputs[iReg] )
-		{
-		case m3dsrt_vector4:
-			pDest->w = pSrc->w * i_fVal;
-		case m3dsrt_vector3:
-			pDest->z = pSrc->z * i_fVal;
-		case m3dsrt_vector2:
-			pDest->y = pSrc->y * i_fVal;
-		case m3dsrt_float32:
-			pDest->x = pSrc->x * i_fVal;
-		case m3dsrt_unused:
-		default: // cannot happen
-			break;
-		}
+		pDest->x = pSrc->x * i_fVal;
+		pDest->y = pSrc->y * i_fVal;
+		pDest->z = pSrc->z * i_fVal;
+		pDest->w = pSrc->w * i_fVal;
 	}
 }
 
@@ -1967,59 +2766,152 @@ void CMuli3DDevice::DrawTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsou
 	}
 
 	for( iVertex = 1; iVertex < iNumVertices - 1; ++iVertex )
-		RasterizeTriangle( ppSrc[0], ppSrc[iVertex], ppSrc[iVertex + 1] );
+	{
+		if( m_RenderInfo.bBinTriangles )
+			BinTriangle( ppSrc[0], ppSrc[iVertex], ppSrc[iVertex + 1] );
+		else
+			RasterizeTriangle( &m_RasterContexts[0], ppSrc[0], ppSrc[iVertex], ppSrc[iVertex + 1] );
+	}
 }
 
-void CMuli3DDevice::CalculateTriangleGradients( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+void CMuli3DDevice::BinTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
 {
-	const float32 fDeltaX[2] = { i_pVSOutput1->vPosition.x - i_pVSOutput0->vPosition.x, i_pVSOutput2->vPosition.x - i_pVSOutput0->vPosition.x };
-	const float32 fDeltaY[2] = { i_pVSOutput1->vPosition.y - i_pVSOutput0->vPosition.y, i_pVSOutput2->vPosition.y - i_pVSOutput0->vPosition.y };
-	m_TriangleInfo.fCommonGradient = 1.0f / ( fDeltaX[0] * fDeltaY[1] - fDeltaX[1] * fDeltaY[0] );
-	m_TriangleInfo.pBaseVertex = i_pVSOutput0;
+	if( m_iNumBinnedTriangles == c_iMaxBinnedTriangles )
+		RasterizeBinnedTriangles();
+
+	// The triangle's vertices are stored in the order they were passed in, so
+	// that the rasterizer reproduces exactly the same gradients later on.
+	const uint32 iTriangle = m_iNumBinnedTriangles++;
+	m3dvsoutput *pDest = &m_BinnedVertices[iTriangle * 3];
+	memcpy( &pDest[0], i_pVSOutput0, sizeof( m3dvsoutput ) );
+	memcpy( &pDest[1], i_pVSOutput1, sizeof( m3dvsoutput ) );
+	memcpy( &pDest[2], i_pVSOutput2, sizeof( m3dvsoutput ) );
+
+	// Compute the screen space bounding box ----------------------------------
+	const vector4 &vA = i_pVSOutput0->vPosition;
+	const vector4 &vB = i_pVSOutput1->vPosition;
+	const vector4 &vC = i_pVSOutput2->vPosition;
+
+	float32 fMinX = vA.x, fMaxX = vA.x, fMinY = vA.y, fMaxY = vA.y;
+	if( vB.x < fMinX ) fMinX = vB.x; else if( vB.x > fMaxX ) fMaxX = vB.x;
+	if( vC.x < fMinX ) fMinX = vC.x; else if( vC.x > fMaxX ) fMaxX = vC.x;
+	if( vB.y < fMinY ) fMinY = vB.y; else if( vB.y > fMaxY ) fMaxY = vB.y;
+	if( vC.y < fMinY ) fMinY = vC.y; else if( vC.y > fMaxY ) fMaxY = vC.y;
+
+	// The box is enlarged by one pixel to account for rounding errors during edge-stepping.
+	const int32 iTileSize = (int32)c_iRasterizerTileSize;
+	int32 iTileX[2] = { ( ftol( fMinX ) - 1 ) / iTileSize, ( ftol( fMaxX ) + 1 ) / iTileSize };
+	int32 iTileY[2] = { ( ftol( fMinY ) - 1 ) / iTileSize, ( ftol( fMaxY ) + 1 ) / iTileSize };
+
+	// Tiles at the border of the grid also receive triangles lying outside of it.
+	if( iTileX[0] < 0 ) iTileX[0] = 0;
+	if( iTileY[0] < 0 ) iTileY[0] = 0;
+	if( iTileX[1] >= (int32)m_iNumTilesX ) iTileX[1] = m_iNumTilesX - 1;
+	if( iTileY[1] >= (int32)m_iNumTilesY ) iTileY[1] = m_iNumTilesY - 1;
+
+	for( int32 iY = iTileY[0]; iY <= iTileY[1]; ++iY )
+	{
+		for( int32 iX = iTileX[0]; iX <= iTileX[1]; ++iX )
+			m_TileBins[iY * m_iNumTilesX + iX].push_back( iTriangle );
+	}
+}
 
-	// The derivatives with respect to the y-coordinate are negated, because in screen-space the y-axis is reversed.
+void CMuli3DDevice::RasterizeBinnedTriangles()
+{
+	if( !m_iNumBinnedTriangles )
+		return;
 
-	const float32 fDeltaZ[2] = { i_pVSOutput1->vPosition.z - i_pVSOutput0->vPosition.z, i_pVSOutput2->vPosition.z - i_pVSOutput0->vPosition.z };
-	m_TriangleInfo.fZDdx = ( fDeltaZ[0] * fDeltaY[1] - fDeltaZ[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-	m_TriangleInfo.fZDdy = -( fDeltaZ[0] * fDeltaX[1] - fDeltaZ[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
+	const uint32 iNumTiles = m_iNumTilesX * m_iNumTilesY;
+	m_pThreadPool->Execute( RasterizeTileJob, this, iNumTiles );
 
-	const float32 fDeltaW[2] = { i_pVSOutput1->vPosition.w - i_pVSOutput0->vPosition.w, i_pVSOutput2->vPosition.w - i_pVSOutput0->vPosition.w };
-	m_TriangleInfo.fWDdx = ( fDeltaW[0] * fDeltaY[1] - fDeltaW[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-	m_TriangleInfo.fWDdy = -( fDeltaW[0] * fDeltaX[1] - fDeltaW[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
+	for( uint32 iTile = 0; iTile < iNumTiles; ++iTile )
+		m_TileBins[iTile].clear();
+
+	m_iNumBinnedTriangles = 0;
+}
+
+void CMuli3DDevice::RasterizeTileJob( void *i_pDevice, uint32 i_iTile, uint32 i_iThread )
+{
+	CMuli3DDevice *pDevice = (CMuli3DDevice *)i_pDevice;
+
+	const std::vector<uint32> &TileBin = pDevice->m_TileBins[i_iTile];
+	if( TileBin.empty() )
+		return;
+
+	// Restrict rasterization to the tile. Tiles at the border of the grid are
+	// open towards the outside, like the single-threaded rasterizer.
+	rastercontext *pContext = &pDevice->m_RasterContexts[i_iThread];
+	const uint32 iTileX = i_iTile % pDevice->m_iNumTilesX, iTileY = i_iTile / pDevice->m_iNumTilesX;
+	pContext->iTileLeft = iTileX ? (int32)( iTileX * c_iRasterizerTileSize ) : INT_MIN;
+	pContext->iTileTop = iTileY ? (int32)( iTileY * c_iRasterizerTileSize ) : INT_MIN;
+	pContext->iTileRight = ( iTileX + 1 < pDevice->m_iNumTilesX ) ? (int32)( ( iTileX + 1 ) * c_iRasterizerTileSize ) : INT_MAX;
+	pContext->iTileBottom = ( iTileY + 1 < pDevice->m_iNumTilesY ) ? (int32)( ( iTileY + 1 ) * c_iRasterizerTileSize ) : INT_MAX;
 
-	shaderreg *pDestDdx = m_TriangleInfo.ShaderOutputsDdx;
-	shaderreg *pDestDdy = m_TriangleInfo.ShaderOutputsDdy;
-	for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg, ++pDestDdx, ++pDestDdy )
+	fpuTruncate(); // the FPU control word is per thread; ftol() has to behave the same on all threads
+	IMuli3DPixelShader::SetThreadTriangleInfo( &pContext->TriangleInfo );
+
+	const m3dvsoutput *pBinnedVertices = &pDevice->m_BinnedVertices[0];
+	for( std::vector<uint32>::const_iterator pTriangle = TileBin.begin(); pTriangle != TileBin.end(); ++pTriangle )
 	{
-		switch( m_RenderInfo.VSOutputs[iReg] )
-		{
-		case m3dsrt_vector4:
+		const m3dvsoutput *pVertices = &pBinnedVertices[*pTriangle * 3];
+		pDevice->RasterizeTriangle( pContext, &pVertices[0], &pVertices[1], &pVertices[2] );
+	}
+
+	IMuli3DPixelShader::SetThreadTriangleInfo( 0 );
+}
+
+void CMuli3DDevice::CalculateTriangleGradients( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+{
+	const float32 fDeltaX[2] = { i_pVSOutput1->vPosition.x - i_pVSOutput0->vPosition.x, i_pVSOutput2->vPosition.x - i_pVSOutput0->vPosition.x };
+	const float32 fDeltaY[2] = { i_pVSOutput1->vPosition.y - i_pVSOutput0->vPosition.y, i_pVSOutput2->vPosition.y - i_pVSOutput0->vPosition.y };
+	io_pContext->TriangleInfo.fCommonGradient = 1.0f / ( fDeltaX[0] * fDeltaY[1] - fDeltaX[1] * fDeltaY[0] );
+	io_pContext->TriangleInfo.pBaseVertex = i_pVSOutput0;
+
+	// The derivatives with respect to the y-coordinate are negated, because in screen-space the y-axis is reversed.
+
+	const float32 fDeltaZ[2] = { i_pVSOutput1->vPosition.z - i_pVSOutput0->vPosition.z, i_pVSOutput2->vPosition.z - i_pVSOutput0->vPosition.z };
+	io_pContext->TriangleInfo.fZDdx = ( fDeltaZ[0] * fDeltaY[1] - fDeltaZ[1] * fDeltaY[0] ) * io_pContext->TriangleInfo.fCommonGradient;
+	io_pContext->TriangleInfo.fZDdy = -( fDeltaZ[0] * fDeltaX[1] - fDeltaZ[1] * fDeltaX[0] ) * io_pContext->TriangleInfo.fCommonGradient;
+
+	const float32 fDeltaW[2] = { i_pVSOutput1->vPosition.w - i_pVSOutput0->vPosition.w, i_pVSOutput2->vPosition.w - i_pVSOutput0->vPosition.w };
+	io_pContext->TriangleInfo.fWDdx = ( fDeltaW[0] * fDeltaY[1] - fDeltaW[1] * fDeltaY[0] ) * io_pContext->TriangleInfo.fCommonGradient;
+	io_pContext->TriangleInfo.fWDdy = -( fDeltaW[0] * fDeltaX[1] - fDeltaW[1] * fDeltaX[0] ) * io_pContext->TriangleInfo.fCommonGradient;
+
+	// Gradients of unused components are set to 0, so that registers can be interpolated as a whole.
+	shaderreg *pDestDdx = io_pContext->TriangleInfo.ShaderOutputsDdx;
+	shaderreg *pDestDdy = io_pContext->TriangleInfo.ShaderOutputsDdy;
+	for( uint32 iReg = 0; iReg < m_RenderInfo.iNumVSOutputs; ++iReg, ++pDestDdx, ++pDestDdy )
+	{
+		*pDestDdx = *pDestDdy = vector4( 0, 0, 0, 0 );
+		switch( m_RenderInfo.VSOutputs[iReg] )
+		{
+		case m3dsrt_vector4:
 			{
 				const float32 fDeltaRegVal[2] = { i_pVSOutput1->ShaderOutputs[iReg].w - i_pVSOutput0->ShaderOutputs[iReg].w,
 					i_pVSOutput2->ShaderOutputs[iReg].w - i_pVSOutput0->ShaderOutputs[iReg].w };
-				pDestDdx->w = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-				pDestDdy->w = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
+				pDestDdx->w = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * io_pContext->TriangleInfo.fCommonGradient;
+				pDestDdy->w = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * io_pContext->TriangleInfo.fCommonGradient;
 			}
 		case m3dsrt_vector3:
 			{
 				const float32 fDeltaRegVal[2] = { i_pVSOutput1->ShaderOutputs[iReg].z - i_pVSOutput0->ShaderOutputs[iReg].z,
 					i_pVSOutput2->ShaderOutputs[iReg].z - i_pVSOutput0->ShaderOutputs[iReg].z };
-				pDestDdx->z = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-				pDestDdy->z = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
+				pDestDdx->z = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * io_pContext->TriangleInfo.fCommonGradient;
+				pDestDdy->z = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * io_pContext->TriangleInfo.fCommonGradient;
 			}
 		case m3dsrt_vector2:
 			{
 				const float32 fDeltaRegVal[2] = { i_pVSOutput1->ShaderOutputs[iReg].y - i_pVSOutput0->ShaderOutputs[iReg].y,
 					i_pVSOutput2->ShaderOutputs[iReg].y - i_pVSOutput0->ShaderOutputs[iReg].y };
-				pDestDdx->y = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-				pDestDdy->y = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
+				pDestDdx->y = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * io_pContext->TriangleInfo.fCommonGradient;
+				pDestDdy->y = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * io_pContext->TriangleInfo.fCommonGradient;
 			}
 		case m3dsrt_float32:
 			{
 				const float32 fDeltaRegVal[2] = { i_pVSOutput1->ShaderOutputs[iReg].x - i_pVSOutput0->ShaderOutputs[iReg].x,
 					i_pVSOutput2->ShaderOutputs[iReg].x - i_pVSOutput0->ShaderOutputs[iReg].x };
-				pDestDdx->x = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * m_TriangleInfo.fCommonGradient;
-				pDestDdy->x = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * m_TriangleInfo.fCommonGradient;
+				pDestDdx->x = ( fDeltaRegVal[0] * fDeltaY[1] - fDeltaRegVal[1] * fDeltaY[0] ) * io_pContext->TriangleInfo.fCommonGradient;
+				pDestDdy->x = -( fDeltaRegVal[0] * fDeltaX[1] - fDeltaRegVal[1] * fDeltaX[0] ) * io_pContext->TriangleInfo.fCommonGradient;
 			}
 		case m3dsrt_unused:
 		default: // cannot happen
@@ -2028,25 +2920,28 @@ void CMuli3DDevice::CalculateTriangleGradients( const m3dvsoutput *i_pVSOutput0,
 	}
 }
 
-void CMuli3DDevice::SetVSOutputFromGradient( m3dvsoutput *o_pVSOutput, float32 i_fX, float32 i_fY )
+void CMuli3DDevice::SetVSOutputFromGradient( const rastercontext *i_pContext, m3dvsoutput *o_pVSOutput, float32 i_fX, float32 i_fY )
 {
-	const float32 fOffsetX = ( i_fX - m_TriangleInfo.pBaseVertex->vPosition.x );
-	const float32 fOffsetY = ( i_fY - m_TriangleInfo.pBaseVertex->vPosition.y );
+	const float32 fOffsetX = ( i_fX - i_pContext->TriangleInfo.pBaseVertex->vPosition.x );
+	const float32 fOffsetY = ( i_fY - i_pContext->TriangleInfo.pBaseVertex->vPosition.y );
 
-	o_pVSOutput->vPosition.z = m_TriangleInfo.pBaseVertex->vPosition.z +
-		m_TriangleInfo.fZDdx * fOffsetX + m_TriangleInfo.fZDdy * fOffsetY;
-	o_pVSOutput->vPosition.w = m_TriangleInfo.pBaseVertex->vPosition.w +
-		m_TriangleInfo.fWDdx * fOffsetX + m_TriangleInfo.fWDdy * fOffsetY;
+	o_pVSOutput->vPosition.z = i_pContext->TriangleInfo.pBaseVertex->vPosition.z +
+		i_pContext->TriangleInfo.fZDdx * fOffsetX + i_pContext->TriangleInfo.fZDdy * fOffsetY;
+	o_pVSOutput->vPosition.w = i_pContext->TriangleInfo.pBaseVertex->vPosition.w +
+		i_pContext->TriangleInfo.fWDdx * fOffsetX + i_pContext->TriangleInfo.fWDdy * fOffsetY;
 
 	shaderreg *pDest = o_pVSOutput->ShaderOutputs;
-	const shaderreg *pBase = m_TriangleInfo.pBaseVertex->ShaderOutputs;
-	const shaderreg *pDdx = m_TriangleInfo.ShaderOutputsDdx;
-	const shaderreg *pDdy = m_TriangleInfo.ShaderOutputsDdy;
-	for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg, ++pDest, ++pBase, ++pDdx, ++pDdy )
+	const shaderreg *pBase = i_pContext->TriangleInfo.pBaseVertex->ShaderOutputs;
+	const shaderreg *pDdx = i_pContext->TriangleInfo.ShaderOutputsDdx;
+	const shaderreg *pDdy = i_pContext->TriangleInfo.ShaderOutputsDdy;
+	for( uint32 iReg = 0; iReg < m_RenderInfo.iNumVSOutputs; ++iReg, ++pDest, ++pBase, ++pDdx, ++pDdy )
 	{
 		// The following assignments to pDest automatically zero out unused components.
 		switch( m_RenderInfo.VSOutputs[iReg] )
 		{
+		case m3dsrt_unused:
+			*pDest = vector4( 0, 0, 0, 0 );
+			break;
 		case m3dsrt_float32:
 			*pDest = *(float32 *)pBase + *(float32 *)pDdx * fOffsetX + *(float32 *)pDdy * fOffsetY;
 			break;
@@ -2059,49 +2954,179 @@ void CMuli3DDevice::SetVSOutputFromGradient( m3dvsoutput *o_pVSOutput, float32 i
 		case m3dsrt_vector4:
 			*pDest = *(vector4 *)pBase + *(vector4 *)pDdx * fOffsetX + *(vector4 *)pDdy * fOffsetY;
 			break;
-		case m3dsrt_unused:
 		default: // cannot happen
 			break;
 		}
 	}
 }
 
-inline void CMuli3DDevice::StepXVSOutputFromGradient( m3dvsoutput *io_pVSOutput )
+inline void CMuli3DDevice::StepXVSOutputFromGradient( const rastercontext *i_pContext, m3dvsoutput *io_pVSOutput )
 {
-	io_pVSOutput->vPosition.z += m_TriangleInfo.fZDdx;
-	io_pVSOutput->vPosition.w += m_TriangleInfo.fWDdx;
+	io_pVSOutput->vPosition.z += i_pContext->TriangleInfo.fZDdx;
+	io_pVSOutput->vPosition.w += i_pContext->TriangleInfo.fWDdx;
 
+	// Unused components stay 0, because their gradients are 0.
 	shaderreg *pDest = io_pVSOutput->ShaderOutputs;
-	const shaderreg *pDdx = m_TriangleInfo.ShaderOutputsDdx;
-	for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg, ++pDest, ++pDdx )
+	const shaderreg *pDdx = i_pContext->TriangleInfo.ShaderOutputsDdx;
+	for( uint32 iReg = 0; iReg < m_RenderInfo.iNumVSOutputs; ++iReg, ++pDest, ++pDdx )
 	{
-		switch( m_RenderInfo.VSOutputs[iReg] )
+		pDest->x += pDdx->x;
+		pDest->y += pDdx->y;
+		pDest->z += pDdx->z;
+		pDest->w += pDdx->w;
+	}
+}
+
+int32 CMuli3DDevice::iHiZCompare( float32 i_fMinZ, float32 i_fMaxZ, const float32 *i_pBounds )
+{
+	switch( m_RenderInfo.DepthCompare )
+	{
+	case m3dcmp_less:
+	case m3dcmp_lessequal:
+		if( i_fMinZ > i_pBounds[1] + c_fHiZEpsilon ) return -1;
+		if( i_fMaxZ < i_pBounds[0] - c_fHiZEpsilon ) return 1;
+		return 0;
+	case m3dcmp_greater:
+	case m3dcmp_greaterequal:
+		if( i_fMaxZ < i_pBounds[0] - c_fHiZEpsilon ) return -1;
+		if( i_fMinZ > i_pBounds[1] + c_fHiZEpsilon ) return 1;
+		return 0;
+	default:
+		return 0;
+	}
+}
+
+void CMuli3DDevice::HiZExtendBlock( uint32 i_iBlock, float32 i_fMinZ, float32 i_fMaxZ )
+{
+	// Depth-values which pass the test are always less (or greater) than the ones they
+	// replace, so only one of the bounds can change.
+	float32 *pBounds = &m_RenderInfo.pHiZ[i_iBlock * 2];
+	switch( m_RenderInfo.DepthCompare )
+	{
+	case m3dcmp_less: case m3dcmp_lessequal: if( i_fMinZ < pBounds[0] ) pBounds[0] = i_fMinZ; break;
+	case m3dcmp_greater: case m3dcmp_greaterequal: if( i_fMaxZ > pBounds[1] ) pBounds[1] = i_fMaxZ; break;
+	default:
+		if( i_fMinZ < pBounds[0] ) pBounds[0] = i_fMinZ;
+		if( i_fMaxZ > pBounds[1] ) pBounds[1] = i_fMaxZ;
+		break;
+	}
+
+	m_RenderInfo.pHiZDirty[i_iBlock] = 1;
+}
+
+bool CMuli3DDevice::bHiZTestTriangle( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0,
+	const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+{
+	const vector4 &vA = i_pVSOutput0->vPosition, &vB = i_pVSOutput1->vPosition, &vC = i_pVSOutput2->vPosition;
+
+	// Depth range: pixels may lie slightly outside of the triangle, where the interpolated
+	// depth-values exceed those of the vertices by up to one pixel's gradient.
+	const float32 fMargin = fabsf( io_pContext->TriangleInfo.fZDdx ) + fabsf( io_pContext->TriangleInfo.fZDdy );
+	float32 fMinZ = vA.z, fMaxZ = vA.z;
+	if( vB.z < fMinZ ) fMinZ = vB.z; else if( vB.z > fMaxZ ) fMaxZ = vB.z;
+	if( vC.z < fMinZ ) fMinZ = vC.z; else if( vC.z > fMaxZ ) fMaxZ = vC.z;
+	io_pContext->fHiZMinZ = fMinZ - fMargin;
+	io_pContext->fHiZMaxZ = fMaxZ + fMargin;
+
+	// Bounding box, enlarged by a pixel and by the thickness of lines drawn in wireframe mode.
+	int32 iExtent = 1;
+	if( m_iRenderStates[m3drs_fillmode] == m3dfill_wireframe )
+		iExtent += m_iRenderStates[m3drs_linethickness] / 2;
+
+	float32 fMinX = vA.x, fMaxX = vA.x, fMinY = vA.y, fMaxY = vA.y;
+	if( vB.x < fMinX ) fMinX = vB.x; else if( vB.x > fMaxX ) fMaxX = vB.x;
+	if( vC.x < fMinX ) fMinX = vC.x; else if( vC.x > fMaxX ) fMaxX = vC.x;
+	if( vB.y < fMinY ) fMinY = vB.y; else if( vB.y > fMaxY ) fMaxY = vB.y;
+	if( vC.y < fMinY ) fMinY = vC.y; else if( vC.y > fMaxY ) fMaxY = vC.y;
+
+	int32 iMinX = ftol( floorf( fMinX ) ) - iExtent, iMaxX = ftol( ceilf( fMaxX ) ) + iExtent;
+	int32 iMinY = ftol( floorf( fMinY ) ) - iExtent, iMaxY = ftol( ceilf( fMaxY ) ) + iExtent;
+
+	m3drect ClipRect = m_RenderInfo.ViewportRect;
+	if( m_iRenderStates[m3drs_scissortestenable] )
+		ClipRect = m_ScissorRect;
+
+	if( iMinX < (int32)ClipRect.iLeft ) iMinX = ClipRect.iLeft;
+	if( iMinX < io_pContext->iTileLeft ) iMinX = io_pContext->iTileLeft;
+	if( iMinY < (int32)ClipRect.iTop ) iMinY = ClipRect.iTop;
+	if( iMinY < io_pContext->iTileTop ) iMinY = io_pContext->iTileTop;
+	if( iMaxX >= (int32)ClipRect.iRight ) iMaxX = ClipRect.iRight - 1;
+	if( iMaxX >= io_pContext->iTileRight ) iMaxX = io_pContext->iTileRight - 1;
+	if( iMaxY >= (int32)ClipRect.iBottom ) iMaxY = ClipRect.iBottom - 1;
+	if( iMaxY >= io_pContext->iTileBottom ) iMaxY = io_pContext->iTileBottom - 1;
+	if( iMinX > iMaxX || iMinY > iMaxY )
+		return false;
+
+	io_pContext->iHiZLeft = iMinX / c_iHiZBlockSize; io_pContext->iHiZRight = iMaxX / c_iHiZBlockSize;
+	io_pContext->iHiZTop = iMinY / c_iHiZBlockSize; io_pContext->iHiZBottom = iMaxY / c_iHiZBlockSize;
+
+	io_pContext->DepthCompare = m_RenderInfo.DepthCompare;
+	if( !m_RenderInfo.bHiZTest )
+		return true;
+
+	bool bHidden = true, bAccepted = true;
+	for( int32 iBlockY = io_pContext->iHiZTop; iBlockY <= io_pContext->iHiZBottom && ( bHidden || bAccepted ); ++iBlockY )
+	{
+		const float32 *pBounds = &m_RenderInfo.pHiZ[( iBlockY * m_RenderInfo.iHiZPitch + io_pContext->iHiZLeft ) * 2];
+		for( int32 iBlockX = io_pContext->iHiZLeft; iBlockX <= io_pContext->iHiZRight; ++iBlockX, pBounds += 2 )
 		{
-		case m3dsrt_vector4:
-			pDest->w += pDdx->w;
-		case m3dsrt_vector3:
-			pDest->z += pDdx->z;
-		case m3dsrt_vector2:
-			pDest->y += pDdx->y;
-		case m3dsrt_float32:
-			pDest->x += pDdx->x;
-		case m3dsrt_unused:
-		default: // cannot happen
-			break;
+			const int32 iResult = iHiZCompare( io_pContext->fHiZMinZ, io_pContext->fHiZMaxZ, pBounds );
+			if( iResult >= 0 ) bHidden = false;
+			if( iResult <= 0 ) bAccepted = false;
 		}
 	}
+
+	if( bHidden )
+		return false;
+
+	// Edges of wireframe-triangles share pixels, which have to be depth-tested against each other.
+	if( bAccepted && m_iRenderStates[m3drs_fillmode] == m3dfill_solid )
+		io_pContext->DepthCompare = m3dcmp_always;
+
+	return true;
+}
+
+void CMuli3DDevice::HiZUpdateTriangle( const rastercontext *i_pContext )
+{
+	if( !m_RenderInfo.bDepthWrite )
+		return;
+
+	for( int32 iBlockY = i_pContext->iHiZTop; iBlockY <= i_pContext->iHiZBottom; ++iBlockY )
+	{
+		for( int32 iBlockX = i_pContext->iHiZLeft; iBlockX <= i_pContext->iHiZRight; ++iBlockX )
+			HiZExtendBlock( iBlockY * m_RenderInfo.iHiZPitch + iBlockX, i_pContext->fHiZMinZ, i_pContext->fHiZMaxZ );
+	}
 }
 
-void CMuli3DDevice::RasterizeTriangle( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+void CMuli3DDevice::RasterizeTriangle( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
 {
-	CalculateTriangleGradients( i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 );
+	CalculateTriangleGradients( io_pContext, i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 );
+
+	// Skip triangles which are hidden by the contents of the depthbuffer.
+	if( m_RenderInfo.pHiZ && !bHiZTestTriangle( io_pContext, i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 ) )
+		return;
 
 	// If in wireframe mode draw triangle edges as lines.
 	if( m_iRenderStates[m3drs_fillmode] == m3dfill_wireframe )
 	{
-		RasterizeLine( i_pVSOutput0, i_pVSOutput1 );
-		RasterizeLine( i_pVSOutput1, i_pVSOutput2 );
-		RasterizeLine( i_pVSOutput2, i_pVSOutput0 );
+		RasterizeLine( io_pContext, i_pVSOutput0, i_pVSOutput1 );
+		RasterizeLine( io_pContext, i_pVSOutput1, i_pVSOutput2 );
+		RasterizeLine( io_pContext, i_pVSOutput2, i_pVSOutput0 );
+		if( m_RenderInfo.pHiZ )
+		{
+			HiZUpdateTriangle( io_pContext );
+			io_pContext->DepthCompare = m_RenderInfo.DepthCompare;
+		}
+		return;
+	}
+
+	if( m_iRenderStates[m3drs_rasterizer] == m3drast_halfspace )
+	{
+		// Blocks of the hierarchical depth buffer are tested and updated during traversal.
+		RasterizeTriangle_HalfSpace( io_pContext, i_pVSOutput0, i_pVSOutput1, i_pVSOutput2 );
+		if( m_RenderInfo.iPixelBatchSize )
+			FlushPixelBatch( io_pContext );
+		io_pContext->DepthCompare = m_RenderInfo.DepthCompare;
 		return;
 	}
 
@@ -2122,6 +3147,10 @@ void CMuli3DDevice::RasterizeTriangle( const m3dvsoutput *i_pVSOutput0, const m3
 		( vC.y - vA.y > 0.0f ) ? ( vC.x - vA.x ) / ( vC.y - vA.y ) : 0.0f,
 		( vC.y - vB.y > 0.0f ) ? ( vC.x - vB.x ) / ( vC.y - vB.y ) : 0.0f };
 
+	// Triangles which have passed the hierarchical depth-test everywhere skip the per-pixel test.
+	const rasterizescanlinefunc fpRasterizeScanline = ( io_pContext->DepthCompare == m3dcmp_always ) ?
+		m_RenderInfo.fpRasterizeScanlineNoDepthTest : m_RenderInfo.fpRasterizeScanline;
+
 	// Begin rasterization ----------------------------------------------------
 	float32 fX[2] = { vA.x, vA.x };
 	for( uint32 iPart = 0; iPart < 2; ++iPart )
@@ -2177,223 +3206,743 @@ void CMuli3DDevice::RasterizeTriangle( const m3dvsoutput *i_pVSOutput0, const m3
 
 		for( ; iY[0] < iY[1]; ++iY[0], fX[0] += fDeltaX[0], fX[1] += fDeltaX[1] )
 		{
+			// Restrict rasterization to the context's tile.
+			if( (int32)iY[0] < io_pContext->iTileTop )
+				continue;
+			if( (int32)iY[0] >= io_pContext->iTileBottom )
+				break;
+
 			const int32 iX[2] = { ftol( ceilf( fX[0] ) ), ftol( ceilf( fX[1] ) ) };
 			// const float32 fPreStepX = (float32)iX[0] - fX[0];
 
+			const int32 iSpanX[2] = { iX[0] > io_pContext->iTileLeft ? iX[0] : io_pContext->iTileLeft,
+				iX[1] < io_pContext->iTileRight ? iX[1] : io_pContext->iTileRight };
+			if( iSpanX[0] >= iSpanX[1] )
+				continue;
+
 			m3dvsoutput VSOutput;
-			SetVSOutputFromGradient( &VSOutput, (float32)iX[0], (float32)iY[0] );
-			m_TriangleInfo.iCurPixelY = iY[0];
-			(*this.*m_RenderInfo.fpRasterizeScanline)( iY[0], iX[0], iX[1], &VSOutput );
+			SetVSOutputFromGradient( io_pContext, &VSOutput, (float32)iX[0], (float32)iY[0] );
+
+			// Step to the tile's border instead of evaluating the gradients there, so
+			// that the interpolated values match those of an unrestricted scanline.
+			for( int32 iStep = iX[0]; iStep < iSpanX[0]; ++iStep )
+				StepXVSOutputFromGradient( io_pContext, &VSOutput );
+
+			io_pContext->TriangleInfo.iCurPixelY = iY[0];
+			(*this.*fpRasterizeScanline)( io_pContext, iY[0], iSpanX[0], iSpanX[1], &VSOutput );
 		}
 	}
+
+	// Shade the remaining pixels before the gradients change
+	if( m_RenderInfo.iPixelBatchSize )
+		FlushPixelBatch( io_pContext );
+
+	if( m_RenderInfo.pHiZ )
+	{
+		HiZUpdateTriangle( io_pContext );
+		io_pContext->DepthCompare = m_RenderInfo.DepthCompare;
+	}
 }
 
-void CMuli3DDevice::RasterizeScanline_ColorOnly( uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+CMuli3DDevice::rasterizescanlinefunc CMuli3DDevice::fpGetRasterizeScanline( m3dcmpfunc i_DepthCompare )
 {
-	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
-	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
-	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
-	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
+	switch( i_DepthCompare )
+	{
+	case m3dcmp_equal: return fpGetRasterizeScanline_WriteMasks<m3dcmp_equal>();
+	case m3dcmp_notequal: return fpGetRasterizeScanline_WriteMasks<m3dcmp_notequal>();
+	case m3dcmp_less: return fpGetRasterizeScanline_WriteMasks<m3dcmp_less>();
+	case m3dcmp_lessequal: return fpGetRasterizeScanline_WriteMasks<m3dcmp_lessequal>();
+	case m3dcmp_greaterequal: return fpGetRasterizeScanline_WriteMasks<m3dcmp_greaterequal>();
+	case m3dcmp_greater: return fpGetRasterizeScanline_WriteMasks<m3dcmp_greater>();
+	case m3dcmp_always: return fpGetRasterizeScanline_WriteMasks<m3dcmp_always>();
+	case m3dcmp_never:
+	default: // nothing will be drawn, so states don't matter
+		return &CMuli3DDevice::RasterizeScanline_ColorOnly<m3dcmp_never, false, false, 0, false>;
+	}
+}
 
-	for( ; i_iX < i_iX2; ++i_iX,
-		pFrameData += m_RenderInfo.iColorFloats, ++pDepthData,
-		StepXVSOutputFromGradient( io_pVSOutput ) )
+template<m3dcmpfunc DepthCompare>
+CMuli3DDevice::rasterizescanlinefunc CMuli3DDevice::fpGetRasterizeScanline_WriteMasks()
+{
+	if( m_RenderInfo.bDepthWrite )
+		return m_RenderInfo.bColorWrite ? fpGetRasterizeScanline_Output<DepthCompare, true, true>() : fpGetRasterizeScanline_Output<DepthCompare, true, false>();
+	else
+		return m_RenderInfo.bColorWrite ? fpGetRasterizeScanline_Output<DepthCompare, false, true>() : fpGetRasterizeScanline_Output<DepthCompare, false, false>();
+}
+
+template<m3dcmpfunc DepthCompare, bool bDepthWrite, bool bColorWrite>
+CMuli3DDevice::rasterizescanlinefunc CMuli3DDevice::fpGetRasterizeScanline_Output()
+{
+	if( m_RenderInfo.PixelShaderOutput == m3dpso_colordepth )
 	{
-		// Get depth of current pixel
-		float32 fDepth = io_pVSOutput->vPosition.z;
+		switch( m_RenderInfo.iColorLayout )
+		{
+		case 1: return &CMuli3DDevice::RasterizeScanline_ColorDepth<DepthCompare, bDepthWrite, bColorWrite, 1>;
+		case 2: return &CMuli3DDevice::RasterizeScanline_ColorDepth<DepthCompare, bDepthWrite, bColorWrite, 2>;
+		case 3: return &CMuli3DDevice::RasterizeScanline_ColorDepth<DepthCompare, bDepthWrite, bColorWrite, 3>;
+		case 4: return &CMuli3DDevice::RasterizeScanline_ColorDepth<DepthCompare, bDepthWrite, bColorWrite, 4>;
+		case c_iColorLayoutR8G8B8A8: return &CMuli3DDevice::RasterizeScanline_ColorDepth<DepthCompare, bDepthWrite, bColorWrite, c_iColorLayoutR8G8B8A8>;
+		case c_iColorLayoutR5G6B5: return &CMuli3DDevice::RasterizeScanline_ColorDepth<DepthCompare, bDepthWrite, bColorWrite, c_iColorLayoutR5G6B5>;
+		default: return &CMuli3DDevice::RasterizeScanline_ColorDepth<DepthCompare, bDepthWrite, bColorWrite, 0>;
+		}
+	}
 
-		// Perform depth-test
-		switch( m_RenderInfo.DepthCompare )
+	if( m_pPixelShader->bMightKillPixels() )
+	{
+		switch( m_RenderInfo.iColorLayout )
 		{
-		case m3dcmp_never: return;
-		case m3dcmp_equal: if( fabsf( fDepth - *pDepthData ) < FLT_EPSILON ) break; else continue;
-		case m3dcmp_notequal: if( fabsf( fDepth - *pDepthData ) >= FLT_EPSILON ) break; else continue;
-		case m3dcmp_less: if( fDepth < *pDepthData ) break; else continue;
-		case m3dcmp_lessequal: if( fDepth <= *pDepthData ) break; else continue;
-		case m3dcmp_greaterequal: if( fDepth >= *pDepthData ) break; else continue;
-		case m3dcmp_greater: if( fDepth > *pDepthData ) break; else continue;
-		case m3dcmp_always: break;
+		case 1: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 1, true>;
+		case 2: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 2, true>;
+		case 3: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 3, true>;
+		case 4: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 4, true>;
+		case c_iColorLayoutR8G8B8A8: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, c_iColorLayoutR8G8B8A8, true>;
+		case c_iColorLayoutR5G6B5: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, c_iColorLayoutR5G6B5, true>;
+		default: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 0, true>;
 		}
+	}
 
-		// passed depth test - update depthbuffer!
-		if( m_RenderInfo.bDepthWrite )
-			*pDepthData = fDepth;
+	// Without colorwrites, the colorbuffer isn't accessed at all.
+	switch( bColorWrite ? m_RenderInfo.iColorLayout : 0 )
+	{
+	case 1: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 1, false>;
+	case 2: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 2, false>;
+	case 3: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 3, false>;
+	case 4: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 4, false>;
+	case c_iColorLayoutR8G8B8A8: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, c_iColorLayoutR8G8B8A8, false>;
+	case c_iColorLayoutR5G6B5: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, c_iColorLayoutR5G6B5, false>;
+	default: return &CMuli3DDevice::RasterizeScanline_ColorOnly<DepthCompare, bDepthWrite, bColorWrite, 0, false>;
+	}
+}
 
-		if( m_RenderInfo.bColorWrite )
-		{
-			m3dvsoutput PSInput;
-			m_TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
-			MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, m_TriangleInfo.fCurPixelInvW );
-			// note: PSInput now only contains valid register data, position etc. are not initialized!
+// Switches in the following functions depend on template parameters only and are resolved at compile-time.
 
-			// Read in current pixel's color in the colorbuffer
-			vector4 vPixelColor( 0, 0, 0, 1 );
-			switch( m_RenderInfo.iColorFloats )
-			{
-			case 4: vPixelColor.a = pFrameData[3];
-			case 3: vPixelColor.b = pFrameData[2];
-			case 2: vPixelColor.g = pFrameData[1];
-			case 1: vPixelColor.r = pFrameData[0];
-			}
+/// Returns the size of a colorbuffer-pixel of the given layout in bytes; see RasterizeScanline_ColorOnly().
+template<uint32 iColorLayout>
+inline uint32 iGetColorLayoutBytes()
+{
+	switch( iColorLayout )
+	{
+	case c_iColorLayoutR8G8B8A8: return 4;
+	case c_iColorLayoutR5G6B5: return 2;
+	default: return iColorLayout * sizeof( float32 );
+	}
+}
 
-			// Execute the pixel shader
-			m_TriangleInfo.iCurPixelX = i_iX;
-			m_pPixelShader->bExecute( PSInput.ShaderOutputs, vPixelColor, fDepth );
+/// Reads a colorbuffer-pixel of the given layout. Channels which are not part of the layout are left untouched.
+template<uint32 iColorLayout>
+inline void ReadFrameColor( vector4 &io_vColor, const byte *i_pFrameData )
+{
+	const float32 *pFloats = (const float32 *)i_pFrameData;
+	switch( iColorLayout )
+	{
+	case 4: io_vColor.a = pFloats[3];
+	case 3: io_vColor.b = pFloats[2];
+	case 2: io_vColor.g = pFloats[1];
+	case 1: io_vColor.r = pFloats[0]; break;
+	case c_iColorLayoutR8G8B8A8: DecodePixel( io_vColor, m3dfmt_r8g8b8a8, i_pFrameData ); break;
+	case c_iColorLayoutR5G6B5: DecodePixel( io_vColor, m3dfmt_r5g6b5, i_pFrameData ); break;
+	}
+}
 
-			// Write the new color to the colorbuffer
-			switch( m_RenderInfo.iColorFloats )
-			{
-			case 4: pFrameData[3] = vPixelColor.a;
-			case 3: pFrameData[2] = vPixelColor.b;
-			case 2: pFrameData[1] = vPixelColor.g;
-			case 1: pFrameData[0] = vPixelColor.r;
-			}
-		}
+/// Writes a colorbuffer-pixel of the given layout.
+template<uint32 iColorLayout>
+inline void WriteFrameColor( byte *o_pFrameData, const vector4 &i_vColor )
+{
+	float32 *pFloats = (float32 *)o_pFrameData;
+	switch( iColorLayout )
+	{
+	case 4: pFloats[3] = i_vColor.a;
+	case 3: pFloats[2] = i_vColor.b;
+	case 2: pFloats[1] = i_vColor.g;
+	case 1: pFloats[0] = i_vColor.r; break;
+	case c_iColorLayoutR8G8B8A8: EncodePixel( o_pFrameData, m3dfmt_r8g8b8a8, i_vColor ); break;
+	case c_iColorLayoutR5G6B5: *(uint16 *)o_pFrameData = iPackR5G6B5( i_vColor ); break;
+	}
+}
 
-		++m_RenderInfo.iRenderedPixels;
+/// Reads a colorbuffer-pixel of a layout, which is only known at runtime; see ReadFrameColor().
+inline void ReadFrameColor( uint32 i_iColorLayout, vector4 &io_vColor, const byte *i_pFrameData )
+{
+	switch( i_iColorLayout )
+	{
+	case 1: ReadFrameColor<1>( io_vColor, i_pFrameData ); break;
+	case 2: ReadFrameColor<2>( io_vColor, i_pFrameData ); break;
+	case 3: ReadFrameColor<3>( io_vColor, i_pFrameData ); break;
+	case 4: ReadFrameColor<4>( io_vColor, i_pFrameData ); break;
+	case c_iColorLayoutR8G8B8A8: ReadFrameColor<c_iColorLayoutR8G8B8A8>( io_vColor, i_pFrameData ); break;
+	case c_iColorLayoutR5G6B5: ReadFrameColor<c_iColorLayoutR5G6B5>( io_vColor, i_pFrameData ); break;
+	default: break; // no colorbuffer
 	}
 }
 
-void CMuli3DDevice::RasterizeScanline_ColorOnly_MightKillPixels( uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+/// Writes a colorbuffer-pixel of a layout, which is only known at runtime; see WriteFrameColor().
+inline void WriteFrameColor( uint32 i_iColorLayout, byte *o_pFrameData, const vector4 &i_vColor )
 {
-	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
-	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
-	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
-	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
+	switch( i_iColorLayout )
+	{
+	case 1: WriteFrameColor<1>( o_pFrameData, i_vColor ); break;
+	case 2: WriteFrameColor<2>( o_pFrameData, i_vColor ); break;
+	case 3: WriteFrameColor<3>( o_pFrameData, i_vColor ); break;
+	case 4: WriteFrameColor<4>( o_pFrameData, i_vColor ); break;
+	case c_iColorLayoutR8G8B8A8: WriteFrameColor<c_iColorLayoutR8G8B8A8>( o_pFrameData, i_vColor ); break;
+	case c_iColorLayoutR5G6B5: WriteFrameColor<c_iColorLayoutR5G6B5>( o_pFrameData, i_vColor ); break;
+	default: break; // no colorbuffer
+	}
+}
+
+/// Compares a pixel's depth with the depth stored in the depthbuffer; m3dcmp_never and m3dcmp_always have to be handled by the caller.
+template<m3dcmpfunc DepthCompare, class type>
+inline bool bCompareDepth( type i_Depth, type i_BufferDepth )
+{
+	switch( DepthCompare )
+	{
+	case m3dcmp_equal: return i_Depth == i_BufferDepth;
+	case m3dcmp_notequal: return i_Depth != i_BufferDepth;
+	case m3dcmp_less: return i_Depth < i_BufferDepth;
+	case m3dcmp_lessequal: return i_Depth <= i_BufferDepth;
+	case m3dcmp_greaterequal: return i_Depth >= i_BufferDepth;
+	case m3dcmp_greater: return i_Depth > i_BufferDepth;
+	default: return true;
+	}
+}
+
+/// Performs the depth-test of a pixel. Fixed-point depthbuffers compare the pixel's depth at the precision they store it with, so that
+/// surfaces drawn a second time pass m3dcmp_equal and m3dcmp_lessequal-tests. The depthbuffer isn't accessed for m3dcmp_always.
+template<m3dcmpfunc DepthCompare>
+inline bool bDepthTest( float32 i_fDepth, const byte *i_pDepthData, m3dformat i_fmtDepth )
+{
+	switch( DepthCompare )
+	{
+	case m3dcmp_never: return false;
+	case m3dcmp_always: return true;
+	default: break;
+	}
+
+	switch( i_fmtDepth )
+	{
+	case m3dfmt_d16: return bCompareDepth<DepthCompare, uint32>( iFloatToUNorm16( i_fDepth ), *(const uint16 *)i_pDepthData );
+	case m3dfmt_d24: return bCompareDepth<DepthCompare, uint32>( iFloatToUNorm24( i_fDepth ), *(const uint32 *)i_pDepthData );
+	default: break;
+	}
+
+	const float32 fBufferDepth = *(const float32 *)i_pDepthData;
+	switch( DepthCompare )
+	{
+	case m3dcmp_equal: return fabsf( i_fDepth - fBufferDepth ) < FLT_EPSILON;
+	case m3dcmp_notequal: return fabsf( i_fDepth - fBufferDepth ) >= FLT_EPSILON;
+	default: return bCompareDepth<DepthCompare, float32>( i_fDepth, fBufferDepth );
+	}
+}
+
+/// Performs the depth-test of a pixel for a compare-function, which is only known at runtime; see bDepthTest().
+inline bool bDepthTest( m3dcmpfunc i_DepthCompare, float32 i_fDepth, const byte *i_pDepthData, m3dformat i_fmtDepth )
+{
+	switch( i_DepthCompare )
+	{
+	case m3dcmp_equal: return bDepthTest<m3dcmp_equal>( i_fDepth, i_pDepthData, i_fmtDepth );
+	case m3dcmp_notequal: return bDepthTest<m3dcmp_notequal>( i_fDepth, i_pDepthData, i_fmtDepth );
+	case m3dcmp_less: return bDepthTest<m3dcmp_less>( i_fDepth, i_pDepthData, i_fmtDepth );
+	case m3dcmp_lessequal: return bDepthTest<m3dcmp_lessequal>( i_fDepth, i_pDepthData, i_fmtDepth );
+	case m3dcmp_greaterequal: return bDepthTest<m3dcmp_greaterequal>( i_fDepth, i_pDepthData, i_fmtDepth );
+	case m3dcmp_greater: return bDepthTest<m3dcmp_greater>( i_fDepth, i_pDepthData, i_fmtDepth );
+	case m3dcmp_always: return true;
+	case m3dcmp_never: default: return false;
+	}
+}
+
+/// Writes a pixel's depth to the depthbuffer.
+inline void WriteDepth( byte *o_pDepthData, m3dformat i_fmtDepth, float32 i_fDepth )
+{
+	switch( i_fmtDepth )
+	{
+	case m3dfmt_d16: *(uint16 *)o_pDepthData = iFloatToUNorm16( i_fDepth ); break;
+	case m3dfmt_d24: *(uint32 *)o_pDepthData = iFloatToUNorm24( i_fDepth ); break;
+	default: *(float32 *)o_pDepthData = i_fDepth; break;
+	}
+}
+
+
+template<m3dcmpfunc DepthCompare, bool bDepthWrite, bool bColorWrite, uint32 iColorLayout, bool bMightKillPixels>
+void CMuli3DDevice::RasterizeScanline_ColorOnly( rastercontext *io_pContext, uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+{
+	const m3dformat fmtDepth = m_RenderInfo.DepthFormat;
+	byte *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * iGetColorLayoutBytes<iColorLayout>());
+	byte *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX * m_RenderInfo.iDepthPixelBytes);
 
 	for( ; i_iX < i_iX2; ++i_iX,
-		pFrameData += m_RenderInfo.iColorFloats, ++pDepthData,
-		StepXVSOutputFromGradient( io_pVSOutput ) )
+		pFrameData += iGetColorLayoutBytes<iColorLayout>(), pDepthData += m_RenderInfo.iDepthPixelBytes,
+		StepXVSOutputFromGradient( io_pContext, io_pVSOutput ) )
 	{
 		// Get depth of current pixel
 		float32 fDepth = io_pVSOutput->vPosition.z;
 
 		// Perform depth-test
-		switch( m_RenderInfo.DepthCompare )
-		{
-		case m3dcmp_never: return;
-		case m3dcmp_equal: if( fabsf( fDepth - *pDepthData ) < FLT_EPSILON ) break; else continue;
-		case m3dcmp_notequal: if( fabsf( fDepth - *pDepthData ) >= FLT_EPSILON ) break; else continue;
-		case m3dcmp_less: if( fDepth < *pDepthData ) break; else continue;
-		case m3dcmp_lessequal: if( fDepth <= *pDepthData ) break; else continue;
-		case m3dcmp_greaterequal: if( fDepth >= *pDepthData ) break; else continue;
-		case m3dcmp_greater: if( fDepth > *pDepthData ) break; else continue;
-		case m3dcmp_always: break;
-		}
+		if( DepthCompare == m3dcmp_never )
+			return;
+		if( !bDepthTest<DepthCompare>( fDepth, pDepthData, fmtDepth ) )
+			continue;
+
+		// passed depth test - if the pixel cannot be killed, update depthbuffer right away!
+		if( bDepthWrite && !bMightKillPixels )
+			WriteDepth( pDepthData, fmtDepth, fDepth );
 
-		if( m_RenderInfo.bColorWrite || m_RenderInfo.bDepthWrite )
+		if( bColorWrite || ( bDepthWrite && bMightKillPixels ) )
 		{
 			m3dvsoutput PSInput;
-			m_TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
-			MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, m_TriangleInfo.fCurPixelInvW );
+			io_pContext->TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
+			MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, io_pContext->TriangleInfo.fCurPixelInvW );
 			// note: PSInput now only contains valid register data, position etc. are not initialized!
 
 			// Read in current pixel's color in the colorbuffer
 			vector4 vPixelColor( 0, 0, 0, 1 );
-			switch( m_RenderInfo.iColorFloats )
-			{
-			case 4: vPixelColor.a = pFrameData[3];
-			case 3: vPixelColor.b = pFrameData[2];
-			case 2: vPixelColor.g = pFrameData[1];
-			case 1: vPixelColor.r = pFrameData[0];
-			}
+			ReadFrameColor<iColorLayout>( vPixelColor, pFrameData );
 
 			// Execute the pixel shader
-			m_TriangleInfo.iCurPixelX = i_iX;
-			if( !m_pPixelShader->bExecute( PSInput.ShaderOutputs, vPixelColor, fDepth ) )
+			io_pContext->TriangleInfo.iCurPixelX = i_iX;
+			if( !m_pPixelShader->bExecute( PSInput.ShaderOutputs, vPixelColor, fDepth ) && bMightKillPixels )
 				continue; // pixel got killed
 
 			// Passed depth-test and pixel was not killed, so update depthbuffer
-			if( m_RenderInfo.bDepthWrite )
-				*pDepthData = fDepth;
+			if( bDepthWrite && bMightKillPixels )
+				WriteDepth( pDepthData, fmtDepth, fDepth );
 
 			// Write the new color to the colorbuffer
-			if( m_RenderInfo.bColorWrite )
-			{
-				switch( m_RenderInfo.iColorFloats )
-				{
-				case 4: pFrameData[3] = vPixelColor.a;
-				case 3: pFrameData[2] = vPixelColor.b;
-				case 2: pFrameData[1] = vPixelColor.g;
-				case 1: pFrameData[0] = vPixelColor.r;
-				}
-			}
+			if( bColorWrite )
+				WriteFrameColor<iColorLayout>( pFrameData, vPixelColor );
 		}
 
-		++m_RenderInfo.iRenderedPixels;
+		++io_pContext->iRenderedPixels;
 	}
 }
 
-void CMuli3DDevice::RasterizeScanline_ColorDepth( uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+template<m3dcmpfunc DepthCompare, bool bDepthWrite, bool bColorWrite, uint32 iColorLayout>
+void CMuli3DDevice::RasterizeScanline_ColorDepth( rastercontext *io_pContext, uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
 {
-	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
-	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
-	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX] : 0;
-	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX] : 0;
+	const m3dformat fmtDepth = m_RenderInfo.DepthFormat;
+	byte *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * iGetColorLayoutBytes<iColorLayout>());
+	byte *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX * m_RenderInfo.iDepthPixelBytes);
 
 	for( ; i_iX < i_iX2; ++i_iX,
-		pFrameData += m_RenderInfo.iColorFloats, ++pDepthData,
-		StepXVSOutputFromGradient( io_pVSOutput ) )
+		pFrameData += iGetColorLayoutBytes<iColorLayout>(), pDepthData += m_RenderInfo.iDepthPixelBytes,
+		StepXVSOutputFromGradient( io_pContext, io_pVSOutput ) )
 	{
 		m3dvsoutput PSInput;
-		m_TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
-		MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, m_TriangleInfo.fCurPixelInvW );
+		io_pContext->TriangleInfo.fCurPixelInvW = 1.0f / io_pVSOutput->vPosition.w;
+		MultiplyVertexShaderOutputRegisters( &PSInput, io_pVSOutput, io_pContext->TriangleInfo.fCurPixelInvW );
 		// note: PSInput now only contains valid register data, position etc. are not initialized!
 
 		// Read in current colorbuffer-color
 		vector4 vPixelColor( 0, 0, 0, 1 );
-		switch( m_RenderInfo.iColorFloats )
-		{
-		case 4: vPixelColor.a = pFrameData[3];
-		case 3: vPixelColor.b = pFrameData[2];
-		case 2: vPixelColor.g = pFrameData[1];
-		case 1: vPixelColor.r = pFrameData[0];
-		}
+		ReadFrameColor<iColorLayout>( vPixelColor, pFrameData );
 
 		// Get depth of current pixel
 		float32 fDepth = io_pVSOutput->vPosition.z;
 
 		// Execute pixel shader
-		m_TriangleInfo.iCurPixelX = i_iX;
+		io_pContext->TriangleInfo.iCurPixelX = i_iX;
 		if( !m_pPixelShader->bExecute( PSInput.ShaderOutputs, vPixelColor, fDepth ) )
 			continue; // pixel got killed
 
 		// Perform depth-test
-		switch( m_RenderInfo.DepthCompare )
-		{
-		case m3dcmp_never: return;
-		case m3dcmp_equal: if( fabsf( fDepth - *pDepthData ) < FLT_EPSILON ) break; else continue;
-		case m3dcmp_notequal: if( fabsf( fDepth - *pDepthData ) >= FLT_EPSILON ) break; else continue;
-		case m3dcmp_less: if( fDepth < *pDepthData ) break; else continue;
-		case m3dcmp_lessequal: if( fDepth <= *pDepthData ) break; else continue;
-		case m3dcmp_greaterequal: if( fDepth >= *pDepthData ) break; else continue;
-		case m3dcmp_greater: if( fDepth > *pDepthData ) break; else continue;
-		case m3dcmp_always: break;
-		}
+		if( DepthCompare == m3dcmp_never )
+			return;
+		if( !bDepthTest<DepthCompare>( fDepth, pDepthData, fmtDepth ) )
+			continue;
 
 		// Passed depth-test, so update depthbuffer
-		if( m_RenderInfo.bDepthWrite )
-			*pDepthData = fDepth;
+		if( bDepthWrite )
+			WriteDepth( pDepthData, fmtDepth, fDepth );
 
 		// Write new color to colorbuffer
-		if( m_RenderInfo.bColorWrite )
+		if( bColorWrite )
+			WriteFrameColor<iColorLayout>( pFrameData, vPixelColor );
+
+		++io_pContext->iRenderedPixels;
+	}
+}
+
+void CMuli3DDevice::RasterizeTriangle_HalfSpace( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1, const m3dvsoutput *i_pVSOutput2 )
+{
+	// Snap vertices to the sub-pixel grid ------------------------------------
+	const float32 fSubPixels = (float32)( 1 << c_iSubPixelBits );
+	int32 iVertexX[3] = { ftol( i_pVSOutput0->vPosition.x * fSubPixels + 0.5f ),
+		ftol( i_pVSOutput1->vPosition.x * fSubPixels + 0.5f ),
+		ftol( i_pVSOutput2->vPosition.x * fSubPixels + 0.5f ) };
+	int32 iVertexY[3] = { ftol( i_pVSOutput0->vPosition.y * fSubPixels + 0.5f ),
+		ftol( i_pVSOutput1->vPosition.y * fSubPixels + 0.5f ),
+		ftol( i_pVSOutput2->vPosition.y * fSubPixels + 0.5f ) };
+
+	// Make sure the triangle's interior lies on the positive side of all edges.
+	const int64 iArea = (int64)( iVertexX[1] - iVertexX[0] ) * ( iVertexY[2] - iVertexY[0] ) -
+		(int64)( iVertexY[1] - iVertexY[0] ) * ( iVertexX[2] - iVertexX[0] );
+	if( !iArea )
+		return; // degenerate triangle
+
+	if( iArea < 0 )
+	{
+		int32 iTemp = iVertexX[1]; iVertexX[1] = iVertexX[2]; iVertexX[2] = iTemp;
+		iTemp = iVertexY[1]; iVertexY[1] = iVertexY[2]; iVertexY[2] = iTemp;
+	}
+
+	// Determine the pixels to be traversed -----------------------------------
+	int32 iMinX = iVertexX[0], iMaxX = iVertexX[0], iMinY = iVertexY[0], iMaxY = iVertexY[0];
+	for( uint32 iVertex = 1; iVertex < 3; ++iVertex )
+	{
+		if( iVertexX[iVertex] < iMinX ) iMinX = iVertexX[iVertex]; else if( iVertexX[iVertex] > iMaxX ) iMaxX = iVertexX[iVertex];
+		if( iVertexY[iVertex] < iMinY ) iMinY = iVertexY[iVertex]; else if( iVertexY[iVertex] > iMaxY ) iMaxY = iVertexY[iVertex];
+	}
+
+	// Pixels are sampled at integer coordinates; the maximum is inclusive.
+	const int32 iSubPixelMask = ( 1 << c_iSubPixelBits ) - 1;
+	iMinX = ( iMinX + iSubPixelMask ) >> c_iSubPixelBits; iMaxX >>= c_iSubPixelBits;
+	iMinY = ( iMinY + iSubPixelMask ) >> c_iSubPixelBits; iMaxY >>= c_iSubPixelBits;
+
+	m3drect ClipRect = m_RenderInfo.ViewportRect;
+	if( m_iRenderStates[m3drs_scissortestenable] )
+		ClipRect = m_ScissorRect;
+
+	if( iMinX < (int32)ClipRect.iLeft ) iMinX = ClipRect.iLeft;
+	if( iMinX < io_pContext->iTileLeft ) iMinX = io_pContext->iTileLeft;
+	if( iMinY < (int32)ClipRect.iTop ) iMinY = ClipRect.iTop;
+	if( iMinY < io_pContext->iTileTop ) iMinY = io_pContext->iTileTop;
+	if( iMaxX >= (int32)ClipRect.iRight ) iMaxX = ClipRect.iRight - 1;
+	if( iMaxX >= io_pContext->iTileRight ) iMaxX = io_pContext->iTileRight - 1;
+	if( iMaxY >= (int32)ClipRect.iBottom ) iMaxY = ClipRect.iBottom - 1;
+	if( iMaxY >= io_pContext->iTileBottom ) iMaxY = io_pContext->iTileBottom - 1;
+	if( iMinX > iMaxX || iMinY > iMaxY )
+		return;
+
+	// Setup edge functions ---------------------------------------------------
+	// E(x,y) = A * (x - x0) + B * (y - y0) is positive inside the triangle. Following the top-left
+	// fill-rule pixels lying exactly on an edge are only drawn for top and left edges, which
+	// is achieved by biasing the remaining edge functions by -1.
+	int64 iEdgeA[3], iEdgeB[3], iEdgeRow[3];
+	for( uint32 iEdge = 0; iEdge < 3; ++iEdge )
+	{
+		const uint32 iNext = ( iEdge + 1 ) % 3;
+		const int32 iDeltaX = iVertexX[iNext] - iVertexX[iEdge];
+		const int32 iDeltaY = iVertexY[iNext] - iVertexY[iEdge];
+		const bool bTopLeft = ( iDeltaY < 0 ) || ( iDeltaY == 0 && iDeltaX > 0 );
+
+		iEdgeA[iEdge] = -(int64)iDeltaY;
+		iEdgeB[iEdge] = iDeltaX;
+
+		// Evaluate at the first block's upper left pixel.
+		const int32 iBlockX = iMinX & ~( c_iHalfSpaceBlockSize - 1 ), iBlockY = iMinY & ~( c_iHalfSpaceBlockSize - 1 );
+		iEdgeRow[iEdge] = iEdgeA[iEdge] * ( ( (int64)iBlockX << c_iSubPixelBits ) - iVertexX[iEdge] ) +
+			iEdgeB[iEdge] * ( ( (int64)iBlockY << c_iSubPixelBits ) - iVertexY[iEdge] ) - ( bTopLeft ? 0 : 1 );
+
+		// From now on the coefficients are used for stepping from pixel to pixel.
+		iEdgeA[iEdge] <<= c_iSubPixelBits;
+		iEdgeB[iEdge] <<= c_iSubPixelBits;
+	}
+
+	// Traverse blocks --------------------------------------------------------
+	const int32 iBlockSize = (int32)c_iHalfSpaceBlockSize;
+	for( int32 iBlockY = iMinY & ~( iBlockSize - 1 ); iBlockY <= iMaxY; iBlockY += iBlockSize )
+	{
+		int64 iEdgeBlock[3] = { iEdgeRow[0], iEdgeRow[1], iEdgeRow[2] };
+		const int32 iBlockMinY = iBlockY > iMinY ? iBlockY : iMinY;
+		const int32 iBlockMaxY = iBlockY + iBlockSize - 1 < iMaxY ? iBlockY + iBlockSize - 1 : iMaxY;
+
+		for( int32 iBlockX = iMinX & ~( iBlockSize - 1 ); iBlockX <= iMaxX; iBlockX += iBlockSize )
 		{
-			switch( m_RenderInfo.iColorFloats )
+			const int32 iBlockMinX = iBlockX > iMinX ? iBlockX : iMinX;
+			const int32 iBlockMaxX = iBlockX + iBlockSize - 1 < iMaxX ? iBlockX + iBlockSize - 1 : iMaxX;
+
+			// Edge functions are linear, so testing the corners of the block is sufficient
+			// to determine if it lies completely outside or inside of the triangle.
+			bool bOutside = false, bInside = true;
+			for( uint32 iEdge = 0; iEdge < 3 && !bOutside; ++iEdge )
 			{
-			case 4: pFrameData[3] = vPixelColor.a;
-			case 3: pFrameData[2] = vPixelColor.b;
-			case 2: pFrameData[1] = vPixelColor.g;
-			case 1: pFrameData[0] = vPixelColor.r;
+				const int64 iLeft = ( iBlockMinX - iBlockX ) * iEdgeA[iEdge], iRight = ( iBlockMaxX - iBlockX ) * iEdgeA[iEdge];
+				const int64 iTop = ( iBlockMinY - iBlockY ) * iEdgeB[iEdge], iBottom = ( iBlockMaxY - iBlockY ) * iEdgeB[iEdge];
+				const int64 iCorners[4] = { iEdgeBlock[iEdge] + iLeft + iTop, iEdgeBlock[iEdge] + iRight + iTop,
+					iEdgeBlock[iEdge] + iLeft + iBottom, iEdgeBlock[iEdge] + iRight + iBottom };
+
+				const uint32 iNumInside = ( iCorners[0] >= 0 ) + ( iCorners[1] >= 0 ) + ( iCorners[2] >= 0 ) + ( iCorners[3] >= 0 );
+				if( !iNumInside )
+					bOutside = true;
+				else if( iNumInside < 4 )
+					bInside = false;
 			}
+
+			// Test the block against the hierarchical depth buffer using the depth range of
+			// the plane across the traversed region, which is linear in x and y.
+			int32 iHiZResult = 0;
+			uint32 iHiZBlock = 0;
+			float32 fBlockMinZ = 0.0f, fBlockMaxZ = 0.0f;
+			if( !bOutside && m_RenderInfo.pHiZ )
+			{
+				iHiZBlock = ( iBlockY / c_iHiZBlockSize ) * m_RenderInfo.iHiZPitch + iBlockX / c_iHiZBlockSize;
+
+				const m3dtriangleinfo &TriangleInfo = io_pContext->TriangleInfo;
+				const float32 fZ = TriangleInfo.pBaseVertex->vPosition.z +
+					TriangleInfo.fZDdx * ( (float32)iBlockMinX - TriangleInfo.pBaseVertex->vPosition.x ) +
+					TriangleInfo.fZDdy * ( (float32)iBlockMinY - TriangleInfo.pBaseVertex->vPosition.y );
+				const float32 fDeltaX = TriangleInfo.fZDdx * (float32)( iBlockMaxX - iBlockMinX );
+				const float32 fDeltaY = TriangleInfo.fZDdy * (float32)( iBlockMaxY - iBlockMinY );
+				fBlockMinZ = fZ + ( fDeltaX < 0.0f ? fDeltaX : 0.0f ) + ( fDeltaY < 0.0f ? fDeltaY : 0.0f );
+				fBlockMaxZ = fZ + ( fDeltaX > 0.0f ? fDeltaX : 0.0f ) + ( fDeltaY > 0.0f ? fDeltaY : 0.0f );
+				if( fBlockMinZ < io_pContext->fHiZMinZ ) fBlockMinZ = io_pContext->fHiZMinZ;
+				if( fBlockMaxZ > io_pContext->fHiZMaxZ ) fBlockMaxZ = io_pContext->fHiZMaxZ;
+
+				if( m_RenderInfo.bHiZTest )
+					iHiZResult = iHiZCompare( fBlockMinZ, fBlockMaxZ, &m_RenderInfo.pHiZ[iHiZBlock * 2] );
+				io_pContext->DepthCompare = ( iHiZResult > 0 ) ? m3dcmp_always : m_RenderInfo.DepthCompare;
+			}
+
+			if( !bOutside && iHiZResult >= 0 )
+			{
+				// Traverse the block's quads
+				for( int32 iQuadY = iBlockMinY & ~1; iQuadY <= iBlockMaxY; iQuadY += 2 )
+				{
+					// Pixels outside of the traversed area are masked out.
+					uint32 iRowMask = 15;
+					if( iQuadY < iMinY ) iRowMask &= ~3;
+					if( iQuadY + 1 > iMaxY ) iRowMask &= ~12;
+
+					for( int32 iQuadX = iBlockMinX & ~1; iQuadX <= iBlockMaxX; iQuadX += 2 )
+					{
+						uint32 iCoverageMask = iRowMask;
+						if( iQuadX < iMinX ) iCoverageMask &= ~5;
+						if( iQuadX + 1 > iMaxX ) iCoverageMask &= ~10;
+
+						if( !bInside )
+						{
+							for( uint32 iEdge = 0; iEdge < 3 && iCoverageMask; ++iEdge )
+							{
+								const int64 iEdgeValue = iEdgeBlock[iEdge] + ( iQuadX - iBlockX ) * iEdgeA[iEdge] + ( iQuadY - iBlockY ) * iEdgeB[iEdge];
+								if( iEdgeValue < 0 ) iCoverageMask &= ~1;
+								if( iEdgeValue + iEdgeA[iEdge] < 0 ) iCoverageMask &= ~2;
+								if( iEdgeValue + iEdgeB[iEdge] < 0 ) iCoverageMask &= ~4;
+								if( iEdgeValue + iEdgeA[iEdge] + iEdgeB[iEdge] < 0 ) iCoverageMask &= ~8;
+							}
+						}
+
+						if( iCoverageMask )
+							RasterizeQuad( io_pContext, iQuadX, iQuadY, iCoverageMask );
+					}
+				}
+
+				if( m_RenderInfo.pHiZ && m_RenderInfo.bDepthWrite )
+				{
+					// If every pixel of the block has passed the depth-test and none has been killed,
+					// the triangle's depth range replaces the block's bounds.
+					if( iHiZResult > 0 && bInside && !m_RenderInfo.bMightKillPixels &&
+						iBlockMaxX - iBlockMinX == iBlockSize - 1 && iBlockMaxY - iBlockMinY == iBlockSize - 1 )
+					{
+						float32 *pBounds = &m_RenderInfo.pHiZ[iHiZBlock * 2];
+						pBounds[0] = fBlockMinZ; pBounds[1] = fBlockMaxZ;
+						m_RenderInfo.pHiZDirty[iHiZBlock] = 0;
+					}
+					else
+						HiZExtendBlock( iHiZBlock, fBlockMinZ, fBlockMaxZ );
+				}
+			}
+
+			for( uint32 iEdge = 0; iEdge < 3; ++iEdge )
+				iEdgeBlock[iEdge] += iBlockSize * iEdgeA[iEdge];
+		}
+
+		for( uint32 iEdge = 0; iEdge < 3; ++iEdge )
+			iEdgeRow[iEdge] += iBlockSize * iEdgeB[iEdge];
+	}
+}
+
+void CMuli3DDevice::RasterizeQuad( rastercontext *io_pContext, uint32 i_iX, uint32 i_iY, uint32 i_iCoverageMask )
+{
+	// Interpolate vertex data for all four pixels of the quad: the upper left
+	// pixel is set up from the gradients, the others are offset from it.
+	m3dvsoutput Quad[4];
+	SetVSOutputFromGradient( io_pContext, &Quad[0], (float32)i_iX, (float32)i_iY );
+
+	const m3dtriangleinfo &TriangleInfo = io_pContext->TriangleInfo;
+	Quad[1].vPosition.z = Quad[0].vPosition.z + TriangleInfo.fZDdx;
+	Quad[1].vPosition.w = Quad[0].vPosition.w + TriangleInfo.fWDdx;
+	Quad[2].vPosition.z = Quad[0].vPosition.z + TriangleInfo.fZDdy;
+	Quad[2].vPosition.w = Quad[0].vPosition.w + TriangleInfo.fWDdy;
+	Quad[3].vPosition.z = Quad[2].vPosition.z + TriangleInfo.fZDdx;
+	Quad[3].vPosition.w = Quad[2].vPosition.w + TriangleInfo.fWDdx;
+
+	for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg )
+	{
+		const shaderreg &vBase = Quad[0].ShaderOutputs[iReg];
+		const shaderreg &vDdx = TriangleInfo.ShaderOutputsDdx[iReg];
+		const shaderreg &vDdy = TriangleInfo.ShaderOutputsDdy[iReg];
+		shaderreg &vRight = Quad[1].ShaderOutputs[iReg];
+		shaderreg &vBelow = Quad[2].ShaderOutputs[iReg];
+		shaderreg &vBelowRight = Quad[3].ShaderOutputs[iReg];
+
+		// Unused components are zeroed out, as done by SetVSOutputFromGradient().
+		vRight = vBelow = vBelowRight = vector4( 0, 0, 0, 0 );
+		switch( m_RenderInfo.VSOutputs[iReg] )
+		{
+		case m3dsrt_vector4:
+			vRight.w = vBase.w + vDdx.w; vBelow.w = vBase.w + vDdy.w; vBelowRight.w = vBelow.w + vDdx.w;
+		case m3dsrt_vector3:
+			vRight.z = vBase.z + vDdx.z; vBelow.z = vBase.z + vDdy.z; vBelowRight.z = vBelow.z + vDdx.z;
+		case m3dsrt_vector2:
+			vRight.y = vBase.y + vDdx.y; vBelow.y = vBase.y + vDdy.y; vBelowRight.y = vBelow.y + vDdx.y;
+		case m3dsrt_float32:
+			vRight.x = vBase.x + vDdx.x; vBelow.x = vBase.x + vDdy.x; vBelowRight.x = vBelow.x + vDdx.x;
+		case m3dsrt_unused:
+		default:
+			break;
+		}
+	}
+
+	for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+	{
+		if( !( i_iCoverageMask & ( 1 << iPixel ) ) )
+			continue;
+
+		if( m_RenderInfo.iPixelBatchSize )
+		{
+			BatchPixel( io_pContext, i_iX + ( iPixel & 1 ), i_iY + ( iPixel >> 1 ), &Quad[iPixel] );
+			continue;
 		}
 
-		++m_RenderInfo.iRenderedPixels;
+		m3dvsoutput *pPSInput = &Quad[iPixel];
+		io_pContext->TriangleInfo.fCurPixelInvW = 1.0f / pPSInput->vPosition.w;
+		MultiplyVertexShaderOutputRegisters( pPSInput, pPSInput, io_pContext->TriangleInfo.fCurPixelInvW );
+
+		(*this.*m_RenderInfo.fpDrawPixel)( io_pContext, i_iX + ( iPixel & 1 ), i_iY + ( iPixel >> 1 ), pPSInput );
+	}
+}
+
+void CMuli3DDevice::RasterizeScanline_Batch( rastercontext *io_pContext, uint32 i_iY, uint32 i_iX, uint32 i_iX2, m3dvsoutput *io_pVSOutput )
+{
+	for( ; i_iX < i_iX2; ++i_iX, StepXVSOutputFromGradient( io_pContext, io_pVSOutput ) )
+		BatchPixel( io_pContext, i_iX, i_iY, io_pVSOutput );
+}
+
+void CMuli3DDevice::BatchPixel( rastercontext *io_pContext, uint32 i_iX, uint32 i_iY, const m3dvsoutput *i_pVSOutput )
+{
+	const float32 fDepth = i_pVSOutput->vPosition.z;
+
+	// Perform early depth-test, if the pixel shader doesn't output depth
+	if( m_RenderInfo.PixelShaderOutput == m3dpso_coloronly )
+	{
+		const byte *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX * m_RenderInfo.iDepthPixelBytes);
+		if( !bDepthTest( io_pContext->DepthCompare, fDepth, pDepthData, m_RenderInfo.DepthFormat ) )
+			return;
+	}
+
+	// Store the pixel in the lane of the batch
+	const uint32 iLane = io_pContext->iBatchedPixels;
+	m3dpixelbatch &Batch = io_pContext->PixelBatch;
+
+	const float32 fInvW = 1.0f / i_pVSOutput->vPosition.w;
+	for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg )
+	{
+		const shaderreg &vSrc = i_pVSOutput->ShaderOutputs[iReg];
+		m3dshaderregbatch &Dest = Batch.Inputs[iReg];
+
+		// The following assignments automatically zero out unused components.
+		switch( m_RenderInfo.VSOutputs[iReg] )
+		{
+		case m3dsrt_float32:
+			Dest.x[iLane] = vSrc.x * fInvW; Dest.y[iLane] = 0.0f; Dest.z[iLane] = 0.0f; Dest.w[iLane] = 0.0f;
+			break;
+		case m3dsrt_vector2:
+			Dest.x[iLane] = vSrc.x * fInvW; Dest.y[iLane] = vSrc.y * fInvW; Dest.z[iLane] = 0.0f; Dest.w[iLane] = 0.0f;
+			break;
+		case m3dsrt_vector3:
+			Dest.x[iLane] = vSrc.x * fInvW; Dest.y[iLane] = vSrc.y * fInvW; Dest.z[iLane] = vSrc.z * fInvW; Dest.w[iLane] = 0.0f;
+			break;
+		case m3dsrt_vector4:
+			Dest.x[iLane] = vSrc.x * fInvW; Dest.y[iLane] = vSrc.y * fInvW; Dest.z[iLane] = vSrc.z * fInvW; Dest.w[iLane] = vSrc.w * fInvW;
+			break;
+		case m3dsrt_unused:
+		default:
+			break;
+		}
+	}
+
+	// Read in current pixel's color in the colorbuffer
+	const byte *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorPixelBytes);
+	vector4 vPixelColor( 0, 0, 0, 1 );
+	ReadFrameColor( m_RenderInfo.iColorLayout, vPixelColor, pFrameData );
+	Batch.Color.x[iLane] = vPixelColor.r; Batch.Color.y[iLane] = vPixelColor.g; Batch.Color.z[iLane] = vPixelColor.b; Batch.Color.w[iLane] = vPixelColor.a;
+
+	Batch.fDepth[iLane] = fDepth;
+	Batch.iX[iLane] = i_iX;
+	Batch.iY[iLane] = i_iY;
+	Batch.fInvW[iLane] = fInvW;
+	io_pContext->fBatchedDepth[iLane] = fDepth;
+
+	if( ++io_pContext->iBatchedPixels == m_RenderInfo.iPixelBatchSize )
+		FlushPixelBatch( io_pContext );
+}
+
+void CMuli3DDevice::FlushPixelBatch( rastercontext *io_pContext )
+{
+	const uint32 iNumPixels = io_pContext->iBatchedPixels;
+	if( !iNumPixels )
+		return;
+
+	io_pContext->iBatchedPixels = 0;
+
+	// Unused lanes are filled with copies of the first pixel, so that shaders
+	// don't operate on uninitialized values.
+	m3dpixelbatch &Batch = io_pContext->PixelBatch;
+	for( uint32 iLane = iNumPixels; iLane < m_RenderInfo.iPixelBatchSize; ++iLane )
+	{
+		for( uint32 iReg = 0; iReg < c_iPixelShaderRegisters; ++iReg )
+		{
+			m3dshaderregbatch &Reg = Batch.Inputs[iReg];
+			Reg.x[iLane] = Reg.x[0]; Reg.y[iLane] = Reg.y[0]; Reg.z[iLane] = Reg.z[0]; Reg.w[iLane] = Reg.w[0];
+		}
+		Batch.Color.x[iLane] = Batch.Color.x[0]; Batch.Color.y[iLane] = Batch.Color.y[0];
+		Batch.Color.z[iLane] = Batch.Color.z[0]; Batch.Color.w[iLane] = Batch.Color.w[0];
+		Batch.fDepth[iLane] = Batch.fDepth[0];
+		Batch.iX[iLane] = Batch.iX[0];
+		Batch.iY[iLane] = Batch.iY[0];
+		Batch.fInvW[iLane] = Batch.fInvW[0];
+	}
+
+	// Execute the pixel shader
+	uint32 iLaneMask = ( 1 << iNumPixels ) - 1;
+	m_pPixelShader->ExecuteBatch( Batch, iLaneMask );
+	if( !m_RenderInfo.bMightKillPixels )
+		iLaneMask = ( 1 << iNumPixels ) - 1;
+
+	for( uint32 iLane = 0; iLane < iNumPixels; ++iLane )
+	{
+		if( !( iLaneMask & ( 1 << iLane ) ) )
+			continue; // pixel got killed
+
+		const uint32 iX = Batch.iX[iLane], iY = Batch.iY[iLane];
+		byte *pFrameData = m_RenderInfo.pFrameData + (iY * m_RenderInfo.iColorBufferPitch + iX * m_RenderInfo.iColorPixelBytes);
+		byte *pDepthData = m_RenderInfo.pDepthData + (iY * m_RenderInfo.iDepthBufferPitch + iX * m_RenderInfo.iDepthPixelBytes);
+
+		float32 fDepth = io_pContext->fBatchedDepth[iLane];
+		if( m_RenderInfo.PixelShaderOutput == m3dpso_colordepth )
+		{
+			fDepth = Batch.fDepth[iLane];
+
+			// Perform depth-test
+			if( m_RenderInfo.DepthCompare == m3dcmp_never )
+				return;
+			if( !bDepthTest( m_RenderInfo.DepthCompare, fDepth, pDepthData, m_RenderInfo.DepthFormat ) )
+				continue;
+		}
+
+		// Passed depth-test and pixel was not killed, so update depthbuffer
+		if( m_RenderInfo.bDepthWrite )
+			WriteDepth( pDepthData, m_RenderInfo.DepthFormat, fDepth );
+
+		// Write the new color to the colorbuffer
+		WriteFrameColor( m_RenderInfo.iColorLayout, pFrameData, vector4( Batch.Color.x[iLane], Batch.Color.y[iLane], Batch.Color.z[iLane], Batch.Color.w[iLane] ) );
+
+		++io_pContext->iRenderedPixels;
 	}
 }
 
 // LINES & POINTS -------------------------------------------------------------
 
-void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1 )
+void CMuli3DDevice::RasterizeLine( rastercontext *io_pContext, const m3dvsoutput *i_pVSOutput0, const m3dvsoutput *i_pVSOutput1 )
 {
 	const vector4 &vA = i_pVSOutput0->vPosition;
 	const vector4 &vB = i_pVSOutput1->vPosition;
@@ -2423,12 +3972,12 @@ void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvso
 			const uint32 iPixelY = iIntCoordsA[1] + ftol( fSlope * i );
 
 			m3dvsoutput PSInput;
-			SetVSOutputFromGradient( &PSInput, (float32)iPixelX, (float32)iPixelY );
-			m_TriangleInfo.fCurPixelInvW = 1.0f / PSInput.vPosition.w;
-			MultiplyVertexShaderOutputRegisters( &PSInput, &PSInput, m_TriangleInfo.fCurPixelInvW );
+			SetVSOutputFromGradient( io_pContext, &PSInput, (float32)iPixelX, (float32)iPixelY );
+			io_pContext->TriangleInfo.fCurPixelInvW = 1.0f / PSInput.vPosition.w;
+			MultiplyVertexShaderOutputRegisters( &PSInput, &PSInput, io_pContext->TriangleInfo.fCurPixelInvW );
 
 			if( !iLineThicknessHalf )
-				(*this.*m_RenderInfo.fpDrawPixel)( iPixelX, iPixelY, &PSInput );
+				(*this.*m_RenderInfo.fpDrawPixel)( io_pContext, iPixelX, iPixelY, &PSInput );
 			else
 			{
 				for( int32 j = iLineThicknessHalf + iPosOffset; j <= -iLineThicknessHalf; ++j )
@@ -2440,7 +3989,7 @@ void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvso
 						continue;
 					}
 
-					(*this.*m_RenderInfo.fpDrawPixel)( iPixelX, iNewPixelY, &PSInput );
+					(*this.*m_RenderInfo.fpDrawPixel)( io_pContext, iPixelX, iNewPixelY, &PSInput );
 				}
 			}
 		}
@@ -2463,12 +4012,12 @@ void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvso
 			const uint32 iPixelY = iIntCoordsA[1] + i;
 
 			m3dvsoutput PSInput;
-			SetVSOutputFromGradient( &PSInput, (float32)iPixelX, (float32)iPixelY );
-			m_TriangleInfo.fCurPixelInvW = 1.0f / PSInput.vPosition.w;
-			MultiplyVertexShaderOutputRegisters( &PSInput, &PSInput, m_TriangleInfo.fCurPixelInvW );
+			SetVSOutputFromGradient( io_pContext, &PSInput, (float32)iPixelX, (float32)iPixelY );
+			io_pContext->TriangleInfo.fCurPixelInvW = 1.0f / PSInput.vPosition.w;
+			MultiplyVertexShaderOutputRegisters( &PSInput, &PSInput, io_pContext->TriangleInfo.fCurPixelInvW );
 
 			if( !iLineThicknessHalf )
-				(*this.*m_RenderInfo.fpDrawPixel)( iPixelX, iPixelY, &PSInput );
+				(*this.*m_RenderInfo.fpDrawPixel)( io_pContext, iPixelX, iPixelY, &PSInput );
 			else
 			{
 				for( int32 j = iLineThicknessHalf + iPosOffset; j <= -iLineThicknessHalf; ++j )
@@ -2480,126 +4029,76 @@ void CMuli3DDevice::RasterizeLine( const m3dvsoutput *i_pVSOutput0, const m3dvso
 						continue;
 					}
 
-					(*this.*m_RenderInfo.fpDrawPixel)( iNewPixelX, iPixelY, &PSInput );
+					(*this.*m_RenderInfo.fpDrawPixel)( io_pContext, iNewPixelX, iPixelY, &PSInput );
 				}
 			}
 		}
 	}
 }
 
-void CMuli3DDevice::DrawPixel_ColorOnly( uint32 i_iX, uint32 i_iY, const m3dvsoutput *i_pVSOutput )
+void CMuli3DDevice::DrawPixel_ColorOnly( rastercontext *io_pContext, uint32 i_iX, uint32 i_iY, const m3dvsoutput *i_pVSOutput )
 {
-	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
-	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
-	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
-	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
+	byte *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorPixelBytes);
+	byte *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX * m_RenderInfo.iDepthPixelBytes);
 
 	// Perform depth-test
-	switch( m_RenderInfo.DepthCompare )
-	{
-	case m3dcmp_never: return;
-	case m3dcmp_equal: if( fabsf( i_pVSOutput->vPosition.z - *pDepthData ) < FLT_EPSILON ) break; else return;
-	case m3dcmp_notequal: if( fabsf( i_pVSOutput->vPosition.z - *pDepthData ) >= FLT_EPSILON ) break; else return;
-	case m3dcmp_less: if( i_pVSOutput->vPosition.z < *pDepthData ) break; else return;
-	case m3dcmp_lessequal: if( i_pVSOutput->vPosition.z <= *pDepthData ) break; else return;
-	case m3dcmp_greaterequal: if( i_pVSOutput->vPosition.z >= *pDepthData ) break; else return;
-	case m3dcmp_greater: if( i_pVSOutput->vPosition.z > *pDepthData ) break; else return;
-	case m3dcmp_always: break;
-	}
+	if( !bDepthTest( io_pContext->DepthCompare, i_pVSOutput->vPosition.z, pDepthData, m_RenderInfo.DepthFormat ) )
+		return;
 
 	if( m_RenderInfo.bColorWrite || m_RenderInfo.bDepthWrite )
 	{
 		// Read in current pixel's color in the colorbuffer
 		vector4 vPixelColor( 0, 0, 0, 1 );
-		switch( m_RenderInfo.iColorFloats )
-		{
-		case 4: vPixelColor.a = pFrameData[3];
-		case 3: vPixelColor.b = pFrameData[2];
-		case 2: vPixelColor.g = pFrameData[1];
-		case 1: vPixelColor.r = pFrameData[0];
-		}
+		ReadFrameColor( m_RenderInfo.iColorLayout, vPixelColor, pFrameData );
 
 		// Execute the pixel shader
 		float32 fPSDepth = i_pVSOutput->vPosition.z; // if we passed i_pVSOutput->vPosition.z directly to the pixel shader, it might modify it, which is not allowed in this function
-		m_TriangleInfo.iCurPixelX = i_iX;
-		m_TriangleInfo.iCurPixelY = i_iY;
+		io_pContext->TriangleInfo.iCurPixelX = i_iX;
+		io_pContext->TriangleInfo.iCurPixelY = i_iY;
 
-		if( !m_pPixelShader->bExecute( i_pVSOutput->ShaderOutputs, vPixelColor, fPSDepth ) )
+		if( !m_pPixelShader->bExecute( i_pVSOutput->ShaderOutputs, vPixelColor, fPSDepth ) && m_RenderInfo.bMightKillPixels )
 			return; // pixel got killed
 
 		// Passed depth-test and pixel was not killed, so update depthbuffer
 		if( m_RenderInfo.bDepthWrite )
-			*pDepthData = i_pVSOutput->vPosition.z;
+			WriteDepth( pDepthData, m_RenderInfo.DepthFormat, i_pVSOutput->vPosition.z );
 
 		// Write the new color to the colorbuffer
 		if( m_RenderInfo.bColorWrite )
-		{
-			switch( m_RenderInfo.iColorFloats )
-			{
-			case 4: pFrameData[3] = vPixelColor.a;
-			case 3: pFrameData[2] = vPixelColor.b;
-			case 2: pFrameData[1] = vPixelColor.g;
-			case 1: pFrameData[0] = vPixelColor.r;
-			}
-		}
+			WriteFrameColor( m_RenderInfo.iColorLayout, pFrameData, vPixelColor );
 	}
 
-	++m_RenderInfo.iRenderedPixels;
+	++io_pContext->iRenderedPixels;
 }
 
-void CMuli3DDevice::DrawPixel_ColorDepth( uint32 i_iX, uint32 i_iY, const m3dvsoutput *i_pVSOutput )
+void CMuli3DDevice::DrawPixel_ColorDepth( rastercontext *io_pContext, uint32 i_iX, uint32 i_iY, const m3dvsoutput *i_pVSOutput )
 {
-	float32 *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats);
-	float32 *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX);
-	//float32 *pFrameData = m_RenderInfo.pFrameData ? &m_RenderInfo.pFrameData[i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorFloats ] : 0;
-	//float32 *pDepthData = m_RenderInfo.pDepthData ? &m_RenderInfo.pDepthData[i_iY * m_RenderInfo.iDepthBufferPitch + i_iX ] : 0;
+	byte *pFrameData = m_RenderInfo.pFrameData + (i_iY * m_RenderInfo.iColorBufferPitch + i_iX * m_RenderInfo.iColorPixelBytes);
+	byte *pDepthData = m_RenderInfo.pDepthData + (i_iY * m_RenderInfo.iDepthBufferPitch + i_iX * m_RenderInfo.iDepthPixelBytes);
 
 	// Read in current pixel's color in the colorbuffer
 	vector4 vPixelColor( 0, 0, 0, 1 );
-	switch( m_RenderInfo.iColorFloats )
-	{
-	case 4: vPixelColor.a = pFrameData[3];
-	case 3: vPixelColor.b = pFrameData[2];
-	case 2: vPixelColor.g = pFrameData[1];
-	case 1: vPixelColor.r = pFrameData[0];
-	}
+	ReadFrameColor( m_RenderInfo.iColorLayout, vPixelColor, pFrameData );
 
 	// Execute the pixel shader
 	float32 fPSDepth = i_pVSOutput->vPosition.z;
-	m_TriangleInfo.iCurPixelX = i_iX;
-	m_TriangleInfo.iCurPixelY = i_iY;
+	io_pContext->TriangleInfo.iCurPixelX = i_iX;
+	io_pContext->TriangleInfo.iCurPixelY = i_iY;
 
 	if( !m_pPixelShader->bExecute( i_pVSOutput->ShaderOutputs, vPixelColor, fPSDepth ) )
 		return; // pixel got killed
 
 	// Perform depth-test
-	switch( m_RenderInfo.DepthCompare )
-	{
-	case m3dcmp_never: return;
-	case m3dcmp_equal: if( fabsf( fPSDepth - *pDepthData ) < FLT_EPSILON ) break; else return;
-	case m3dcmp_notequal: if( fabsf( fPSDepth - *pDepthData ) >= FLT_EPSILON ) break; else return;
-	case m3dcmp_less: if( fPSDepth < *pDepthData ) break; else return;
-	case m3dcmp_lessequal: if( fPSDepth <= *pDepthData ) break; else return;
-	case m3dcmp_greaterequal: if( fPSDepth >= *pDepthData ) break; else return;
-	case m3dcmp_greater: if( fPSDepth > *pDepthData ) break; else return;
-	case m3dcmp_always: break;
-	}
+	if( !bDepthTest( m_RenderInfo.DepthCompare, fPSDepth, pDepthData, m_RenderInfo.DepthFormat ) )
+		return;
 
 	// Passed depth-test and pixel was not killed, so update depthbuffer
 	if( m_RenderInfo.bDepthWrite )
-		*pDepthData = fPSDepth;
+		WriteDepth( pDepthData, m_RenderInfo.DepthFormat, fPSDepth );
 
 	// Write the new color to the colorbuffer
 	if( m_RenderInfo.bColorWrite )
-	{
-		switch( m_RenderInfo.iColorFloats )
-		{
-		case 4: pFrameData[3] = vPixelColor.a;
-		case 3: pFrameData[2] = vPixelColor.b;
-		case 2: pFrameData[1] = vPixelColor.g;
-		case 1: pFrameData[0] = vPixelColor.r;
-		}
-	}
+		WriteFrameColor( m_RenderInfo.iColorLayout, pFrameData, vPixelColor );
 
-	++m_RenderInfo.iRenderedPixels;
+	++io_pContext->iRenderedPixels;
 }
@@ -19,14 +19,15 @@
 
 #include "../../include/core/m3dcore_indexbuffer.h"
 #include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_vertexbuffer.h"
 
 CMuli3DIndexBuffer::CMuli3DIndexBuffer( CMuli3DDevice *i_pParent )
-	: m_pParent( i_pParent )
+	: m_pParent( i_pParent ), m_pData( 0 ), m_bOwnsData( false ), m_pDataOwner( 0 )
 {
 	m_pParent->AddRef();
 }
 
-result CMuli3DIndexBuffer::Create( uint32 i_iLength, m3dformat i_fmtFormat )
+result CMuli3DIndexBuffer::Create( uint32 i_iLength, m3dformat i_fmtFormat, const void *i_pData, IBase *i_pDataOwner )
 {
 	if( !i_iLength )
 	{
@@ -43,6 +44,17 @@ result CMuli3DIndexBuffer::Create( uint32 i_iLength, m3dformat i_fmtFormat )
 	m_iLength = i_iLength;
 	m_fmtFormat = i_fmtFormat;
 
+	if( i_pData )
+	{
+		m_pData = (const byte *)i_pData;
+		if( i_pDataOwner )
+		{
+			m_pDataOwner = i_pDataOwner;
+			m_pDataOwner->AddRef();
+		}
+		return s_ok;
+	}
+
 	m_pData = new byte[i_iLength];
 	if( !m_pData )
 	{
@@ -50,12 +62,15 @@ result CMuli3DIndexBuffer::Create( uint32 i_iLength, m3dformat i_fmtFormat )
 		return e_outofmemory;
 	}
 
+	m_bOwnsData = true;
 	return s_ok;
 }
 
 CMuli3DIndexBuffer::~CMuli3DIndexBuffer()
 {
-	SAFE_DELETE_ARRAY( m_pData );
+	if( m_bOwnsData )
+		SAFE_DELETE_ARRAY( m_pData );
+	SAFE_RELEASE( m_pDataOwner );
 
 	SAFE_RELEASE( m_pParent );
 }
@@ -75,6 +90,32 @@ result CMuli3DIndexBuffer::GetPointer( uint32 i_iOffset, void **o_ppData )
 		return e_invalidparameters;
 	}
 
+	if( !m_bOwnsData )
+	{
+		*o_ppData = 0;
+		FUNC_FAILING( "CMuli3DIndexBuffer::GetPointer: index buffer is read-only.\n" );
+		return e_invalidstate;
+	}
+
+	*o_ppData = (byte *)&m_pData[i_iOffset];
+	return s_ok;
+}
+
+result CMuli3DIndexBuffer::GetReadPointer( uint32 i_iOffset, const void **o_ppData )
+{
+	if( !o_ppData )
+	{
+		FUNC_FAILING( "CMuli3DIndexBuffer::GetReadPointer: parameter o_ppData points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	if( i_iOffset >= m_iLength )
+	{
+		*o_ppData = 0;
+		FUNC_FAILING( "CMuli3DIndexBuffer::GetReadPointer: i_iOffset is larger than index buffer length.\n" );
+		return e_invalidparameters;
+	}
+
 	*o_ppData = &m_pData[i_iOffset];
 	return s_ok;
 }
@@ -130,3 +171,158 @@ m3dformat CMuli3DIndexBuffer::fmtGetFormat()
 {
 	return m_fmtFormat;
 }
+
+bool CMuli3DIndexBuffer::bIsReadOnly()
+{
+	return !m_bOwnsData;
+}
+
+result CMuli3DIndexBuffer::ReadIndices( std::vector<uint32> &o_Indices )
+{
+	if( m_fmtFormat == m3dfmt_index16 )
+	{
+		const uint16 *pData = (const uint16 *)m_pData;
+		o_Indices.assign( pData, pData + m_iLength / 2 );
+	}
+	else
+	{
+		const uint32 *pData = (const uint32 *)m_pData;
+		o_Indices.assign( pData, pData + m_iLength / 4 );
+	}
+
+	if( o_Indices.size() < 3 )
+	{
+		FUNC_FAILING( "CMuli3DIndexBuffer::ReadIndices: index buffer doesn't hold a triangle.\n" );
+		return e_invalidstate;
+	}
+
+	return s_ok;
+}
+
+void CMuli3DIndexBuffer::WriteIndices( const std::vector<uint32> &i_Indices )
+{
+	if( m_fmtFormat == m3dfmt_index16 )
+	{
+		uint16 *pData = (uint16 *)m_pData;
+		for( uint32 iIndex = 0; iIndex < i_Indices.size(); ++iIndex )
+			pData[iIndex] = (uint16)i_Indices[iIndex];
+	}
+	else if( !i_Indices.empty() )
+		memcpy( (byte *)m_pData, &i_Indices[0], sizeof( uint32 ) * i_Indices.size() );
+}
+
+uint32 CMuli3DIndexBuffer::iGetVertexCacheSize( uint32 i_iVertexCacheSize )
+{
+	if( !i_iVertexCacheSize )
+		m_pParent->GetRenderState( m3drs_vertexcachesize, i_iVertexCacheSize );
+	return i_iVertexCacheSize;
+}
+
+result CMuli3DIndexBuffer::AnalyzeVertexCache( m3dvertexcachestats &o_Stats, uint32 i_iVertexCacheSize )
+{
+	i_iVertexCacheSize = iGetVertexCacheSize( i_iVertexCacheSize );
+	if( !i_iVertexCacheSize )
+	{
+		FUNC_FAILING( "CMuli3DIndexBuffer::AnalyzeVertexCache: invalid vertex cache size.\n" );
+		return e_invalidparameters;
+	}
+
+	std::vector<uint32> Indices;
+	result resRead = ReadIndices( Indices );
+	if( FUNC_FAILED( resRead ) )
+		return resRead;
+	::AnalyzeVertexCache( o_Stats, &Indices[0], (uint32)Indices.size() / 3 * 3, i_iVertexCacheSize );
+	return s_ok;
+}
+
+result CMuli3DIndexBuffer::OptimizeVertexCache( uint32 i_iVertexCacheSize, m3dvertexcachestats *o_pBefore, m3dvertexcachestats *o_pAfter )
+{
+	if( !m_bOwnsData )
+	{
+		FUNC_FAILING( "CMuli3DIndexBuffer::OptimizeVertexCache: index buffer is read-only.\n" );
+		return e_invalidstate;
+	}
+
+	i_iVertexCacheSize = iGetVertexCacheSize( i_iVertexCacheSize );
+	if( !i_iVertexCacheSize )
+	{
+		FUNC_FAILING( "CMuli3DIndexBuffer::OptimizeVertexCache: invalid vertex cache size.\n" );
+		return e_invalidparameters;
+	}
+
+	std::vector<uint32> Indices;
+	result resRead = ReadIndices( Indices );
+	if( FUNC_FAILED( resRead ) )
+		return resRead;
+	const uint32 iNumIndices = (uint32)Indices.size() / 3 * 3;
+
+	uint32 iNumVertices = 0;
+	for( uint32 iIndex = 0; iIndex < iNumIndices; ++iIndex )
+	{
+		if( Indices[iIndex] >= iNumVertices )
+			iNumVertices = Indices[iIndex] + 1;
+	}
+
+	if( o_pBefore )
+		::AnalyzeVertexCache( *o_pBefore, &Indices[0], iNumIndices, i_iVertexCacheSize );
+
+	::OptimizeVertexCache( &Indices[0], iNumIndices, iNumVertices, i_iVertexCacheSize );
+	WriteIndices( Indices );
+
+	if( o_pAfter )
+		::AnalyzeVertexCache( *o_pAfter, &Indices[0], iNumIndices, i_iVertexCacheSize );
+
+	return s_ok;
+}
+
+result CMuli3DIndexBuffer::OptimizeVertexFetch( CMuli3DVertexBuffer *io_pVertexBuffer, uint32 i_iStride )
+{
+	if( !io_pVertexBuffer || !i_iStride || io_pVertexBuffer->iGetLength() < i_iStride )
+	{
+		FUNC_FAILING( "CMuli3DIndexBuffer::OptimizeVertexFetch: invalid vertex buffer or stride specified.\n" );
+		return e_invalidparameters;
+	}
+
+	if( !m_bOwnsData || io_pVertexBuffer->bIsReadOnly() )
+	{
+		FUNC_FAILING( "CMuli3DIndexBuffer::OptimizeVertexFetch: index buffer or vertex buffer is read-only.\n" );
+		return e_invalidstate;
+	}
+
+	const uint32 iNumVertices = io_pVertexBuffer->iGetLength() / i_iStride;
+	std::vector<uint32> Indices;
+	result resRead = ReadIndices( Indices );
+	if( FUNC_FAILED( resRead ) )
+		return resRead;
+	for( uint32 iIndex = 0; iIndex < Indices.size(); ++iIndex )
+	{
+		if( Indices[iIndex] >= iNumVertices )
+		{
+			FUNC_FAILING( "CMuli3DIndexBuffer::OptimizeVertexFetch: index exceeds vertex buffer.\n" );
+			return e_invalidparameters;
+		}
+	}
+
+	byte *pVertices = 0;
+	result resVB = io_pVertexBuffer->GetPointer( 0, (void **)&pVertices );
+	if( FUNC_FAILED( resVB ) )
+		return resVB;
+
+	byte *pSourceVertices = new byte[iNumVertices * i_iStride];
+	if( !pSourceVertices )
+	{
+		FUNC_FAILING( "CMuli3DIndexBuffer::OptimizeVertexFetch: out of memory, cannot copy vertices.\n" );
+		return e_outofmemory;
+	}
+
+	std::vector<uint32> Remap( iNumVertices );
+	iOptimizeVertexFetch( &Remap[0], &Indices[0], (uint32)Indices.size(), iNumVertices );
+	WriteIndices( Indices );
+
+	memcpy( pSourceVertices, pVertices, iNumVertices * i_iStride );
+	for( uint32 iVertex = 0; iVertex < iNumVertices; ++iVertex )
+		memcpy( &pVertices[Remap[iVertex] * i_iStride], &pSourceVertices[iVertex * i_iStride], i_iStride );
+	SAFE_DELETE_ARRAY( pSourceVertices );
+
+	return s_ok;
+}
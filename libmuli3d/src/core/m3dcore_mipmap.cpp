@@ -0,0 +1,666 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "../../include/core/m3dcore_mipmap.h"
+#include "../../include/core/m3dcore_pixelformat.h"
+#include "../../include/core/m3dcore_threadpool.h"
+
+/// Source pixels contributing to a destination pixel along one axis.
+struct m3dmiptaps
+{
+	uint32	iFirst;			///< Index of the first contributing source pixel.
+	uint32	iNumTaps;		///< Number of contributing source pixels, e [1,3].
+	float32	fWeights[3];	///< Weights of the contributing source pixels; they sum up to 1.
+};
+
+/// Determines the source pixels contributing to a destination pixel along one axis.
+/// @param[out] o_Taps receives the source pixels and their weights.
+/// @param[in] i_iDest index of the destination pixel.
+/// @param[in] i_iSrcSize number of source pixels along the axis.
+/// @param[in] i_iDestSize number of destination pixels along the axis; i_iSrcSize / 2 or i_iSrcSize.
+inline void ComputeMipTaps( m3dmiptaps &o_Taps, uint32 i_iDest, uint32 i_iSrcSize, uint32 i_iDestSize )
+{
+	if( i_iSrcSize == i_iDestSize )
+	{
+		o_Taps.iFirst = i_iDest; o_Taps.iNumTaps = 1;
+		o_Taps.fWeights[0] = 1.0f;
+	}
+	else if( i_iSrcSize == 2 * i_iDestSize )
+	{
+		o_Taps.iFirst = 2 * i_iDest; o_Taps.iNumTaps = 2;
+		o_Taps.fWeights[0] = o_Taps.fWeights[1] = 0.5f;
+	}
+	else
+	{
+		// 2n+1 pixels are reduced to n pixels: pixel i covers the source interval [i*(2n+1)/n;(i+1)*(2n+1)/n[.
+		const float32 fInvSrcSize = 1.0f / (float32)i_iSrcSize;
+		o_Taps.iFirst = 2 * i_iDest; o_Taps.iNumTaps = 3;
+		o_Taps.fWeights[0] = (float32)( i_iDestSize - i_iDest ) * fInvSrcSize;
+		o_Taps.fWeights[1] = (float32)i_iDestSize * fInvSrcSize;
+		o_Taps.fWeights[2] = (float32)( i_iDest + 1 ) * fInvSrcSize;
+	}
+}
+
+/// Returns the number of floats per pixel used for filtering a format; r5g6b5-pixels are padded to four floats, so that they can be converted with vector instructions.
+/// @param[in] i_fmtFormat one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
+inline uint32 iGetMipChannels( m3dformat i_fmtFormat )
+{
+	return ( i_fmtFormat == m3dfmt_r5g6b5 ) ? 4 : iGetFormatChannels( i_fmtFormat );
+}
+
+#ifdef M3D_SSE2
+/// Converts four half-floats to floats like fHalfToFloat().
+/// @param[in] i_vHalfs bit-patterns of the half-floats in the lower 16 bits of each element.
+inline __m128 vHalfToFloat4( __m128i i_vHalfs )
+{
+	const __m128i vAbs = _mm_and_si128( i_vHalfs, _mm_set1_epi32( 0x7fff ) );
+	const __m128i vExponent = _mm_and_si128( i_vHalfs, _mm_set1_epi32( 0x7c00 ) );
+	const __m128i vSign = _mm_slli_epi32( _mm_and_si128( i_vHalfs, _mm_set1_epi32( 0x8000 ) ), 16 );
+
+	// Rebias 15 -> 127; infinities and NaNs are rebiased twice to reach the maximum exponent.
+	const __m128i vRebias = _mm_set1_epi32( 112 << 23 );
+	__m128i vNormal = _mm_add_epi32( _mm_slli_epi32( vAbs, 13 ), vRebias );
+	vNormal = _mm_add_epi32( vNormal, _mm_and_si128( _mm_cmpeq_epi32( vExponent, _mm_set1_epi32( 0x7c00 ) ), vRebias ) );
+
+	// zero or denormal: mantissa * 2^-24
+	const __m128i vDenormal = _mm_castps_si128( _mm_mul_ps( _mm_cvtepi32_ps( vAbs ), _mm_set1_ps( 1.0f / 16777216.0f ) ) );
+	const __m128i vIsDenormal = _mm_cmpeq_epi32( vExponent, _mm_setzero_si128() );
+	return _mm_castsi128_ps( _mm_or_si128( vSign, _mm_or_si128( _mm_and_si128( vIsDenormal, vDenormal ), _mm_andnot_si128( vIsDenormal, vNormal ) ) ) );
+}
+
+/// Converts four floats to half-floats like iFloatToHalf().
+/// @param[in] i_vValues the floats.
+/// @return bit-patterns of the half-floats in the lower 16 bits of each element.
+inline __m128i vFloatToHalf4( __m128 i_vValues )
+{
+	const __m128i vBits = _mm_castps_si128( i_vValues );
+	const __m128i vAbs = _mm_and_si128( vBits, _mm_set1_epi32( 0x7fffffff ) );
+	const __m128i vSign = _mm_and_si128( _mm_srli_epi32( vBits, 16 ), _mm_set1_epi32( 0x8000 ) );
+
+	// Rebias the exponent and round the mantissa to nearest even.
+	const __m128i vRounded = _mm_add_epi32( _mm_add_epi32( vAbs, _mm_set1_epi32( 0x0fff ) ), _mm_and_si128( _mm_srli_epi32( vAbs, 13 ), _mm_set1_epi32( 1 ) ) );
+	__m128i vHalfs = _mm_srli_epi32( _mm_sub_epi32( vRounded, _mm_set1_epi32( 0x38000000 ) ), 13 );
+
+	// < 2^-14: denormal or zero
+	const __m128i vDenormal = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( _mm_castsi128_ps( vAbs ), _mm_set1_ps( 16777216.0f ) ), _mm_set1_ps( 0.5f ) ) );
+	const __m128i vIsDenormal = _mm_cmplt_epi32( vAbs, _mm_set1_epi32( 0x38800000 ) );
+	vHalfs = _mm_or_si128( _mm_and_si128( vIsDenormal, vDenormal ), _mm_andnot_si128( vIsDenormal, vHalfs ) );
+
+	// >= 65520 rounds to infinity; NaNs keep a mantissa bit.
+	const __m128i vIsInfinite = _mm_cmpgt_epi32( vAbs, _mm_set1_epi32( 0x477fefff ) );
+	const __m128i vNaN = _mm_and_si128( _mm_cmpgt_epi32( vAbs, _mm_set1_epi32( 0x7f800000 ) ), _mm_set1_epi32( 0x200 ) );
+	vHalfs = _mm_or_si128( _mm_andnot_si128( vIsInfinite, vHalfs ), _mm_and_si128( vIsInfinite, _mm_or_si128( _mm_set1_epi32( 0x7c00 ), vNaN ) ) );
+
+	return _mm_or_si128( vHalfs, vSign );
+}
+
+/// Packs the lower 16 bits of each element of two vectors into one vector of eight 16-bit values.
+inline __m128i vPackLow16( __m128i i_vLow, __m128i i_vHigh )
+{
+	// Sign-extend the lower halves, so that signed saturation keeps them unchanged.
+	return _mm_packs_epi32( _mm_srai_epi32( _mm_slli_epi32( i_vLow, 16 ), 16 ), _mm_srai_epi32( _mm_slli_epi32( i_vHigh, 16 ), 16 ) );
+}
+#endif
+
+/// Converts a row of pixels of a compact format to floats.
+/// @param[out] o_pValues receives iGetMipChannels() floats per pixel.
+/// @param[in] i_pRow the pixels.
+/// @param[in] i_fmtFormat format of the pixels; one of the formats m3dfmt_r8 to m3dfmt_r5g6b5.
+/// @param[in] i_iPixels number of pixels.
+inline void DecodeMipRow( float32 *o_pValues, const byte *i_pRow, m3dformat i_fmtFormat, uint32 i_iPixels )
+{
+	const uint32 iValues = i_iPixels * iGetFormatChannels( i_fmtFormat );
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_r8:
+	case m3dfmt_r8g8b8a8:
+		{
+			const float32 fByteScale = 1.0f / 255.0f;
+			uint32 iValue = 0;
+			#ifdef M3D_SSE2
+			const __m128i vZero = _mm_setzero_si128();
+			const __m128 vByteScale = _mm_set1_ps( fByteScale );
+			for( ; iValue + 16 <= iValues; iValue += 16 )
+			{
+				const __m128i vBytes = _mm_loadu_si128( (const __m128i *)&i_pRow[iValue] );
+				const __m128i vWordsLo = _mm_unpacklo_epi8( vBytes, vZero ), vWordsHi = _mm_unpackhi_epi8( vBytes, vZero );
+				_mm_storeu_ps( &o_pValues[iValue], _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( vWordsLo, vZero ) ), vByteScale ) );
+				_mm_storeu_ps( &o_pValues[iValue + 4], _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( vWordsLo, vZero ) ), vByteScale ) );
+				_mm_storeu_ps( &o_pValues[iValue + 8], _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpacklo_epi16( vWordsHi, vZero ) ), vByteScale ) );
+				_mm_storeu_ps( &o_pValues[iValue + 12], _mm_mul_ps( _mm_cvtepi32_ps( _mm_unpackhi_epi16( vWordsHi, vZero ) ), vByteScale ) );
+			}
+			#endif
+			for( ; iValue < iValues; ++iValue )
+				o_pValues[iValue] = i_pRow[iValue] * fByteScale;
+		}
+		break;
+
+	case m3dfmt_r16g16f:
+	case m3dfmt_r16g16b16a16f:
+		{
+			const uint16 *pHalfs = (const uint16 *)i_pRow;
+			uint32 iValue = 0;
+			#ifdef M3D_SSE2
+			const __m128i vZero = _mm_setzero_si128();
+			for( ; iValue + 8 <= iValues; iValue += 8 )
+			{
+				const __m128i vHalfs = _mm_loadu_si128( (const __m128i *)&pHalfs[iValue] );
+				_mm_storeu_ps( &o_pValues[iValue], vHalfToFloat4( _mm_unpacklo_epi16( vHalfs, vZero ) ) );
+				_mm_storeu_ps( &o_pValues[iValue + 4], vHalfToFloat4( _mm_unpackhi_epi16( vHalfs, vZero ) ) );
+			}
+			#endif
+			for( ; iValue < iValues; ++iValue )
+				o_pValues[iValue] = fHalfToFloat( pHalfs[iValue] );
+		}
+		break;
+
+	case m3dfmt_r5g6b5:
+		{
+			const uint16 *pPixels = (const uint16 *)i_pRow;
+			uint32 iPixel = 0;
+			#ifdef M3D_SSE2
+			const __m128i vFiveBits = _mm_set1_epi32( 31 ), vSixBits = _mm_set1_epi32( 63 );
+			for( ; iPixel + 4 <= i_iPixels; iPixel += 4, o_pValues += 16 )
+			{
+				const __m128i vPixels = _mm_unpacklo_epi16( _mm_loadl_epi64( (const __m128i *)&pPixels[iPixel] ), _mm_setzero_si128() );
+				__m128 vRed = _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( vPixels, 11 ) ), _mm_set1_ps( 1.0f / 31.0f ) );
+				__m128 vGreen = _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( _mm_srli_epi32( vPixels, 5 ), vSixBits ) ), _mm_set1_ps( 1.0f / 63.0f ) );
+				__m128 vBlue = _mm_mul_ps( _mm_cvtepi32_ps( _mm_and_si128( vPixels, vFiveBits ) ), _mm_set1_ps( 1.0f / 31.0f ) );
+				__m128 vUnused = _mm_setzero_ps();
+				_MM_TRANSPOSE4_PS( vRed, vGreen, vBlue, vUnused );
+				_mm_storeu_ps( &o_pValues[0], vRed ); _mm_storeu_ps( &o_pValues[4], vGreen );
+				_mm_storeu_ps( &o_pValues[8], vBlue ); _mm_storeu_ps( &o_pValues[12], vUnused );
+			}
+			#endif
+			for( ; iPixel < i_iPixels; ++iPixel, o_pValues += 4 )
+			{
+				const uint32 iPixelValue = pPixels[iPixel];
+				o_pValues[0] = ( iPixelValue >> 11 ) * ( 1.0f / 31.0f );
+				o_pValues[1] = ( ( iPixelValue >> 5 ) & 63 ) * ( 1.0f / 63.0f );
+				o_pValues[2] = ( iPixelValue & 31 ) * ( 1.0f / 31.0f );
+				o_pValues[3] = 0.0f;
+			}
+		}
+		break;
+
+	default: // float formats are filtered in place
+		break;
+	}
+}
+
+/// Converts a row of filtered floats to pixels.
+/// @param[out] o_pRow receives the pixels.
+/// @param[in] i_pValues iGetMipChannels() floats per pixel.
+/// @param[in] i_fmtFormat format of the pixels; one of the texture formats m3dfmt_r32f to m3dfmt_r5g6b5.
+/// @param[in] i_iPixels number of pixels.
+inline void EncodeMipRow( byte *o_pRow, const float32 *i_pValues, m3dformat i_fmtFormat, uint32 i_iPixels )
+{
+	const uint32 iValues = i_iPixels * iGetFormatChannels( i_fmtFormat );
+	switch( i_fmtFormat )
+	{
+	case m3dfmt_r8:
+	case m3dfmt_r8g8b8a8:
+		{
+			uint32 iValue = 0;
+			#ifdef M3D_SSE2
+			const __m128 vZero = _mm_setzero_ps(), vOne = _mm_set1_ps( 1.0f );
+			const __m128 vScale = _mm_set1_ps( 255.0f ), vHalf = _mm_set1_ps( 0.5f );
+			for( ; iValue + 4 <= iValues; iValue += 4 )
+			{
+				const __m128 vValues = _mm_min_ps( _mm_max_ps( _mm_loadu_ps( &i_pValues[iValue] ), vZero ), vOne );
+				__m128i vBytes = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( vValues, vScale ), vHalf ) );
+				vBytes = _mm_packs_epi32( vBytes, vBytes );
+				const int32 iBytes = _mm_cvtsi128_si32( _mm_packus_epi16( vBytes, vBytes ) );
+				memcpy( &o_pRow[iValue], &iBytes, 4 );
+			}
+			#endif
+			for( ; iValue < iValues; ++iValue )
+				o_pRow[iValue] = iFloatToUNorm8( i_pValues[iValue] );
+		}
+		break;
+
+	case m3dfmt_r16g16f:
+	case m3dfmt_r16g16b16a16f:
+		{
+			uint16 *pHalfs = (uint16 *)o_pRow;
+			uint32 iValue = 0;
+			#ifdef M3D_SSE2
+			for( ; iValue + 8 <= iValues; iValue += 8 )
+			{
+				_mm_storeu_si128( (__m128i *)&pHalfs[iValue], vPackLow16( vFloatToHalf4( _mm_loadu_ps( &i_pValues[iValue] ) ),
+					vFloatToHalf4( _mm_loadu_ps( &i_pValues[iValue + 4] ) ) ) );
+			}
+			#endif
+			for( ; iValue < iValues; ++iValue )
+				pHalfs[iValue] = iFloatToHalf( i_pValues[iValue] );
+		}
+		break;
+
+	case m3dfmt_r5g6b5:
+		{
+			uint16 *pPixels = (uint16 *)o_pRow;
+			uint32 iPixel = 0;
+			#ifdef M3D_SSE2
+			const __m128 vZero = _mm_setzero_ps(), vOne = _mm_set1_ps( 1.0f ), vHalf = _mm_set1_ps( 0.5f );
+			const __m128 vFiveBits = _mm_set1_ps( 31.0f ), vSixBits = _mm_set1_ps( 63.0f );
+			for( ; iPixel + 4 <= i_iPixels; iPixel += 4, i_pValues += 16 )
+			{
+				__m128 vRed = _mm_loadu_ps( &i_pValues[0] ), vGreen = _mm_loadu_ps( &i_pValues[4] );
+				__m128 vBlue = _mm_loadu_ps( &i_pValues[8] ), vUnused = _mm_loadu_ps( &i_pValues[12] );
+				_MM_TRANSPOSE4_PS( vRed, vGreen, vBlue, vUnused );
+				const __m128i vRedBits = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( _mm_min_ps( _mm_max_ps( vRed, vZero ), vOne ), vFiveBits ), vHalf ) );
+				const __m128i vGreenBits = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( _mm_min_ps( _mm_max_ps( vGreen, vZero ), vOne ), vSixBits ), vHalf ) );
+				const __m128i vBlueBits = _mm_cvttps_epi32( _mm_add_ps( _mm_mul_ps( _mm_min_ps( _mm_max_ps( vBlue, vZero ), vOne ), vFiveBits ), vHalf ) );
+				const __m128i vPixels = _mm_or_si128( _mm_or_si128( _mm_slli_epi32( vRedBits, 11 ), _mm_slli_epi32( vGreenBits, 5 ) ), vBlueBits );
+				_mm_storel_epi64( (__m128i *)&pPixels[iPixel], vPackLow16( vPixels, vPixels ) );
+			}
+			#endif
+			for( ; iPixel < i_iPixels; ++iPixel, i_pValues += 4 )
+				pPixels[iPixel] = iPackR5G6B5( vector4( i_pValues[0], i_pValues[1], i_pValues[2], 1.0f ) );
+		}
+		break;
+
+	default:
+		memcpy( o_pRow, i_pValues, iValues * sizeof( float32 ) );
+		break;
+	}
+}
+
+/// Adds a weighted row of floats to the filtered row.
+/// @param[in,out] io_pSum the filtered row.
+/// @param[in] i_pValues the row to be added.
+/// @param[in] i_fWeight weight of the row.
+/// @param[in] i_iValues number of floats per row.
+/// @param[in] i_bFirst true if io_pSum shall be overwritten instead.
+inline void AccumulateMipRow( float32 *io_pSum, const float32 *i_pValues, float32 i_fWeight, uint32 i_iValues, bool i_bFirst )
+{
+	uint32 iValue = 0;
+	#ifdef M3D_SSE
+	const __m128 vWeight = _mm_set1_ps( i_fWeight );
+	if( i_bFirst )
+	{
+		for( ; iValue + 4 <= i_iValues; iValue += 4 )
+			_mm_storeu_ps( &io_pSum[iValue], _mm_mul_ps( _mm_loadu_ps( &i_pValues[iValue] ), vWeight ) );
+	}
+	else
+	{
+		for( ; iValue + 4 <= i_iValues; iValue += 4 )
+			_mm_storeu_ps( &io_pSum[iValue], _mm_add_ps( _mm_loadu_ps( &io_pSum[iValue] ), _mm_mul_ps( _mm_loadu_ps( &i_pValues[iValue] ), vWeight ) ) );
+	}
+	#endif
+	for( ; iValue < i_iValues; ++iValue )
+		io_pSum[iValue] = i_bFirst ? i_pValues[iValue] * i_fWeight : io_pSum[iValue] + i_pValues[iValue] * i_fWeight;
+}
+
+/// Filters a row of floats horizontally.
+/// @param[out] o_pValues receives the filtered pixels; must provide room for 4 additional floats.
+/// @param[in] i_pSum the vertically filtered source pixels; must be followed by 4 additional readable floats.
+/// @param[in] i_iSrcWidth number of source pixels.
+/// @param[in] i_iDestWidth number of destination pixels.
+/// @param[in] i_iChannels number of floats per pixel, e [1,4].
+inline void FilterMipRow( float32 *o_pValues, const float32 *i_pSum, uint32 i_iSrcWidth, uint32 i_iDestWidth, uint32 i_iChannels )
+{
+	uint32 iX = 0;
+	if( i_iSrcWidth == 2 * i_iDestWidth )
+	{
+		#ifdef M3D_SSE
+		const __m128 vHalf = _mm_set1_ps( 0.5f );
+		switch( i_iChannels )
+		{
+		case 1: // four pixels at once
+			for( ; iX + 4 <= i_iDestWidth; iX += 4 )
+			{
+				const __m128 vSrc0 = _mm_loadu_ps( &i_pSum[2 * iX] ), vSrc1 = _mm_loadu_ps( &i_pSum[2 * iX + 4] );
+				_mm_storeu_ps( &o_pValues[iX], _mm_mul_ps( _mm_add_ps( _mm_shuffle_ps( vSrc0, vSrc1, _MM_SHUFFLE( 2, 0, 2, 0 ) ),
+					_mm_shuffle_ps( vSrc0, vSrc1, _MM_SHUFFLE( 3, 1, 3, 1 ) ) ), vHalf ) );
+			}
+			break;
+
+		case 2: // two pixels at once
+			for( ; iX + 2 <= i_iDestWidth; iX += 2 )
+			{
+				const __m128 vSrc0 = _mm_loadu_ps( &i_pSum[4 * iX] ), vSrc1 = _mm_loadu_ps( &i_pSum[4 * iX + 4] );
+				_mm_storeu_ps( &o_pValues[2 * iX], _mm_mul_ps( _mm_add_ps( _mm_shuffle_ps( vSrc0, vSrc1, _MM_SHUFFLE( 1, 0, 1, 0 ) ),
+					_mm_shuffle_ps( vSrc0, vSrc1, _MM_SHUFFLE( 3, 2, 3, 2 ) ) ), vHalf ) );
+			}
+			break;
+
+		default: // one pixel at a time; three channel pixels are stored with a fourth float, which is overwritten by the next one
+			for( ; iX < i_iDestWidth; ++iX )
+			{
+				const float32 *pSrc = &i_pSum[2 * iX * i_iChannels];
+				_mm_storeu_ps( &o_pValues[iX * i_iChannels], _mm_mul_ps( _mm_add_ps( _mm_loadu_ps( pSrc ), _mm_loadu_ps( pSrc + i_iChannels ) ), vHalf ) );
+			}
+			break;
+		}
+		#endif
+
+		for( ; iX < i_iDestWidth; ++iX )
+		{
+			const float32 *pSrc = &i_pSum[2 * iX * i_iChannels];
+			for( uint32 iChannel = 0; iChannel < i_iChannels; ++iChannel )
+				o_pValues[iX * i_iChannels + iChannel] = ( pSrc[iChannel] + pSrc[i_iChannels + iChannel] ) * 0.5f;
+		}
+	}
+	else
+	{
+		// Three taps per pixel; see ComputeMipTaps().
+		const float32 fInvSrcWidth = 1.0f / (float32)i_iSrcWidth;
+		for( ; iX < i_iDestWidth; ++iX )
+		{
+			const float32 fWeights[3] = { (float32)( i_iDestWidth - iX ) * fInvSrcWidth, (float32)i_iDestWidth * fInvSrcWidth, (float32)( iX + 1 ) * fInvSrcWidth };
+			const float32 *pSrc = &i_pSum[2 * iX * i_iChannels];
+
+			#ifdef M3D_SSE
+			_mm_storeu_ps( &o_pValues[iX * i_iChannels], _mm_add_ps( _mm_add_ps(
+				_mm_mul_ps( _mm_loadu_ps( pSrc ), _mm_set1_ps( fWeights[0] ) ),
+				_mm_mul_ps( _mm_loadu_ps( pSrc + i_iChannels ), _mm_set1_ps( fWeights[1] ) ) ),
+				_mm_mul_ps( _mm_loadu_ps( pSrc + 2 * i_iChannels ), _mm_set1_ps( fWeights[2] ) ) ) );
+			#else
+			for( uint32 iChannel = 0; iChannel < i_iChannels; ++iChannel )
+			{
+				o_pValues[iX * i_iChannels + iChannel] = pSrc[iChannel] * fWeights[0] +
+					pSrc[i_iChannels + iChannel] * fWeights[1] + pSrc[2 * i_iChannels + iChannel] * fWeights[2];
+			}
+			#endif
+		}
+	}
+}
+
+/// Averages 2x2 or 2x2x2 blocks of 8-bit pixels, rounding to nearest.
+/// @param[out] o_pRow receives the destination pixels.
+/// @param[in] i_ppRows the source rows; two for 2-dimensional levels, four for volumes.
+/// @param[in] i_iNumRows number of source rows.
+/// @param[in] i_iDestWidth number of destination pixels.
+/// @param[in] i_iChannels number of bytes per pixel, 1 or 4.
+inline void AverageMipRow8( byte *o_pRow, const byte * const *i_ppRows, uint32 i_iNumRows, uint32 i_iDestWidth, uint32 i_iChannels )
+{
+	// The sum of 2 * i_iNumRows bytes is rounded and divided by the number of bytes.
+	const uint32 iShift = ( i_iNumRows == 4 ) ? 3 : 2;
+	uint32 iX = 0;
+
+	#ifdef M3D_SSE2
+	const __m128i vZero = _mm_setzero_si128(), vRound = _mm_set1_epi16( (int16)i_iNumRows );
+	const __m128i vShift = _mm_cvtsi32_si128( iShift );
+	if( i_iChannels == 4 )
+	{
+		// Four source pixels of each row yield two destination pixels; channels are summed in 16 bits.
+		for( ; iX + 2 <= i_iDestWidth; iX += 2 )
+		{
+			__m128i vSumLo = vZero, vSumHi = vZero;
+			for( uint32 iRow = 0; iRow < i_iNumRows; ++iRow )
+			{
+				const __m128i vBytes = _mm_loadu_si128( (const __m128i *)&i_ppRows[iRow][iX * 8] );
+				vSumLo = _mm_add_epi16( vSumLo, _mm_unpacklo_epi8( vBytes, vZero ) );
+				vSumHi = _mm_add_epi16( vSumHi, _mm_unpackhi_epi8( vBytes, vZero ) );
+			}
+
+			__m128i vSum = _mm_add_epi16( _mm_unpacklo_epi64( vSumLo, vSumHi ), _mm_unpackhi_epi64( vSumLo, vSumHi ) );
+			vSum = _mm_srl_epi16( _mm_add_epi16( vSum, vRound ), vShift );
+			_mm_storel_epi64( (__m128i *)&o_pRow[iX * 4], _mm_packus_epi16( vSum, vSum ) );
+		}
+	}
+	else
+	{
+		// Sixteen source pixels of each row yield eight destination pixels.
+		const __m128i vOnes = _mm_set1_epi16( 1 );
+		for( ; iX + 8 <= i_iDestWidth; iX += 8 )
+		{
+			__m128i vSumLo = vZero, vSumHi = vZero;
+			for( uint32 iRow = 0; iRow < i_iNumRows; ++iRow )
+			{
+				const __m128i vBytes = _mm_loadu_si128( (const __m128i *)&i_ppRows[iRow][iX * 2] );
+				vSumLo = _mm_add_epi16( vSumLo, _mm_unpacklo_epi8( vBytes, vZero ) );
+				vSumHi = _mm_add_epi16( vSumHi, _mm_unpackhi_epi8( vBytes, vZero ) );
+			}
+
+			__m128i vSum = _mm_packs_epi32( _mm_madd_epi16( vSumLo, vOnes ), _mm_madd_epi16( vSumHi, vOnes ) );
+			vSum = _mm_srl_epi16( _mm_add_epi16( vSum, vRound ), vShift );
+			_mm_storel_epi64( (__m128i *)&o_pRow[iX], _mm_packus_epi16( vSum, vSum ) );
+		}
+	}
+	#endif
+
+	for( ; iX < i_iDestWidth; ++iX )
+	{
+		const uint32 iOffsets[2] = { 2 * iX * i_iChannels, ( 2 * iX + 1 ) * i_iChannels };
+		for( uint32 iChannel = 0; iChannel < i_iChannels; ++iChannel )
+		{
+			uint32 iSum = i_iNumRows;
+			for( uint32 iRow = 0; iRow < i_iNumRows; ++iRow )
+				iSum += i_ppRows[iRow][iOffsets[0] + iChannel] + i_ppRows[iRow][iOffsets[1] + iChannel];
+			o_pRow[iX * i_iChannels + iChannel] = (byte)( iSum >> iShift );
+		}
+	}
+}
+
+/// Adds 2x2 blocks of float pixels of two source rows to a destination row.
+/// @param[in,out] io_pRow the destination row.
+/// @param[in] i_pSrcRow0 the upper source row.
+/// @param[in] i_pSrcRow1 the lower source row.
+/// @param[in] i_iDestWidth number of destination pixels.
+/// @param[in] i_iChannels number of floats per pixel, e [1,4].
+/// @param[in] i_bFirst true if the destination row shall be overwritten instead of being added to.
+/// @param[in] i_fScale factor the sums are multiplied with.
+inline void AddMipBlocks( float32 *io_pRow, const float32 *i_pSrcRow0, const float32 *i_pSrcRow1, uint32 i_iDestWidth, uint32 i_iChannels, bool i_bFirst, float32 i_fScale )
+{
+	uint32 iX = 0;
+
+	#ifdef M3D_SSE
+	// Pixels are added from left to right and from top to bottom.
+	const __m128 vScale = _mm_set1_ps( i_fScale );
+	switch( i_iChannels )
+	{
+	case 1: // four pixels at once
+		for( ; iX + 4 <= i_iDestWidth; iX += 4 )
+		{
+			const __m128 vSrc00 = _mm_loadu_ps( &i_pSrcRow0[2 * iX] ), vSrc01 = _mm_loadu_ps( &i_pSrcRow0[2 * iX + 4] );
+			const __m128 vSrc10 = _mm_loadu_ps( &i_pSrcRow1[2 * iX] ), vSrc11 = _mm_loadu_ps( &i_pSrcRow1[2 * iX + 4] );
+			__m128 vSum = _mm_shuffle_ps( vSrc00, vSrc01, _MM_SHUFFLE( 2, 0, 2, 0 ) );
+			if( !i_bFirst )
+				vSum = _mm_add_ps( _mm_loadu_ps( &io_pRow[iX] ), vSum );
+			vSum = _mm_add_ps( vSum, _mm_shuffle_ps( vSrc00, vSrc01, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+			vSum = _mm_add_ps( vSum, _mm_shuffle_ps( vSrc10, vSrc11, _MM_SHUFFLE( 2, 0, 2, 0 ) ) );
+			vSum = _mm_add_ps( vSum, _mm_shuffle_ps( vSrc10, vSrc11, _MM_SHUFFLE( 3, 1, 3, 1 ) ) );
+			_mm_storeu_ps( &io_pRow[iX], _mm_mul_ps( vSum, vScale ) );
+		}
+		break;
+
+	case 2: // two pixels at once
+		for( ; iX + 2 <= i_iDestWidth; iX += 2 )
+		{
+			const __m128 vSrc00 = _mm_loadu_ps( &i_pSrcRow0[4 * iX] ), vSrc01 = _mm_loadu_ps( &i_pSrcRow0[4 * iX + 4] );
+			const __m128 vSrc10 = _mm_loadu_ps( &i_pSrcRow1[4 * iX] ), vSrc11 = _mm_loadu_ps( &i_pSrcRow1[4 * iX + 4] );
+			__m128 vSum = _mm_shuffle_ps( vSrc00, vSrc01, _MM_SHUFFLE( 1, 0, 1, 0 ) );
+			if( !i_bFirst )
+				vSum = _mm_add_ps( _mm_loadu_ps( &io_pRow[2 * iX] ), vSum );
+			vSum = _mm_add_ps( vSum, _mm_shuffle_ps( vSrc00, vSrc01, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+			vSum = _mm_add_ps( vSum, _mm_shuffle_ps( vSrc10, vSrc11, _MM_SHUFFLE( 1, 0, 1, 0 ) ) );
+			vSum = _mm_add_ps( vSum, _mm_shuffle_ps( vSrc10, vSrc11, _MM_SHUFFLE( 3, 2, 3, 2 ) ) );
+			_mm_storeu_ps( &io_pRow[2 * iX], _mm_mul_ps( vSum, vScale ) );
+		}
+		break;
+
+	case 3: // one pixel at a time; the fourth float belongs to the next pixel and is stored unchanged, so the last pixel is left to the scalar loop
+		for( ; iX + 1 < i_iDestWidth; ++iX )
+		{
+			const __m128 vOld = _mm_loadu_ps( &io_pRow[3 * iX] );
+			__m128 vSum = _mm_loadu_ps( &i_pSrcRow0[6 * iX] );
+			if( !i_bFirst )
+				vSum = _mm_add_ps( vOld, vSum );
+			vSum = _mm_add_ps( vSum, _mm_loadu_ps( &i_pSrcRow0[6 * iX + 3] ) );
+			vSum = _mm_add_ps( vSum, _mm_loadu_ps( &i_pSrcRow1[6 * iX] ) );
+			vSum = _mm_mul_ps( _mm_add_ps( vSum, _mm_loadu_ps( &i_pSrcRow1[6 * iX + 3] ) ), vScale );
+			_mm_storeu_ps( &io_pRow[3 * iX], _mm_shuffle_ps( vSum, _mm_shuffle_ps( vSum, vOld, _MM_SHUFFLE( 3, 3, 2, 2 ) ), _MM_SHUFFLE( 2, 0, 1, 0 ) ) );
+		}
+		break;
+
+	default:
+		for( ; iX < i_iDestWidth; ++iX )
+		{
+			__m128 vSum = _mm_loadu_ps( &i_pSrcRow0[8 * iX] );
+			if( !i_bFirst )
+				vSum = _mm_add_ps( _mm_loadu_ps( &io_pRow[4 * iX] ), vSum );
+			vSum = _mm_add_ps( vSum, _mm_loadu_ps( &i_pSrcRow0[8 * iX + 4] ) );
+			vSum = _mm_add_ps( vSum, _mm_loadu_ps( &i_pSrcRow1[8 * iX] ) );
+			vSum = _mm_add_ps( vSum, _mm_loadu_ps( &i_pSrcRow1[8 * iX + 4] ) );
+			_mm_storeu_ps( &io_pRow[4 * iX], _mm_mul_ps( vSum, vScale ) );
+		}
+		break;
+	}
+	#endif
+
+	for( uint32 iValue = iX * i_iChannels; iValue < i_iDestWidth * i_iChannels; ++iValue )
+	{
+		const uint32 iLeft = ( iValue / i_iChannels ) * i_iChannels + iValue;
+		float32 fSum = i_pSrcRow0[iLeft];
+		if( !i_bFirst )
+			fSum = io_pRow[iValue] + fSum;
+		fSum = fSum + i_pSrcRow0[iLeft + i_iChannels] + i_pSrcRow1[iLeft] + i_pSrcRow1[iLeft + i_iChannels];
+		io_pRow[iValue] = fSum * i_fScale;
+	}
+}
+
+/// Averages 2x2 or 2x2x2 blocks of float pixels, adding the pixels in the same order as the scalar box-filter of previous versions.
+/// @param[out] o_pRow receives the destination pixels.
+/// @param[in] i_ppRows the source rows; two for 2-dimensional levels, four for volumes.
+/// @param[in] i_iNumRows number of source rows.
+/// @param[in] i_iDestWidth number of destination pixels.
+/// @param[in] i_iChannels number of floats per pixel, e [1,4].
+inline void AverageMipRowFloat( float32 *o_pRow, const float32 * const *i_ppRows, uint32 i_iNumRows, uint32 i_iDestWidth, uint32 i_iChannels )
+{
+	const float32 fScale = 0.5f / (float32)i_iNumRows;
+	if( i_iNumRows == 2 )
+		AddMipBlocks( o_pRow, i_ppRows[0], i_ppRows[1], i_iDestWidth, i_iChannels, true, fScale );
+	else
+	{
+		// The sums of the first slice are kept in the destination row, which stays in the cache.
+		AddMipBlocks( o_pRow, i_ppRows[0], i_ppRows[1], i_iDestWidth, i_iChannels, true, 1.0f );
+		AddMipBlocks( o_pRow, i_ppRows[2], i_ppRows[3], i_iDestWidth, i_iChannels, false, fScale );
+	}
+}
+
+/// Describes the rows shared by all jobs generating a mip-level.
+struct m3dmipjob
+{
+	const m3dmipgeneration	*pGeneration;	///< The levels.
+	uint32					iChannels;		///< Number of channels per pixel.
+	uint32					iPixelBytes;	///< Size of a pixel in bytes.
+	bool					bAverage;		///< True if all dimensions are halved and 8-bit or float pixels are averaged directly; 8-bit pixels are averaged in integer arithmetic.
+};
+
+/// Thread pool job: filters c_iMipRowsPerJob destination rows. Rows of all slices of a volume are numbered consecutively.
+/// @param[in] i_pJob pointer to the m3dmipjob.
+/// @param[in] i_iJob index of the job.
+/// @param[in] i_iThread index of the executing thread (unused).
+void FilterMipRowsJob( void *i_pJob, uint32 i_iJob, uint32 i_iThread )
+{
+	const m3dmipjob *pJob = (const m3dmipjob *)i_pJob;
+	const m3dmipgeneration &Generation = *pJob->pGeneration;
+
+	const uint32 iNumRows = Generation.iDestHeight * Generation.iDestDepth;
+	const uint32 iFirstRow = i_iJob * c_iMipRowsPerJob;
+	uint32 iLastRow = iFirstRow + c_iMipRowsPerJob;
+	if( iLastRow > iNumRows )
+		iLastRow = iNumRows;
+
+	const uint32 iSrcPitch = Generation.iSrcWidth * pJob->iPixelBytes;
+	const uint32 iSrcSlicePitch = iSrcPitch * Generation.iSrcHeight;
+	const uint32 iDestPitch = Generation.iDestWidth * pJob->iPixelBytes;
+	const uint32 iSrcValues = Generation.iSrcWidth * pJob->iChannels;
+	const bool bFloatFormat = bIsFloat32Format( Generation.fmtFormat );
+
+	// Scratch rows are padded for vector loads and stores beyond the last pixel.
+	std::vector<float32> Decoded, Sum, Filtered;
+	if( !pJob->bAverage )
+	{
+		if( !bFloatFormat )
+			Decoded.resize( iSrcValues + 4 );
+		Sum.resize( iSrcValues + 4 );
+		Filtered.resize( Generation.iDestWidth * pJob->iChannels + 4 );
+	}
+
+	for( uint32 iRow = iFirstRow; iRow < iLastRow; ++iRow )
+	{
+		m3dmiptaps TapsZ, TapsY;
+		ComputeMipTaps( TapsZ, iRow / Generation.iDestHeight, Generation.iSrcDepth, Generation.iDestDepth );
+		ComputeMipTaps( TapsY, iRow % Generation.iDestHeight, Generation.iSrcHeight, Generation.iDestHeight );
+
+		const byte *pSrcRows[9];
+		float32 fRowWeights[9];
+		uint32 iNumSrcRows = 0;
+		for( uint32 iTapZ = 0; iTapZ < TapsZ.iNumTaps; ++iTapZ )
+		{
+			for( uint32 iTapY = 0; iTapY < TapsY.iNumTaps; ++iTapY, ++iNumSrcRows )
+			{
+				pSrcRows[iNumSrcRows] = Generation.pSource + ( TapsZ.iFirst + iTapZ ) * iSrcSlicePitch + ( TapsY.iFirst + iTapY ) * iSrcPitch;
+				fRowWeights[iNumSrcRows] = TapsZ.fWeights[iTapZ] * TapsY.fWeights[iTapY];
+			}
+		}
+
+		byte *pDestRow = Generation.pDestination + iRow * iDestPitch;
+		if( pJob->bAverage )
+		{
+			if( bFloatFormat )
+				AverageMipRowFloat( (float32 *)pDestRow, (const float32 * const *)pSrcRows, iNumSrcRows, Generation.iDestWidth, pJob->iChannels );
+			else
+				AverageMipRow8( pDestRow, pSrcRows, iNumSrcRows, Generation.iDestWidth, pJob->iChannels );
+			continue;
+		}
+
+		for( uint32 iSrcRow = 0; iSrcRow < iNumSrcRows; ++iSrcRow )
+		{
+			const float32 *pValues = (const float32 *)pSrcRows[iSrcRow];
+			if( !bFloatFormat )
+			{
+				DecodeMipRow( &Decoded[0], pSrcRows[iSrcRow], Generation.fmtFormat, Generation.iSrcWidth );
+				pValues = &Decoded[0];
+			}
+
+			AccumulateMipRow( &Sum[0], pValues, fRowWeights[iSrcRow], iSrcValues, iSrcRow == 0 );
+		}
+
+		FilterMipRow( &Filtered[0], &Sum[0], Generation.iSrcWidth, Generation.iDestWidth, pJob->iChannels );
+		EncodeMipRow( pDestRow, &Filtered[0], Generation.fmtFormat, Generation.iDestWidth );
+	}
+}
+
+void GenerateMipLevel( const m3dmipgeneration &i_Generation, CMuli3DThreadPool *i_pThreads )
+{
+	m3dmipjob Job;
+	Job.pGeneration = &i_Generation;
+	Job.iChannels = iGetMipChannels( i_Generation.fmtFormat );
+	Job.iPixelBytes = iGetFormatPixelBytes( i_Generation.fmtFormat );
+	Job.bAverage = ( bIsFloat32Format( i_Generation.fmtFormat ) || i_Generation.fmtFormat == m3dfmt_r8 || i_Generation.fmtFormat == m3dfmt_r8g8b8a8 ) &&
+		i_Generation.iSrcWidth == 2 * i_Generation.iDestWidth && i_Generation.iSrcHeight == 2 * i_Generation.iDestHeight &&
+		( i_Generation.iSrcDepth == 2 * i_Generation.iDestDepth || i_Generation.iSrcDepth == i_Generation.iDestDepth );
+
+	const uint32 iNumRows = i_Generation.iDestHeight * i_Generation.iDestDepth;
+	const uint32 iNumJobs = ( iNumRows + c_iMipRowsPerJob - 1 ) / c_iMipRowsPerJob;
+	if( i_pThreads && i_pThreads->iGetNumThreads() > 1 && iNumJobs > 1 &&
+		i_Generation.iDestWidth * iNumRows >= c_iMipMinParallelPixels )
+	{
+		i_pThreads->Execute( FilterMipRowsJob, &Job, iNumJobs );
+	}
+	else
+	{
+		for( uint32 iJob = 0; iJob < iNumJobs; ++iJob )
+			FilterMipRowsJob( &Job, iJob, 0 );
+	}
+}
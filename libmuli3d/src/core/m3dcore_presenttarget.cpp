@@ -19,16 +19,34 @@
 
 #include "../../include/core/m3dcore_presenttarget.h"
 #include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_pixelformat.h"
+#include "../../include/core/m3dcore_threadpool.h"
+#include <math.h>
+#include <stdio.h>
+
+#ifdef WIN32
+#define snprintf _snprintf
+#endif
+
+const uint32 c_iGammaLUTSize = 4096;	///< Number of intensities per channel in the gamma lookup-table.
+const uint32 c_iPresentRowsPerJob = 16;	///< Number of rows converted by a single thread pool job.
 
 IMuli3DPresentTarget::IMuli3DPresentTarget( CMuli3DDevice *i_pParent ) :
-	m_pParent( i_pParent )
+	m_pParent( i_pParent ), m_pConversionThreads( 0 ),
+	m_GammaLUTFormat( m3dppf_numformats ), m_fGammaLUTGamma( 0.0f ),
+	m_FixedLUTFormat( m3dppf_numformats ), m_fFixedLUTGamma( 0.0f )
 {
+	m_i16bitMaxVal[0] = m_i16bitMaxVal[1] = m_i16bitMaxVal[2] = 0;
+	m_i16bitShift[0] = m_i16bitShift[1] = m_i16bitShift[2] = 0;
+
 	//	note: cannot add a reference to parent or the presenttarget will never be freed
 	//	m_pParent->AddRef();
 }
 
 IMuli3DPresentTarget::~IMuli3DPresentTarget()
 {
+	SAFE_DELETE( m_pConversionThreads );
+
 	//	note: see note in constructor.
 	//	SAFE_RELEASE( m_pParent );
 }
@@ -40,6 +58,493 @@ CMuli3DDevice *IMuli3DPresentTarget::pGetDevice() {
 	return m_pParent;
 }
 
+void IMuli3DPresentTarget::ConvertPixels( m3dpresentpixelformat i_Format, byte *o_pDestination, uint32 i_iDestinationPitch,
+	const void *i_pSource, m3dformat i_fmtSource )
+{
+	m3ddeviceparameters DeviceParameters = m_pParent->GetDeviceParameters();
+
+	// Create conversion threads on first use ---------------------------------
+	const uint32 iThreads = DeviceParameters.iPresentThreads < c_iMaxRasterizerThreads ? DeviceParameters.iPresentThreads : c_iMaxRasterizerThreads;
+	if( iThreads > 1 && ( !m_pConversionThreads || m_pConversionThreads->iGetNumThreads() != iThreads ) )
+	{
+		if( !m_pConversionThreads )
+			m_pConversionThreads = new CMuli3DThreadPool;
+
+		if( m_pConversionThreads && FUNC_FAILED( m_pConversionThreads->Create( iThreads ) ) )
+			SAFE_DELETE( m_pConversionThreads ); // convert on the calling thread only
+	}
+
+	// Setup gamma correction -------------------------------------------------
+	m_bConvertGamma = ( DeviceParameters.fPresentGamma > 0.0f && DeviceParameters.fPresentGamma != 1.0f );
+	if( bIsFloat32Format( i_fmtSource ) )
+	{
+		if( m_bConvertGamma && ( m_GammaLUTFormat != i_Format || m_fGammaLUTGamma != DeviceParameters.fPresentGamma ) )
+			BuildGammaLUT( i_Format, DeviceParameters.fPresentGamma );
+	}
+	else
+	{
+		// Fixed-point colorbuffers are converted through a lookup-table, which includes gamma correction.
+		const float32 fGamma = m_bConvertGamma ? DeviceParameters.fPresentGamma : 1.0f;
+		if( m_FixedLUTFormat != i_Format || m_fFixedLUTGamma != fGamma )
+			BuildFixedLUT( i_Format, fGamma );
+	}
+
+	m_ConvertFormat = i_Format;
+	m_pConvertDestination = o_pDestination;
+	m_iConvertPitch = i_iDestinationPitch;
+	m_pConvertSource = (const byte *)i_pSource;
+	m_fmtConvertSource = i_fmtSource;
+	m_iConvertSourceBytes = iGetFormatPixelBytes( i_fmtSource );
+	m_iConvertWidth = DeviceParameters.iBackbufferWidth;
+	m_iConvertHeight = DeviceParameters.iBackbufferHeight;
+
+	const uint32 iNumJobs = ( m_iConvertHeight + c_iPresentRowsPerJob - 1 ) / c_iPresentRowsPerJob;
+	if( m_pConversionThreads && iThreads > 1 )
+		m_pConversionThreads->Execute( ConvertRowsJob, this, iNumJobs );
+	else
+	{
+		for( uint32 iJob = 0; iJob < iNumJobs; ++iJob )
+			ConvertRowsJob( this, iJob, 0 );
+	}
+}
+
+void IMuli3DPresentTarget::ConvertRowsJob( void *i_pPresentTarget, uint32 i_iJob, uint32 i_iThread )
+{
+	IMuli3DPresentTarget *pPresentTarget = (IMuli3DPresentTarget *)i_pPresentTarget;
+
+	const uint32 iFirstRow = i_iJob * c_iPresentRowsPerJob;
+	uint32 iLastRow = iFirstRow + c_iPresentRowsPerJob;
+	if( iLastRow > pPresentTarget->m_iConvertHeight )
+		iLastRow = pPresentTarget->m_iConvertHeight;
+
+	const uint32 iSourcePitch = pPresentTarget->m_iConvertWidth * pPresentTarget->m_iConvertSourceBytes;
+	const bool bFloatSource = bIsFloat32Format( pPresentTarget->m_fmtConvertSource );
+
+	fpuTruncate(); // the fpu control word is per thread
+
+	for( uint32 iRow = iFirstRow; iRow < iLastRow; ++iRow )
+	{
+		byte *pDestination = pPresentTarget->m_pConvertDestination + iRow * pPresentTarget->m_iConvertPitch;
+		const byte *pSource = pPresentTarget->m_pConvertSource + iRow * iSourcePitch;
+		if( bFloatSource )
+			pPresentTarget->ConvertRow( pDestination, (const float32 *)pSource, pPresentTarget->m_iConvertWidth );
+		else
+			pPresentTarget->ConvertRowFixed( pDestination, pSource, pPresentTarget->m_iConvertWidth );
+	}
+
+	fpuReset();
+}
+
+void IMuli3DPresentTarget::BuildGammaLUT( m3dpresentpixelformat i_Format, float32 i_fGamma )
+{
+	m_GammaLUT.resize( 3 * c_iGammaLUTSize );
+
+	const float32 fInvGamma = 1.0f / i_fGamma;
+	for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+	{
+		const float32 fMaxVal = ( i_Format == m3dppf_packed16 ) ? (float32)m_i16bitMaxVal[iChannel] : 255.0f;
+		uint32 *pLUT = &m_GammaLUT[iChannel * c_iGammaLUTSize];
+		for( uint32 iIntensity = 0; iIntensity < c_iGammaLUTSize; ++iIntensity )
+		{
+			const float32 fIntensity = powf( (float32)iIntensity / (float32)( c_iGammaLUTSize - 1 ), fInvGamma );
+			pLUT[iIntensity] = (uint32)( fIntensity * fMaxVal + 0.5f );
+		}
+	}
+
+	m_GammaLUTFormat = i_Format;
+	m_fGammaLUTGamma = i_fGamma;
+}
+
+void IMuli3DPresentTarget::BuildFixedLUT( m3dpresentpixelformat i_Format, float32 i_fGamma )
+{
+	m_FixedLUT.resize( 3 * 256 );
+
+	const float32 fInvGamma = 1.0f / i_fGamma;
+	for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+	{
+		const float32 fMaxVal = ( i_Format == m3dppf_packed16 ) ? (float32)m_i16bitMaxVal[iChannel] : 255.0f;
+		uint32 *pLUT = &m_FixedLUT[iChannel * 256];
+		for( uint32 iIntensity = 0; iIntensity < 256; ++iIntensity )
+		{
+			const float32 fIntensity = ( i_fGamma != 1.0f ) ? powf( (float32)iIntensity / 255.0f, fInvGamma ) : (float32)iIntensity / 255.0f;
+			pLUT[iIntensity] = (uint32)( fIntensity * fMaxVal + 0.5f );
+		}
+	}
+
+	m_FixedLUTFormat = i_Format;
+	m_fFixedLUTGamma = i_fGamma;
+}
+
+/// Scales a color-channel, clamps it to [0;i_fMax] and truncates it; NaNs become 0.
+inline int32 iConvertChannel( float32 i_fValue, float32 i_fScale, float32 i_fOffset, float32 i_fMax )
+{
+	const float32 fValue = i_fValue * i_fScale + i_fOffset;
+	if( fValue > 0.0f )
+		return fValue < i_fMax ? ftol( fValue ) : (int32)i_fMax;
+	return 0;
+}
+
+void IMuli3DPresentTarget::ConvertRow( byte *o_pDestination, const float32 *i_pSource, uint32 i_iPixels )
+{
+	const uint32 iFloats = m_iConvertSourceBytes / sizeof( float32 );
+	const bool bSourceAlpha = ( iFloats >= 4 );
+
+	// Channels are either scaled to their final range or, with gamma correction,
+	// rounded to an index into the gamma lookup-table; alpha is never corrected.
+	float32 fScale[4], fOffset[4];
+	for( uint32 iChannel = 0; iChannel < 3; ++iChannel )
+	{
+		if( m_bConvertGamma )
+		{
+			fScale[iChannel] = (float32)( c_iGammaLUTSize - 1 );
+			fOffset[iChannel] = 0.5f;
+		}
+		else
+		{
+			fScale[iChannel] = ( m_ConvertFormat == m3dppf_packed16 ) ? (float32)m_i16bitMaxVal[iChannel] : 255.0f;
+			fOffset[iChannel] = 0.0f;
+		}
+	}
+	fScale[3] = 255.0f; fOffset[3] = 0.0f;
+
+	const uint32 *pLUTRed = m_bConvertGamma ? &m_GammaLUT[0] : 0;
+	const uint32 *pLUTGreen = m_bConvertGamma ? &m_GammaLUT[c_iGammaLUTSize] : 0;
+	const uint32 *pLUTBlue = m_bConvertGamma ? &m_GammaLUT[2 * c_iGammaLUTSize] : 0;
+
+	// Up to four pixels are converted at once; iValues[channel][pixel].
+	int32 iValues[4][4];
+	uint32 iNumValues;
+
+	while( i_iPixels )
+	{
+		#ifdef M3D_SSE2
+		// Loading four floats per pixel reads one float beyond the last pixel of
+		// a 3-float colorbuffer; keep at least one pixel for the scalar path.
+		if( i_iPixels >= 4 + ( bSourceAlpha ? 0 : 1 ) )
+		{
+			__m128 vRed = _mm_loadu_ps( i_pSource );
+			__m128 vGreen = _mm_loadu_ps( i_pSource + iFloats );
+			__m128 vBlue = _mm_loadu_ps( i_pSource + 2 * iFloats );
+			__m128 vAlpha = _mm_loadu_ps( i_pSource + 3 * iFloats );
+			_MM_TRANSPOSE4_PS( vRed, vGreen, vBlue, vAlpha );
+
+			// max( NaN, 0 ) returns 0
+			const __m128 vZero = _mm_setzero_ps();
+			const __m128i vRedI = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_add_ps( _mm_mul_ps( vRed, _mm_set1_ps( fScale[0] ) ), _mm_set1_ps( fOffset[0] ) ), vZero ), _mm_set1_ps( fScale[0] ) ) );
+			const __m128i vGreenI = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_add_ps( _mm_mul_ps( vGreen, _mm_set1_ps( fScale[1] ) ), _mm_set1_ps( fOffset[1] ) ), vZero ), _mm_set1_ps( fScale[1] ) ) );
+			const __m128i vBlueI = _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_add_ps( _mm_mul_ps( vBlue, _mm_set1_ps( fScale[2] ) ), _mm_set1_ps( fOffset[2] ) ), vZero ), _mm_set1_ps( fScale[2] ) ) );
+			const __m128i vAlphaI = bSourceAlpha ? _mm_cvttps_epi32( _mm_min_ps( _mm_max_ps( _mm_mul_ps( vAlpha, _mm_set1_ps( 255.0f ) ), vZero ), _mm_set1_ps( 255.0f ) ) ) : _mm_set1_epi32( 255 );
+
+			i_pSource += 4 * iFloats;
+
+			if( m_ConvertFormat == m3dppf_bgra32 && !m_bConvertGamma )
+			{
+				// Pack and store four pixels at once
+				const __m128i vPixels = _mm_or_si128( _mm_or_si128( vBlueI, _mm_slli_epi32( vGreenI, 8 ) ),
+					_mm_or_si128( _mm_slli_epi32( vRedI, 16 ), _mm_slli_epi32( vAlphaI, 24 ) ) );
+				_mm_storeu_si128( (__m128i *)o_pDestination, vPixels );
+				o_pDestination += 16;
+				i_iPixels -= 4;
+				continue;
+			}
+
+			_mm_storeu_si128( (__m128i *)iValues[0], vRedI );
+			_mm_storeu_si128( (__m128i *)iValues[1], vGreenI );
+			_mm_storeu_si128( (__m128i *)iValues[2], vBlueI );
+			_mm_storeu_si128( (__m128i *)iValues[3], vAlphaI );
+			iNumValues = 4;
+		}
+		else
+		#endif
+		{
+			iValues[0][0] = iConvertChannel( i_pSource[0], fScale[0], fOffset[0], fScale[0] );
+			iValues[1][0] = iConvertChannel( i_pSource[1], fScale[1], fOffset[1], fScale[1] );
+			iValues[2][0] = iConvertChannel( i_pSource[2], fScale[2], fOffset[2], fScale[2] );
+			iValues[3][0] = bSourceAlpha ? iConvertChannel( i_pSource[3], 255.0f, 0.0f, 255.0f ) : 255;
+			i_pSource += iFloats;
+			iNumValues = 1;
+		}
+
+		for( uint32 iPixel = 0; iPixel < iNumValues; ++iPixel )
+		{
+			uint32 iRed = iValues[0][iPixel], iGreen = iValues[1][iPixel], iBlue = iValues[2][iPixel];
+			if( m_bConvertGamma )
+			{
+				iRed = pLUTRed[iRed];
+				iGreen = pLUTGreen[iGreen];
+				iBlue = pLUTBlue[iBlue];
+			}
+
+			switch( m_ConvertFormat )
+			{
+			case m3dppf_packed16:
+				*(uint16 *)o_pDestination = (uint16)( ( iRed << m_i16bitShift[0] ) | ( iGreen << m_i16bitShift[1] ) | ( iBlue << m_i16bitShift[2] ) );
+				o_pDestination += 2;
+				break;
+
+			case m3dppf_bgr24:
+				o_pDestination[0] = (byte)iBlue; o_pDestination[1] = (byte)iGreen; o_pDestination[2] = (byte)iRed;
+				o_pDestination += 3;
+				break;
+
+			case m3dppf_bgra32:
+				o_pDestination[0] = (byte)iBlue; o_pDestination[1] = (byte)iGreen; o_pDestination[2] = (byte)iRed;
+				o_pDestination[3] = (byte)iValues[3][iPixel];
+				o_pDestination += 4;
+				break;
+
+			default: // m3dppf_rgb24
+				o_pDestination[0] = (byte)iRed; o_pDestination[1] = (byte)iGreen; o_pDestination[2] = (byte)iBlue;
+				o_pDestination += 3;
+				break;
+			}
+		}
+
+		i_iPixels -= iNumValues;
+	}
+}
+
+void IMuli3DPresentTarget::ConvertRowFixed( byte *o_pDestination, const byte *i_pSource, uint32 i_iPixels )
+{
+	if( !m_bConvertGamma )
+	{
+		// Copy rows, whose layout already matches the display's.
+		if( m_fmtConvertSource == m3dfmt_r5g6b5 && m_ConvertFormat == m3dppf_packed16 &&
+			m_i16bitMaxVal[0] == 31 && m_i16bitMaxVal[1] == 63 && m_i16bitMaxVal[2] == 31 &&
+			m_i16bitShift[0] == 11 && m_i16bitShift[1] == 5 && m_i16bitShift[2] == 0 )
+		{
+			memcpy( o_pDestination, i_pSource, i_iPixels * 2 );
+			return;
+		}
+
+		if( m_fmtConvertSource == m3dfmt_r8g8b8a8 && m_ConvertFormat == m3dppf_bgra32 )
+		{
+			#ifdef M3D_SSE2
+			// Swap red and blue of four pixels at once
+			const __m128i vMaskGreenAlpha = _mm_set1_epi32( 0xff00ff00 ), vMaskByte = _mm_set1_epi32( 0xff );
+			for( ; i_iPixels >= 4; i_iPixels -= 4, i_pSource += 16, o_pDestination += 16 )
+			{
+				const __m128i vPixels = _mm_loadu_si128( (const __m128i *)i_pSource );
+				_mm_storeu_si128( (__m128i *)o_pDestination, _mm_or_si128( _mm_and_si128( vPixels, vMaskGreenAlpha ),
+					_mm_or_si128( _mm_and_si128( _mm_srli_epi32( vPixels, 16 ), vMaskByte ), _mm_slli_epi32( _mm_and_si128( vPixels, vMaskByte ), 16 ) ) ) );
+			}
+			#endif
+
+			for( ; i_iPixels; --i_iPixels, i_pSource += 4, o_pDestination += 4 )
+			{
+				o_pDestination[0] = i_pSource[2]; o_pDestination[1] = i_pSource[1];
+				o_pDestination[2] = i_pSource[0]; o_pDestination[3] = i_pSource[3];
+			}
+			return;
+		}
+
+		if( m_fmtConvertSource == m3dfmt_r8g8b8a8 && m_ConvertFormat == m3dppf_rgb24 )
+		{
+			for( ; i_iPixels; --i_iPixels, i_pSource += 4, o_pDestination += 3 )
+			{
+				o_pDestination[0] = i_pSource[0]; o_pDestination[1] = i_pSource[1]; o_pDestination[2] = i_pSource[2];
+			}
+			return;
+		}
+	}
+
+	const uint32 *pLUTRed = &m_FixedLUT[0];
+	const uint32 *pLUTGreen = &m_FixedLUT[256];
+	const uint32 *pLUTBlue = &m_FixedLUT[2 * 256];
+
+	for( ; i_iPixels; --i_iPixels, i_pSource += m_iConvertSourceBytes )
+	{
+		// Expand the channels to bytes
+		uint32 iRed, iGreen, iBlue, iAlpha;
+		if( m_fmtConvertSource == m3dfmt_r5g6b5 )
+		{
+			const uint32 iPixel = *(const uint16 *)i_pSource;
+			iRed = ( iPixel >> 11 ) & 31; iRed = ( iRed << 3 ) | ( iRed >> 2 );
+			iGreen = ( iPixel >> 5 ) & 63; iGreen = ( iGreen << 2 ) | ( iGreen >> 4 );
+			iBlue = iPixel & 31; iBlue = ( iBlue << 3 ) | ( iBlue >> 2 );
+			iAlpha = 255;
+		}
+		else
+		{
+			iRed = i_pSource[0]; iGreen = i_pSource[1]; iBlue = i_pSource[2]; iAlpha = i_pSource[3];
+		}
+
+		iRed = pLUTRed[iRed];
+		iGreen = pLUTGreen[iGreen];
+		iBlue = pLUTBlue[iBlue];
+
+		switch( m_ConvertFormat )
+		{
+		case m3dppf_packed16:
+			*(uint16 *)o_pDestination = (uint16)( ( iRed << m_i16bitShift[0] ) | ( iGreen << m_i16bitShift[1] ) | ( iBlue << m_i16bitShift[2] ) );
+			o_pDestination += 2;
+			break;
+
+		case m3dppf_bgr24:
+			o_pDestination[0] = (byte)iBlue; o_pDestination[1] = (byte)iGreen; o_pDestination[2] = (byte)iRed;
+			o_pDestination += 3;
+			break;
+
+		case m3dppf_bgra32:
+			o_pDestination[0] = (byte)iBlue; o_pDestination[1] = (byte)iGreen; o_pDestination[2] = (byte)iRed;
+			o_pDestination[3] = (byte)iAlpha;
+			o_pDestination += 4;
+			break;
+
+		default: // m3dppf_rgb24
+			o_pDestination[0] = (byte)iRed; o_pDestination[1] = (byte)iGreen; o_pDestination[2] = (byte)iBlue;
+			o_pDestination += 3;
+			break;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------
+
+CMuli3DPresentTargetFrameQueue::CMuli3DPresentTargetFrameQueue( CMuli3DDevice *i_pParent )
+	: IMuli3DPresentTarget( i_pParent ),
+	m_iFrameSize( 0 ), m_iQueueLength( 0 ), m_iFirstFrame( 0 ), m_iNumFrames( 0 )
+{}
+
+CMuli3DPresentTargetFrameQueue::~CMuli3DPresentTargetFrameQueue()
+{}
+
+result CMuli3DPresentTargetFrameQueue::Create()
+{
+	m3ddeviceparameters DeviceParameters = m_pParent->GetDeviceParameters();
+
+	if( !DeviceParameters.iBackbufferWidth || !DeviceParameters.iBackbufferHeight )
+	{
+		FUNC_FAILING( "CMuli3DPresentTargetFrameQueue::Create: invalid backbuffer dimensions have been supplied.\n" );
+		return e_invalidparameters;
+	}
+
+	m_iFrameSize = DeviceParameters.iBackbufferWidth * DeviceParameters.iBackbufferHeight * 3;
+	m_iQueueLength = DeviceParameters.iFrameQueueLength ? DeviceParameters.iFrameQueueLength : c_iDefaultFrameQueueLength;
+	m_iFirstFrame = 0;
+	m_iNumFrames = 0;
+
+	m_Frames.resize( m_iFrameSize * m_iQueueLength );
+	if( m_Frames.size() != m_iFrameSize * m_iQueueLength )
+	{
+		FUNC_FAILING( "CMuli3DPresentTargetFrameQueue::Create: couldn't allocate memory for frame queue.\n" );
+		return e_outofmemory;
+	}
+
+	return s_ok;
+}
+
+result CMuli3DPresentTargetFrameQueue::Present( const void *i_pSource, m3dformat i_fmtSource )
+{
+	if( m_iNumFrames == m_iQueueLength )
+	{
+		// queue is full: drop the oldest frame
+		m_iFirstFrame = ( m_iFirstFrame + 1 ) % m_iQueueLength;
+		--m_iNumFrames;
+	}
+
+	const uint32 iFrame = ( m_iFirstFrame + m_iNumFrames ) % m_iQueueLength;
+	ConvertPixels( m3dppf_rgb24, &m_Frames[iFrame * m_iFrameSize], m_iFrameSize / m_pParent->GetDeviceParameters().iBackbufferHeight, i_pSource, i_fmtSource );
+	++m_iNumFrames;
+
+	return s_ok;
+}
+
+result CMuli3DPresentTargetFrameQueue::ReadFrame( byte *o_pPixels )
+{
+	if( !o_pPixels )
+	{
+		FUNC_FAILING( "CMuli3DPresentTargetFrameQueue::ReadFrame: parameter o_pPixels points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	if( !m_iNumFrames )
+	{
+		FUNC_FAILING( "CMuli3DPresentTargetFrameQueue::ReadFrame: frame queue is empty.\n" );
+		return e_invalidstate;
+	}
+
+	memcpy( o_pPixels, &m_Frames[m_iFirstFrame * m_iFrameSize], m_iFrameSize );
+	m_iFirstFrame = ( m_iFirstFrame + 1 ) % m_iQueueLength;
+	--m_iNumFrames;
+
+	return s_ok;
+}
+
+uint32 CMuli3DPresentTargetFrameQueue::iGetNumFrames()
+{
+	return m_iNumFrames;
+}
+
+// ----------------------------------------------------------------------------
+
+CMuli3DPresentTargetPPMFiles::CMuli3DPresentTargetPPMFiles( CMuli3DDevice *i_pParent )
+	: IMuli3DPresentTarget( i_pParent ), m_iFrameNumber( 0 )
+{}
+
+CMuli3DPresentTargetPPMFiles::~CMuli3DPresentTargetPPMFiles()
+{}
+
+result CMuli3DPresentTargetPPMFiles::Create()
+{
+	m3ddeviceparameters DeviceParameters = m_pParent->GetDeviceParameters();
+
+	if( !DeviceParameters.iBackbufferWidth || !DeviceParameters.iBackbufferHeight )
+	{
+		FUNC_FAILING( "CMuli3DPresentTargetPPMFiles::Create: invalid backbuffer dimensions have been supplied.\n" );
+		return e_invalidparameters;
+	}
+
+	if( !DeviceParameters.pFileNamePattern || !*DeviceParameters.pFileNamePattern )
+	{
+		FUNC_FAILING( "CMuli3DPresentTargetPPMFiles::Create: no file name pattern has been supplied.\n" );
+		return e_invalidparameters;
+	}
+
+	m_strFileNamePattern = DeviceParameters.pFileNamePattern;
+	m_iFrameNumber = 0;
+
+	const uint32 iPixelBytes = DeviceParameters.iBackbufferWidth * DeviceParameters.iBackbufferHeight * 3;
+	m_Pixels.resize( iPixelBytes );
+	if( m_Pixels.size() != iPixelBytes )
+	{
+		FUNC_FAILING( "CMuli3DPresentTargetPPMFiles::Create: couldn't allocate memory for frame.\n" );
+		return e_outofmemory;
+	}
+
+	return s_ok;
+}
+
+result CMuli3DPresentTargetPPMFiles::Present( const void *i_pSource, m3dformat i_fmtSource )
+{
+	m3ddeviceparameters DeviceParameters = m_pParent->GetDeviceParameters();
+
+	ConvertPixels( m3dppf_rgb24, &m_Pixels[0], DeviceParameters.iBackbufferWidth * 3, i_pSource, i_fmtSource );
+
+	char szFileName[1024];
+	snprintf( szFileName, sizeof( szFileName ), m_strFileNamePattern.c_str(), m_iFrameNumber++ );
+	szFileName[sizeof( szFileName ) - 1] = 0;
+
+	FILE *pFile = fopen( szFileName, "wb" );
+	if( !pFile )
+	{
+		FUNC_FAILING( "CMuli3DPresentTargetPPMFiles::Present: couldn't create image file.\n" );
+		return e_unknown;
+	}
+
+	fprintf( pFile, "P6\n%u %u\n255\n", DeviceParameters.iBackbufferWidth, DeviceParameters.iBackbufferHeight );
+	const bool bWritten = ( fwrite( &m_Pixels[0], 1, m_Pixels.size(), pFile ) == m_Pixels.size() );
+	fclose( pFile );
+
+	if( !bWritten )
+	{
+		FUNC_FAILING( "CMuli3DPresentTargetPPMFiles::Present: couldn't write image file.\n" );
+		return e_unknown;
+	}
+
+	return s_ok;
+}
+
 // ----------------------------------------------------------------------------
 
 #ifdef WIN32
@@ -253,7 +758,7 @@ void CMuli3DPresentTargetWin32::ProcessBits( uint32 i_iMask, uint16 &o_iLowBit,
 	}
 }
 
-result CMuli3DPresentTargetWin32::Present( const float32 *i_pSource, uint32 i_iFloats )
+result CMuli3DPresentTargetWin32::Present( const void *i_pSource, m3dformat i_fmtSource )
 {
 	m3ddeviceparameters DeviceParameters = m_pParent->GetDeviceParameters();
 
@@ -278,52 +783,8 @@ result CMuli3DPresentTargetWin32::Present( const float32 *i_pSource, uint32 i_iF
 	const uint32 iDestBytes = descSurface.ddpfPixelFormat.dwRGBBitCount / 8;
 
     // Copy pixels to the backbuffer-surface ----------------------------------
-	const uint32 iDestRowJump = descSurface.lPitch - iDestBytes * DeviceParameters.iBackbufferWidth;
-	uint8 *pDestination = (uint8 *)descSurface.lpSurface;
-
-	fpuTruncate();
-
-	if( iDestBytes == 2 )
-	{
-		// 16-bit
-		uint32 iHeight = DeviceParameters.iBackbufferHeight;
-		while( iHeight-- )
-		{
-			uint32 iWidth = DeviceParameters.iBackbufferWidth;
-			while( iWidth-- )
-			{
-				const int32 iR = iClamp( ftol( i_pSource[0] * m_i16bitMaxVal[0] ), 0, m_i16bitMaxVal[0] );
-				const int32 iG = iClamp( ftol( i_pSource[1] * m_i16bitMaxVal[1] ), 0, m_i16bitMaxVal[1] );
-				const int32 iB = iClamp( ftol( i_pSource[2] * m_i16bitMaxVal[2] ), 0, m_i16bitMaxVal[2] );
-				i_pSource += i_iFloats;
-
-				*((uint16 *)pDestination) = ( iR << m_i16bitShift[0] ) | ( iG << m_i16bitShift[1] ) | ( iB << m_i16bitShift[2] );
-				pDestination += 2;
-			}
-			pDestination += iDestRowJump;
-		}
-	}
-	else
-	{
-		// 24- or 32-bit
-		uint32 iHeight = DeviceParameters.iBackbufferHeight;
-		while( iHeight-- )
-		{
-			uint32 iWidth = DeviceParameters.iBackbufferWidth;
-			while( iWidth-- )
-			{
-				pDestination[0] = iClamp( ftol( i_pSource[2] * 255.0f ), 0, 255 ); // b
-				pDestination[1] = iClamp( ftol( i_pSource[1] * 255.0f ), 0, 255 ); // g
-				pDestination[2] = iClamp( ftol( i_pSource[0] * 255.0f ), 0, 255 ); // r
-
-				i_pSource += i_iFloats;
-				pDestination += iDestBytes;
-			}
-			pDestination += iDestRowJump;
-		}
-	}
-
-	fpuReset();
+	const m3dpresentpixelformat Format = ( iDestBytes == 2 ) ? m3dppf_packed16 : ( ( iDestBytes == 3 ) ? m3dppf_bgr24 : m3dppf_bgra32 );
+	ConvertPixels( Format, (byte *)descSurface.lpSurface, descSurface.lPitch, i_pSource, i_fmtSource );
 
     // Unlock backbuffer-surface and surface
     m_pDirectDrawSurfaces[1]->Unlock( 0 );
@@ -475,46 +936,13 @@ result CMuli3DPresentTargetLinuxX11::Create()
 	return s_ok;
 }
 
-result CMuli3DPresentTargetLinuxX11::Present( const float32 *i_pSource, uint32 i_iFloats )
+result CMuli3DPresentTargetLinuxX11::Present( const void *i_pSource, m3dformat i_fmtSource )
 {
 	m3ddeviceparameters DeviceParameters = m_pParent->GetDeviceParameters();
 
 	// Copy pixels to the ximage-buffer ---------------------------------------
-
-	fpuTruncate();
-
-	if( m_iPixelBytes == 2 )
-	{
-		// 16-bit
-		uint16 *pDestination = (uint16 *)m_pXImage->data;
-		uint32 iPixels = DeviceParameters.iBackbufferWidth * DeviceParameters.iBackbufferHeight;
-		while( iPixels-- )
-		{
-			const int32 iR = iClamp( ftol( i_pSource[0] * m_i16bitMaxVal[0] ), 0, m_i16bitMaxVal[0] );
-			const int32 iG = iClamp( ftol( i_pSource[1] * m_i16bitMaxVal[1] ), 0, m_i16bitMaxVal[1] );
-			const int32 iB = iClamp( ftol( i_pSource[2] * m_i16bitMaxVal[2] ), 0, m_i16bitMaxVal[2] );
-			i_pSource += i_iFloats;
-
-			*pDestination++ = ( iR << m_i16bitShift[0] ) | ( iG << m_i16bitShift[1] ) | ( iB << m_i16bitShift[2] );
-		}
-	}
-	else
-	{
-		// 24- or 32-bit
-		uint8 *pDestination = (uint8 *)m_pXImage->data;
-		uint32 iPixels = DeviceParameters.iBackbufferWidth * DeviceParameters.iBackbufferHeight;
-		while( iPixels-- )
-		{
-			pDestination[0] = iClamp( ftol( i_pSource[2] * 255.0f ), 0, 255 ); // b
-			pDestination[1] = iClamp( ftol( i_pSource[1] * 255.0f ), 0, 255 ); // g
-			pDestination[2] = iClamp( ftol( i_pSource[0] * 255.0f ), 0, 255 ); // r
-
-			i_pSource += i_iFloats;
-			pDestination += m_iPixelBytes;
-		}
-	}
-
-	fpuReset();
+	const m3dpresentpixelformat Format = ( m_iPixelBytes == 2 ) ? m3dppf_packed16 : ( ( m_iPixelBytes == 3 ) ? m3dppf_bgr24 : m3dppf_bgra32 );
+	ConvertPixels( Format, (byte *)m_pXImage->data, DeviceParameters.iBackbufferWidth * m_iPixelBytes, i_pSource, i_fmtSource );
 
 	// Present to window/screen
 	XPutImage( m_pDisplay, DeviceParameters.hDeviceWindow, m_WindowGC, m_pXImage, 0, 0,
@@ -575,15 +1003,12 @@ result CMuli3DPresentTargetAmigaOS4::Create()
 	return s_ok;
 }
 
-result CMuli3DPresentTargetAmigaOS4::Present( const float32 *i_pSource, uint32 i_iFloats )
+result CMuli3DPresentTargetAmigaOS4::Present( const void *i_pSource, m3dformat i_fmtSource )
 {
 	m3ddeviceparameters DeviceParameters = m_pParent->GetDeviceParameters();
 
 	// Copy pixels to the image-buffer ---------------------------------------
 
-	// Doesn't currently do anything...
-	fpuTruncate();
-
 	// Picasso96 RenderInfo for locking the bitmap
 	struct RenderInfo ri;
 
@@ -592,36 +1017,7 @@ result CMuli3DPresentTargetAmigaOS4::Present( const float32 *i_pSource, uint32 i
 
 	if ( lock )
 	{
-		// Pointer to allocated buffer
-		uint8 *pDestination = (uint8 *)ri.Memory;
-	
-		// Help pointer to a row in bitmap
-		uint8 *_pDestination;
-	
-		for ( uint32 y = 0; y < DeviceParameters.iBackbufferHeight; y++ )
-		{
-			// Next row
-			_pDestination = pDestination + y * ri.BytesPerRow; 
-
-			for ( uint32 x = 0; x < DeviceParameters.iBackbufferWidth; x++ )
-			{
-		 		//*_pDestination++ = iClamp( (int32)( *i_pSource++ * 255.0f ), 0, 255 ); // r
-				//*_pDestination++ = iClamp( (int32)( *i_pSource++ * 255.0f ), 0, 255 ); // g
-				//*_pDestination++ = iClamp( (int32)( *i_pSource++ * 255.0f ), 0, 255 ); // b
-
-				// Set r, g and b bytes in our buffer
-		 		_pDestination[0] = iClamp( ftol( i_pSource[0] * 255.0f ), 0, 255 ); // r
-				_pDestination[1] = iClamp( ftol( i_pSource[1] * 255.0f ), 0, 255 ); // g
-				_pDestination[2] = iClamp( ftol( i_pSource[2] * 255.0f ), 0, 255 ); // b
-
-		 		//*_pDestination++ = (iClamp( ftol( i_pSource[0] * 255.0f ), 0, 255 ) << 16) |
-				//	(iClamp( ftol( i_pSource[1] * 255.0f ), 0, 255 ) << 8) |
-				//	iClamp( ftol( i_pSource[2] * 255.0f ), 0, 255 );
-
-				i_pSource += i_iFloats;
-				_pDestination += 3;
-			}
-		}
+		ConvertPixels( m3dppf_rgb24, (byte *)ri.Memory, ri.BytesPerRow, i_pSource, i_fmtSource );
 
 		IP96->p96UnlockBitMap( m_pBitMap, lock );
 
@@ -631,9 +1027,6 @@ result CMuli3DPresentTargetAmigaOS4::Present( const float32 *i_pSource, uint32 i
 		IGraphics->WaitTOF();
 	} // lock
 
-	// Doesn't currently do anything...
-	fpuReset();
-
 	return s_ok;
 }
 
@@ -20,6 +20,7 @@
 #include "../../include/core/m3dcore_rendertarget.h"
 #include "../../include/core/m3dcore_device.h"
 #include "../../include/core/m3dcore_surface.h"
+#include "../../include/core/m3dcore_pixelformat.h"
 
 CMuli3DRenderTarget::CMuli3DRenderTarget( CMuli3DDevice *i_pParent )
 	: m_pParent( i_pParent ), m_pColorBuffer( 0 ), m_pDepthBuffer( 0 )
@@ -68,7 +69,8 @@ result CMuli3DRenderTarget::SetColorBuffer( CMuli3DSurface *i_pColorBuffer )
 {
 	if( i_pColorBuffer )
 	{
-		if( i_pColorBuffer->fmtGetFormat() < m3dfmt_r32f || i_pColorBuffer->fmtGetFormat() > m3dfmt_r32g32b32a32f )
+		const m3dformat fmtFormat = i_pColorBuffer->fmtGetFormat();
+		if( !bIsFloat32Format( fmtFormat ) && fmtFormat != m3dfmt_r8g8b8a8 && fmtFormat != m3dfmt_r5g6b5 )
 		{
 			FUNC_FAILING( "CMuli3DRenderTarget::SetColorBuffer: invalid texture format.\n" );
 			return e_invalidformat;
@@ -95,7 +97,7 @@ result CMuli3DRenderTarget::SetDepthBuffer( CMuli3DSurface *i_pDepthBuffer )
 {
 	if( i_pDepthBuffer )
 	{
-		if( i_pDepthBuffer->fmtGetFormat() != m3dfmt_r32f )
+		if( i_pDepthBuffer->fmtGetFormat() != m3dfmt_r32f && !bIsDepthFormat( i_pDepthBuffer->fmtGetFormat() ) )
 		{
 			FUNC_FAILING( "CMuli3DRenderTarget::SetDepthBuffer: invalid texture format.\n" );
 			return e_invalidformat;
@@ -18,6 +18,21 @@
 */
 
 #include "../../include/core/m3dcore_shaders.h"
+#include "../../include/core/m3dcore_threadpool.h"
+
+static M3D_THREADLOCAL const m3dtriangleinfo *g_pThreadTriangleInfo = 0; ///< Triangle info of the calling rasterization thread.
+
+void IMuli3DVertexShader::TransformBatch( m3dshaderregbatch &o_Dest, const m3dshaderregbatch &i_Src, const matrix44 &i_matMatrix ) const
+{
+	for( uint32 iLane = 0; iLane < c_iMaxShaderBatchSize; ++iLane )
+	{
+		const float32 fX = i_Src.x[iLane], fY = i_Src.y[iLane], fZ = i_Src.z[iLane], fW = i_Src.w[iLane];
+		o_Dest.x[iLane] = i_matMatrix._11 * fX + i_matMatrix._21 * fY + i_matMatrix._31 * fZ + i_matMatrix._41 * fW;
+		o_Dest.y[iLane] = i_matMatrix._12 * fX + i_matMatrix._22 * fY + i_matMatrix._32 * fZ + i_matMatrix._42 * fW;
+		o_Dest.z[iLane] = i_matMatrix._13 * fX + i_matMatrix._23 * fY + i_matMatrix._33 * fZ + i_matMatrix._43 * fW;
+		o_Dest.w[iLane] = i_matMatrix._14 * fX + i_matMatrix._24 * fY + i_matMatrix._34 * fZ + i_matMatrix._44 * fW;
+	}
+}
 
 void IMuli3DPixelShader::SetInfo( const m3dshaderregtype *i_pVSOutputs, const struct m3dtriangleinfo *i_pTriangleInfo )
 {
@@ -25,28 +40,54 @@ void IMuli3DPixelShader::SetInfo( const m3dshaderregtype *i_pVSOutputs, const st
 	m_pTriangleInfo = i_pTriangleInfo;
 }
 
+void IMuli3DPixelShader::SetThreadTriangleInfo( const struct m3dtriangleinfo *i_pTriangleInfo )
+{
+	g_pThreadTriangleInfo = i_pTriangleInfo;
+}
+
 // Partial derivative equations taken from
 // "MIP-Map Level Selection for Texture Mapping",
 // Jon P. Ewins, Member, IEEE, Marcus D. Waller,
 // Martin White, and Paul F. Lister, Member, IEEE
 
 void IMuli3DPixelShader::GetDerivatives( uint32 i_iRegister, vector4 &o_vDdx, vector4 &o_vDdy ) const
+{
+	const m3dtriangleinfo *pTriangleInfo = g_pThreadTriangleInfo ? g_pThreadTriangleInfo : m_pTriangleInfo;
+	ComputeDerivatives( i_iRegister, (float32)pTriangleInfo->iCurPixelX, (float32)pTriangleInfo->iCurPixelY,
+		pTriangleInfo->fCurPixelInvW, o_vDdx, o_vDdy );
+}
+
+void IMuli3DPixelShader::GetDerivatives( const m3dpixelbatch &i_Batch, uint32 i_iLane, uint32 i_iRegister, vector4 &o_vDdx, vector4 &o_vDdy ) const
+{
+	if( i_iLane >= c_iMaxShaderBatchSize )
+	{
+		o_vDdx = vector4( 0, 0, 0, 0 ); o_vDdy = vector4( 0, 0, 0, 0 );
+		return;
+	}
+
+	ComputeDerivatives( i_iRegister, (float32)i_Batch.iX[i_iLane], (float32)i_Batch.iY[i_iLane],
+		i_Batch.fInvW[i_iLane], o_vDdx, o_vDdy );
+}
+
+void IMuli3DPixelShader::ComputeDerivatives( uint32 i_iRegister, float32 i_fPixelX, float32 i_fPixelY, float32 i_fInvW, vector4 &o_vDdx, vector4 &o_vDdy ) const
 {
 	o_vDdx = vector4( 0, 0, 0, 0 ); o_vDdy = vector4( 0, 0, 0, 0 );
 	if( i_iRegister < 0 || i_iRegister >= c_iPixelShaderRegisters )
 		return;
 
-	const shaderreg &A = m_pTriangleInfo->ShaderOutputsDdx[i_iRegister];
-	const shaderreg &B = m_pTriangleInfo->ShaderOutputsDdy[i_iRegister];
-	const shaderreg &C = m_pTriangleInfo->pBaseVertex->ShaderOutputs[i_iRegister];
+	const m3dtriangleinfo *pTriangleInfo = g_pThreadTriangleInfo ? g_pThreadTriangleInfo : m_pTriangleInfo;
+
+	const shaderreg &A = pTriangleInfo->ShaderOutputsDdx[i_iRegister];
+	const shaderreg &B = pTriangleInfo->ShaderOutputsDdy[i_iRegister];
+	const shaderreg &C = pTriangleInfo->pBaseVertex->ShaderOutputs[i_iRegister];
 
-	const float32 D = m_pTriangleInfo->fWDdx;
-	const float32 E = m_pTriangleInfo->fWDdy;
-	const float32 F = m_pTriangleInfo->pBaseVertex->vPosition.w;
+	const float32 D = pTriangleInfo->fWDdx;
+	const float32 E = pTriangleInfo->fWDdy;
+	const float32 F = pTriangleInfo->pBaseVertex->vPosition.w;
 
-	const float32 fRelPixelX = m_pTriangleInfo->iCurPixelX - m_pTriangleInfo->pBaseVertex->vPosition.x;
-	const float32 fRelPixelY = m_pTriangleInfo->iCurPixelY - m_pTriangleInfo->pBaseVertex->vPosition.y;
-	const float32 fInvWSquare = m_pTriangleInfo->fCurPixelInvW * m_pTriangleInfo->fCurPixelInvW;
+	const float32 fRelPixelX = i_fPixelX - pTriangleInfo->pBaseVertex->vPosition.x;
+	const float32 fRelPixelY = i_fPixelY - pTriangleInfo->pBaseVertex->vPosition.y;
+	const float32 fInvWSquare = i_fInvW * i_fInvW;
 
 	// Compute partial derivative with respect to the x-screen space coordinate.
 	switch( m_pVSOutputs[i_iRegister] )
@@ -18,20 +18,68 @@
 */
 
 #include "../../include/core/m3dcore_surface.h"
+#include "../../include/core/m3dcore_blockformat.h"
 #include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_pixelformat.h"
 
 CMuli3DSurface::CMuli3DSurface( CMuli3DDevice *i_pParent ) :
-	m_pParent( i_pParent ), m_iWidth( 0 ), m_iHeight( 0 ), m_iWidthMin1( 0 ), m_iHeightMin1( 0 ),
-	m_bLockedComplete( false ), m_pPartialLockData( 0 ), m_pData( 0 )
+	m_pParent( i_pParent ), m_iWidth( 0 ), m_iHeight( 0 ), m_iWidthMin1( 0 ), m_iHeightMin1( 0 ), m_iPixelBytes( 0 ), m_iBlocksPerRow( 0 ), m_iBlockCacheID( 0 ),
+	m_Layout( m3dtl_linear ), m_iTilesPerRow( 0 ),
+	m_bLockedComplete( false ), m_pPartialLockData( 0 ), m_pData( 0 ), m_iDataSize( 0 ), m_bOwnsData( false ),
+	m_pHiZ( 0 ), m_pHiZDirty( 0 ), m_iHiZWidth( 0 ), m_iHiZHeight( 0 ), m_bHiZValid( false )
 {}
 
 CMuli3DSurface::~CMuli3DSurface()
 {
 	SAFE_DELETE_ARRAY( m_pPartialLockData ); // somebody might have forgotten to unlock the surface ;)
-	SAFE_DELETE_ARRAY( m_pData );
+	if( m_bOwnsData )
+		SAFE_DELETE_ARRAY( m_pData );
+	SAFE_DELETE_ARRAY( m_pHiZ );
+	SAFE_DELETE_ARRAY( m_pHiZDirty );
 }
 
-result CMuli3DSurface::Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat )
+inline uint32 CMuli3DSurface::iGetPixelIndex( uint32 i_iX, uint32 i_iY )
+{
+	if( m_Layout == m3dtl_linear )
+		return i_iY * m_iWidth + i_iX;
+
+	const uint32 iTile = ( i_iY / c_iTextureTileSize ) * m_iTilesPerRow + i_iX / c_iTextureTileSize;
+	return ( iTile * c_iTextureTileSize + i_iY % c_iTextureTileSize ) * c_iTextureTileSize + i_iX % c_iTextureTileSize;
+}
+
+inline void CMuli3DSurface::ReadBlockPixel( byte *o_pPixel, uint32 i_iX, uint32 i_iY )
+{
+	const uint32 iBlockX = i_iX / c_iCompressedBlockSize, iBlockY = i_iY / c_iCompressedBlockSize;
+	const byte *pPixels = pGetCachedBlock( m_fmtFormat, &m_pData[( iBlockY * m_iBlocksPerRow + iBlockX ) * m_iPixelBytes],
+		m_iBlockCacheID, iBlockX, iBlockY );
+	memcpy( o_pPixel, &pPixels[( ( i_iY % c_iCompressedBlockSize ) * c_iCompressedBlockSize + i_iX % c_iCompressedBlockSize ) * 4], 4 );
+}
+
+bool CMuli3DSurface::bIsBlockAligned( const m3drect &i_Rect )
+{
+	return !( i_Rect.iLeft % c_iCompressedBlockSize ) && !( i_Rect.iTop % c_iCompressedBlockSize ) &&
+		( !( i_Rect.iRight % c_iCompressedBlockSize ) || i_Rect.iRight == m_iWidth ) &&
+		( !( i_Rect.iBottom % c_iCompressedBlockSize ) || i_Rect.iBottom == m_iHeight );
+}
+
+/// Bi-linearly filters four pixels of unsigned normalized bytes.
+/// @param[out] o_vColor receives the filtered color.
+/// @param[in] i_ppPixels the upper left, upper right, lower left and lower right pixel; four bytes each.
+/// @param[in] i_fInterpolation horizontal and vertical interpolation factor.
+static inline void FilterUNorm8Pixels( vector4 &o_vColor, const byte * const *i_ppPixels, const float32 *i_fInterpolation )
+{
+	float32 fFinalColor[4];
+	for( uint32 iChannel = 0; iChannel < 4; ++iChannel )
+	{
+		const float32 fColorRow0 = fLerp( i_ppPixels[0][iChannel], i_ppPixels[1][iChannel], i_fInterpolation[0] );
+		const float32 fColorRow1 = fLerp( i_ppPixels[2][iChannel], i_ppPixels[3][iChannel], i_fInterpolation[0] );
+		fFinalColor[iChannel] = fLerp( fColorRow0, fColorRow1, i_fInterpolation[1] ) * ( 1.0f / 255.0f );
+	}
+
+	o_vColor = vector4( fFinalColor[0], fFinalColor[1], fFinalColor[2], fFinalColor[3] );
+}
+
+result CMuli3DSurface::Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fmtFormat, m3dtexturelayout i_Layout, byte *i_pData )
 {
 	if( !i_iWidth || !i_iHeight )
 	{
@@ -39,14 +87,10 @@ result CMuli3DSurface::Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fm
 		return e_invalidparameters;
 	}
 	
-	uint32 iFloats;
-	switch( i_fmtFormat )
+	if( !bIsTextureFormat( i_fmtFormat ) && !bIsBlockFormat( i_fmtFormat ) && !bIsDepthFormat( i_fmtFormat ) )
 	{
-	case m3dfmt_r32f: iFloats = 1; break;
-	case m3dfmt_r32g32f: iFloats = 2; break;
-	case m3dfmt_r32g32b32f: iFloats = 3; break;
-	case m3dfmt_r32g32b32a32f: iFloats = 4; break;
-	default: FUNC_FAILING( "CMuli3DSurface::Create: invalid format specified.\n" ); return e_invalidformat;
+		FUNC_FAILING( "CMuli3DSurface::Create: invalid format specified.\n" );
+		return e_invalidformat;
 	}
 
 	m_fmtFormat = i_fmtFormat;
@@ -54,14 +98,47 @@ result CMuli3DSurface::Create( uint32 i_iWidth, uint32 i_iHeight, m3dformat i_fm
 	m_iHeight = i_iHeight;
 	m_iWidthMin1 = m_iWidth - 1;
 	m_iHeightMin1 = m_iHeight - 1;
+	m_iPixelBytes = iGetFormatPixelBytes( i_fmtFormat );
+	m_Layout = i_Layout;
 
-	m_pData = new float32[m_iWidth * m_iHeight * iFloats];
+	uint32 iNumPixels = m_iWidth * m_iHeight;
+	if( bIsBlockFormat( i_fmtFormat ) )
+	{
+		// Blocks are stored row by row; the pixels of a block are close to each other anyway.
+		m_iPixelBytes = iGetFormatBlockBytes( i_fmtFormat );
+		m_iBlocksPerRow = ( m_iWidth + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize;
+		m_Layout = m3dtl_linear;
+		m_iBlockCacheID = iGetBlockCacheID();
+		iNumPixels = m_iBlocksPerRow * ( ( m_iHeight + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize ); // number of blocks
+	}
+	else if( m_Layout == m3dtl_tiled )
+	{
+		// Pad the surface to whole tiles
+		m_iTilesPerRow = ( m_iWidth + c_iTextureTileSize - 1 ) / c_iTextureTileSize;
+		const uint32 iTileRows = ( m_iHeight + c_iTextureTileSize - 1 ) / c_iTextureTileSize;
+		iNumPixels = m_iTilesPerRow * iTileRows * c_iTextureTileSize * c_iTextureTileSize;
+	}
+	else if( m_Layout != m3dtl_linear )
+	{
+		FUNC_FAILING( "CMuli3DSurface::Create: invalid layout specified.\n" );
+		return e_invalidparameters;
+	}
+
+	m_iDataSize = iNumPixels * m_iPixelBytes;
+	if( i_pData )
+	{
+		m_pData = i_pData;
+		return s_ok;
+	}
+
+	m_pData = new byte[m_iDataSize];
 	if( !m_pData )
 	{
 		FUNC_FAILING( "CMuli3DSurface::Create: out of memory, cannot create surface.\n" );
 		return e_outofmemory;
 	}
 
+	m_bOwnsData = true;
 	return s_ok;
 }
 
@@ -92,6 +169,60 @@ result CMuli3DSurface::Clear( const vector4 &i_vColor, const m3drect *i_pRect )
 		ClearRect.iRight = m_iWidth; ClearRect.iBottom = m_iHeight;
 	}
 
+	if( m_iBlocksPerRow )
+	{
+		// Fill the blocks with a single encoded block.
+		if( !bIsBlockAligned( ClearRect ) )
+		{
+			FUNC_FAILING( "CMuli3DSurface::Clear: clear-rectangle isn't aligned to the surface's blocks!\n" );
+			return e_invalidparameters;
+		}
+
+		if( m_bLockedComplete || m_pPartialLockData )
+		{
+			FUNC_FAILING( "CMuli3DSurface::Clear: surface is locked!\n" );
+			return e_invalidstate;
+		}
+
+		byte ClearBlock[16];
+		EncodeSolidBlock( ClearBlock, m_fmtFormat, i_vColor );
+
+		const uint32 iBlockRight = ( ClearRect.iRight + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize;
+		const uint32 iBlockBottom = ( ClearRect.iBottom + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize;
+		for( uint32 iBlockY = ClearRect.iTop / c_iCompressedBlockSize; iBlockY < iBlockBottom; ++iBlockY )
+		{
+			for( uint32 iBlockX = ClearRect.iLeft / c_iCompressedBlockSize; iBlockX < iBlockRight; ++iBlockX )
+				memcpy( &m_pData[( iBlockY * m_iBlocksPerRow + iBlockX ) * m_iPixelBytes], ClearBlock, m_iPixelBytes );
+		}
+
+		m_iBlockCacheID = iGetBlockCacheID();
+		return s_ok;
+	}
+
+	if( m_Layout != m3dtl_linear )
+	{
+		// Tiled surfaces never have a hierarchical depth buffer; fill the tiles directly
+		// instead of detiling and retiling the whole surface.
+		if( m_bLockedComplete || m_pPartialLockData )
+		{
+			FUNC_FAILING( "CMuli3DSurface::Clear: surface is locked!\n" );
+			return e_invalidstate;
+		}
+
+		byte ClearPixel[16];
+		EncodePixel( ClearPixel, m_fmtFormat, i_vColor );
+
+		for( uint32 iY = ClearRect.iTop; iY < ClearRect.iBottom; ++iY )
+		{
+			for( uint32 iX = ClearRect.iLeft; iX < ClearRect.iRight; ++iX )
+				memcpy( &m_pData[iGetPixelIndex( iX, iY ) * m_iPixelBytes], ClearPixel, m_iPixelBytes );
+		}
+
+		return s_ok;
+	}
+
+	const bool bHiZValid = m_bHiZValid; // locking invalidates the hierarchical depth buffer
+
 	float32 *pData;
 	result resPointer = LockRect( (void **)&pData, 0 ); // lock entire surface for higher speed!
 	if( FUNC_FAILED( resPointer ) )
@@ -145,16 +276,149 @@ result CMuli3DSurface::Clear( const vector4 &i_vColor, const m3drect *i_pRect )
 		}
 		break;
 
-	default: // cannot happen
-		FUNC_FAILING( "CMuli3DSurface::Clear: invalid surface format.\n" );
-		UnlockRect();
-		return e_invalidformat;
+	default:
+		{
+			// Compact formats: encode the color once and replicate it
+			byte ClearPixel[8];
+			EncodePixel( ClearPixel, m_fmtFormat, i_vColor );
+
+			byte *pCurData = &((byte *)pData)[( ClearRect.iTop * m_iWidth + ClearRect.iLeft ) * m_iPixelBytes];
+			for( uint32 iY = ClearRect.iTop; iY < ClearRect.iBottom; ++iY, pCurData += iBridgeStep * m_iPixelBytes )
+			{
+				for( uint32 iX = ClearRect.iLeft; iX < ClearRect.iRight; ++iX, pCurData += m_iPixelBytes )
+					memcpy( pCurData, ClearPixel, m_iPixelBytes );
+			}
+		}
+		break;
+	}
+
+	// Update the hierarchical depth buffer: blocks which have been cleared completely
+	// are set to the clear-value, partially cleared blocks are extended to include it.
+	const bool bCompleteClear = !ClearRect.iLeft && !ClearRect.iTop && ClearRect.iRight == m_iWidth && ClearRect.iBottom == m_iHeight;
+	if( m_pHiZ && ( bHiZValid || bCompleteClear ) )
+	{
+		const float32 fDepth = i_vColor.r;
+		for( uint32 iBlockY = ClearRect.iTop / c_iHiZBlockSize; iBlockY <= ( ClearRect.iBottom - 1 ) / c_iHiZBlockSize; ++iBlockY )
+		{
+			const uint32 iTop = iBlockY * c_iHiZBlockSize, iBottom = iTop + c_iHiZBlockSize < m_iHeight ? iTop + c_iHiZBlockSize : m_iHeight;
+			for( uint32 iBlockX = ClearRect.iLeft / c_iHiZBlockSize; iBlockX <= ( ClearRect.iRight - 1 ) / c_iHiZBlockSize; ++iBlockX )
+			{
+				const uint32 iLeft = iBlockX * c_iHiZBlockSize, iRight = iLeft + c_iHiZBlockSize < m_iWidth ? iLeft + c_iHiZBlockSize : m_iWidth;
+				float32 *pBounds = &m_pHiZ[( iBlockY * m_iHiZWidth + iBlockX ) * 2];
+				if( iLeft >= ClearRect.iLeft && iRight <= ClearRect.iRight && iTop >= ClearRect.iTop && iBottom <= ClearRect.iBottom )
+				{
+					pBounds[0] = pBounds[1] = fDepth;
+					m_pHiZDirty[iBlockY * m_iHiZWidth + iBlockX] = 0;
+				}
+				else
+				{
+					if( fDepth < pBounds[0] ) pBounds[0] = fDepth;
+					if( fDepth > pBounds[1] ) pBounds[1] = fDepth;
+				}
+			}
+		}
 	}
 
 	UnlockRect();
+
+	if( m_pHiZ && ( bHiZValid || bCompleteClear ) )
+		m_bHiZValid = true;
+
+	return s_ok;
+}
+
+result CMuli3DSurface::LockRectHiZ( void **o_ppData, float32 **o_ppHiZ, byte **o_ppHiZDirty, uint32 &o_iHiZPitch )
+{
+	if( m_fmtFormat != m3dfmt_r32f )
+	{
+		FUNC_FAILING( "CMuli3DSurface::LockRectHiZ: surface is not a depthbuffer.\n" );
+		return e_invalidstate;
+	}
+
+	const bool bHiZValid = m_bHiZValid;
+	result resLock = LockRect( o_ppData, 0 );
+	if( FUNC_FAILED( resLock ) )
+		return resLock;
+
+	if( m_Layout != m3dtl_linear )
+	{
+		// The surface is accessed through a lock-buffer; don't maintain a hierarchical depth buffer.
+		*o_ppHiZ = 0;
+		*o_ppHiZDirty = 0;
+		o_iHiZPitch = 0;
+		return s_ok;
+	}
+
+	if( !m_pHiZ )
+	{
+		m_iHiZWidth = ( m_iWidth + c_iHiZBlockSize - 1 ) / c_iHiZBlockSize;
+		m_iHiZHeight = ( m_iHeight + c_iHiZBlockSize - 1 ) / c_iHiZBlockSize;
+		m_pHiZ = new float32[m_iHiZWidth * m_iHiZHeight * 2];
+		m_pHiZDirty = new byte[m_iHiZWidth * m_iHiZHeight];
+		if( !m_pHiZ || !m_pHiZDirty )
+		{
+			// Not fatal, the device will just work without the hierarchical depth buffer.
+			FUNC_NOTIFY( "CMuli3DSurface::LockRectHiZ: out of memory, cannot create hierarchical depth buffer.\n" );
+			SAFE_DELETE_ARRAY( m_pHiZ );
+			SAFE_DELETE_ARRAY( m_pHiZDirty );
+		}
+	}
+
+	if( m_pHiZ && !bHiZValid )
+	{
+		// Rebuild all blocks
+		memset( m_pHiZDirty, 1, m_iHiZWidth * m_iHiZHeight );
+		UpdateHiZ();
+	}
+
+	m_bHiZValid = ( m_pHiZ != 0 );
+
+	*o_ppHiZ = m_pHiZ;
+	*o_ppHiZDirty = m_pHiZDirty;
+	o_iHiZPitch = m_iHiZWidth;
 	return s_ok;
 }
 
+void CMuli3DSurface::UpdateHiZ()
+{
+	if( !m_pHiZ )
+		return;
+
+	const byte *pDirty = m_pHiZDirty;
+	for( uint32 iBlockY = 0; iBlockY < m_iHiZHeight; ++iBlockY )
+	{
+		const uint32 iTop = iBlockY * c_iHiZBlockSize, iBottom = iTop + c_iHiZBlockSize < m_iHeight ? iTop + c_iHiZBlockSize : m_iHeight;
+		for( uint32 iBlockX = 0; iBlockX < m_iHiZWidth; ++iBlockX, ++pDirty )
+		{
+			if( !*pDirty )
+				continue;
+
+			const uint32 iLeft = iBlockX * c_iHiZBlockSize, iRight = iLeft + c_iHiZBlockSize < m_iWidth ? iLeft + c_iHiZBlockSize : m_iWidth;
+			const float32 *pDepthData = (const float32 *)m_pData;
+			float32 fMin = pDepthData[iTop * m_iWidth + iLeft], fMax = fMin;
+			for( uint32 iY = iTop; iY < iBottom; ++iY )
+			{
+				const float32 *pData = &pDepthData[iY * m_iWidth + iLeft];
+				for( uint32 iX = iLeft; iX < iRight; ++iX, ++pData )
+				{
+					if( *pData < fMin ) fMin = *pData;
+					if( *pData > fMax ) fMax = *pData;
+				}
+			}
+
+			float32 *pBounds = &m_pHiZ[( iBlockY * m_iHiZWidth + iBlockX ) * 2];
+			pBounds[0] = fMin; pBounds[1] = fMax;
+		}
+	}
+
+	memset( m_pHiZDirty, 0, m_iHiZWidth * m_iHiZHeight );
+}
+
+void CMuli3DSurface::InvalidateHiZ()
+{
+	m_bHiZValid = false;
+}
+
 result CMuli3DSurface::LockRect( void **o_ppData, const m3drect *i_pRect )
 {
 	if( !o_ppData )
@@ -169,48 +433,58 @@ result CMuli3DSurface::LockRect( void **o_ppData, const m3drect *i_pRect )
 		return e_invalidstate;
 	}
 
-	if( !i_pRect )
+	m_bHiZValid = false; // the application may modify the surface's contents
+
+	if( !i_pRect && m_Layout == m3dtl_linear )
 	{
 		*o_ppData = m_pData;
 		m_bLockedComplete = true;
 		return s_ok;
 	}
 
-	if( i_pRect->iRight > m_iWidth ||
+	if( !i_pRect )
+	{
+		m_PartialLockRect.iLeft = 0; m_PartialLockRect.iTop = 0;
+		m_PartialLockRect.iRight = m_iWidth; m_PartialLockRect.iBottom = m_iHeight;
+	}
+	else if( i_pRect->iRight > m_iWidth ||
 		i_pRect->iBottom > m_iHeight )
 	{
 		FUNC_FAILING( "CMuli3DSurface::LockRect: rectangle exceeds surface dimensions!\n" );
 		return e_invalidparameters;
 	}
 
-	if( i_pRect->iLeft >= i_pRect->iRight ||
+	else if( i_pRect->iLeft >= i_pRect->iRight ||
 		i_pRect->iTop >= i_pRect->iBottom )
 	{
 		FUNC_FAILING( "CMuli3DSurface::LockRect: invalid rectangle specified!\n" );
 		return e_invalidparameters;
 	}
+	else
+		m_PartialLockRect = *i_pRect;
 
-	m_PartialLockRect = *i_pRect;
+	if( m_iBlocksPerRow && !bIsBlockAligned( m_PartialLockRect ) )
+	{
+		FUNC_FAILING( "CMuli3DSurface::LockRect: rectangle isn't aligned to the surface's blocks!\n" );
+		return e_invalidparameters;
+	}
 	
 	// create lock-buffer
-	const uint32 iLockWidth = m_PartialLockRect.iRight - m_PartialLockRect.iLeft;
-	const uint32 iLockHeight = m_PartialLockRect.iBottom - m_PartialLockRect.iTop;
-	const uint32 iSurfaceFloats = iGetFormatFloats();
-
-	m_pPartialLockData = new float32[iLockWidth * iLockHeight * iSurfaceFloats];
+	uint32 iLockWidth = m_PartialLockRect.iRight - m_PartialLockRect.iLeft;
+	uint32 iLockHeight = m_PartialLockRect.iBottom - m_PartialLockRect.iTop;
+	if( m_iBlocksPerRow )
+	{
+		iLockWidth = ( iLockWidth + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize;
+		iLockHeight = ( iLockHeight + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize;
+	}
+	m_pPartialLockData = new byte[iLockWidth * iLockHeight * m_iPixelBytes];
 	if( !m_pPartialLockData )
 	{
 		FUNC_FAILING( "CMuli3DSurface::LockRect: memory allocation failed!\n" );
 		return e_outofmemory;
 	}
 	
-	float32 *pCurLockData = m_pPartialLockData;
-	for( uint32 iY = m_PartialLockRect.iTop; iY < m_PartialLockRect.iBottom; ++iY )
-	{
-		const float32 *pCurSurfaceData = &m_pData[(iY * m_iWidth + m_PartialLockRect.iLeft) * iSurfaceFloats];
-		memcpy( pCurLockData, pCurSurfaceData, sizeof( float32 ) * iSurfaceFloats * iLockWidth );
-		pCurLockData += iSurfaceFloats * iLockWidth;
-	}
+	ReadRect( m_pPartialLockData, m_PartialLockRect );
 
 	*o_ppData = m_pPartialLockData;
 
@@ -225,6 +499,9 @@ result CMuli3DSurface::UnlockRect()
 		return e_invalidstate;
 	}
 
+	if( m_iBlocksPerRow )
+		m_iBlockCacheID = iGetBlockCacheID(); // blocks decoded before may have changed
+
 	if( m_bLockedComplete )
 	{
 		m_bLockedComplete = false;
@@ -232,20 +509,76 @@ result CMuli3DSurface::UnlockRect()
 	}
 
 	// update surface
-	const uint32 iLockWidth = m_PartialLockRect.iRight - m_PartialLockRect.iLeft;
-	const uint32 iSurfaceFloats = iGetFormatFloats();
+	WriteRect( m_pPartialLockData, m_PartialLockRect );
 
-	const float32 *pCurLockData = m_pPartialLockData;
-	for( uint32 iY = m_PartialLockRect.iTop; iY < m_PartialLockRect.iBottom; ++iY )
+	SAFE_DELETE_ARRAY( m_pPartialLockData );
+
+	return s_ok;
+}
+
+void CMuli3DSurface::ReadRect( byte *o_pDest, const m3drect &i_Rect )
+{
+	if( m_iBlocksPerRow )
 	{
-		float32 *pCurSurfaceData = &m_pData[(iY * m_iWidth + m_PartialLockRect.iLeft) * iSurfaceFloats];
-		memcpy( pCurSurfaceData, pCurLockData, sizeof( float32 ) * iSurfaceFloats * iLockWidth );
-		pCurLockData += iSurfaceFloats * iLockWidth;
+		const uint32 iBlockLeft = i_Rect.iLeft / c_iCompressedBlockSize;
+		const uint32 iRowBytes = ( ( i_Rect.iRight + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize - iBlockLeft ) * m_iPixelBytes;
+		const uint32 iBlockBottom = ( i_Rect.iBottom + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize;
+		for( uint32 iBlockY = i_Rect.iTop / c_iCompressedBlockSize; iBlockY < iBlockBottom; ++iBlockY, o_pDest += iRowBytes )
+			memcpy( o_pDest, &m_pData[( iBlockY * m_iBlocksPerRow + iBlockLeft ) * m_iPixelBytes], iRowBytes );
+		return;
 	}
 
-	SAFE_DELETE_ARRAY( m_pPartialLockData );
+	const uint32 iRectWidth = i_Rect.iRight - i_Rect.iLeft;
+	for( uint32 iY = i_Rect.iTop; iY < i_Rect.iBottom; ++iY )
+	{
+		if( m_Layout == m3dtl_linear )
+		{
+			memcpy( o_pDest, &m_pData[iGetPixelIndex( i_Rect.iLeft, iY ) * m_iPixelBytes], m_iPixelBytes * iRectWidth );
+			o_pDest += m_iPixelBytes * iRectWidth;
+			continue;
+		}
 
-	return s_ok;
+		// Copy the row in spans, which don't cross tile boundaries
+		for( uint32 iX = i_Rect.iLeft; iX < i_Rect.iRight; )
+		{
+			uint32 iSpan = c_iTextureTileSize - iX % c_iTextureTileSize;
+			if( iSpan > i_Rect.iRight - iX ) iSpan = i_Rect.iRight - iX;
+			memcpy( o_pDest, &m_pData[iGetPixelIndex( iX, iY ) * m_iPixelBytes], m_iPixelBytes * iSpan );
+			o_pDest += m_iPixelBytes * iSpan; iX += iSpan;
+		}
+	}
+}
+
+void CMuli3DSurface::WriteRect( const byte *i_pSrc, const m3drect &i_Rect )
+{
+	if( m_iBlocksPerRow )
+	{
+		const uint32 iBlockLeft = i_Rect.iLeft / c_iCompressedBlockSize;
+		const uint32 iRowBytes = ( ( i_Rect.iRight + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize - iBlockLeft ) * m_iPixelBytes;
+		const uint32 iBlockBottom = ( i_Rect.iBottom + c_iCompressedBlockSize - 1 ) / c_iCompressedBlockSize;
+		for( uint32 iBlockY = i_Rect.iTop / c_iCompressedBlockSize; iBlockY < iBlockBottom; ++iBlockY, i_pSrc += iRowBytes )
+			memcpy( &m_pData[( iBlockY * m_iBlocksPerRow + iBlockLeft ) * m_iPixelBytes], i_pSrc, iRowBytes );
+		return;
+	}
+
+	const uint32 iRectWidth = i_Rect.iRight - i_Rect.iLeft;
+	for( uint32 iY = i_Rect.iTop; iY < i_Rect.iBottom; ++iY )
+	{
+		if( m_Layout == m3dtl_linear )
+		{
+			memcpy( &m_pData[iGetPixelIndex( i_Rect.iLeft, iY ) * m_iPixelBytes], i_pSrc, m_iPixelBytes * iRectWidth );
+			i_pSrc += m_iPixelBytes * iRectWidth;
+			continue;
+		}
+
+		for( uint32 iX = i_Rect.iLeft; iX < i_Rect.iRight; )
+		{
+			uint32 iSpan = c_iTextureTileSize - iX % c_iTextureTileSize;
+			if( iSpan > i_Rect.iRight - iX ) iSpan = i_Rect.iRight - iX;
+			memcpy( &m_pData[iGetPixelIndex( iX, iY ) * m_iPixelBytes], i_pSrc, m_iPixelBytes * iSpan );
+			i_pSrc += m_iPixelBytes * iSpan; iX += iSpan;
+		}
+	}
 }
 
 uint32 CMuli3DSurface::iGetFormatFloats()
@@ -256,42 +589,80 @@ uint32 CMuli3DSurface::iGetFormatFloats()
 	case m3dfmt_r32g32f: return 2;
 	case m3dfmt_r32g32b32f: return 3;
 	case m3dfmt_r32g32b32a32f: return 4;
-	default: /* cannot happen */ return 0;
+	default: return 0; // compact format
 	}
 }
 
+uint32 CMuli3DSurface::iGetPixelBytes()
+{
+	return m_iPixelBytes;
+}
+
+result CMuli3DSurface::ReadData( void *o_pData )
+{
+	if( m_bLockedComplete || m_pPartialLockData )
+	{
+		FUNC_FAILING( "CMuli3DSurface::ReadData: surface is locked.\n" );
+		return e_invalidstate;
+	}
+
+	memcpy( o_pData, m_pData, m_iDataSize );
+	return s_ok;
+}
+
+uint32 CMuli3DSurface::iGetDataSize()
+{
+	return m_iDataSize;
+}
+
+m3dtexturelayout CMuli3DSurface::GetLayout()
+{
+	return m_Layout;
+}
+
 void CMuli3DSurface::SamplePoint( vector4 &o_vColor, float32 i_fU, float32 i_fV )
 {
 	const float32 fX = i_fU * m_iWidthMin1, fY = i_fV * m_iHeightMin1;
-	const uint32 iPixelX = ftol( fX ), iPixelY = ftol( fY );
+	const uint32 iIndex = iGetPixelIndex( ftol( fX ), ftol( fY ) );
 
 	switch( m_fmtFormat )
 	{
 	case m3dfmt_r32f:
 		{
-			const float32 *pPixel = &m_pData[iPixelY * m_iWidth + iPixelX];
+			const float32 *pPixel = &((const float32 *)m_pData)[iIndex];
 			o_vColor = vector4( pPixel[0], 0, 0, 1 );
 		}
 		break;
 	case m3dfmt_r32g32f:
 		{
-			const vector2 *pPixel = (const vector2 *)&m_pData[2 * (iPixelY * m_iWidth + iPixelX)];
+			const vector2 *pPixel = &((const vector2 *)m_pData)[iIndex];
 			o_vColor = vector4( pPixel->x, pPixel->y, 0, 1 );
 		}
 		break;
 	case m3dfmt_r32g32b32f:
 		{
-			const vector3 *pPixel = (const vector3 *)&m_pData[3 * (iPixelY * m_iWidth + iPixelX)];
+			const vector3 *pPixel = &((const vector3 *)m_pData)[iIndex];
 			o_vColor = vector4( pPixel->x, pPixel->y, pPixel->z, 1 );
 		}
 		break;
 	case m3dfmt_r32g32b32a32f:
 		{
-			const vector4 *pPixel = (const vector4 *)&m_pData[4 * (iPixelY * m_iWidth + iPixelX)];
+			const vector4 *pPixel = &((const vector4 *)m_pData)[iIndex];
 			o_vColor = *pPixel;
 		}
 		break;
-	default: // cannot happen
+	case m3dfmt_r8:
+		o_vColor = vector4( m_pData[iIndex] * ( 1.0f / 255.0f ), 0, 0, 1 );
+		break;
+	case m3dfmt_bc1: case m3dfmt_bc3: case m3dfmt_bc4: case m3dfmt_bc5:
+		{
+			byte Pixel[4];
+			ReadBlockPixel( Pixel, ftol( fX ), ftol( fY ) );
+			DecodePixel( o_vColor, m3dfmt_r8g8b8a8, Pixel );
+		}
+		break;
+	default: // m3dfmt_r8g8b8a8, m3dfmt_r16g16f, m3dfmt_r16g16b16a16f, m3dfmt_r5g6b5, m3dfmt_d16, m3dfmt_d24
+		DecodePixel( o_vColor, m_fmtFormat, &m_pData[iIndex * m_iPixelBytes] );
 		break;
 	}
 }
@@ -305,7 +676,11 @@ void CMuli3DSurface::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV
 	if( iPixelX2 >= m_iWidth ) iPixelX2 = m_iWidthMin1;
 	if( iPixelY2 >= m_iHeight ) iPixelY2 = m_iHeightMin1;
 
-	const uint32 iIndexRows[2] = { iPixelY * m_iWidth, iPixelY2 * m_iWidth };
+	const uint32 iIndices[4] =
+	{
+		iGetPixelIndex( iPixelX, iPixelY ), iGetPixelIndex( iPixelX2, iPixelY ),
+		iGetPixelIndex( iPixelX, iPixelY2 ), iGetPixelIndex( iPixelX2, iPixelY2 )
+	};
 	const float32 fInterpolation[2] = { fX - iPixelX, fY - iPixelY };
 
 	switch( m_fmtFormat )
@@ -313,8 +688,9 @@ void CMuli3DSurface::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV
 	case m3dfmt_r32f:
 		{
 			float32 fColorRows[2];
-			fColorRows[0] = fLerp( m_pData[iIndexRows[0] + iPixelX], m_pData[iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			fColorRows[1] = fLerp( m_pData[iIndexRows[1] + iPixelX], m_pData[iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			const float32 *pPixelData = (const float32 *)m_pData;
+			fColorRows[0] = fLerp( pPixelData[iIndices[0]], pPixelData[iIndices[1]], fInterpolation[0] );
+			fColorRows[1] = fLerp( pPixelData[iIndices[2]], pPixelData[iIndices[3]], fInterpolation[0] );
 			const float32 fFinalColor = fLerp( fColorRows[0], fColorRows[1], fInterpolation[1] );
 			
 			o_vColor = vector4( fFinalColor, 0, 0, 1 );
@@ -324,10 +700,10 @@ void CMuli3DSurface::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV
 		{
 			const vector2 *pPixelData = (const vector2 *)m_pData;
 
-			static vector2 vColorRows[2];
-			vVector2Lerp( vColorRows[0], pPixelData[iIndexRows[0] + iPixelX], pPixelData[iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector2Lerp( vColorRows[1], pPixelData[iIndexRows[1] + iPixelX], pPixelData[iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			static vector2 vFinalColor; vVector2Lerp( vFinalColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
+			vector2 vColorRows[2];
+			vVector2Lerp( vColorRows[0], pPixelData[iIndices[0]], pPixelData[iIndices[1]], fInterpolation[0] );
+			vVector2Lerp( vColorRows[1], pPixelData[iIndices[2]], pPixelData[iIndices[3]], fInterpolation[0] );
+			vector2 vFinalColor; vVector2Lerp( vFinalColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
 
 			o_vColor = vector4( vFinalColor.x, vFinalColor.y, 0, 1 );
 		}
@@ -336,10 +712,10 @@ void CMuli3DSurface::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV
 		{
 			const vector3 *pPixelData = (const vector3 *)m_pData;
 
-			static vector3 vColorRows[2];
-			vVector3Lerp( vColorRows[0], pPixelData[iIndexRows[0] + iPixelX], pPixelData[iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector3Lerp( vColorRows[1], pPixelData[iIndexRows[1] + iPixelX], pPixelData[iIndexRows[1] + iPixelX2], fInterpolation[0] );
-			static vector3 vFinalColor; vVector3Lerp( vFinalColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
+			vector3 vColorRows[2];
+			vVector3Lerp( vColorRows[0], pPixelData[iIndices[0]], pPixelData[iIndices[1]], fInterpolation[0] );
+			vVector3Lerp( vColorRows[1], pPixelData[iIndices[2]], pPixelData[iIndices[3]], fInterpolation[0] );
+			vector3 vFinalColor; vVector3Lerp( vFinalColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
 
 			o_vColor = vector4( vFinalColor.x, vFinalColor.y, vFinalColor.z, 1 );
 		}
@@ -348,13 +724,56 @@ void CMuli3DSurface::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV
 		{
 			const vector4 *pPixelData = (const vector4 *)m_pData;
 
-			static vector4 vColorRows[2];
-			vVector4Lerp( vColorRows[0], pPixelData[iIndexRows[0] + iPixelX], pPixelData[iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector4Lerp( vColorRows[1], pPixelData[iIndexRows[1] + iPixelX], pPixelData[iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			vector4 vColorRows[2];
+			vVector4Lerp( vColorRows[0], pPixelData[iIndices[0]], pPixelData[iIndices[1]], fInterpolation[0] );
+			vVector4Lerp( vColorRows[1], pPixelData[iIndices[2]], pPixelData[iIndices[3]], fInterpolation[0] );
 			vVector4Lerp( o_vColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
 		}
 		break;
-	default: // cannot happen
+	case m3dfmt_r8:
+		{
+			// Filter the bytes and normalize the result only once.
+			float32 fColorRows[2];
+			fColorRows[0] = fLerp( m_pData[iIndices[0]], m_pData[iIndices[1]], fInterpolation[0] );
+			fColorRows[1] = fLerp( m_pData[iIndices[2]], m_pData[iIndices[3]], fInterpolation[0] );
+			const float32 fFinalColor = fLerp( fColorRows[0], fColorRows[1], fInterpolation[1] );
+
+			o_vColor = vector4( fFinalColor * ( 1.0f / 255.0f ), 0, 0, 1 );
+		}
+		break;
+	case m3dfmt_r8g8b8a8:
+		{
+			const byte *pPixels[4] =
+			{
+				&m_pData[iIndices[0] * 4], &m_pData[iIndices[1] * 4],
+				&m_pData[iIndices[2] * 4], &m_pData[iIndices[3] * 4]
+			};
+			FilterUNorm8Pixels( o_vColor, pPixels, fInterpolation );
+		}
+		break;
+	case m3dfmt_bc1: case m3dfmt_bc3: case m3dfmt_bc4: case m3dfmt_bc5:
+		{
+			// Decoded blocks are filtered like m3dfmt_r8g8b8a8.
+			byte Pixels[4][4];
+			ReadBlockPixel( Pixels[0], iPixelX, iPixelY ); ReadBlockPixel( Pixels[1], iPixelX2, iPixelY );
+			ReadBlockPixel( Pixels[2], iPixelX, iPixelY2 ); ReadBlockPixel( Pixels[3], iPixelX2, iPixelY2 );
+			const byte *pPixels[4] = { Pixels[0], Pixels[1], Pixels[2], Pixels[3] };
+			FilterUNorm8Pixels( o_vColor, pPixels, fInterpolation );
+		}
+		break;
+	default: // m3dfmt_r16g16f, m3dfmt_r16g16b16a16f, m3dfmt_r5g6b5, m3dfmt_d16, m3dfmt_d24
+		{
+			vector4 vPixels[4];
+			DecodePixel( vPixels[0], m_fmtFormat, &m_pData[iIndices[0] * m_iPixelBytes] );
+			DecodePixel( vPixels[1], m_fmtFormat, &m_pData[iIndices[1] * m_iPixelBytes] );
+			DecodePixel( vPixels[2], m_fmtFormat, &m_pData[iIndices[2] * m_iPixelBytes] );
+			DecodePixel( vPixels[3], m_fmtFormat, &m_pData[iIndices[3] * m_iPixelBytes] );
+
+			vector4 vColorRows[2];
+			vVector4Lerp( vColorRows[0], vPixels[0], vPixels[1], fInterpolation[0] );
+			vVector4Lerp( vColorRows[1], vPixels[2], vPixels[3], fInterpolation[0] );
+			vVector4Lerp( o_vColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
+		}
 		break;
 	}
 }
@@ -382,6 +801,12 @@ result CMuli3DSurface::CopyToSurface( const m3drect *i_pSrcRect, CMuli3DSurface
 		return e_invalidparameters;
 	}
 
+	if( bIsBlockFormat( i_pDestSurface->fmtGetFormat() ) )
+	{
+		FUNC_FAILING( "CMuli3DSurface::CopyToSurface: cannot copy to a block-compressed surface!\n" );
+		return e_invalidformat;
+	}
+
 	if( i_Filter != m3dtf_point || i_Filter != m3dtf_linear )
 	{
 		FUNC_FAILING( "CMuli3DSurface::CopyToSurface: invalid filter specified!\n" );
@@ -438,7 +863,7 @@ result CMuli3DSurface::CopyToSurface( const m3drect *i_pSrcRect, CMuli3DSurface
 		DestRect.iRight = i_pDestSurface->iGetWidth(); DestRect.iBottom = i_pDestSurface->iGetHeight();
 	}
 
-	float32 *pDestData = 0;
+	byte *pDestData = 0;
 	result resLock = i_pDestSurface->LockRect( (void **)&pDestData, i_pDestRect );
 	if( FUNC_FAILED( resLock ) )
 	{
@@ -446,15 +871,16 @@ result CMuli3DSurface::CopyToSurface( const m3drect *i_pSrcRect, CMuli3DSurface
 		return resLock;
 	}
 
-	const uint32 iDestFloats = i_pDestSurface->iGetFormatFloats();
+	const m3dformat fmtDestFormat = i_pDestSurface->fmtGetFormat();
+	const uint32 iDestPixelBytes = i_pDestSurface->iGetPixelBytes();
 	const uint32 iDestWidth = DestRect.iRight - DestRect.iLeft;
 	const uint32 iDestHeight = DestRect.iBottom - DestRect.iTop;
 
 	// direct copy possible?
-	if( !i_pSrcRect && !i_pDestRect && iDestFloats == iGetFormatFloats() &&
+	if( !i_pSrcRect && !i_pDestRect && fmtDestFormat == m_fmtFormat && m_Layout == m3dtl_linear &&
 		iDestWidth == m_iWidth && iDestHeight == m_iHeight )
 	{
-		memcpy( pDestData, m_pData, sizeof( float32 ) * iDestFloats * iDestWidth * iDestHeight );
+		memcpy( pDestData, m_pData, iDestPixelBytes * iDestWidth * iDestHeight );
 		i_pDestSurface->UnlockRect();
 		return s_ok;
 	}
@@ -466,21 +892,15 @@ result CMuli3DSurface::CopyToSurface( const m3drect *i_pSrcRect, CMuli3DSurface
 	for( uint32 y = 0; y < iDestHeight; ++y, fSrcV += fStepV )
 	{
 		float32 fSrcU = SrcRect.iLeft * fStepU;
-		for( uint32 x = 0; x < iDestWidth; ++x, fSrcU += fStepU, pDestData += iDestFloats )
+		for( uint32 x = 0; x < iDestWidth; ++x, fSrcU += fStepU, pDestData += iDestPixelBytes )
 		{
 			vector4 vSrcColor;
 			if( i_Filter == m3dtf_linear )
 				SampleLinear( vSrcColor, fSrcU, fSrcV );
 			else
 				SamplePoint( vSrcColor, fSrcU, fSrcV );
-			
-			switch( iDestFloats )
-			{
-			case 4: pDestData[3] = vSrcColor.a;
-			case 3: pDestData[2] = vSrcColor.b;
-			case 2: pDestData[1] = vSrcColor.g;
-			case 1: pDestData[0] = vSrcColor.r;
-			}
+
+			EncodePixel( pDestData, fmtDestFormat, vSrcColor );
 		}
 	}
 
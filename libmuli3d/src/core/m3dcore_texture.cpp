@@ -19,11 +19,13 @@
 
 #include "../../include/core/m3dcore_texture.h"
 #include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_mipmap.h"
+#include "../../include/core/m3dcore_pixelformat.h"
 #include "../../include/core/m3dcore_surface.h"
 
 CMuli3DTexture::CMuli3DTexture( CMuli3DDevice *i_pParent )
 	: IMuli3DBaseTexture( i_pParent ),
-	m_iMipLevels( 0 ), m_ppMipLevels( 0 )
+	m_iMipLevels( 0 ), m_ppMipLevels( 0 ), m_pDataOwner( 0 )
 {
 	
 }
@@ -33,9 +35,10 @@ CMuli3DTexture::~CMuli3DTexture()
 	for( uint32 iLevel = 0; iLevel < m_iMipLevels; ++iLevel )
 		SAFE_RELEASE( m_ppMipLevels[iLevel] );
 	SAFE_DELETE_ARRAY( m_ppMipLevels );
+	SAFE_RELEASE( m_pDataOwner );
 }
 
-result CMuli3DTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat )
+result CMuli3DTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout, byte *i_pData, uint32 i_iDataSize, IBase *i_pDataOwner )
 {
 	if( !i_iWidth || !i_iHeight )
 	{
@@ -43,7 +46,7 @@ result CMuli3DTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipL
 		return e_invalidparameters;
 	}
 	
-	if( i_fmtFormat < m3dfmt_r32f || i_fmtFormat > m3dfmt_r32g32b32a32f )
+	if( !bIsTextureFormat( i_fmtFormat ) && !bIsBlockFormat( i_fmtFormat ) )
 	{
 		FUNC_FAILING( "CMuli3DTexture::Create: invalid format specified.\n" );
 		return e_invalidformat;
@@ -73,10 +76,16 @@ result CMuli3DTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipL
 
 	memset( m_ppMipLevels, 0, sizeof( CMuli3DSurface * ) * i_iMipLevels );
 
+	if( i_pDataOwner )
+	{
+		m_pDataOwner = i_pDataOwner;
+		m_pDataOwner->AddRef();
+	}
+
 	CMuli3DSurface **pCurMipLevel = m_ppMipLevels;
 	do
 	{
-		result resMipLevel = m_pParent->CreateSurface( pCurMipLevel, i_iWidth, i_iHeight, i_fmtFormat );
+		result resMipLevel = m_pParent->CreateSurfaceInMemory( pCurMipLevel, i_iWidth, i_iHeight, i_fmtFormat, i_Layout, i_pData );
 		if( FUNC_FAILED( resMipLevel ) )
 		{
 			// destructor will perform cleanup
@@ -84,7 +93,23 @@ result CMuli3DTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipL
 			return resMipLevel;
 		}
 
-		++m_iMipLevels; ++pCurMipLevel;
+		++m_iMipLevels;
+
+		if( i_pData )
+		{
+			// The surface hasn't touched the memory yet; fail before it is accessed beyond the end.
+			const uint32 iLevelSize = (*pCurMipLevel)->iGetDataSize();
+			if( iLevelSize > i_iDataSize )
+			{
+				FUNC_FAILING( "CMuli3DTexture::Create: i_iDataSize is too small for the mip-chain.\n" );
+				return e_invalidparameters;
+			}
+
+			i_pData += iLevelSize;
+			i_iDataSize -= iLevelSize;
+		}
+
+		++pCurMipLevel;
 
 		if( --i_iMipLevels == 0 )
 			break;
@@ -113,6 +138,14 @@ result CMuli3DTexture::Clear( uint32 i_iMipLevel, const vector4 &i_vColor, const
 }
 
 result CMuli3DTexture::GenerateMipSubLevels( uint32 i_iSrcLevel )
+{
+	CMuli3DThreadPool *pThreads = m_pParent->pAcquireMipThreads();
+	const result resGenerate = GenerateMipChain( i_iSrcLevel, pThreads );
+	m_pParent->ReleaseMipThreads( pThreads );
+	return resGenerate;
+}
+
+result CMuli3DTexture::GenerateMipChain( uint32 i_iSrcLevel, CMuli3DThreadPool *i_pThreads )
 {
 	if( i_iSrcLevel + 1 >= m_iMipLevels )
 	{
@@ -120,109 +153,38 @@ result CMuli3DTexture::GenerateMipSubLevels( uint32 i_iSrcLevel )
 		return e_invalidparameters;
 	}
 
+	if( bIsBlockFormat( fmtGetFormat() ) )
+	{
+		FUNC_FAILING( "CMuli3DTexture::GenerateMipSubLevels: cannot generate mip-levels of a block-compressed texture.\n" );
+		return e_invalidformat;
+	}
+
 	for( uint32 iLevel = i_iSrcLevel + 1; iLevel < m_iMipLevels; ++iLevel )
 	{
-		const float32 *pSrcData = 0;
+		const byte *pSrcData = 0;
 		result resLock = LockRect( iLevel - 1, (void **)&pSrcData, 0 );
 		if( FUNC_FAILED( resLock ) )
 			return resLock;
 		
-		float32 *pDestData = 0;
+		byte *pDestData = 0;
 		resLock = LockRect( iLevel, (void **)&pDestData, 0 );
 		if( FUNC_FAILED( resLock ) )
 		{
-			UnlockRect( iLevel );
+			UnlockRect( iLevel - 1 );
 			return resLock;
 		}
 
-		const uint32 iSrcHeight = iGetHeight( iLevel - 1 );
-		const uint32 iSrcWidth = iGetWidth( iLevel - 1 );
-
-		switch( fmtGetFormat() )
-		{
-		case m3dfmt_r32f:
-			{
-				for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-				{
-					const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-					for( uint32 iX = 0; iX < iSrcWidth; iX += 2, ++pDestData )
-					{
-						const float32 fSrcPixels[4] = 
-						{
-							pSrcData[iIndexRows[0] + iX],
-							pSrcData[iIndexRows[0] + iX + 1],
-							pSrcData[iIndexRows[1] + iX],
-							pSrcData[iIndexRows[1] + iX + 1]
-						};
-						*pDestData = ( fSrcPixels[0] + fSrcPixels[1] + fSrcPixels[2] + fSrcPixels[3] ) * 0.25f;
-					}
-				}
-			}
-			break;
-
-		case m3dfmt_r32g32f:
-			{
-				for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-				{
-					const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-					for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 2 )
-					{
-						const vector2 *pSrcPixels[4] = 
-						{
-							&((vector2 *)pSrcData)[iIndexRows[0] + iX],
-							&((vector2 *)pSrcData)[iIndexRows[0] + iX + 1],
-							&((vector2 *)pSrcData)[iIndexRows[1] + iX],
-							&((vector2 *)pSrcData)[iIndexRows[1] + iX + 1]
-						};
-						*(vector2 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] ) * 0.25f;
-					}
-				}
-			}
-			break;
-
-		case m3dfmt_r32g32b32f:
-			{
-				for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-				{
-					const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-					for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 3 )
-					{
-						const vector3 *pSrcPixels[4] = 
-						{
-							&((vector3 *)pSrcData)[iIndexRows[0] + iX],
-							&((vector3 *)pSrcData)[iIndexRows[0] + iX + 1],
-							&((vector3 *)pSrcData)[iIndexRows[1] + iX],
-							&((vector3 *)pSrcData)[iIndexRows[1] + iX + 1]
-						};
-						*(vector3 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] ) * 0.25f;
-					}
-				}
-			}
-			break;
-
-		case m3dfmt_r32g32b32a32f:
-			{
-				for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-				{
-					const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-					for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 4 )
-					{
-						const vector4 *pSrcPixels[4] = 
-						{
-							&((vector4 *)pSrcData)[iIndexRows[0] + iX],
-							&((vector4 *)pSrcData)[iIndexRows[0] + iX + 1],
-							&((vector4 *)pSrcData)[iIndexRows[1] + iX],
-							&((vector4 *)pSrcData)[iIndexRows[1] + iX + 1]
-						};
-						*(vector4 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] ) * 0.25f;
-					}
-				}
-			}
-			break;
-
-		default: // cannot happen
-			break;
-		}
+		m3dmipgeneration Generation;
+		Generation.fmtFormat = fmtGetFormat();
+		Generation.pSource = pSrcData;
+		Generation.pDestination = pDestData;
+		Generation.iSrcWidth = iGetWidth( iLevel - 1 );
+		Generation.iSrcHeight = iGetHeight( iLevel - 1 );
+		Generation.iSrcDepth = 1;
+		Generation.iDestWidth = iGetWidth( iLevel );
+		Generation.iDestHeight = iGetHeight( iLevel );
+		Generation.iDestDepth = 1;
+		GenerateMipLevel( Generation, i_pThreads );
 
 		UnlockRect( iLevel );
 		UnlockRect( iLevel - 1 );
@@ -268,43 +230,63 @@ CMuli3DSurface *CMuli3DTexture::pGetMipLevel( uint32 i_iMipLevel )
 
 result CMuli3DTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
 {
-	uint32 iTexFilter = i_pSamplerStates[m3dtss_minfilter];
-	float32 fTexMipLevel = 0.0f;
+	float32 fTexMipLevel; uint32 iTexFilter;
+	ComputeMipLevel( fTexMipLevel, iTexFilter, i_pXGradient, i_pYGradient, i_pSamplerStates );
+	SampleMipLevel( o_vColor, i_fU, i_fV, fTexMipLevel, iTexFilter, i_pSamplerStates[m3dtss_mipfilter] );
+	return s_ok;
+}
+
+result CMuli3DTexture::SampleTextureQuad( vector4 *o_pColors, const vector4 *i_pCoords, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	float32 fTexMipLevel; uint32 iTexFilter;
+	ComputeMipLevel( fTexMipLevel, iTexFilter, i_pXGradient, i_pYGradient, i_pSamplerStates );
+
+	const uint32 iMipFilter = i_pSamplerStates[m3dtss_mipfilter];
+	for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		SampleMipLevel( o_pColors[iPixel], i_pCoords[iPixel].x, i_pCoords[iPixel].y, fTexMipLevel, iTexFilter, iMipFilter );
+
+	return s_ok;
+}
+
+void CMuli3DTexture::ComputeMipLevel( float32 &o_fMipLevel, uint32 &o_iTexFilter, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	o_iTexFilter = i_pSamplerStates[m3dtss_minfilter];
+	o_fMipLevel = 0.0f;
 	
 	if( i_pXGradient && i_pYGradient )
 	{
 		// Compute the mip-level and determine the texture filter type.
 		const float32 fLenXGrad = i_pXGradient->x * i_pXGradient->x * m_fSquaredWidth + i_pXGradient->y * i_pXGradient->y * m_fSquaredHeight;
 		const float32 fLenYGrad = i_pYGradient->x * i_pYGradient->x * m_fSquaredWidth + i_pYGradient->y * i_pYGradient->y * m_fSquaredHeight;
-		const float32 fTexelsPerScreenPixel = sqrtf( fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad );
+		const float32 fSquaredTexelsPerScreenPixel = fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad;
 
-		if( fTexelsPerScreenPixel <= 1.0f )
+		if( fSquaredTexelsPerScreenPixel <= 1.0f )
 		{
 			 // if fTexelsPerScreenPixel < 1.0f -> magnification, no mipmapping needed
-			fTexMipLevel = 0.0f;
-			iTexFilter = i_pSamplerStates[m3dtss_magfilter];
+			o_iTexFilter = i_pSamplerStates[m3dtss_magfilter];
 		}
 		else
 		{
-			// minification, need mipmapping
-			static const float32 fInvLog2 = 1.0f / logf( 2.0f ); // calculate log2
-			fTexMipLevel = logf( fTexelsPerScreenPixel ) * fInvLog2;
-			iTexFilter = i_pSamplerStates[m3dtss_minfilter];
+			// minification, need mipmapping: log2( sqrt( x ) ) = 0.5 * log2( x )
+			o_fMipLevel = 0.5f * fFastLog2( fSquaredTexelsPerScreenPixel );
 		}
 	}
 
 	const float32 fMipLODBias = *(float32 *)&i_pSamplerStates[m3dtss_miplodbias];
 	const float32 fMaxMipLevel = *(float32 *)&i_pSamplerStates[m3dtss_maxmiplevel];
-	fTexMipLevel = fClamp( fTexMipLevel + fMipLODBias, 0.0f, fMaxMipLevel );
+	o_fMipLevel = fClamp( o_fMipLevel + fMipLODBias, 0.0f, fMaxMipLevel );
+}
 
-	if( i_pSamplerStates[m3dtss_mipfilter] == m3dtf_linear )
+void CMuli3DTexture::SampleMipLevel( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fMipLevel, uint32 i_iTexFilter, uint32 i_iMipFilter )
+{
+	if( i_iMipFilter == m3dtf_linear )
 	{
-		uint32 iMipLevelA = ftol( fTexMipLevel ), iMipLevelB = iMipLevelA + 1;
+		uint32 iMipLevelA = ftol( i_fMipLevel ), iMipLevelB = iMipLevelA + 1;
 		if( iMipLevelA >= m_iMipLevels ) iMipLevelA = m_iMipLevels - 1;
 		if( iMipLevelB >= m_iMipLevels ) iMipLevelB = m_iMipLevels - 1;
 
 		vector4 vColorA, vColorB;
-		if( iTexFilter == m3dtf_linear )
+		if( i_iTexFilter == m3dtf_linear )
 		{
 			m_ppMipLevels[iMipLevelA]->SampleLinear( vColorA, i_fU, i_fV );
 			m_ppMipLevels[iMipLevelB]->SampleLinear( vColorB, i_fU, i_fV );
@@ -315,21 +297,19 @@ result CMuli3DTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i
 			m_ppMipLevels[iMipLevelB]->SamplePoint( vColorB, i_fU, i_fV );
 		}
 
-		const float32 fInterpolation = fTexMipLevel - iMipLevelA; // TODO: not accurate
+		const float32 fInterpolation = i_fMipLevel - iMipLevelA; // TODO: not accurate
 		vVector4Lerp( o_vColor, vColorA, vColorB, fInterpolation );
 	}
 	else
 	{
-		uint32 iMipLevel = ftol( fTexMipLevel );
+		uint32 iMipLevel = ftol( i_fMipLevel );
 		if( iMipLevel >= m_iMipLevels ) iMipLevel = m_iMipLevels - 1;
 
-		if( iTexFilter == m3dtf_linear )
+		if( i_iTexFilter == m3dtf_linear )
 			m_ppMipLevels[iMipLevel]->SampleLinear( o_vColor, i_fU, i_fV );
 		else
 			m_ppMipLevels[iMipLevel]->SamplePoint( o_vColor, i_fU, i_fV );
 	}
-
-	return s_ok;
 }
 
 m3dformat CMuli3DTexture::fmtGetFormat()
@@ -0,0 +1,487 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "../../include/core/m3dcore_threadpool.h"
+
+CMuli3DThreadPool::CMuli3DThreadPool() :
+	m_iNumThreads( 1 ), m_pWorkers( 0 ), m_pJob( 0 ), m_pUserData( 0 ),
+	m_iNumJobs( 0 ), m_iNextJob( 0 ), m_bShutdown( false )
+{
+	#ifdef WIN32
+	InitializeCriticalSection( &m_Lock );
+	#elif !defined( __amigaos4__ )
+	pthread_mutex_init( &m_Lock, 0 );
+	pthread_cond_init( &m_WorkAvailable, 0 );
+	pthread_cond_init( &m_WorkDone, 0 );
+	m_iGeneration = 0;
+	m_iBusyWorkers = 0;
+	#endif
+}
+
+CMuli3DThreadPool::~CMuli3DThreadPool()
+{
+	Destroy();
+
+	#ifdef WIN32
+	DeleteCriticalSection( &m_Lock );
+	#elif !defined( __amigaos4__ )
+	pthread_cond_destroy( &m_WorkDone );
+	pthread_cond_destroy( &m_WorkAvailable );
+	pthread_mutex_destroy( &m_Lock );
+	#endif
+}
+
+result CMuli3DThreadPool::Create( uint32 i_iNumThreads )
+{
+	if( !i_iNumThreads || i_iNumThreads > c_iMaxRasterizerThreads )
+	{
+		FUNC_FAILING( "CMuli3DThreadPool::Create: invalid number of threads.\n" );
+		return e_invalidparameters;
+	}
+
+	Destroy();
+
+	m_iNumThreads = i_iNumThreads;
+	m_bShutdown = false;
+
+	#ifdef __amigaos4__
+	// NOTE: no worker threads on AmigaOS 4 yet - all jobs are executed by the calling thread.
+	return s_ok;
+	#else
+	m_pWorkers = new workerthread[m_iNumThreads - 1];
+	if( !m_pWorkers )
+	{
+		FUNC_FAILING( "CMuli3DThreadPool::Create: out of memory, cannot create worker threads.\n" );
+		m_iNumThreads = 1;
+		return e_outofmemory;
+	}
+
+	for( uint32 iWorker = 0; iWorker < m_iNumThreads - 1; ++iWorker )
+	{
+		workerthread &Worker = m_pWorkers[iWorker];
+		Worker.pPool = this;
+		Worker.iThread = iWorker + 1;
+
+		#ifdef WIN32
+		Worker.hStart = CreateEvent( 0, FALSE, FALSE, 0 );
+		Worker.hDone = CreateEvent( 0, FALSE, FALSE, 0 );
+		Worker.hThread = CreateThread( 0, 0, WorkerThread, &Worker, 0, 0 );
+		const bool bCreated = Worker.hStart && Worker.hDone && Worker.hThread;
+		#else
+		Worker.iGeneration = m_iGeneration;
+		const bool bCreated = ( pthread_create( &Worker.Thread, 0, WorkerThread, &Worker ) == 0 );
+		#endif
+
+		if( !bCreated )
+		{
+			FUNC_FAILING( "CMuli3DThreadPool::Create: couldn't create worker thread.\n" );
+
+			// Only tear down the workers that have been started successfully.
+			#ifdef WIN32
+			if( Worker.hThread ) { TerminateThread( Worker.hThread, 0 ); CloseHandle( Worker.hThread ); }
+			if( Worker.hStart ) CloseHandle( Worker.hStart );
+			if( Worker.hDone ) CloseHandle( Worker.hDone );
+			#endif
+			m_iNumThreads = iWorker + 1;
+			Destroy();
+			return e_unknown;
+		}
+	}
+
+	return s_ok;
+	#endif
+}
+
+void CMuli3DThreadPool::Destroy()
+{
+	if( !m_pWorkers )
+	{
+		m_iNumThreads = 1;
+		return;
+	}
+
+	const uint32 iNumWorkers = m_iNumThreads - 1;
+
+	#ifdef WIN32
+	m_bShutdown = true;
+	for( uint32 iWorker = 0; iWorker < iNumWorkers; ++iWorker )
+		SetEvent( m_pWorkers[iWorker].hStart );
+
+	for( uint32 iWorker = 0; iWorker < iNumWorkers; ++iWorker )
+	{
+		WaitForSingleObject( m_pWorkers[iWorker].hThread, INFINITE );
+		CloseHandle( m_pWorkers[iWorker].hThread );
+		CloseHandle( m_pWorkers[iWorker].hStart );
+		CloseHandle( m_pWorkers[iWorker].hDone );
+	}
+	#elif !defined( __amigaos4__ )
+	pthread_mutex_lock( &m_Lock );
+	m_bShutdown = true;
+	pthread_cond_broadcast( &m_WorkAvailable );
+	pthread_mutex_unlock( &m_Lock );
+
+	for( uint32 iWorker = 0; iWorker < iNumWorkers; ++iWorker )
+		pthread_join( m_pWorkers[iWorker].Thread, 0 );
+	#endif
+
+	SAFE_DELETE_ARRAY( m_pWorkers );
+	m_iNumThreads = 1;
+	m_bShutdown = false;
+}
+
+void CMuli3DThreadPool::Execute( m3dthreadjob i_pJob, void *i_pUserData, uint32 i_iNumJobs )
+{
+	if( !i_iNumJobs )
+		return;
+
+	m_pJob = i_pJob;
+	m_pUserData = i_pUserData;
+	m_iNumJobs = i_iNumJobs;
+	m_iNextJob = 0;
+
+	if( !m_pWorkers || i_iNumJobs == 1 )
+	{
+		ProcessJobs( 0 );
+		return;
+	}
+
+	const uint32 iNumWorkers = m_iNumThreads - 1;
+
+	#ifdef WIN32
+	for( uint32 iWorker = 0; iWorker < iNumWorkers; ++iWorker )
+		SetEvent( m_pWorkers[iWorker].hStart );
+
+	ProcessJobs( 0 );
+
+	for( uint32 iWorker = 0; iWorker < iNumWorkers; ++iWorker )
+		WaitForSingleObject( m_pWorkers[iWorker].hDone, INFINITE );
+	#elif !defined( __amigaos4__ )
+	pthread_mutex_lock( &m_Lock );
+	m_iBusyWorkers = iNumWorkers;
+	++m_iGeneration;
+	pthread_cond_broadcast( &m_WorkAvailable );
+	pthread_mutex_unlock( &m_Lock );
+
+	ProcessJobs( 0 );
+
+	pthread_mutex_lock( &m_Lock );
+	while( m_iBusyWorkers )
+		pthread_cond_wait( &m_WorkDone, &m_Lock );
+	pthread_mutex_unlock( &m_Lock );
+	#endif
+}
+
+uint32 CMuli3DThreadPool::iGetNumThreads()
+{
+	return m_iNumThreads;
+}
+
+void CMuli3DThreadPool::ProcessJobs( uint32 i_iThread )
+{
+	while( true )
+	{
+		uint32 iJob;
+
+		#ifdef WIN32
+		EnterCriticalSection( &m_Lock );
+		iJob = m_iNextJob++;
+		LeaveCriticalSection( &m_Lock );
+		#elif !defined( __amigaos4__ )
+		pthread_mutex_lock( &m_Lock );
+		iJob = m_iNextJob++;
+		pthread_mutex_unlock( &m_Lock );
+		#else
+		iJob = m_iNextJob++;
+		#endif
+
+		if( iJob >= m_iNumJobs )
+			return;
+
+		m_pJob( m_pUserData, iJob, i_iThread );
+	}
+}
+
+#ifdef WIN32
+
+DWORD WINAPI CMuli3DThreadPool::WorkerThread( LPVOID i_pParam )
+{
+	workerthread *pWorker = (workerthread *)i_pParam;
+	CMuli3DThreadPool *pPool = pWorker->pPool;
+
+	while( true )
+	{
+		WaitForSingleObject( pWorker->hStart, INFINITE );
+		if( pPool->m_bShutdown )
+			break;
+
+		pPool->ProcessJobs( pWorker->iThread );
+		SetEvent( pWorker->hDone );
+	}
+
+	return 0;
+}
+
+#elif !defined( __amigaos4__ )
+
+void *CMuli3DThreadPool::WorkerThread( void *i_pParam )
+{
+	workerthread *pWorker = (workerthread *)i_pParam;
+	CMuli3DThreadPool *pPool = pWorker->pPool;
+
+	pthread_mutex_lock( &pPool->m_Lock );
+	while( true )
+	{
+		while( !pPool->m_bShutdown && pWorker->iGeneration == pPool->m_iGeneration )
+			pthread_cond_wait( &pPool->m_WorkAvailable, &pPool->m_Lock );
+
+		if( pPool->m_bShutdown )
+			break;
+
+		pWorker->iGeneration = pPool->m_iGeneration;
+		pthread_mutex_unlock( &pPool->m_Lock );
+
+		pPool->ProcessJobs( pWorker->iThread );
+
+		pthread_mutex_lock( &pPool->m_Lock );
+		if( --pPool->m_iBusyWorkers == 0 )
+			pthread_cond_signal( &pPool->m_WorkDone );
+	}
+	pthread_mutex_unlock( &pPool->m_Lock );
+
+	return 0;
+}
+
+#endif
+
+CMuli3DWorkQueue::CMuli3DWorkQueue() :
+	m_iSubmitted( 0 ), m_iCompleted( 0 ), m_bCreated( false ), m_bShutdown( false )
+{
+	#ifdef WIN32
+	InitializeCriticalSection( &m_Lock );
+	m_hThread = 0;
+	m_hWorkAvailable = 0;
+	m_hJobDone = 0;
+	#elif !defined( __amigaos4__ )
+	pthread_mutex_init( &m_Lock, 0 );
+	pthread_cond_init( &m_WorkAvailable, 0 );
+	pthread_cond_init( &m_JobDone, 0 );
+	#endif
+}
+
+CMuli3DWorkQueue::~CMuli3DWorkQueue()
+{
+	Destroy();
+
+	#ifdef WIN32
+	DeleteCriticalSection( &m_Lock );
+	#elif !defined( __amigaos4__ )
+	pthread_cond_destroy( &m_JobDone );
+	pthread_cond_destroy( &m_WorkAvailable );
+	pthread_mutex_destroy( &m_Lock );
+	#endif
+}
+
+result CMuli3DWorkQueue::Create()
+{
+	Destroy();
+
+	#ifdef __amigaos4__
+	// NOTE: no worker threads on AmigaOS 4 yet - jobs are executed by the submitting thread.
+	m_bCreated = true;
+	return s_ok;
+	#else
+	#ifdef WIN32
+	m_hWorkAvailable = CreateSemaphore( 0, 0, 0x7fffffff, 0 );
+	m_hJobDone = CreateEvent( 0, FALSE, FALSE, 0 );
+	if( m_hWorkAvailable && m_hJobDone )
+		m_hThread = CreateThread( 0, 0, WorkerThread, this, 0, 0 );
+	m_bCreated = ( m_hThread != 0 );
+	#else
+	m_bCreated = ( pthread_create( &m_Thread, 0, WorkerThread, this ) == 0 );
+	#endif
+
+	if( !m_bCreated )
+	{
+		FUNC_FAILING( "CMuli3DWorkQueue::Create: couldn't create worker thread.\n" );
+		Destroy();
+		return e_unknown;
+	}
+
+	return s_ok;
+	#endif
+}
+
+void CMuli3DWorkQueue::Destroy()
+{
+	#ifdef WIN32
+	if( m_bCreated )
+	{
+		EnterCriticalSection( &m_Lock );
+		m_bShutdown = true;
+		LeaveCriticalSection( &m_Lock );
+		ReleaseSemaphore( m_hWorkAvailable, 1, 0 );
+
+		WaitForSingleObject( m_hThread, INFINITE );
+		CloseHandle( m_hThread );
+		m_hThread = 0;
+	}
+	if( m_hWorkAvailable ) { CloseHandle( m_hWorkAvailable ); m_hWorkAvailable = 0; }
+	if( m_hJobDone ) { CloseHandle( m_hJobDone ); m_hJobDone = 0; }
+	#elif !defined( __amigaos4__ )
+	if( m_bCreated )
+	{
+		pthread_mutex_lock( &m_Lock );
+		m_bShutdown = true;
+		pthread_cond_signal( &m_WorkAvailable );
+		pthread_mutex_unlock( &m_Lock );
+
+		pthread_join( m_Thread, 0 );
+	}
+	#endif
+
+	m_bCreated = false;
+	m_bShutdown = false;
+}
+
+uint32 CMuli3DWorkQueue::iSubmit( m3dthreadjob i_pJob, void *i_pUserData )
+{
+	queuedjob Job;
+	Job.pJob = i_pJob;
+	Job.pUserData = i_pUserData;
+
+	#ifdef WIN32
+	EnterCriticalSection( &m_Lock );
+	Job.iJob = ++m_iSubmitted;
+	m_Jobs.push_back( Job );
+	LeaveCriticalSection( &m_Lock );
+	ReleaseSemaphore( m_hWorkAvailable, 1, 0 );
+	#elif !defined( __amigaos4__ )
+	pthread_mutex_lock( &m_Lock );
+	Job.iJob = ++m_iSubmitted;
+	m_Jobs.push_back( Job );
+	pthread_cond_signal( &m_WorkAvailable );
+	pthread_mutex_unlock( &m_Lock );
+	#else
+	Job.iJob = ++m_iSubmitted;
+	Job.pJob( Job.pUserData, Job.iJob, 0 );
+	m_iCompleted = Job.iJob;
+	#endif
+
+	return Job.iJob;
+}
+
+bool CMuli3DWorkQueue::bIsComplete( uint32 i_iJob )
+{
+	// note: signed difference, so that sequence numbers may wrap around.
+	#ifdef WIN32
+	EnterCriticalSection( &m_Lock );
+	const bool bComplete = ( (int32)( m_iCompleted - i_iJob ) >= 0 );
+	LeaveCriticalSection( &m_Lock );
+	#elif !defined( __amigaos4__ )
+	pthread_mutex_lock( &m_Lock );
+	const bool bComplete = ( (int32)( m_iCompleted - i_iJob ) >= 0 );
+	pthread_mutex_unlock( &m_Lock );
+	#else
+	const bool bComplete = ( (int32)( m_iCompleted - i_iJob ) >= 0 );
+	#endif
+
+	return bComplete;
+}
+
+void CMuli3DWorkQueue::Wait( uint32 i_iJob )
+{
+	#ifdef WIN32
+	while( !bIsComplete( i_iJob ) )
+		WaitForSingleObject( m_hJobDone, INFINITE );
+	#elif !defined( __amigaos4__ )
+	pthread_mutex_lock( &m_Lock );
+	while( (int32)( m_iCompleted - i_iJob ) < 0 )
+		pthread_cond_wait( &m_JobDone, &m_Lock );
+	pthread_mutex_unlock( &m_Lock );
+	#endif
+}
+
+void CMuli3DWorkQueue::WaitIdle()
+{
+	Wait( m_iSubmitted );
+}
+
+#ifdef WIN32
+
+DWORD WINAPI CMuli3DWorkQueue::WorkerThread( LPVOID i_pParam )
+{
+	CMuli3DWorkQueue *pQueue = (CMuli3DWorkQueue *)i_pParam;
+
+	while( true )
+	{
+		WaitForSingleObject( pQueue->m_hWorkAvailable, INFINITE );
+
+		EnterCriticalSection( &pQueue->m_Lock );
+		if( pQueue->m_Jobs.empty() ) // only signaled without a job when shutting down
+		{
+			LeaveCriticalSection( &pQueue->m_Lock );
+			break;
+		}
+		const queuedjob Job = pQueue->m_Jobs.front();
+		pQueue->m_Jobs.pop_front();
+		LeaveCriticalSection( &pQueue->m_Lock );
+
+		Job.pJob( Job.pUserData, Job.iJob, 0 );
+
+		EnterCriticalSection( &pQueue->m_Lock );
+		pQueue->m_iCompleted = Job.iJob;
+		LeaveCriticalSection( &pQueue->m_Lock );
+		SetEvent( pQueue->m_hJobDone );
+	}
+
+	return 0;
+}
+
+#elif !defined( __amigaos4__ )
+
+void *CMuli3DWorkQueue::WorkerThread( void *i_pParam )
+{
+	CMuli3DWorkQueue *pQueue = (CMuli3DWorkQueue *)i_pParam;
+
+	pthread_mutex_lock( &pQueue->m_Lock );
+	while( true )
+	{
+		while( !pQueue->m_bShutdown && pQueue->m_Jobs.empty() )
+			pthread_cond_wait( &pQueue->m_WorkAvailable, &pQueue->m_Lock );
+
+		// Finish all submitted jobs before terminating.
+		if( pQueue->m_Jobs.empty() )
+			break;
+
+		const queuedjob Job = pQueue->m_Jobs.front();
+		pQueue->m_Jobs.pop_front();
+		pthread_mutex_unlock( &pQueue->m_Lock );
+
+		Job.pJob( Job.pUserData, Job.iJob, 0 );
+
+		pthread_mutex_lock( &pQueue->m_Lock );
+		pQueue->m_iCompleted = Job.iJob;
+		pthread_cond_broadcast( &pQueue->m_JobDone );
+	}
+	pthread_mutex_unlock( &pQueue->m_Lock );
+
+	return 0;
+}
+
+#endif
@@ -21,12 +21,12 @@
 #include "../../include/core/m3dcore_device.h"
 
 CMuli3DVertexBuffer::CMuli3DVertexBuffer( CMuli3DDevice *i_pParent )
-	: m_pParent( i_pParent ), m_pData( 0 )
+	: m_pParent( i_pParent ), m_pData( 0 ), m_bOwnsData( false ), m_pDataOwner( 0 )
 {
 	m_pParent->AddRef();
 }
 
-result CMuli3DVertexBuffer::Create( uint32 i_iLength )
+result CMuli3DVertexBuffer::Create( uint32 i_iLength, const void *i_pData, IBase *i_pDataOwner )
 {
 	if( !i_iLength )
 	{
@@ -36,6 +36,17 @@ result CMuli3DVertexBuffer::Create( uint32 i_iLength )
 
 	m_iLength = i_iLength;
 
+	if( i_pData )
+	{
+		m_pData = (const byte *)i_pData;
+		if( i_pDataOwner )
+		{
+			m_pDataOwner = i_pDataOwner;
+			m_pDataOwner->AddRef();
+		}
+		return s_ok;
+	}
+
 	m_pData = new byte[i_iLength];
 	if( !m_pData )
 	{
@@ -43,12 +54,15 @@ result CMuli3DVertexBuffer::Create( uint32 i_iLength )
 		return e_outofmemory;
 	}
 
+	m_bOwnsData = true;
 	return s_ok;
 }
 
 CMuli3DVertexBuffer::~CMuli3DVertexBuffer()
 {
-	SAFE_DELETE_ARRAY( m_pData );
+	if( m_bOwnsData )
+		SAFE_DELETE_ARRAY( m_pData );
+	SAFE_RELEASE( m_pDataOwner );
 
 	SAFE_RELEASE( m_pParent );
 }
@@ -68,6 +82,32 @@ result CMuli3DVertexBuffer::GetPointer( uint32 i_iOffset, void **o_ppData )
 		return e_invalidparameters;
 	}
 
+	if( !m_bOwnsData )
+	{
+		*o_ppData = 0;
+		FUNC_FAILING( "CMuli3DVertexBuffer::GetPointer: vertex buffer is read-only.\n" );
+		return e_invalidstate;
+	}
+
+	*o_ppData = (byte *)&m_pData[i_iOffset];
+	return s_ok;
+}
+
+result CMuli3DVertexBuffer::GetReadPointer( uint32 i_iOffset, const void **o_ppData )
+{
+	if( !o_ppData )
+	{
+		FUNC_FAILING( "CMuli3DVertexBuffer::GetReadPointer: parameter o_ppData points to null.\n" );
+		return e_invalidparameters;
+	}
+
+	if( i_iOffset >= m_iLength )
+	{
+		*o_ppData = 0;
+		FUNC_FAILING( "CMuli3DVertexBuffer::GetReadPointer: i_iOffset exceeds vertex buffer length.\n" );
+		return e_invalidparameters;
+	}
+
 	*o_ppData = &m_pData[i_iOffset];
 	return s_ok;
 }
@@ -83,3 +123,8 @@ uint32 CMuli3DVertexBuffer::iGetLength()
 {
 	return m_iLength;
 }
+
+bool CMuli3DVertexBuffer::bIsReadOnly()
+{
+	return !m_bOwnsData;
+}
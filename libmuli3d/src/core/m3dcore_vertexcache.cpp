@@ -0,0 +1,256 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "../../include/core/m3dcore_vertexcache.h"
+
+const uint32 c_iNoVertex = 0xffffffff;		///< Marks unused cache entries and vertices that haven't been renumbered yet.
+const uint32 c_iNoTriangle = 0xffffffff;	///< Marks the absence of a candidate triangle.
+const uint32 c_iMaxScoredCacheSize = 64;	///< Larger caches are modeled with this size by OptimizeVertexCache(); positions beyond it hardly change the order of the triangles.
+const uint32 c_iMaxScoredValence = 32;		///< Number of precomputed valence scores; vertices with more remaining triangles get the last one.
+const float32 c_fCacheDecayPower = 1.5f;	///< Controls how fast the score of a vertex drops as it moves towards the end of the cache.
+const float32 c_fLastTriangleScore = 0.75f;	///< Score of the vertices of the last emitted triangle; lower than that of the next entries, so that strips don't turn back onto themselves.
+const float32 c_fValenceBoostScale = 2.0f;	///< Weight of the bonus of vertices with few remaining triangles, which prevents leaving single triangles behind.
+const float32 c_fValenceBoostPower = 0.5f;	///< Controls how fast the bonus drops with the number of remaining triangles.
+
+void AnalyzeVertexCache( m3dvertexcachestats &o_Stats, const uint32 *i_pIndices, uint32 i_iNumIndices, uint32 i_iVertexCacheSize )
+{
+	if( !i_iVertexCacheSize )
+		i_iVertexCacheSize = 1;
+	const uint32 iNumWays = i_iVertexCacheSize < c_iVertexCacheWays ? i_iVertexCacheSize : c_iVertexCacheWays;
+	const uint32 iSetMask = i_iVertexCacheSize / iNumWays - 1;
+
+	// Entries hold the vertex index and the time of their last use; the least recently used entry of a set is replaced.
+	std::vector<uint32> CachedVertices( i_iVertexCacheSize, c_iNoVertex );
+	std::vector<uint32> FetchTimes( i_iVertexCacheSize, 0 );
+	std::vector<bool> Referenced;
+
+	o_Stats.iNumTriangles = i_iNumIndices / 3;
+	o_Stats.iNumVertices = 0;
+	o_Stats.iTransformedVertices = 0;
+
+	for( uint32 iIndex = 0; iIndex < i_iNumIndices; ++iIndex )
+	{
+		const uint32 iVertex = i_pIndices[iIndex];
+		if( iVertex >= Referenced.size() )
+			Referenced.resize( iVertex + 1, false );
+		if( !Referenced[iVertex] )
+		{
+			Referenced[iVertex] = true;
+			++o_Stats.iNumVertices;
+		}
+
+		const uint32 iSet = ( iVertex & iSetMask ) * iNumWays;
+		uint32 iDestEntry = iSet, iWay = 0;
+		for( ; iWay < iNumWays; ++iWay )
+		{
+			if( CachedVertices[iSet + iWay] == iVertex )
+				break;
+			if( FetchTimes[iSet + iWay] < FetchTimes[iDestEntry] )
+				iDestEntry = iSet + iWay;
+		}
+
+		if( iWay < iNumWays )
+			iDestEntry = iSet + iWay;
+		else
+		{
+			CachedVertices[iDestEntry] = iVertex;
+			++o_Stats.iTransformedVertices;
+		}
+		FetchTimes[iDestEntry] = iIndex + 1;
+	}
+
+	o_Stats.fACMR = o_Stats.iNumTriangles ? (float32)o_Stats.iTransformedVertices / (float32)o_Stats.iNumTriangles : 0.0f;
+	o_Stats.fATVR = o_Stats.iNumVertices ? (float32)o_Stats.iTransformedVertices / (float32)o_Stats.iNumVertices : 0.0f;
+}
+
+void OptimizeVertexCache( uint32 *io_pIndices, uint32 i_iNumIndices, uint32 i_iNumVertices, uint32 i_iVertexCacheSize )
+{
+	const uint32 iNumTriangles = i_iNumIndices / 3;
+	const uint32 iCacheSize = i_iVertexCacheSize > c_iMaxScoredCacheSize ? c_iMaxScoredCacheSize : i_iVertexCacheSize;
+	if( iNumTriangles < 2 || iCacheSize <= 3 )
+		return;
+
+	// Precompute the scores of cache positions and valences ------------------
+	float32 fCacheScores[c_iMaxScoredCacheSize];
+	for( uint32 iPosition = 0; iPosition < iCacheSize; ++iPosition )
+	{
+		fCacheScores[iPosition] = iPosition < 3 ? c_fLastTriangleScore :
+			powf( 1.0f - (float32)( iPosition - 3 ) / (float32)( iCacheSize - 3 ), c_fCacheDecayPower );
+	}
+
+	float32 fValenceScores[c_iMaxScoredValence + 1];
+	fValenceScores[0] = -1.0f; // vertices without remaining triangles are never looked at again
+	for( uint32 iValence = 1; iValence <= c_iMaxScoredValence; ++iValence )
+		fValenceScores[iValence] = c_fValenceBoostScale * powf( (float32)iValence, -c_fValenceBoostPower );
+
+	// Build the lists of triangles adjacent to each vertex -------------------
+	// The first RemainingTriangles[v] entries of the list of vertex v are the
+	// triangles that haven't been emitted yet.
+	std::vector<uint32> RemainingTriangles( i_iNumVertices, 0 );
+	for( uint32 iIndex = 0; iIndex < iNumTriangles * 3; ++iIndex )
+		++RemainingTriangles[io_pIndices[iIndex]];
+
+	std::vector<uint32> AdjacencyOffsets( i_iNumVertices + 1, 0 );
+	for( uint32 iVertex = 0; iVertex < i_iNumVertices; ++iVertex )
+		AdjacencyOffsets[iVertex + 1] = AdjacencyOffsets[iVertex] + RemainingTriangles[iVertex];
+
+	std::vector<uint32> AdjacentTriangles( iNumTriangles * 3 );
+	std::vector<uint32> AdjacencyFill( AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1 );
+	for( uint32 iIndex = 0; iIndex < iNumTriangles * 3; ++iIndex )
+		AdjacentTriangles[AdjacencyFill[io_pIndices[iIndex]]++] = iIndex / 3;
+
+	// Score vertices and triangles -------------------------------------------
+	std::vector<int32> CachePositions( i_iNumVertices, -1 );
+	std::vector<float32> VertexScores( i_iNumVertices );
+	for( uint32 iVertex = 0; iVertex < i_iNumVertices; ++iVertex )
+	{
+		const uint32 iValence = RemainingTriangles[iVertex];
+		VertexScores[iVertex] = fValenceScores[iValence < c_iMaxScoredValence ? iValence : c_iMaxScoredValence];
+	}
+
+	std::vector<float32> TriangleScores( iNumTriangles );
+	std::vector<bool> Emitted( iNumTriangles, false );
+	uint32 iBestTriangle = 0;
+	for( uint32 iTriangle = 0; iTriangle < iNumTriangles; ++iTriangle )
+	{
+		const uint32 *pTriangle = &io_pIndices[iTriangle * 3];
+		TriangleScores[iTriangle] = VertexScores[pTriangle[0]] + VertexScores[pTriangle[1]] + VertexScores[pTriangle[2]];
+		if( TriangleScores[iTriangle] > TriangleScores[iBestTriangle] )
+			iBestTriangle = iTriangle;
+	}
+
+	// Emit triangles ---------------------------------------------------------
+	std::vector<uint32> Output( iNumTriangles * 3 );
+	uint32 Cache[c_iMaxScoredCacheSize + 3], NewCache[c_iMaxScoredCacheSize + 3];
+	uint32 iCacheEntries = 0, iNextUnemitted = 0;
+
+	for( uint32 iOutput = 0; iOutput < iNumTriangles; ++iOutput )
+	{
+		if( iBestTriangle == c_iNoTriangle )
+		{
+			// None of the cached vertices has remaining triangles; continue with the next triangle in the original order.
+			while( Emitted[iNextUnemitted] )
+				++iNextUnemitted;
+			iBestTriangle = iNextUnemitted;
+		}
+
+		const uint32 *pTriangle = &io_pIndices[iBestTriangle * 3];
+		Output[iOutput * 3 + 0] = pTriangle[0];
+		Output[iOutput * 3 + 1] = pTriangle[1];
+		Output[iOutput * 3 + 2] = pTriangle[2];
+		Emitted[iBestTriangle] = true;
+
+		// Remove the triangle from the remaining triangles of its vertices and
+		// move its vertices to the front of the cache.
+		uint32 iNewCacheEntries = 0;
+		for( uint32 iCorner = 0; iCorner < 3; ++iCorner )
+		{
+			const uint32 iVertex = pTriangle[iCorner];
+			uint32 *pRemaining = &AdjacentTriangles[AdjacencyOffsets[iVertex]];
+			uint32 iLast = --RemainingTriangles[iVertex];
+			for( uint32 iAdjacent = 0; iAdjacent < iLast; ++iAdjacent )
+			{
+				if( pRemaining[iAdjacent] == iBestTriangle )
+				{
+					pRemaining[iAdjacent] = pRemaining[iLast];
+					pRemaining[iLast] = iBestTriangle;
+					break;
+				}
+			}
+
+			NewCache[iNewCacheEntries++] = iVertex;
+		}
+
+		for( uint32 iEntry = 0; iEntry < iCacheEntries; ++iEntry )
+		{
+			const uint32 iVertex = Cache[iEntry];
+			if( iVertex != pTriangle[0] && iVertex != pTriangle[1] && iVertex != pTriangle[2] )
+				NewCache[iNewCacheEntries++] = iVertex;
+		}
+
+		// Rescore the vertices whose cache position has changed, including those that dropped out of the cache.
+		for( uint32 iEntry = 0; iEntry < iNewCacheEntries; ++iEntry )
+		{
+			const uint32 iVertex = NewCache[iEntry];
+			const uint32 iValence = RemainingTriangles[iVertex];
+			float32 fScore = fValenceScores[iValence < c_iMaxScoredValence ? iValence : c_iMaxScoredValence];
+			if( iEntry < iCacheSize )
+			{
+				CachePositions[iVertex] = iEntry;
+				if( iValence )
+					fScore += fCacheScores[iEntry];
+			}
+			else
+				CachePositions[iVertex] = -1;
+
+			const float32 fDelta = fScore - VertexScores[iVertex];
+			VertexScores[iVertex] = fScore;
+
+			const uint32 *pRemaining = &AdjacentTriangles[AdjacencyOffsets[iVertex]];
+			for( uint32 iAdjacent = 0; iAdjacent < iValence; ++iAdjacent )
+				TriangleScores[pRemaining[iAdjacent]] += fDelta;
+		}
+
+		// The next triangle is the best one using a cached vertex.
+		iBestTriangle = c_iNoTriangle;
+		float32 fBestScore = -1.0f;
+		iCacheEntries = iNewCacheEntries < iCacheSize ? iNewCacheEntries : iCacheSize;
+		for( uint32 iEntry = 0; iEntry < iCacheEntries; ++iEntry )
+		{
+			const uint32 iVertex = NewCache[iEntry];
+			Cache[iEntry] = iVertex;
+
+			const uint32 *pRemaining = &AdjacentTriangles[AdjacencyOffsets[iVertex]];
+			for( uint32 iAdjacent = 0; iAdjacent < RemainingTriangles[iVertex]; ++iAdjacent )
+			{
+				if( TriangleScores[pRemaining[iAdjacent]] > fBestScore )
+				{
+					fBestScore = TriangleScores[pRemaining[iAdjacent]];
+					iBestTriangle = pRemaining[iAdjacent];
+				}
+			}
+		}
+	}
+
+	memcpy( io_pIndices, &Output[0], sizeof( uint32 ) * iNumTriangles * 3 );
+}
+
+uint32 iOptimizeVertexFetch( uint32 *o_pRemap, uint32 *io_pIndices, uint32 i_iNumIndices, uint32 i_iNumVertices )
+{
+	for( uint32 iVertex = 0; iVertex < i_iNumVertices; ++iVertex )
+		o_pRemap[iVertex] = c_iNoVertex;
+
+	uint32 iNextVertex = 0;
+	for( uint32 iIndex = 0; iIndex < i_iNumIndices; ++iIndex )
+	{
+		uint32 &iNewVertex = o_pRemap[io_pIndices[iIndex]];
+		if( iNewVertex == c_iNoVertex )
+			iNewVertex = iNextVertex++;
+		io_pIndices[iIndex] = iNewVertex;
+	}
+
+	const uint32 iReferencedVertices = iNextVertex;
+	for( uint32 iVertex = 0; iVertex < i_iNumVertices; ++iVertex )
+	{
+		if( o_pRemap[iVertex] == c_iNoVertex )
+			o_pRemap[iVertex] = iNextVertex++;
+	}
+
+	return iReferencedVertices;
+}
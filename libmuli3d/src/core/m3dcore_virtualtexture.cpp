@@ -0,0 +1,504 @@
+/*
+	Muli3D - a software rendering library
+	Copyright (C) 2004, 2005 Stephan Reiter <streiter@aon.at>
+
+	This library is free software; you can redistribute it and/or
+	modify it under the terms of the GNU Lesser General Public
+	License as published by the Free Software Foundation; either
+	version 2.1 of the License, or (at your option) any later version.
+
+	This library is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+	Lesser General Public License for more details.
+
+	You should have received a copy of the GNU Lesser General Public
+	License along with this library; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "../../include/core/m3dcore_virtualtexture.h"
+#include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_pixelformat.h"
+#include "../../include/core/m3dcore_threadpool.h"
+#include <algorithm>
+#include <functional>
+
+CMuli3DVirtualTexture::CMuli3DVirtualTexture( CMuli3DDevice *i_pParent )
+	: IMuli3DBaseTexture( i_pParent ),
+	m_fmtFormat( m3dfmt_r32f ), m_iPixelBytes( 0 ), m_iMipLevels( 0 ), m_pMipLevels( 0 ),
+	m_iNumPages( 0 ), m_pPageTable( 0 ), m_pPageStates( 0 ),
+	m_iNumPhysicalPages( 0 ), m_iPhysicalPageSize( 0 ), m_pPhysicalData( 0 ), m_pPhysicalPages( 0 ),
+	m_pFreePhysicalPages( 0 ), m_iNumFreePhysicalPages( 0 ), m_iNumResidentPages( 0 ), m_iFrame( 0 ),
+	m_iNumPageRequests( 0 ), m_iNumPageLoads( 0 ), m_pLoader( 0 ), m_pPageSource( 0 )
+{
+	for( uint32 iLoad = 0; iLoad < c_iMaxPageLoads; ++iLoad )
+		m_PageLoads[iLoad].iPhysicalPage = -1;
+}
+
+CMuli3DVirtualTexture::~CMuli3DVirtualTexture()
+{
+	// The loader thread may still be accessing the page source and the physical pages.
+	if( m_pLoader )
+		m_pLoader->WaitIdle();
+	SAFE_DELETE( m_pLoader );
+	SAFE_RELEASE( m_pPageSource );
+
+	SAFE_DELETE_ARRAY( m_pFreePhysicalPages );
+	SAFE_DELETE_ARRAY( m_pPhysicalPages );
+	SAFE_DELETE_ARRAY( m_pPhysicalData );
+	SAFE_DELETE_ARRAY( m_pPageStates );
+	SAFE_DELETE_ARRAY( m_pPageTable );
+	SAFE_DELETE_ARRAY( m_pMipLevels );
+}
+
+result CMuli3DVirtualTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iMipLevels, m3dformat i_fmtFormat, uint32 i_iResidentPages, IMuli3DPageSource *i_pPageSource )
+{
+	if( !i_iWidth || !i_iHeight || !i_pPageSource )
+	{
+		FUNC_FAILING( "CMuli3DVirtualTexture::Create: texture dimensions or page source are invalid.\n" );
+		return e_invalidparameters;
+	}
+
+	if( !bIsTextureFormat( i_fmtFormat ) )
+	{
+		FUNC_FAILING( "CMuli3DVirtualTexture::Create: invalid format specified.\n" );
+		return e_invalidformat;
+	}
+
+	m_fmtFormat = i_fmtFormat;
+	m_iPixelBytes = iGetFormatPixelBytes( i_fmtFormat );
+	m_iPhysicalPageSize = c_iVirtualPageSize * c_iVirtualPageSize * m_iPixelBytes;
+
+	m_fSquaredWidth = (float32)(i_iWidth * i_iWidth);
+	m_fSquaredHeight = (float32)(i_iHeight * i_iHeight);
+
+	m_pPageSource = i_pPageSource;
+	m_pPageSource->AddRef();
+
+	uint32 iMaxMipLevels = 0;
+	for( uint32 iWidth = i_iWidth, iHeight = i_iHeight; iWidth && iHeight; iWidth >>= 1, iHeight >>= 1 )
+		++iMaxMipLevels;
+	if( !i_iMipLevels || i_iMipLevels > iMaxMipLevels )
+		i_iMipLevels = iMaxMipLevels;
+
+	m_pMipLevels = new miplevel[i_iMipLevels];
+	if( !m_pMipLevels )
+	{
+		FUNC_FAILING( "CMuli3DVirtualTexture::Create: out of memory, cannot create mip-levels.\n" );
+		return e_outofmemory;
+	}
+
+	// Mip-levels fitting into a single page are always resident.
+	uint32 iPinnedPages = 0;
+	for( ; m_iMipLevels < i_iMipLevels; ++m_iMipLevels )
+	{
+		miplevel &MipLevel = m_pMipLevels[m_iMipLevels];
+		MipLevel.iWidth = i_iWidth >> m_iMipLevels;
+		MipLevel.iHeight = i_iHeight >> m_iMipLevels;
+		MipLevel.iPagesX = ( MipLevel.iWidth + c_iVirtualPageSize - 1 ) / c_iVirtualPageSize;
+		MipLevel.iPagesY = ( MipLevel.iHeight + c_iVirtualPageSize - 1 ) / c_iVirtualPageSize;
+		MipLevel.iFirstPage = m_iNumPages;
+		m_iNumPages += MipLevel.iPagesX * MipLevel.iPagesY;
+
+		if( MipLevel.iPagesX * MipLevel.iPagesY == 1 )
+			++iPinnedPages;
+	}
+
+	if( !iPinnedPages )
+	{
+		FUNC_FAILING( "CMuli3DVirtualTexture::Create: the last mip-level doesn't fit into a single page.\n" );
+		return e_invalidparameters;
+	}
+
+	if( i_iResidentPages <= iPinnedPages )
+	{
+		FUNC_FAILING( "CMuli3DVirtualTexture::Create: i_iResidentPages doesn't exceed the number of pages which are always resident.\n" );
+		return e_invalidparameters;
+	}
+
+	m_pPageTable = new int32[m_iNumPages];
+	m_pPageStates = new int32[m_iNumPages];
+	m_pPhysicalData = new byte[i_iResidentPages * m_iPhysicalPageSize];
+	m_pPhysicalPages = new physicalpage[i_iResidentPages];
+	m_pFreePhysicalPages = new int32[i_iResidentPages];
+	if( !m_pPageTable || !m_pPageStates || !m_pPhysicalData || !m_pPhysicalPages || !m_pFreePhysicalPages )
+	{
+		FUNC_FAILING( "CMuli3DVirtualTexture::Create: out of memory, cannot create page table and physical pages.\n" );
+		return e_outofmemory;
+	}
+
+	for( uint32 iPage = 0; iPage < m_iNumPages; ++iPage )
+	{
+		m_pPageTable[iPage] = -1;
+		m_pPageStates[iPage] = ps_missing;
+	}
+
+	m_iNumPhysicalPages = i_iResidentPages;
+	for( uint32 iPhysicalPage = 0; iPhysicalPage < m_iNumPhysicalPages; ++iPhysicalPage )
+	{
+		m_pPhysicalPages[iPhysicalPage].iPage = -1;
+		m_pPhysicalPages[iPhysicalPage].iLastUse = 0;
+		m_pPhysicalPages[iPhysicalPage].bPinned = false;
+
+		// pop physical pages in ascending order
+		m_pFreePhysicalPages[iPhysicalPage] = m_iNumPhysicalPages - 1 - iPhysicalPage;
+	}
+	m_iNumFreePhysicalPages = m_iNumPhysicalPages;
+
+	// Load the pages which are always resident.
+	for( uint32 iMipLevel = 0; iMipLevel < m_iMipLevels; ++iMipLevel )
+	{
+		const miplevel &MipLevel = m_pMipLevels[iMipLevel];
+		if( MipLevel.iPagesX * MipLevel.iPagesY != 1 )
+			continue;
+
+		const int32 iPhysicalPage = m_pFreePhysicalPages[--m_iNumFreePhysicalPages];
+		if( !m_pPageSource->bLoadPage( &m_pPhysicalData[iPhysicalPage * m_iPhysicalPageSize], iMipLevel, 0, 0 ) )
+		{
+			FUNC_FAILING( "CMuli3DVirtualTexture::Create: a page of the mip-levels which are always resident failed to load.\n" );
+			return e_unknown;
+		}
+
+		m_pPhysicalPages[iPhysicalPage].iPage = MipLevel.iFirstPage;
+		m_pPhysicalPages[iPhysicalPage].bPinned = true;
+		m_pPageTable[MipLevel.iFirstPage] = iPhysicalPage;
+		m_pPageStates[MipLevel.iFirstPage] = ps_resident;
+		++m_iNumResidentPages;
+	}
+
+	m_pLoader = new CMuli3DWorkQueue;
+	if( !m_pLoader )
+	{
+		FUNC_FAILING( "CMuli3DVirtualTexture::Create: out of memory, cannot create loader thread.\n" );
+		return e_outofmemory;
+	}
+
+	result resCreate = m_pLoader->Create();
+	if( FUNC_FAILED( resCreate ) )
+	{
+		SAFE_DELETE( m_pLoader );
+		return resCreate;
+	}
+
+	return s_ok;
+}
+
+m3dtexsampleinput CMuli3DVirtualTexture::eGetTexSampleInput()
+{
+	return m3dtsi_2coords;
+}
+
+result CMuli3DVirtualTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	float32 fTexMipLevel; uint32 iTexFilter;
+	ComputeMipLevel( fTexMipLevel, iTexFilter, i_pXGradient, i_pYGradient, i_pSamplerStates );
+	SampleMipLevel( o_vColor, i_fU, i_fV, fTexMipLevel, iTexFilter, i_pSamplerStates[m3dtss_mipfilter] );
+	return s_ok;
+}
+
+result CMuli3DVirtualTexture::SampleTextureQuad( vector4 *o_pColors, const vector4 *i_pCoords, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	float32 fTexMipLevel; uint32 iTexFilter;
+	ComputeMipLevel( fTexMipLevel, iTexFilter, i_pXGradient, i_pYGradient, i_pSamplerStates );
+
+	const uint32 iMipFilter = i_pSamplerStates[m3dtss_mipfilter];
+	for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		SampleMipLevel( o_pColors[iPixel], i_pCoords[iPixel].x, i_pCoords[iPixel].y, fTexMipLevel, iTexFilter, iMipFilter );
+
+	return s_ok;
+}
+
+void CMuli3DVirtualTexture::ComputeMipLevel( float32 &o_fMipLevel, uint32 &o_iTexFilter, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	o_iTexFilter = i_pSamplerStates[m3dtss_minfilter];
+	o_fMipLevel = 0.0f;
+
+	if( i_pXGradient && i_pYGradient )
+	{
+		// Compute the mip-level and determine the texture filter type.
+		const float32 fLenXGrad = i_pXGradient->x * i_pXGradient->x * m_fSquaredWidth + i_pXGradient->y * i_pXGradient->y * m_fSquaredHeight;
+		const float32 fLenYGrad = i_pYGradient->x * i_pYGradient->x * m_fSquaredWidth + i_pYGradient->y * i_pYGradient->y * m_fSquaredHeight;
+		const float32 fSquaredTexelsPerScreenPixel = fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad;
+
+		if( fSquaredTexelsPerScreenPixel <= 1.0f )
+		{
+			 // if fTexelsPerScreenPixel < 1.0f -> magnification, no mipmapping needed
+			o_iTexFilter = i_pSamplerStates[m3dtss_magfilter];
+		}
+		else
+		{
+			// minification, need mipmapping: log2( sqrt( x ) ) = 0.5 * log2( x )
+			o_fMipLevel = 0.5f * fFastLog2( fSquaredTexelsPerScreenPixel );
+		}
+	}
+
+	const float32 fMipLODBias = *(float32 *)&i_pSamplerStates[m3dtss_miplodbias];
+	const float32 fMaxMipLevel = *(float32 *)&i_pSamplerStates[m3dtss_maxmiplevel];
+	o_fMipLevel = fClamp( o_fMipLevel + fMipLODBias, 0.0f, fMaxMipLevel );
+}
+
+void CMuli3DVirtualTexture::SampleMipLevel( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fMipLevel, uint32 i_iTexFilter, uint32 i_iMipFilter )
+{
+	// Missing pages fall back to the next coarser mip-level; the last mip-level is always resident.
+	if( i_iMipFilter == m3dtf_linear )
+	{
+		uint32 iMipLevelA = ftol( i_fMipLevel ), iMipLevelB = iMipLevelA + 1;
+		if( iMipLevelA >= m_iMipLevels ) iMipLevelA = m_iMipLevels - 1;
+		if( iMipLevelB >= m_iMipLevels ) iMipLevelB = m_iMipLevels - 1;
+
+		vector4 vColorA, vColorB;
+		while( !bSampleLevel( vColorA, i_fU, i_fV, iMipLevelA, i_iTexFilter ) )
+			++iMipLevelA;
+		if( iMipLevelB < iMipLevelA )
+			iMipLevelB = iMipLevelA;
+		while( !bSampleLevel( vColorB, i_fU, i_fV, iMipLevelB, i_iTexFilter ) )
+			++iMipLevelB;
+
+		const float32 fInterpolation = fSaturate( i_fMipLevel - iMipLevelA );
+		vVector4Lerp( o_vColor, vColorA, vColorB, fInterpolation );
+	}
+	else
+	{
+		uint32 iMipLevel = ftol( i_fMipLevel );
+		if( iMipLevel >= m_iMipLevels ) iMipLevel = m_iMipLevels - 1;
+
+		while( !bSampleLevel( o_vColor, i_fU, i_fV, iMipLevel, i_iTexFilter ) )
+			++iMipLevel;
+	}
+}
+
+bool CMuli3DVirtualTexture::bSampleLevel( vector4 &o_vColor, float32 i_fU, float32 i_fV, uint32 i_iMipLevel, uint32 i_iTexFilter )
+{
+	const miplevel &MipLevel = m_pMipLevels[i_iMipLevel];
+	const float32 fX = i_fU * ( MipLevel.iWidth - 1 ), fY = i_fV * ( MipLevel.iHeight - 1 );
+	const uint32 iPixelX = ftol( fX ), iPixelY = ftol( fY );
+	const uint32 iPageX = iPixelX / c_iVirtualPageSize, iPageY = iPixelY / c_iVirtualPageSize;
+	const uint32 iOffsetX = iPixelX % c_iVirtualPageSize, iOffsetY = iPixelY % c_iVirtualPageSize;
+
+	if( i_iTexFilter != m3dtf_linear )
+	{
+		const byte *pPage = pGetPage( i_iMipLevel, iPageX, iPageY );
+		if( !pPage )
+			return false;
+
+		DecodePixel( o_vColor, m_fmtFormat, &pPage[( iOffsetY * c_iVirtualPageSize + iOffsetX ) * m_iPixelBytes] );
+		return true;
+	}
+
+	uint32 iPixelX2 = iPixelX + 1, iPixelY2 = iPixelY + 1;
+	if( iPixelX2 >= MipLevel.iWidth ) iPixelX2 = MipLevel.iWidth - 1;
+	if( iPixelY2 >= MipLevel.iHeight ) iPixelY2 = MipLevel.iHeight - 1;
+	const uint32 iPageX2 = iPixelX2 / c_iVirtualPageSize, iPageY2 = iPixelY2 / c_iVirtualPageSize;
+	const uint32 iOffsetX2 = iPixelX2 % c_iVirtualPageSize, iOffsetY2 = iPixelY2 % c_iVirtualPageSize;
+
+	// The four pixels usually lie in a single page; all missing pages are recorded.
+	const byte *pPages[4];
+	pPages[0] = pGetPage( i_iMipLevel, iPageX, iPageY );
+	pPages[1] = ( iPageX2 == iPageX ) ? pPages[0] : pGetPage( i_iMipLevel, iPageX2, iPageY );
+	pPages[2] = ( iPageY2 == iPageY ) ? pPages[0] : pGetPage( i_iMipLevel, iPageX, iPageY2 );
+	pPages[3] = ( iPageY2 == iPageY ) ? pPages[1] : ( ( iPageX2 == iPageX ) ? pPages[2] : pGetPage( i_iMipLevel, iPageX2, iPageY2 ) );
+	if( !pPages[0] || !pPages[1] || !pPages[2] || !pPages[3] )
+		return false;
+
+	vector4 vPixels[4];
+	DecodePixel( vPixels[0], m_fmtFormat, &pPages[0][( iOffsetY * c_iVirtualPageSize + iOffsetX ) * m_iPixelBytes] );
+	DecodePixel( vPixels[1], m_fmtFormat, &pPages[1][( iOffsetY * c_iVirtualPageSize + iOffsetX2 ) * m_iPixelBytes] );
+	DecodePixel( vPixels[2], m_fmtFormat, &pPages[2][( iOffsetY2 * c_iVirtualPageSize + iOffsetX ) * m_iPixelBytes] );
+	DecodePixel( vPixels[3], m_fmtFormat, &pPages[3][( iOffsetY2 * c_iVirtualPageSize + iOffsetX2 ) * m_iPixelBytes] );
+
+	const float32 fInterpolation[2] = { fX - iPixelX, fY - iPixelY };
+	vector4 vColorRows[2];
+	vVector4Lerp( vColorRows[0], vPixels[0], vPixels[1], fInterpolation[0] );
+	vVector4Lerp( vColorRows[1], vPixels[2], vPixels[3], fInterpolation[0] );
+	vVector4Lerp( o_vColor, vColorRows[0], vColorRows[1], fInterpolation[1] );
+	return true;
+}
+
+const byte *CMuli3DVirtualTexture::pGetPage( uint32 i_iMipLevel, uint32 i_iPageX, uint32 i_iPageY )
+{
+	const miplevel &MipLevel = m_pMipLevels[i_iMipLevel];
+	const uint32 iPage = MipLevel.iFirstPage + i_iPageY * MipLevel.iPagesX + i_iPageX;
+
+	const int32 iPhysicalPage = m_pPageTable[iPage];
+	if( iPhysicalPage >= 0 )
+	{
+		m_pPhysicalPages[iPhysicalPage].iLastUse = m_iFrame;
+		return &m_pPhysicalData[iPhysicalPage * m_iPhysicalPageSize];
+	}
+
+	// Record the page as missing; the first thread to do so appends it to the requests.
+	if( m_pPageStates[iPage] == ps_missing &&
+		iAtomicCompareExchange( &m_pPageStates[iPage], ps_requested, ps_missing ) == ps_missing )
+	{
+		const int32 iRequest = iAtomicIncrement( &m_iNumPageRequests ) - 1;
+		if( iRequest < (int32)c_iMaxPageRequests )
+			m_iPageRequests[iRequest] = iPage;
+		else
+			m_pPageStates[iPage] = ps_missing; // requested again after the next call to UpdatePages()
+	}
+
+	return 0;
+}
+
+result CMuli3DVirtualTexture::UpdatePages( bool i_bWaitForLoads )
+{
+	if( i_bWaitForLoads )
+		m_pLoader->WaitIdle();
+
+	// Map the pages which have finished loading.
+	for( uint32 iLoad = 0; iLoad < c_iMaxPageLoads && m_iNumPageLoads; ++iLoad )
+	{
+		pageload &PageLoad = m_PageLoads[iLoad];
+		if( PageLoad.iPhysicalPage < 0 || !m_pLoader->bIsComplete( PageLoad.iJob ) )
+			continue;
+
+		if( PageLoad.bLoaded )
+		{
+			physicalpage &PhysicalPage = m_pPhysicalPages[PageLoad.iPhysicalPage];
+			PhysicalPage.iPage = PageLoad.iPage;
+			PhysicalPage.iLastUse = m_iFrame;
+			m_pPageTable[PageLoad.iPage] = PageLoad.iPhysicalPage;
+			m_pPageStates[PageLoad.iPage] = ps_resident;
+			++m_iNumResidentPages;
+		}
+		else
+		{
+			m_pFreePhysicalPages[m_iNumFreePhysicalPages++] = PageLoad.iPhysicalPage;
+			m_pPageStates[PageLoad.iPage] = ps_failed;
+		}
+
+		PageLoad.iPhysicalPage = -1;
+		--m_iNumPageLoads;
+	}
+
+	// Start loading the missing pages; pages of coarser mip-levels have larger indices and are loaded first.
+	uint32 iNumRequests = (uint32)m_iNumPageRequests;
+	if( iNumRequests > c_iMaxPageRequests )
+		iNumRequests = c_iMaxPageRequests;
+	std::sort( m_iPageRequests, m_iPageRequests + iNumRequests, std::greater<uint32>() );
+
+	uint32 iLoad = 0;
+	for( uint32 iRequest = 0; iRequest < iNumRequests; ++iRequest )
+	{
+		const uint32 iPage = m_iPageRequests[iRequest];
+
+		while( iLoad < c_iMaxPageLoads && m_PageLoads[iLoad].iPhysicalPage >= 0 )
+			++iLoad;
+
+		const int32 iPhysicalPage = ( iLoad < c_iMaxPageLoads ) ? iAcquirePhysicalPage() : -1;
+		if( iPhysicalPage < 0 )
+		{
+			// requested again when it's sampled the next time
+			m_pPageStates[iPage] = ps_missing;
+			continue;
+		}
+
+		uint32 iMipLevel = 0;
+		while( iMipLevel + 1 < m_iMipLevels && m_pMipLevels[iMipLevel + 1].iFirstPage <= iPage )
+			++iMipLevel;
+		const miplevel &MipLevel = m_pMipLevels[iMipLevel];
+
+		pageload &PageLoad = m_PageLoads[iLoad];
+		PageLoad.pTexture = this;
+		PageLoad.iPage = iPage;
+		PageLoad.iMipLevel = iMipLevel;
+		PageLoad.iPageX = ( iPage - MipLevel.iFirstPage ) % MipLevel.iPagesX;
+		PageLoad.iPageY = ( iPage - MipLevel.iFirstPage ) / MipLevel.iPagesX;
+		PageLoad.iPhysicalPage = iPhysicalPage;
+		PageLoad.bLoaded = false;
+		m_pPageStates[iPage] = ps_loading;
+		++m_iNumPageLoads;
+
+		PageLoad.iJob = m_pLoader->iSubmit( LoadPageJob, &PageLoad );
+	}
+
+	m_iNumPageRequests = 0;
+	++m_iFrame;
+
+	return s_ok;
+}
+
+int32 CMuli3DVirtualTexture::iAcquirePhysicalPage()
+{
+	if( m_iNumFreePhysicalPages )
+		return m_pFreePhysicalPages[--m_iNumFreePhysicalPages];
+
+	// Replace the least recently used page, unless it has been sampled during the last frame.
+	int32 iVictim = -1; uint32 iVictimAge = 0;
+	for( uint32 iPhysicalPage = 0; iPhysicalPage < m_iNumPhysicalPages; ++iPhysicalPage )
+	{
+		const physicalpage &PhysicalPage = m_pPhysicalPages[iPhysicalPage];
+		if( PhysicalPage.bPinned || PhysicalPage.iPage < 0 )
+			continue;
+
+		const uint32 iAge = m_iFrame - PhysicalPage.iLastUse;
+		if( iAge > iVictimAge )
+		{
+			iVictim = (int32)iPhysicalPage;
+			iVictimAge = iAge;
+		}
+	}
+
+	if( iVictim < 0 )
+		return -1;
+
+	physicalpage &PhysicalPage = m_pPhysicalPages[iVictim];
+	m_pPageTable[PhysicalPage.iPage] = -1;
+	m_pPageStates[PhysicalPage.iPage] = ps_missing;
+	PhysicalPage.iPage = -1;
+	--m_iNumResidentPages;
+
+	return iVictim;
+}
+
+void CMuli3DVirtualTexture::LoadPageJob( void *i_pPageLoad, uint32 i_iJob, uint32 i_iThread )
+{
+	pageload *pPageLoad = (pageload *)i_pPageLoad;
+	CMuli3DVirtualTexture *pTexture = pPageLoad->pTexture;
+
+	byte *pData = &pTexture->m_pPhysicalData[pPageLoad->iPhysicalPage * pTexture->m_iPhysicalPageSize];
+	pPageLoad->bLoaded = pTexture->m_pPageSource->bLoadPage( pData, pPageLoad->iMipLevel, pPageLoad->iPageX, pPageLoad->iPageY );
+}
+
+m3dformat CMuli3DVirtualTexture::fmtGetFormat()
+{
+	return m_fmtFormat;
+}
+
+uint32 CMuli3DVirtualTexture::iGetMipLevels()
+{
+	return m_iMipLevels;
+}
+
+uint32 CMuli3DVirtualTexture::iGetResidentPages()
+{
+	return m_iNumResidentPages;
+}
+
+uint32 CMuli3DVirtualTexture::iGetLoadingPages()
+{
+	return m_iNumPageLoads;
+}
+
+uint32 CMuli3DVirtualTexture::iGetWidth( uint32 i_iMipLevel )
+{
+	if( i_iMipLevel >= m_iMipLevels )
+	{
+		FUNC_FAILING( "CMuli3DVirtualTexture::iGetWidth: invalid mip-level specified.\n" );
+		return 0;
+	}
+
+	return m_pMipLevels[i_iMipLevel].iWidth;
+}
+
+uint32 CMuli3DVirtualTexture::iGetHeight( uint32 i_iMipLevel )
+{
+	if( i_iMipLevel >= m_iMipLevels )
+	{
+		FUNC_FAILING( "CMuli3DVirtualTexture::iGetHeight: invalid mip-level specified.\n" );
+		return 0;
+	}
+
+	return m_pMipLevels[i_iMipLevel].iHeight;
+}
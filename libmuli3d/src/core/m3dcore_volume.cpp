@@ -19,10 +19,12 @@
 
 #include "../../include/core/m3dcore_volume.h"
 #include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_pixelformat.h"
 
 CMuli3DVolume::CMuli3DVolume( CMuli3DDevice *i_pParent ) :
 	m_pParent( i_pParent ), m_iWidth( 0 ), m_iHeight( 0 ), m_iDepth( 0 ),
-	m_iWidthMin1( 0 ), m_iHeightMin1( 0 ), m_iDepthMin1( 0 ), 
+	m_iWidthMin1( 0 ), m_iHeightMin1( 0 ), m_iDepthMin1( 0 ), m_iPixelBytes( 0 ),
+	m_Layout( m3dtl_linear ), m_iTilesPerRow( 0 ), m_iTilesPerSlice( 0 ),
 	m_bLockedComplete( false ), m_pPartialLockData( 0 ), m_pData( 0 )
 {}
 
@@ -32,7 +34,16 @@ CMuli3DVolume::~CMuli3DVolume()
 	SAFE_DELETE_ARRAY( m_pData );
 }
 
-result CMuli3DVolume::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, m3dformat i_fmtFormat )
+inline uint32 CMuli3DVolume::iGetPixelIndex( uint32 i_iX, uint32 i_iY, uint32 i_iZ )
+{
+	if( m_Layout == m3dtl_linear )
+		return ( i_iZ * m_iHeight + i_iY ) * m_iWidth + i_iX;
+
+	const uint32 iBrick = ( i_iZ / c_iTextureTileSize ) * m_iTilesPerSlice + ( i_iY / c_iTextureTileSize ) * m_iTilesPerRow + i_iX / c_iTextureTileSize;
+	return ( ( iBrick * c_iTextureTileSize + i_iZ % c_iTextureTileSize ) * c_iTextureTileSize + i_iY % c_iTextureTileSize ) * c_iTextureTileSize + i_iX % c_iTextureTileSize;
+}
+
+result CMuli3DVolume::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, m3dformat i_fmtFormat, m3dtexturelayout i_Layout )
 {
 	if( !i_iWidth || !i_iHeight || !i_iDepth )
 	{
@@ -40,14 +51,10 @@ result CMuli3DVolume::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth
 		return e_invalidparameters;
 	}
 	
-	uint32 iFloats;
-	switch( i_fmtFormat )
+	if( !bIsTextureFormat( i_fmtFormat ) )
 	{
-	case m3dfmt_r32f: iFloats = 1; break;
-	case m3dfmt_r32g32f: iFloats = 2; break;
-	case m3dfmt_r32g32b32f: iFloats = 3; break;
-	case m3dfmt_r32g32b32a32f: iFloats = 4; break;
-	default: FUNC_FAILING( "CMuli3DVolume::Create: invalid format specified.\n" ); return e_invalidformat;
+		FUNC_FAILING( "CMuli3DVolume::Create: invalid format specified.\n" );
+		return e_invalidformat;
 	}
 
 	m_fmtFormat = i_fmtFormat;
@@ -57,8 +64,25 @@ result CMuli3DVolume::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth
 	m_iWidthMin1 = m_iWidth - 1;
 	m_iHeightMin1 = m_iHeight - 1;
 	m_iDepthMin1 = m_iDepth - 1;
+	m_iPixelBytes = iGetFormatPixelBytes( i_fmtFormat );
+	m_Layout = i_Layout;
+
+	uint32 iNumPixels = m_iWidth * m_iHeight * m_iDepth;
+	if( m_Layout == m3dtl_tiled )
+	{
+		// Pad the volume to whole bricks
+		m_iTilesPerRow = ( m_iWidth + c_iTextureTileSize - 1 ) / c_iTextureTileSize;
+		m_iTilesPerSlice = m_iTilesPerRow * ( ( m_iHeight + c_iTextureTileSize - 1 ) / c_iTextureTileSize );
+		const uint32 iTileSlices = ( m_iDepth + c_iTextureTileSize - 1 ) / c_iTextureTileSize;
+		iNumPixels = m_iTilesPerSlice * iTileSlices * c_iTextureTileSize * c_iTextureTileSize * c_iTextureTileSize;
+	}
+	else if( m_Layout != m3dtl_linear )
+	{
+		FUNC_FAILING( "CMuli3DVolume::Create: invalid layout specified.\n" );
+		return e_invalidparameters;
+	}
 
-	m_pData = new float32[m_iWidth * m_iHeight * m_iDepth * iFloats];
+	m_pData = new byte[iNumPixels * m_iPixelBytes];
 	if( !m_pData )
 	{
 		FUNC_FAILING( "CMuli3DVolume::Create: out of memory, cannot create volume.\n" );
@@ -97,6 +121,30 @@ result CMuli3DVolume::Clear( const vector4 &i_vColor, const m3dbox *i_pBox )
 		ClearBox.iRight = m_iWidth; ClearBox.iBottom = m_iHeight; ClearBox.iBack = m_iDepth;
 	}
 
+	if( m_Layout != m3dtl_linear )
+	{
+		// Fill the bricks directly instead of detiling and retiling the whole volume.
+		if( m_bLockedComplete || m_pPartialLockData )
+		{
+			FUNC_FAILING( "CMuli3DVolume::Clear: volume is locked!\n" );
+			return e_invalidstate;
+		}
+
+		byte ClearPixel[16];
+		EncodePixel( ClearPixel, m_fmtFormat, i_vColor );
+
+		for( uint32 iZ = ClearBox.iFront; iZ < ClearBox.iBack; ++iZ )
+		{
+			for( uint32 iY = ClearBox.iTop; iY < ClearBox.iBottom; ++iY )
+			{
+				for( uint32 iX = ClearBox.iLeft; iX < ClearBox.iRight; ++iX )
+					memcpy( &m_pData[iGetPixelIndex( iX, iY, iZ ) * m_iPixelBytes], ClearPixel, m_iPixelBytes );
+			}
+		}
+
+		return s_ok;
+	}
+
 	float32 *pData;
 	result resPointer = LockBox( (void **)&pData, 0 );
 	if( FUNC_FAILED( resPointer ) )
@@ -164,10 +212,24 @@ result CMuli3DVolume::Clear( const vector4 &i_vColor, const m3dbox *i_pBox )
 		}
 		break;
 
-	default: // cannot happen
-		FUNC_FAILING( "CMuli3DVolume::Clear: invalid volume format.\n" );
-		UnlockBox();
-		return e_invalidformat;
+	default:
+		{
+			// Compact formats: encode the color once and replicate it
+			byte ClearPixel[8];
+			EncodePixel( ClearPixel, m_fmtFormat, i_vColor );
+
+			for( uint32 iZ = ClearBox.iFront; iZ < ClearBox.iBack; ++iZ )
+			{
+				byte *pCurData2 = &((byte *)pData)[iZ * m_iWidth * m_iHeight * m_iPixelBytes];
+				for( uint32 iY = ClearBox.iTop; iY < ClearBox.iBottom; ++iY )
+				{
+					byte *pCurData = &pCurData2[( iY * m_iWidth + ClearBox.iLeft ) * m_iPixelBytes];
+					for( uint32 iX = ClearBox.iLeft; iX < ClearBox.iRight; ++iX, pCurData += m_iPixelBytes )
+						memcpy( pCurData, ClearPixel, m_iPixelBytes );
+				}
+			}
+		}
+		break;
 	}
 
 	UnlockBox();
@@ -188,14 +250,19 @@ result CMuli3DVolume::LockBox( void **o_ppData, const m3dbox *i_pBox )
 		return e_invalidstate;
 	}
 
-	if( !i_pBox )
+	if( !i_pBox && m_Layout == m3dtl_linear )
 	{
 		*o_ppData = m_pData;
 		m_bLockedComplete = true;
 		return s_ok;
 	}
 
-	if( i_pBox->iRight > m_iWidth ||
+	if( !i_pBox )
+	{
+		m_PartialLockBox.iLeft = 0; m_PartialLockBox.iTop = 0; m_PartialLockBox.iFront = 0;
+		m_PartialLockBox.iRight = m_iWidth; m_PartialLockBox.iBottom = m_iHeight; m_PartialLockBox.iBack = m_iDepth;
+	}
+	else if( i_pBox->iRight > m_iWidth ||
 		i_pBox->iBottom > m_iHeight ||
 		i_pBox->iBack > m_iDepth )
 	{
@@ -203,40 +270,28 @@ result CMuli3DVolume::LockBox( void **o_ppData, const m3dbox *i_pBox )
 		return e_invalidparameters;
 	}
 
-	if( i_pBox->iLeft >= i_pBox->iRight ||
+	else if( i_pBox->iLeft >= i_pBox->iRight ||
 		i_pBox->iTop >= i_pBox->iBottom ||
 		i_pBox->iFront >= i_pBox->iBack )
 	{
 		FUNC_FAILING( "CMuli3DVolume::LockBox: invalid box specified!\n" );
 		return e_invalidparameters;
 	}
-
-	m_PartialLockBox = *i_pBox;
+	else
+		m_PartialLockBox = *i_pBox;
 	
 	// create lock-buffer
 	const uint32 iLockWidth = m_PartialLockBox.iRight - m_PartialLockBox.iLeft;
 	const uint32 iLockHeight = m_PartialLockBox.iBottom - m_PartialLockBox.iTop;
 	const uint32 iLockDepth = m_PartialLockBox.iBack - m_PartialLockBox.iFront;
-	const uint32 iVolumeFloats = iGetFormatFloats();
-
-	m_pPartialLockData = new float32[iLockWidth * iLockHeight * iLockDepth * iVolumeFloats];
+	m_pPartialLockData = new byte[iLockWidth * iLockHeight * iLockDepth * m_iPixelBytes];
 	if( !m_pPartialLockData )
 	{
 		FUNC_FAILING( "CMuli3DVolume::LockBox: memory allocation failed!\n" );
 		return e_outofmemory;
 	}
 	
-	float32 *pCurLockData = m_pPartialLockData;
-	for( uint32 iZ = m_PartialLockBox.iFront; iZ < m_PartialLockBox.iBack; ++iZ )
-	{
-		const float32 *pCurVolumeData2 = &m_pData[(iZ * m_iWidth * m_iHeight) * iVolumeFloats];
-		for( uint32 iY = m_PartialLockBox.iTop; iY < m_PartialLockBox.iBottom; ++iY )
-		{
-			const float32 *pCurVolumeData = &pCurVolumeData2[(iY * m_iWidth + m_PartialLockBox.iLeft) * iVolumeFloats];
-			memcpy( pCurLockData, pCurVolumeData, sizeof( float32 ) * iVolumeFloats * iLockWidth );
-			pCurLockData += iVolumeFloats * iLockWidth;
-		}
-	}
+	ReadBox( m_pPartialLockData, m_PartialLockBox );
 
 	*o_ppData = m_pPartialLockData;
 
@@ -258,24 +313,62 @@ result CMuli3DVolume::UnlockBox()
 	}
 
 	// update volume
-	const uint32 iLockWidth = m_PartialLockBox.iRight - m_PartialLockBox.iLeft;
-	const uint32 iVolumeFloats = iGetFormatFloats();
+	WriteBox( m_pPartialLockData, m_PartialLockBox );
 
-	const float32 *pCurLockData = m_pPartialLockData;
-	for( uint32 iZ = m_PartialLockBox.iFront; iZ < m_PartialLockBox.iBack; ++iZ )
+	SAFE_DELETE_ARRAY( m_pPartialLockData );
+
+	return s_ok;
+}
+
+void CMuli3DVolume::ReadBox( byte *o_pDest, const m3dbox &i_Box )
+{
+	const uint32 iBoxWidth = i_Box.iRight - i_Box.iLeft;
+	for( uint32 iZ = i_Box.iFront; iZ < i_Box.iBack; ++iZ )
 	{
-		float32 *pCurVolumeData2 = &m_pData[(iZ * m_iWidth * m_iHeight) * iVolumeFloats];
-		for( uint32 iY = m_PartialLockBox.iTop; iY < m_PartialLockBox.iBottom; ++iY )
+		for( uint32 iY = i_Box.iTop; iY < i_Box.iBottom; ++iY )
 		{
-			float32 *pCurVolumeData = &pCurVolumeData2[(iY * m_iWidth + m_PartialLockBox.iLeft) * iVolumeFloats];
-			memcpy( pCurVolumeData, pCurLockData, sizeof( float32 ) * iVolumeFloats * iLockWidth );
-			pCurLockData += iVolumeFloats * iLockWidth;
+			if( m_Layout == m3dtl_linear )
+			{
+				memcpy( o_pDest, &m_pData[iGetPixelIndex( i_Box.iLeft, iY, iZ ) * m_iPixelBytes], m_iPixelBytes * iBoxWidth );
+				o_pDest += m_iPixelBytes * iBoxWidth;
+				continue;
+			}
+
+			// Copy the row in spans, which don't cross brick boundaries
+			for( uint32 iX = i_Box.iLeft; iX < i_Box.iRight; )
+			{
+				uint32 iSpan = c_iTextureTileSize - iX % c_iTextureTileSize;
+				if( iSpan > i_Box.iRight - iX ) iSpan = i_Box.iRight - iX;
+				memcpy( o_pDest, &m_pData[iGetPixelIndex( iX, iY, iZ ) * m_iPixelBytes], m_iPixelBytes * iSpan );
+				o_pDest += m_iPixelBytes * iSpan; iX += iSpan;
+			}
 		}
 	}
+}
 
-	SAFE_DELETE_ARRAY( m_pPartialLockData );
+void CMuli3DVolume::WriteBox( const byte *i_pSrc, const m3dbox &i_Box )
+{
+	const uint32 iBoxWidth = i_Box.iRight - i_Box.iLeft;
+	for( uint32 iZ = i_Box.iFront; iZ < i_Box.iBack; ++iZ )
+	{
+		for( uint32 iY = i_Box.iTop; iY < i_Box.iBottom; ++iY )
+		{
+			if( m_Layout == m3dtl_linear )
+			{
+				memcpy( &m_pData[iGetPixelIndex( i_Box.iLeft, iY, iZ ) * m_iPixelBytes], i_pSrc, m_iPixelBytes * iBoxWidth );
+				i_pSrc += m_iPixelBytes * iBoxWidth;
+				continue;
+			}
 
-	return s_ok;
+			for( uint32 iX = i_Box.iLeft; iX < i_Box.iRight; )
+			{
+				uint32 iSpan = c_iTextureTileSize - iX % c_iTextureTileSize;
+				if( iSpan > i_Box.iRight - iX ) iSpan = i_Box.iRight - iX;
+				memcpy( &m_pData[iGetPixelIndex( iX, iY, iZ ) * m_iPixelBytes], i_pSrc, m_iPixelBytes * iSpan );
+				i_pSrc += m_iPixelBytes * iSpan; iX += iSpan;
+			}
+		}
+	}
 }
 
 uint32 CMuli3DVolume::iGetFormatFloats()
@@ -286,42 +379,53 @@ uint32 CMuli3DVolume::iGetFormatFloats()
 	case m3dfmt_r32g32f: return 2;
 	case m3dfmt_r32g32b32f: return 3;
 	case m3dfmt_r32g32b32a32f: return 4;
-	default: /* cannot happen */ return 0;
+	default: return 0; // compact format
 	}
 }
 
+uint32 CMuli3DVolume::iGetPixelBytes()
+{
+	return m_iPixelBytes;
+}
+
+m3dtexturelayout CMuli3DVolume::GetLayout()
+{
+	return m_Layout;
+}
+
 void CMuli3DVolume::SamplePoint( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW )
 {
 	const float32 fX = i_fU * m_iWidthMin1, fY = i_fV * m_iHeightMin1, fZ = i_fW * m_iDepthMin1;
-	const uint32 iPixelX = ftol( fX ), iPixelY = ftol( fY ), iPixelZ = ftol( fZ );
+	const uint32 iIndex = iGetPixelIndex( ftol( fX ), ftol( fY ), ftol( fZ ) );
 
 	switch( m_fmtFormat )
 	{
 	case m3dfmt_r32f:
 		{
-			const float32 *pPixel = &m_pData[iPixelZ * m_iWidth * m_iHeight + iPixelY * m_iWidth + iPixelX];
+			const float32 *pPixel = &((const float32 *)m_pData)[iIndex];
 			o_vColor = vector4( pPixel[0], 0, 0, 1 );
 		}
 		break;
 	case m3dfmt_r32g32f:
 		{
-			const vector2 *pPixel = (const vector2 *)&m_pData[2 * (iPixelZ * m_iWidth * m_iHeight + iPixelY * m_iWidth + iPixelX)];
+			const vector2 *pPixel = &((const vector2 *)m_pData)[iIndex];
 			o_vColor = vector4( pPixel->x, pPixel->y, 0, 1 );
 		}
 		break;
 	case m3dfmt_r32g32b32f:
 		{
-			const vector3 *pPixel = (const vector3 *)&m_pData[3 * (iPixelZ * m_iWidth * m_iHeight + iPixelY * m_iWidth + iPixelX)];
+			const vector3 *pPixel = &((const vector3 *)m_pData)[iIndex];
 			o_vColor = vector4( pPixel->x, pPixel->y, pPixel->z, 1 );
 		}
 		break;
 	case m3dfmt_r32g32b32a32f:
 		{
-			const vector4 *pPixel = (const vector4 *)&m_pData[4 * (iPixelZ * m_iWidth * m_iHeight + iPixelY * m_iWidth + iPixelX)];
+			const vector4 *pPixel = &((const vector4 *)m_pData)[iIndex];
 			o_vColor = *pPixel;
 		}
 		break;
-	default: // cannot happen
+	default: // compact formats
+		DecodePixel( o_vColor, m_fmtFormat, &m_pData[iIndex * m_iPixelBytes] );
 		break;
 	}
 }
@@ -336,22 +440,28 @@ void CMuli3DVolume::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV,
 	if( iPixelY2 >= m_iHeight ) iPixelY2 = m_iHeightMin1;
 	if( iPixelZ2 >= m_iDepth ) iPixelZ2 = m_iDepthMin1;
 
-	const uint32 iIndexRows[2] = { iPixelY * m_iWidth, iPixelY2 * m_iWidth };
-	const uint32 iIndexSlices[2] = { iPixelZ * m_iWidth * m_iHeight, iPixelZ2 * m_iWidth * m_iHeight };
+	const uint32 iIndices[8] =
+	{
+		iGetPixelIndex( iPixelX, iPixelY, iPixelZ ), iGetPixelIndex( iPixelX2, iPixelY, iPixelZ ),
+		iGetPixelIndex( iPixelX, iPixelY2, iPixelZ ), iGetPixelIndex( iPixelX2, iPixelY2, iPixelZ ),
+		iGetPixelIndex( iPixelX, iPixelY, iPixelZ2 ), iGetPixelIndex( iPixelX2, iPixelY, iPixelZ2 ),
+		iGetPixelIndex( iPixelX, iPixelY2, iPixelZ2 ), iGetPixelIndex( iPixelX2, iPixelY2, iPixelZ2 )
+	};
 	const float32 fInterpolation[3] = { fX - iPixelX, fY - iPixelY, fZ - iPixelZ };
 
 	switch( m_fmtFormat )
 	{
 	case m3dfmt_r32f:
 		{
+			const float32 *pPixelData = (const float32 *)m_pData;
 			float32 fColorSlices[2], fColorRows[2];
 
-			fColorRows[0] = fLerp( m_pData[iIndexSlices[0] + iIndexRows[0] + iPixelX], m_pData[iIndexSlices[0] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			fColorRows[1] = fLerp( m_pData[iIndexSlices[0] + iIndexRows[1] + iPixelX], m_pData[iIndexSlices[0] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			fColorRows[0] = fLerp( pPixelData[iIndices[0]], pPixelData[iIndices[1]], fInterpolation[0] );
+			fColorRows[1] = fLerp( pPixelData[iIndices[2]], pPixelData[iIndices[3]], fInterpolation[0] );
 			fColorSlices[0] = fLerp( fColorRows[0], fColorRows[1], fInterpolation[1] );
 
-			fColorRows[0] = fLerp( m_pData[iIndexSlices[1] + iIndexRows[0] + iPixelX], m_pData[iIndexSlices[1] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			fColorRows[1] = fLerp( m_pData[iIndexSlices[1] + iIndexRows[1] + iPixelX], m_pData[iIndexSlices[1] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			fColorRows[0] = fLerp( pPixelData[iIndices[4]], pPixelData[iIndices[5]], fInterpolation[0] );
+			fColorRows[1] = fLerp( pPixelData[iIndices[6]], pPixelData[iIndices[7]], fInterpolation[0] );
 			fColorSlices[1] = fLerp( fColorRows[1], fColorRows[1], fInterpolation[1] );
 
 			const float32 fFinalColor = fLerp( fColorSlices[0], fColorSlices[1], fInterpolation[2] );
@@ -363,17 +473,17 @@ void CMuli3DVolume::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV,
 		{
 			const vector2 *pPixelData = (const vector2 *)m_pData;
 
-			static vector2 vColorSlices[2], vColorRows[2];
+			vector2 vColorSlices[2], vColorRows[2];
 
-			vVector2Lerp( vColorRows[0], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector2Lerp( vColorRows[1], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			vVector2Lerp( vColorRows[0], pPixelData[iIndices[0]], pPixelData[iIndices[1]], fInterpolation[0] );
+			vVector2Lerp( vColorRows[1], pPixelData[iIndices[2]], pPixelData[iIndices[3]], fInterpolation[0] );
 			vVector2Lerp( vColorSlices[0], vColorRows[0], vColorRows[1], fInterpolation[1] );
 			
-			vVector2Lerp( vColorRows[0], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector2Lerp( vColorRows[1], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			vVector2Lerp( vColorRows[0], pPixelData[iIndices[4]], pPixelData[iIndices[5]], fInterpolation[0] );
+			vVector2Lerp( vColorRows[1], pPixelData[iIndices[6]], pPixelData[iIndices[7]], fInterpolation[0] );
 			vVector2Lerp( vColorSlices[1], vColorRows[0], vColorRows[1], fInterpolation[1] );
 
-			static vector2 vFinalColor; vVector2Lerp( vFinalColor, vColorSlices[0], vColorSlices[1], fInterpolation[2] );
+			vector2 vFinalColor; vVector2Lerp( vFinalColor, vColorSlices[0], vColorSlices[1], fInterpolation[2] );
 
 			o_vColor = vector4( vFinalColor.x, vFinalColor.y, 0, 1 );
 		}
@@ -382,17 +492,17 @@ void CMuli3DVolume::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV,
 		{
 			const vector3 *pPixelData = (const vector3 *)m_pData;
 
-			static vector3 vColorSlices[2], vColorRows[2];
+			vector3 vColorSlices[2], vColorRows[2];
 
-			vVector3Lerp( vColorRows[0], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector3Lerp( vColorRows[1], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			vVector3Lerp( vColorRows[0], pPixelData[iIndices[0]], pPixelData[iIndices[1]], fInterpolation[0] );
+			vVector3Lerp( vColorRows[1], pPixelData[iIndices[2]], pPixelData[iIndices[3]], fInterpolation[0] );
 			vVector3Lerp( vColorSlices[0], vColorRows[0], vColorRows[1], fInterpolation[1] );
 			
-			vVector3Lerp( vColorRows[0], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector3Lerp( vColorRows[1], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			vVector3Lerp( vColorRows[0], pPixelData[iIndices[4]], pPixelData[iIndices[5]], fInterpolation[0] );
+			vVector3Lerp( vColorRows[1], pPixelData[iIndices[6]], pPixelData[iIndices[7]], fInterpolation[0] );
 			vVector3Lerp( vColorSlices[1], vColorRows[0], vColorRows[1], fInterpolation[1] );
 
-			static vector3 vFinalColor; vVector3Lerp( vFinalColor, vColorSlices[0], vColorSlices[1], fInterpolation[2] );
+			vector3 vFinalColor; vVector3Lerp( vFinalColor, vColorSlices[0], vColorSlices[1], fInterpolation[2] );
 
 			o_vColor = vector4( vFinalColor.x, vFinalColor.y, vFinalColor.z, 1 );
 		}
@@ -401,20 +511,35 @@ void CMuli3DVolume::SampleLinear( vector4 &o_vColor, float32 i_fU, float32 i_fV,
 		{
 			const vector4 *pPixelData = (const vector4 *)m_pData;
 
-			static vector4 vColorSlices[2], vColorRows[2];
+			vector4 vColorSlices[2], vColorRows[2];
 
-			vVector4Lerp( vColorRows[0], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector4Lerp( vColorRows[1], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[0] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			vVector4Lerp( vColorRows[0], pPixelData[iIndices[0]], pPixelData[iIndices[1]], fInterpolation[0] );
+			vVector4Lerp( vColorRows[1], pPixelData[iIndices[2]], pPixelData[iIndices[3]], fInterpolation[0] );
 			vVector4Lerp( vColorSlices[0], vColorRows[0], vColorRows[1], fInterpolation[1] );
 			
-			vVector4Lerp( vColorRows[0], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[0] + iPixelX2], fInterpolation[0] );
-			vVector4Lerp( vColorRows[1], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX], pPixelData[iIndexSlices[1] + iIndexRows[1] + iPixelX2], fInterpolation[0] );
+			vVector4Lerp( vColorRows[0], pPixelData[iIndices[4]], pPixelData[iIndices[5]], fInterpolation[0] );
+			vVector4Lerp( vColorRows[1], pPixelData[iIndices[6]], pPixelData[iIndices[7]], fInterpolation[0] );
 			vVector4Lerp( vColorSlices[1], vColorRows[0], vColorRows[1], fInterpolation[1] );
 
 			vVector4Lerp( o_vColor, vColorSlices[0], vColorSlices[1], fInterpolation[2] );
 		}
 		break;
-	default: // cannot happen
+	default: // compact formats
+		{
+			vector4 vPixels[8];
+			for( uint32 iPixel = 0; iPixel < 8; ++iPixel )
+				DecodePixel( vPixels[iPixel], m_fmtFormat, &m_pData[iIndices[iPixel] * m_iPixelBytes] );
+
+			vector4 vColorSlices[2], vColorRows[2];
+			for( uint32 iSlice = 0; iSlice < 2; ++iSlice )
+			{
+				vVector4Lerp( vColorRows[0], vPixels[iSlice * 4 + 0], vPixels[iSlice * 4 + 1], fInterpolation[0] );
+				vVector4Lerp( vColorRows[1], vPixels[iSlice * 4 + 2], vPixels[iSlice * 4 + 3], fInterpolation[0] );
+				vVector4Lerp( vColorSlices[iSlice], vColorRows[0], vColorRows[1], fInterpolation[1] );
+			}
+
+			vVector4Lerp( o_vColor, vColorSlices[0], vColorSlices[1], fInterpolation[2] );
+		}
 		break;
 	}
 }
@@ -507,7 +632,7 @@ result CMuli3DVolume::CopyToVolume( const m3dbox *i_pSrcBox, CMuli3DVolume *i_pD
 		DestBox.iRight = i_pDestVolume->iGetWidth(); DestBox.iBottom = i_pDestVolume->iGetHeight(); DestBox.iBack = i_pDestVolume->iGetDepth();
 	}
 
-	float32 *pDestData = 0;
+	byte *pDestData = 0;
 	result resLock = i_pDestVolume->LockBox( (void **)&pDestData, i_pDestBox );
 	if( FUNC_FAILED( resLock ) )
 	{
@@ -515,16 +640,17 @@ result CMuli3DVolume::CopyToVolume( const m3dbox *i_pSrcBox, CMuli3DVolume *i_pD
 		return resLock;
 	}
 
-	const uint32 iDestFloats = i_pDestVolume->iGetFormatFloats();
+	const m3dformat fmtDestFormat = i_pDestVolume->fmtGetFormat();
+	const uint32 iDestPixelBytes = i_pDestVolume->iGetPixelBytes();
 	const uint32 iDestWidth = DestBox.iRight - DestBox.iLeft;
 	const uint32 iDestHeight = DestBox.iBottom - DestBox.iTop;
 	const uint32 iDestDepth = DestBox.iBack - DestBox.iFront;
 	
 	// direct copy possible?
-	if( !i_pSrcBox && !i_pDestBox && iDestFloats == iGetFormatFloats() &&
+	if( !i_pSrcBox && !i_pDestBox && fmtDestFormat == m_fmtFormat && m_Layout == m3dtl_linear &&
 		iDestWidth == m_iWidth && iDestHeight == m_iHeight && iDestDepth == m_iDepth )
 	{
-		memcpy( pDestData, m_pData, sizeof( float32 ) * iDestFloats * iDestWidth * iDestHeight * iDestDepth );
+		memcpy( pDestData, m_pData, iDestPixelBytes * iDestWidth * iDestHeight * iDestDepth );
 		i_pDestVolume->UnlockBox();
 		return s_ok;
 	}
@@ -540,21 +666,15 @@ result CMuli3DVolume::CopyToVolume( const m3dbox *i_pSrcBox, CMuli3DVolume *i_pD
 		for( uint32 y = 0; y < iDestHeight; ++y, fSrcV += fStepV )
 		{
 			float32 fSrcU = SrcBox.iLeft * fStepU;
-			for( uint32 x = 0; x < iDestWidth; ++x, fSrcU += fStepU, pDestData += iDestFloats )
+			for( uint32 x = 0; x < iDestWidth; ++x, fSrcU += fStepU, pDestData += iDestPixelBytes )
 			{
 				vector4 vSrcColor;
 				if( i_Filter == m3dtf_linear )
 					SampleLinear( vSrcColor, fSrcU, fSrcV, fSrcW );
 				else
 					SamplePoint( vSrcColor, fSrcU, fSrcV, fSrcW );
-				
-				switch( iDestFloats )
-				{
-				case 4: pDestData[3] = vSrcColor.a;
-				case 3: pDestData[2] = vSrcColor.b;
-				case 2: pDestData[1] = vSrcColor.g;
-				case 1: pDestData[0] = vSrcColor.r;
-				}
+
+				EncodePixel( pDestData, fmtDestFormat, vSrcColor );
 			}
 		}
 	}
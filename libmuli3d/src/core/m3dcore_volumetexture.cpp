@@ -19,6 +19,8 @@
 
 #include "../../include/core/m3dcore_volumetexture.h"
 #include "../../include/core/m3dcore_device.h"
+#include "../../include/core/m3dcore_mipmap.h"
+#include "../../include/core/m3dcore_pixelformat.h"
 #include "../../include/core/m3dcore_volume.h"
 
 CMuli3DVolumeTexture::CMuli3DVolumeTexture( CMuli3DDevice *i_pParent )
@@ -35,7 +37,7 @@ CMuli3DVolumeTexture::~CMuli3DVolumeTexture()
 	SAFE_DELETE_ARRAY( m_ppMipLevels );
 }
 
-result CMuli3DVolumeTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, uint32 i_iMipLevels, m3dformat i_fmtFormat )
+result CMuli3DVolumeTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i_iDepth, uint32 i_iMipLevels, m3dformat i_fmtFormat, m3dtexturelayout i_Layout )
 {
 	if( !i_iWidth || !i_iHeight || !i_iDepth )
 	{
@@ -43,7 +45,7 @@ result CMuli3DVolumeTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i
 		return e_invalidparameters;
 	}
 	
-	if( i_fmtFormat < m3dfmt_r32f || i_fmtFormat > m3dfmt_r32g32b32a32f )
+	if( !bIsTextureFormat( i_fmtFormat ) )
 	{
 		FUNC_FAILING( "CMuli3DVolumeTexture::Create: invalid format specified.\n" );
 		return e_invalidformat;
@@ -77,7 +79,7 @@ result CMuli3DVolumeTexture::Create( uint32 i_iWidth, uint32 i_iHeight, uint32 i
 	CMuli3DVolume **pCurMipLevel = m_ppMipLevels;
 	do
 	{
-		result resMipLevel = m_pParent->CreateVolume( pCurMipLevel, i_iWidth, i_iHeight, i_iDepth, i_fmtFormat );
+		result resMipLevel = m_pParent->CreateVolume( pCurMipLevel, i_iWidth, i_iHeight, i_iDepth, i_fmtFormat, i_Layout );
 		if( FUNC_FAILED( resMipLevel ) )
 		{
 			// destructor will perform cleanup
@@ -121,151 +123,43 @@ result CMuli3DVolumeTexture::GenerateMipSubLevels( uint32 i_iSrcLevel )
 		return e_invalidparameters;
 	}
 
+	CMuli3DThreadPool *pThreads = m_pParent->pAcquireMipThreads();
 	for( uint32 iLevel = i_iSrcLevel + 1; iLevel < m_iMipLevels; ++iLevel )
 	{
-		const float32 *pSrcData = 0;
+		const byte *pSrcData = 0;
 		result resLock = LockBox( iLevel - 1, (void **)&pSrcData, 0 );
 		if( FUNC_FAILED( resLock ) )
+		{
+			m_pParent->ReleaseMipThreads( pThreads );
 			return resLock;
+		}
 		
-		float32 *pDestData = 0;
+		byte *pDestData = 0;
 		resLock = LockBox( iLevel, (void **)&pDestData, 0 );
 		if( FUNC_FAILED( resLock ) )
 		{
-			UnlockBox( iLevel );
+			UnlockBox( iLevel - 1 );
+			m_pParent->ReleaseMipThreads( pThreads );
 			return resLock;
 		}
 
-		const uint32 iSrcDepth = iGetDepth( iLevel - 1 );
-		const uint32 iSrcHeight = iGetHeight( iLevel - 1 );
-		const uint32 iSrcWidth = iGetWidth( iLevel - 1 );
-
-		switch( fmtGetFormat() )
-		{
-		case m3dfmt_r32f:
-			{
-				for( uint32 iZ = 0; iZ < iSrcDepth; iZ += 2 )
-				{
-					const uint32 iIndexSlices[2] = { iZ * iSrcWidth * iSrcHeight, ( iZ + 1 ) * iSrcWidth * iSrcHeight };
-					for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-					{
-						const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-						for( uint32 iX = 0; iX < iSrcWidth; iX += 2, ++pDestData )
-						{
-							const float32 fSrcPixels[8] = 
-							{
-								pSrcData[iIndexSlices[0] + iIndexRows[0] + iX],
-								pSrcData[iIndexSlices[0] + iIndexRows[0] + iX + 1],
-								pSrcData[iIndexSlices[0] + iIndexRows[1] + iX],
-								pSrcData[iIndexSlices[0] + iIndexRows[1] + iX + 1],
-								pSrcData[iIndexSlices[1] + iIndexRows[0] + iX],
-								pSrcData[iIndexSlices[1] + iIndexRows[0] + iX + 1],
-								pSrcData[iIndexSlices[1] + iIndexRows[1] + iX],
-								pSrcData[iIndexSlices[1] + iIndexRows[1] + iX + 1]
-							};
-							*pDestData = ( fSrcPixels[0] + fSrcPixels[1] + fSrcPixels[2] + fSrcPixels[3] +
-								fSrcPixels[4] + fSrcPixels[5] + fSrcPixels[6] + fSrcPixels[7] ) * 0.125f;
-						}
-					}
-				}
-			}
-			break;
-
-		case m3dfmt_r32g32f:
-			{
-				for( uint32 iZ = 0; iZ < iSrcDepth; iZ += 2 )
-				{
-					const uint32 iIndexSlices[2] = { iZ * iSrcWidth * iSrcHeight, ( iZ + 1 ) * iSrcWidth * iSrcHeight };
-					for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-					{
-						const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-						for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 2 )
-						{
-							const vector2 *pSrcPixels[8] = 
-							{
-								&((vector2 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX],
-								&((vector2 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX + 1],
-								&((vector2 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX],
-								&((vector2 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX + 1],
-								&((vector2 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX],
-								&((vector2 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX + 1],
-								&((vector2 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX],
-								&((vector2 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX + 1]
-							};
-							*(vector2 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] +
-								*pSrcPixels[4] + *pSrcPixels[5] + *pSrcPixels[6] + *pSrcPixels[7] ) * 0.125f;
-						}
-					}
-				}
-			}
-			break;
-
-		case m3dfmt_r32g32b32f:
-			{
-				for( uint32 iZ = 0; iZ < iSrcDepth; iZ += 2 )
-				{
-					const uint32 iIndexSlices[2] = { iZ * iSrcWidth * iSrcHeight, ( iZ + 1 ) * iSrcWidth * iSrcHeight };
-					for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-					{
-						const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-						for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 3 )
-						{
-							const vector3 *pSrcPixels[8] = 
-							{
-								&((vector3 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX],
-								&((vector3 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX + 1],
-								&((vector3 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX],
-								&((vector3 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX + 1],
-								&((vector3 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX],
-								&((vector3 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX + 1],
-								&((vector3 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX],
-								&((vector3 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX + 1]
-							};
-							*(vector3 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] +
-								*pSrcPixels[4] + *pSrcPixels[5] + *pSrcPixels[6] + *pSrcPixels[7] ) * 0.125f;
-						}
-					}
-				}
-			}
-			break;
-
-		case m3dfmt_r32g32b32a32f:
-			{
-				for( uint32 iZ = 0; iZ < iSrcDepth; iZ += 2 )
-				{
-					const uint32 iIndexSlices[2] = { iZ * iSrcWidth * iSrcHeight, ( iZ + 1 ) * iSrcWidth * iSrcHeight };
-					for( uint32 iY = 0; iY < iSrcHeight; iY += 2 )
-					{
-						const uint32 iIndexRows[2] = { iY * iSrcWidth, ( iY + 1 ) * iSrcWidth };
-						for( uint32 iX = 0; iX < iSrcWidth; iX += 2, pDestData += 4 )
-						{
-							const vector4 *pSrcPixels[8] = 
-							{
-								&((vector4 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX],
-								&((vector4 *)pSrcData)[iIndexSlices[0] + iIndexRows[0] + iX + 1],
-								&((vector4 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX],
-								&((vector4 *)pSrcData)[iIndexSlices[0] + iIndexRows[1] + iX + 1],
-								&((vector4 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX],
-								&((vector4 *)pSrcData)[iIndexSlices[1] + iIndexRows[0] + iX + 1],
-								&((vector4 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX],
-								&((vector4 *)pSrcData)[iIndexSlices[1] + iIndexRows[1] + iX + 1]
-							};
-							*(vector4 *)pDestData = ( *pSrcPixels[0] + *pSrcPixels[1] + *pSrcPixels[2] + *pSrcPixels[3] +
-								*pSrcPixels[4] + *pSrcPixels[5] + *pSrcPixels[6] + *pSrcPixels[7] ) * 0.125f;
-						}
-					}
-				}
-			}
-			break;
-
-		default: // cannot happen
-			break;
-		}
+		m3dmipgeneration Generation;
+		Generation.fmtFormat = fmtGetFormat();
+		Generation.pSource = pSrcData;
+		Generation.pDestination = pDestData;
+		Generation.iSrcWidth = iGetWidth( iLevel - 1 );
+		Generation.iSrcHeight = iGetHeight( iLevel - 1 );
+		Generation.iSrcDepth = iGetDepth( iLevel - 1 );
+		Generation.iDestWidth = iGetWidth( iLevel );
+		Generation.iDestHeight = iGetHeight( iLevel );
+		Generation.iDestDepth = iGetDepth( iLevel );
+		GenerateMipLevel( Generation, pThreads );
 
 		UnlockBox( iLevel );
 		UnlockBox( iLevel - 1 );
 	}
 
+	m_pParent->ReleaseMipThreads( pThreads );
 	return s_ok;
 }
 
@@ -306,40 +200,60 @@ CMuli3DVolume *CMuli3DVolumeTexture::pGetMipLevel( uint32 i_iMipLevel )
 
 result CMuli3DVolumeTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
 {
-	uint32 iTexFilter = i_pSamplerStates[m3dtss_minfilter];
-	float32 fTexMipLevel = 0.0f;
+	float32 fTexMipLevel; uint32 iTexFilter;
+	ComputeMipLevel( fTexMipLevel, iTexFilter, i_pXGradient, i_pYGradient, i_pSamplerStates );
+	SampleMipLevel( o_vColor, i_fU, i_fV, i_fW, fTexMipLevel, iTexFilter, i_pSamplerStates[m3dtss_mipfilter] );
+	return s_ok;
+}
+
+result CMuli3DVolumeTexture::SampleTextureQuad( vector4 *o_pColors, const vector4 *i_pCoords, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	float32 fTexMipLevel; uint32 iTexFilter;
+	ComputeMipLevel( fTexMipLevel, iTexFilter, i_pXGradient, i_pYGradient, i_pSamplerStates );
+
+	const uint32 iMipFilter = i_pSamplerStates[m3dtss_mipfilter];
+	for( uint32 iPixel = 0; iPixel < 4; ++iPixel )
+		SampleMipLevel( o_pColors[iPixel], i_pCoords[iPixel].x, i_pCoords[iPixel].y, i_pCoords[iPixel].z, fTexMipLevel, iTexFilter, iMipFilter );
+
+	return s_ok;
+}
+
+void CMuli3DVolumeTexture::ComputeMipLevel( float32 &o_fMipLevel, uint32 &o_iTexFilter, const vector4 *i_pXGradient, const vector4 *i_pYGradient, const uint32 *i_pSamplerStates )
+{
+	o_iTexFilter = i_pSamplerStates[m3dtss_minfilter];
+	o_fMipLevel = 0.0f;
 	
 	if( i_pXGradient && i_pYGradient )
 	{
 		// Compute the mip-level and determine the texture filter type.
 		const float32 fLenXGrad = i_pXGradient->x * i_pXGradient->x * m_fSquaredWidth + i_pXGradient->y * i_pXGradient->y * m_fSquaredHeight + i_pXGradient->z * i_pXGradient->z * m_fSquaredDepth;
 		const float32 fLenYGrad = i_pYGradient->x * i_pYGradient->x * m_fSquaredWidth + i_pYGradient->y * i_pYGradient->y * m_fSquaredHeight + i_pYGradient->z * i_pYGradient->z * m_fSquaredDepth;
-		const float32 fTexelsPerScreenPixel = sqrtf( fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad );
+		const float32 fSquaredTexelsPerScreenPixel = fLenXGrad > fLenYGrad ? fLenXGrad : fLenYGrad;
 
-		if( fTexelsPerScreenPixel <= 1.0f )
+		if( fSquaredTexelsPerScreenPixel <= 1.0f )
 		{
 			 // if fTexelsPerScreenPixel < 1.0f -> magnification, no mipmapping needed
-			fTexMipLevel = 0.0f;
-			iTexFilter = i_pSamplerStates[m3dtss_magfilter];
+			o_iTexFilter = i_pSamplerStates[m3dtss_magfilter];
 		}
 		else
 		{
-			// minification, need mipmapping
-			static const float32 fInvLog2 = 1.0f / logf( 2.0f ); // calculate log2
-			fTexMipLevel = logf( fTexelsPerScreenPixel ) * fInvLog2;
-			iTexFilter = i_pSamplerStates[m3dtss_minfilter];
+			// minification, need mipmapping: log2( sqrt( x ) ) = 0.5 * log2( x )
+			o_fMipLevel = 0.5f * fFastLog2( fSquaredTexelsPerScreenPixel );
 		}
 	}
+}
 
-	if( i_pSamplerStates[m3dtss_mipfilter] == m3dtf_linear )
+void CMuli3DVolumeTexture::SampleMipLevel( vector4 &o_vColor, float32 i_fU, float32 i_fV, float32 i_fW, float32 i_fMipLevel, uint32 i_iTexFilter, uint32 i_iMipFilter )
+{
+	if( i_iMipFilter == m3dtf_linear )
 	{
-		uint32 iMipLevelA = ftol( fTexMipLevel );
+		uint32 iMipLevelA = ftol( i_fMipLevel );
 		uint32 iMipLevelB = iMipLevelA + 1;
 		if( iMipLevelA >= m_iMipLevels ) iMipLevelA = m_iMipLevels - 1;
 		if( iMipLevelB >= m_iMipLevels ) iMipLevelB = m_iMipLevels - 1;
 
 		vector4 vColorA, vColorB;
-		if( iTexFilter == m3dtf_linear )
+		if( i_iTexFilter == m3dtf_linear )
 		{
 			m_ppMipLevels[iMipLevelA]->SampleLinear( vColorA, i_fU, i_fV, i_fW );
 			m_ppMipLevels[iMipLevelB]->SampleLinear( vColorB, i_fU, i_fV, i_fW );
@@ -350,21 +264,19 @@ result CMuli3DVolumeTexture::SampleTexture( vector4 &o_vColor, float32 i_fU, flo
 			m_ppMipLevels[iMipLevelB]->SamplePoint( vColorB, i_fU, i_fV, i_fW );
 		}
 
-		float32 fInterpolation = fTexMipLevel - iMipLevelA;  // TODO: not accurate
+		float32 fInterpolation = i_fMipLevel - iMipLevelA;  // TODO: not accurate
 		vVector4Lerp( o_vColor, vColorA, vColorB, fInterpolation );
 	}
 	else
 	{
-		uint32 iMipLevel = ftol( fTexMipLevel );
+		uint32 iMipLevel = ftol( i_fMipLevel );
 		if( iMipLevel >= m_iMipLevels ) iMipLevel = m_iMipLevels - 1;
 
-		if( iTexFilter == m3dtf_linear )
+		if( i_iTexFilter == m3dtf_linear )
 			m_ppMipLevels[iMipLevel]->SampleLinear( o_vColor, i_fU, i_fV, i_fW );
 		else
 			m_ppMipLevels[iMipLevel]->SamplePoint( o_vColor, i_fU, i_fV, i_fW );
 	}
-
-	return s_ok;
 }
 
 m3dformat CMuli3DVolumeTexture::fmtGetFormat()
@@ -57,6 +57,54 @@ public:
 
 		return true;
 	}
+
+	uint32 iGetBatchSize() { return 8; }
+	void ExecuteBatch( m3dpixelbatch &io_Batch, uint32 &io_iLaneMask )
+	{
+		const float32 *pConstX = io_Batch.Inputs[0].x, *pConstY = io_Batch.Inputs[0].y;
+
+		float32 fZ0X[8], fZ0Y[8], fZ1X, fZ1Y;
+		uint32 iActive = 0xff;
+		for( uint32 iLane = 0; iLane < 8; ++iLane )
+		{
+			fZ0X[iLane] = pConstX[iLane];
+			fZ0Y[iLane] = pConstY[iLane];
+		}
+
+		// Iterate all lanes in lockstep; lanes that have escaped are masked out.
+		for( uint32 i = 0; i < (MANDELBROT_ITERATIONS / 2) && iActive; ++i )
+		{
+			for( uint32 iLane = 0; iLane < 8; ++iLane )
+			{
+				if( !( iActive & ( 1 << iLane ) ) )
+					continue;
+
+				// ping
+				fZ1X = fZ0X[iLane] * fZ0X[iLane] - fZ0Y[iLane] * fZ0Y[iLane] + pConstX[iLane];
+				fZ1Y = 2.0f * fZ0X[iLane] * fZ0Y[iLane] + pConstY[iLane];
+				// pong
+				fZ0X[iLane] = fZ1X * fZ1X - fZ1Y * fZ1Y + pConstX[iLane];
+				fZ0Y[iLane] = 2.0f * fZ1X * fZ1Y + pConstY[iLane];
+
+				if( fZ0X[iLane] * fZ0X[iLane] + fZ0Y[iLane] * fZ0Y[iLane] >= 4.0f )
+					iActive &= ~( 1 << iLane );
+			}
+		}
+
+		for( uint32 iLane = 0; iLane < 8; ++iLane )
+		{
+			if( !( io_iLaneMask & ( 1 << iLane ) ) )
+				continue;
+
+			const float32 fColor = 1.0f - powf( 2.0f, -2.0f * ( fZ0X[iLane] * fZ0X[iLane] + fZ0Y[iLane] * fZ0Y[iLane] ) );
+			vector4 vColor;
+			SampleTexture( vColor, 0, fColor, 0 );
+			io_Batch.Color.x[iLane] = vColor.r;
+			io_Batch.Color.y[iLane] = vColor.g;
+			io_Batch.Color.z[iLane] = vColor.b;
+			io_Batch.Color.w[iLane] = vColor.a;
+		}
+	}
 };
 
 m3dvertexelement VertexDeclaration[] =
@@ -184,6 +184,13 @@ public:
 		o_pOutput[0] = i_pInput[0];
 	}
 
+	uint32 iGetBatchSize() { return 8; }
+	void ExecuteBatch( m3dvertexbatch &io_Batch, uint32 i_iNumVertices )
+	{
+		TransformBatch( io_Batch.Position, io_Batch.Inputs[0], matGetMatrix( m3dsc_wvpmatrix ) );
+		io_Batch.Outputs[0] = io_Batch.Inputs[0];
+	}
+
 	m3dshaderregtype GetOutputRegisters( uint32 i_iRegister )
 	{
 		switch( i_iRegister )
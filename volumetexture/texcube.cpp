@@ -205,7 +205,7 @@ bool CTexCube::bInitialize()
 	m_pPixelShader = new CTexCubePS;
 
 	// Create the volume texture ----------------------------------------------
-	if( FUNC_FAILED( pM3DDevice->CreateVolumeTexture( &m_pVolumeTexture, 32, 32, 32, 1, m3dfmt_r32g32b32f ) ) )
+	if( FUNC_FAILED( pM3DDevice->CreateVolumeTexture( &m_pVolumeTexture, 32, 32, 32, 1, m3dfmt_r32g32b32f, m3dtl_tiled ) ) )
 		return false;
 
 	vector3 *pVolume = 0;